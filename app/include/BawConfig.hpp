@@ -1,7 +1,9 @@
 #pragma once
 #include <string>
 #include <filesystem>
+#include <chrono>
 #include "config.h"
+#include "concurrency/affinity.hpp"
 
 namespace k3yab::bawns{
 
@@ -21,12 +23,46 @@ struct Config{
 	//This is in ms.
 	static constexpr unsigned long response_timeout = 15 * 1000;
 
+	//Exports are written through a buffer of this size, so that a big network goes out in big writes
+	static constexpr std::streamsize export_buffer_size = 1 << 20;
+
+	//Netrom quality assumed for every link, including our own port, since the state file has no per-link quality yet.
+	//192 is the customary quality for a neighbour heard on a radio port.
+	static constexpr unsigned char default_link_quality = 192;
+
+	//Enough for the query threads' priorities to have a good spread to choose from, without reading all of stdin up front
+	static constexpr std::size_t default_queue_limit = 1 << 16;
+
+	//Query threads beyond the minimum go after this long without a node to query
+	static constexpr std::chrono::seconds thread_keepalive{30};
+
+	//How often the progress dashboard is redrawn on a terminal, or printed as a line when output isn't one
+	static constexpr std::chrono::seconds dashboard_interval{1};
+	static constexpr std::chrono::seconds dashboard_log_interval{60};
+
 	std::string local_address; //local address to bind to, which will typically be the user's callsign, usually hyphenated
-	int threads = 1; 
+	int threads = 1; 	//Most query threads at once. The pool grows toward this while they're waiting on the network...
+	int min_threads = 1;	//...and shrinks back to this when there's nothing to query
+	levitator::concurrency::Affinity placement;	//Which CPUs the query threads go on, if it matters
+	std::chrono::seconds stats_interval{0};	//How often to print the query threads' statistics, if at all
+	std::filesystem::path event_path;	//Binary event log of the crawl, if wanted, for baw-log to read
+	bool dashboard = true;		//Show progress as one line, rather than every query's progress in full
+	std::string log_levels;		//Console log levels as given, already applied. See jab::util::LogChannel::configure.
+	std::size_t queue_limit = default_queue_limit;	//Max nodes queued up for the query threads before reading more input waits for them
 	std::filesystem::path state_path = default_state_path; 
+	bool checksums = true;	//Whether a newly created state file gets record checksums
+	std::string export_format;	//If set, export the state file in this format instead of crawling
+	std::string route_metric;	//If set, print routes from our port by this metric instead of crawling
+	std::string nr_port;		//If set, generate nrparms commands for routes out of this AX.25 port instead of crawling
+	bool dry_run = false;		//Check the nrparms commands against a stand-in routing table, but don't record them as emitted
+	std::filesystem::path output_path;	//Where exports, routes and commands go. Empty for stdout.
 
 	Config(int argc, char *argv[]);
 	static void show_usage(int argc, char *argv[]);
+	bool exporting() const;
+	bool routing() const;
+	bool generating() const;
+	bool offline() const;	//Just working with the state file, not going on the air
 
 };
 
@@ -4,7 +4,12 @@
 #include <stdexcept>
 #include <filesystem>
 #include <regex>
+#include <memory>
 #include "concurrency/thread_pool.hpp"
+#include "Socket.hpp"
+#include "event_log.hpp"
+#include "events.hpp"
+#include "dashboard.hpp"
 #include "BawConfig.hpp"
 #include "state_file.hpp"
 
@@ -12,22 +17,44 @@
 namespace k3yab::bawns{
 
 using path_type = std::filesystem::path;
+using session_stream = jab::file::File_iostream<char, jab::file::Socket>;
 
 class baw{
     bawns::Config m_config;
 	bawns::state::StateFile m_state;
+	std::unique_ptr<levitator::EventLog> m_events;	//If the config asks for one
+	CrawlCounters m_counters;
+
+	void open_existing_state();
+
+	//Call f(std::ostream &) with the configured output stream
+	template<typename F>
+	void write_output( F &&f );
 
 public:
 	baw() = default;
     baw( const bawns::Config &config );
 
 	void run();
+	void export_state();
+	void print_routes();
+	void generate_nrparms();
 	const bawns::Config &config() const;
 	bawns::state::StateFile &state();
 	const bawns::state::StateFile &state() const;
+	levitator::EventLog *events() const;	//Null if there's no event log
+	CrawlCounters &counters();
 	static void send_command( std::ostream &stream, const std::string &);
 };
 
+//What a node_task found
+struct node_result{
+	std::string callsign;
+	unsigned depth = 0;
+	bool answered = false;					//Whether the node was explored to completion
+	std::vector<std::string> neighbours;	//Nodes it listed as reachable from it
+};
+
 //A thread pool task that visits a node
 class node_task{
 
@@ -35,11 +62,20 @@ class node_task{
 
 	baw *m_appp;
 	std::string m_callsign;
+	unsigned m_depth = 0;		//Hops out from our own port, as far as we know. Roots are 0.
+	bool m_answered = false;	//Whether the node has been explored to completion before
+	std::uint32_t m_subject = 0;	//m_callsign in the event log
+	events::stage m_stage = events::connecting;
+	levitator::concurrency::Promise<node_result> m_done;
 
 	std::string parse_callsign(std::string &str) const;
 
-	//Main process
-	int run();
+	//To the event log, if there is one, about this node
+	void log( events::type type, std::int64_t a = 0, std::int64_t b = 0 ) const;
+	void count( counters::counter c, std::int64_t n = 1 ) const;
+
+	//Main process. Returns the nodes reachable from this one.
+	std::vector<std::string> run();
 
 	//Eat stream data until there is an RX timeout
 	void eat_stream( std::istream &stream );
@@ -50,13 +86,25 @@ class node_task{
 
 	//The KPC3P BBS appliance has a long-form J command which lists
 	//all known hosts and their via. 
-	route_result_type try_j_l_command( std::iostream &stream );
+	route_result_type try_j_l_command( session_stream &stream );
 
-	bool bbs_mode( std::iostream &stream );
+	bool bbs_mode( session_stream &stream );
 
 public:
+	//For PriorityThreadPool. Nearer nodes go first, and among those, ones which have answered before go ahead of ones
+	//which never have, since they're likelier to be worth the connection attempt. Terminate tasks go last.
+	struct priority_order{
+		bool operator()( const node_task &a, const node_task &b ) const;
+	};
+
 	node_task(); //terminate worker thread
-	node_task( baw &app, const std::string &call);
+	node_task( baw &app, const std::string &call, unsigned depth = 0, bool answered = false );
+
+	//Smaller goes first
+	unsigned rank() const;
+
+	//Set on the query thread once the task has run, so a continuation given to this runs there too
+	levitator::concurrency::Future<node_result> result() const;
 
 	jab::util::Console::out_type print() const;
 	int operator()();	
@@ -0,0 +1,70 @@
+#pragma once
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include "concurrency/thread_counters.hpp"
+#include "sheduler.hpp"
+
+namespace k3yab::bawns{
+
+//What the query threads count as they go, for the dashboard and the totals at the end
+namespace counters{
+
+enum counter : std::size_t{
+	active,			//Connections open now
+	finished,		//Nodes queried, whether they answered or not
+	answered,
+	discovered,		//New to the state file
+	bytes_in,
+	bytes_out,
+	timeouts,
+	errors,
+	counter_count
+};
+
+}
+
+using CrawlCounters = levitator::concurrency::ThreadCounters<counters::counter_count>;
+
+//One line of how the crawl is going, redrawn in place on a terminal at a fixed rate by a thread of its own.
+//Otherwise, as when output goes to a file, it's printed as a line of its own now and then.
+//Rates are over the last minute, and the ETA is the backlog at that rate, so it's only as good as the crawl is steady.
+class Dashboard{
+public:
+	using clock_type = std::chrono::steady_clock;
+	static constexpr std::chrono::seconds rate_window{60};
+
+	struct sources{
+		const CrawlCounters &counters;
+		std::function<std::size_t ()> backlog;		//Nodes waiting for a query thread
+		std::function<std::size_t ()> threads;		//Query threads running
+	};
+
+private:
+	struct sample{
+		clock_type::time_point time;
+		CrawlCounters::snapshot_type values;
+	};
+
+	sources m_sources;
+	const clock_type::time_point m_start = clock_type::now();
+	const bool m_terminal;
+	const clock_type::duration m_interval;
+	std::deque<sample> m_samples;		//Over the rate window, oldest first
+	std::optional<levitator::Scheduler<std::function<void ()>>> m_timer;
+
+	void refresh();
+	std::string render( const sample &now ) const;
+
+public:
+	//Redraws every terminal_interval on a terminal, or prints every log_interval otherwise
+	Dashboard( const sources &src, clock_type::duration terminal_interval, clock_type::duration log_interval );
+	~Dashboard();
+
+	Dashboard( const Dashboard & ) = delete;
+	Dashboard &operator=( const Dashboard & ) = delete;
+};
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <string_view>
+#include "event_log.hpp"
+
+//What baw writes to its event log (-e), and baw-log reads back.
+//Subjects are interned callsigns. Callsigns in a or b are interned ids too.
+namespace k3yab::bawns::events{
+
+enum type : std::uint16_t{
+	connect = 1,	//Connected to subject. a is its depth.
+	bytes,			//A query's traffic, when the connection goes. a received, b sent.
+	prompt,			//subject gave a command prompt. a is the stage.
+	discovered,		//subject is new to the state file. a is the callsign which listed it, b its depth.
+	edge,			//subject listed a as reachable from it
+	timeout,		//subject didn't answer in time. a is the stage, b the receive timeouts on its connection so far.
+	error,			//The query of subject was abandoned. a is the stage it got to.
+	type_count
+};
+
+//Which part of a query an event happened in
+enum stage : std::int64_t{
+	connecting = 1,
+	bbs,			//Getting into BBS mode
+	routes,			//Listing routes with J L
+	stage_count
+};
+
+constexpr std::array<std::string_view, type_count> type_names{
+	"name", "connect", "bytes", "prompt", "discovered", "edge", "timeout", "error"
+};
+
+constexpr std::array<std::string_view, stage_count> stage_names{
+	"none", "connecting", "bbs", "routes"
+};
+
+static_assert( type_names[levitator::event_record::name_type] == "name" );
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <ostream>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include "state_file.hpp"
+
+namespace k3yab::bawns{
+
+class ExportError:public std::invalid_argument{
+	using base_type = std::invalid_argument;
+
+public:
+	using base_type::base_type;
+};
+
+//Streams the nodes and links of a state file out as a graph in some interchange format.
+//It's one sequential pass over the file and each node is written along with its links,
+//so memory use doesn't depend on the size of the network.
+class Exporter{
+public:
+	using node_type = state_file_blocks::node;
+
+	static constexpr char format_names[] = "csv, ndjson, graphml, dot";
+
+	virtual ~Exporter() = default;
+
+	//Throws ExportError for an unrecognized format name
+	static std::unique_ptr<Exporter> make( const std::string &format );
+
+	void write( const state::StateFile &state, std::ostream &stream );
+
+protected:
+	virtual void begin( std::ostream &stream ){}
+	virtual void node( std::ostream &stream, const node_type &n ) = 0;
+	virtual void edge( std::ostream &stream, const node_type &from, const node_type &to ) = 0;
+	virtual void end( std::ostream &stream ){}
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <ostream>
+#include "state_file.hpp"
+#include "routes.hpp"
+
+namespace k3yab::bawns::routing{
+
+//One entry in the kernel's Netrom tables
+struct nr_entry{
+	using record_type = state_file_blocks::route_record;
+	using kind_type = record_type::kind_type;
+
+	kind_type kind;
+	std::string callsign;
+	std::string neighbour;	//Same as callsign for a route to a neighbour
+	std::string ident;		//Netrom alias. Only meaningful for nodes.
+	std::string port;
+	quality_type quality;
+
+	nr_entry( kind_type kind, const std::string &callsign, const std::string &neighbour, const std::string &port, quality_type quality );
+	nr_entry( const record_type &record );
+	record_type record() const;
+	bool operator==( const nr_entry & ) const = default;
+
+	//What we call a node when we don't know its alias: the callsign without its SSID, cut to Netrom's six characters
+	static std::string default_ident( const std::string &callsign );
+};
+
+struct nr_command{
+	//Obsolescence count given to every node we add, which is Netrom's customary initial value
+	static constexpr int obsolescence_count = 6;
+
+	bool add;
+	nr_entry entry;
+};
+
+//Formats as an nrparms invocation
+std::ostream &operator<<( std::ostream &stream, const nr_command &cmd );
+
+//A stand-in for the kernel's Netrom tables, following the same rules that nrparms runs into there.
+//Adding an entry which exists updates its quality, a node can only be added by way of a known neighbour,
+//and a neighbour can't be deleted while nodes are routed through it.
+class RoutingTable{
+	using key_type = std::tuple<char, std::string, std::string, std::string>;	//kind, callsign, neighbour, port
+	std::map<key_type, nr_entry> m_entries;
+
+	static key_type key( const nr_entry &e );
+	bool routes_through( const nr_entry &route ) const;
+
+public:
+	RoutingTable() = default;
+	RoutingTable( const std::vector<state_file_blocks::route_record> &records );
+
+	//The table that sends each node reachable in routes by way of its first hop, out of the named port.
+	//routes must be by quality, since that's what the table holds.
+	RoutingTable( const RouteGraph &graph, const route_tree &routes, const std::string &port );
+
+	std::size_t size() const;
+	bool operator==( const RoutingTable &rhs ) const;
+	std::vector<state_file_blocks::route_record> records() const;
+
+	//Throws RoutingError where the kernel would refuse the command
+	void apply( const nr_command &cmd );
+	void apply( const std::vector<nr_command> &cmds );
+
+	//The commands which turn this table into target. New neighbours are added before the nodes
+	//which use them, and old ones are deleted after the nodes which used them.
+	std::vector<nr_command> diff( const RoutingTable &target ) const;
+};
+
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <unordered_map>
+#include "state_file.hpp"
+
+namespace k3yab::bawns::routing{
+
+class RoutingError:public std::invalid_argument{
+	using base_type = std::invalid_argument;
+
+public:
+	using base_type::base_type;
+};
+
+enum class metric{
+	hops,		//Fewest hops, which is a BFS
+	quality		//Best Netrom path quality, where each hop scales the quality by link quality / 256
+};
+
+using index_type = std::uint32_t;
+using quality_type = std::uint8_t;
+
+//Shortest paths from one source, or from our own port, to every node in a graph.
+//Nodes are identified by their index in the graph.
+struct route_tree{
+	static constexpr index_type none = ~index_type(0);
+
+	metric by;
+	std::vector<index_type> parent;		//Previous hop toward the source, none for sources and unreachable nodes
+	std::vector<std::uint32_t> cost;	//Hop count, or path quality. Zero quality means unreachable.
+
+	bool reachable( index_type n ) const;
+
+	//The source from which n is reached. For local routes that's the neighbour on our port to route n by.
+	index_type first_hop( index_type n ) const;
+
+	//Source first, n last. Empty if n is unreachable.
+	std::vector<index_type> path( index_type n ) const;
+};
+
+//The discovered network as a CSR (compressed sparse row) adjacency, so that a whole route computation
+//runs over a few flat arrays rather than chasing links through the state file.
+//It's a snapshot, so rebuild it after a crawl has added to the file.
+class RouteGraph{
+	std::vector<std::string> m_callsigns;
+	std::unordered_map<std::string, index_type> m_index;
+	std::vector<index_type> m_roots;		//Nodes heard directly on our port
+	std::vector<index_type> m_row;			//Edges out of node n are m_row[n] up to m_row[n+1]
+	std::vector<index_type> m_column;		//Edge targets
+	std::vector<quality_type> m_quality;	//Edge qualities
+
+	void tree_by_hops( route_tree &tree, const std::vector<index_type> &sources, std::uint32_t source_cost ) const;
+	void tree_by_quality( route_tree &tree, const std::vector<index_type> &sources, std::uint32_t source_cost ) const;
+	route_tree tree( const std::vector<index_type> &sources, metric by, std::uint32_t source_cost ) const;
+
+public:
+	//The state file doesn't record link qualities, so every link gets link_quality for now
+	RouteGraph( const state::StateFile &state, quality_type link_quality );
+
+	std::size_t size() const;
+	std::size_t edge_count() const;
+	const std::string &callsign( index_type n ) const;
+	index_type index( const std::string &callsign ) const;	//Throws RoutingError for an unknown node
+	const std::vector<index_type> &roots() const;
+
+	//Netrom's combination of the quality so far with that of the next hop
+	static quality_type combine( std::uint32_t path_quality, quality_type link_quality );
+
+	//Routes as seen from our own port, where every root node is a first hop
+	//reached over a link of port_quality
+	route_tree local_routes( metric by, quality_type port_quality ) const;
+
+	//One tree per source, spread across up to thread_count threads.
+	//Throws RoutingError for an unknown source.
+	std::vector<route_tree> routes_from( const std::vector<index_type> &sources, metric by, unsigned int thread_count ) const;
+};
+
+}
@@ -1,9 +1,12 @@
 #pragma once
+#include <array>
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <stdexcept>
 #include <list>
 #include <map>
+#include <vector>
 #include "util.hpp"
 #include "concurrency/thread_pool.hpp"
 #include "binary_file.hpp"
@@ -55,12 +58,49 @@ struct node{
 	
 	file_ptr<levitator::binfile::blocks::linked_list<node>> link_list;			//First link in a linked list of nodes found reachable from this one	
 	int query_count = 0;														//Number of times the node has been explored to completion, may be zero
+	std::uint32_t checksum = 0;													//CRC32C of the fields above, refreshed by seal()
 	record_end rend;
 
 	node( const std::string &callsign );
+	std::uint32_t compute_checksum() const;
+	void seal();	//Call after modifying the node
+	void verify( bool check_sum ) const;
+};
+
+//One Netrom routing table entry, as last emitted as a command
+struct route_record{
+	enum kind_type:char{
+		route = 'R',		//A neighbour on one of our ports, nrparms -routes
+		node = 'N'			//A destination and the neighbour to reach it by, nrparms -nodes
+	};
+
+	record_start rstart;
+	char kind = node;
+	callsign_type callsign;
+	callsign_type neighbour;
+	callsign_type ident;
+	callsign_type port;		//AX.25 port name. Not a callsign, but it's a short string all the same.
+	std::uint8_t quality = 0;
+	record_end rend;
+
 	void verify() const;
 };
 
+//The route records follow this immediately in the file.
+//It's rewritten in place as long as the records fit, and otherwise abandoned for a bigger one.
+struct route_set{
+	record_start rstart;
+	std::uint32_t count = 0;
+	std::uint32_t capacity = 0;
+	std::uint32_t checksum = 0;		//CRC32C of the count and the records
+	record_end rend;
+
+	route_record *records();
+	const route_record *records() const;
+	std::uint32_t compute_checksum() const;
+	void verify( bool check_sum ) const;
+};
+
 #define STATE_FILE_HEADER_ID "W00T"
 
 struct header{
@@ -68,7 +108,13 @@ struct header{
 	//using node_list_pointer_type = file_ptr<node_list_type>;
 
 	static constexpr char identifier_string[] = STATE_FILE_HEADER_ID;
-	static constexpr int current_file_version = 1;
+	static constexpr int current_file_version = 3;
+
+	enum flag_bits{
+		record_checksums = 1,	//Per-record and whole-file checksums are verified
+		clean_close = 2			//Written by the destructor, so the whole-file checksum covers the whole of what's there.
+								//Cleared once the file's open, so a run which dies leaves it unset.
+	};
 
 	record_start rstart;
 	char identifier[ sizeof(identifier_string) ] = STATE_FILE_HEADER_ID;
@@ -77,8 +123,13 @@ struct header{
 	int visit_serial = 1;	//A serial number to discern which nodes have been visited
 							//nodes with a lesser visit number are considered to need visiting
 	node_list_type all_nodes, root_nodes;
+	file_ptr<route_set> emitted_routes;	//The routing table as of the last set of commands generated
+	int flags = 0;
+	std::uint32_t file_checksum = 0;	//CRC32C of the whole file image, with this field taken as zero
 	record_end rend;
 
+	bool checksums() const;
+	bool closed_cleanly() const;
 	void verify() const;
 };
 
@@ -157,19 +208,39 @@ class StateFile{
 	using node_map_type = std::map<std::string, offset_ptr<node_type>>;	
 	using node_pointer_type = state_file_blocks::file_ptr<node_type>;
 	using node_list_type = state_file_blocks::header::node_list_type;
+	using link_type = typename node_list_type::link_type;
 	using BinaryFile = levitator::binfile::BinaryFile;
 	using node_list_view_type = levitator::binfile::linked_list_view< offset_ptr< typename node_list_type::link_type >, BinaryFile::allocator<node_type> >;		
 
+	//A node the file was opened with. By offset rather than offset_ptr, which has to lock the file to be copied.
+	struct index_entry{
+		using key_type = std::array<char, sizeof(state_file_blocks::callsign_type)>;
+		key_type callsign;		//Zero-padded, so compared whole
+		std::streamoff offset;
+
+		bool operator<( const index_entry &rhs ) const{
+			return callsign < rhs.callsign;
+		}
+	};
+
 	struct State{
 		std::fstream stream;
 		BinaryFile bfile;
 		std::filesystem::path file_path;
 		node_list_view_type file_nodes;	//All nodes, as stored in the file
-		node_map_type nodes;			//In-memory index of nodes, indexed by callsign
+		std::vector<index_entry> loaded_nodes;	//In-memory index of the nodes the file was opened with, sorted by callsign
+		node_map_type nodes;			//In-memory index of nodes appended since, indexed by callsign
 		std::list<offset_ptr<node_type>> pending;		
 	} m_state;
 
+	static index_entry::key_type index_key( const char *callsign, std::size_t length );
+	offset_ptr<node_type> find_loaded( const std::string &callsign ) const;
 	void insert_all_nodes_node(node_type &n);
+	void bind_views();
+	void load_nodes();
+	std::uint32_t compute_file_checksum() const;
+	void verify_file_checksum() const;
+	bool whole_file_checksum() const;	//Whether the file's checksum can be gone by, which warns if it can't
 
 public:
 	using iterator_type = decltype( std::declval<typename node_list_view_type::iterator_type>().lock( std::declval<BinaryFile::locked_ref<>>() ) );
@@ -177,9 +248,13 @@ public:
 	//using iterator_type = state_file_blocks::header::node_list_type::iterator_type::rebind_for_lock< BinaryFile::locked_ref<> >;
 	//using const_iterator_type = state_file_blocks::header::node_list_type::const_iterator_type::rebind_for_lock< BinaryFile::const_locked_ref<> >;
 
+	//Nodes are verified and indexed in slabs of this many, spread across a thread pool, when a file is opened.
+	//Big enough that queueing a slab is negligible next to verifying it.
+	static constexpr std::size_t verify_slab_size = 16384;
+
 	//StateFile();	//uninitialized and invalid state file
 	StateFile() = default;
-	StateFile( const std::filesystem::path & );
+	StateFile( const std::filesystem::path &, bool checksums = true );	//checksums only applies to new files
 	~StateFile();
 	StateFile &operator=( StateFile && );
 	//auto pending = jab::util::range_property( [this](){ return this->m_state.pending.begin(); }, [this](){ return this->m_state.pending.end(); });
@@ -190,8 +265,47 @@ public:
 	iterator_type end();
 	BinaryFile::locked_ref<state_file_blocks::header> header();
 	BinaryFile::locked_ref<const state_file_blocks::header> header() const;
-	node_pointer_type append_node(const std::string &callsign);
-	node_pointer_type append_root_node( const std::string &callsign );
+	void flush();
+	offset_ptr<node_type> append_node(const std::string &callsign);
+	offset_ptr<node_type> append_root_node( const std::string &callsign );	//A node heard directly on our own port
+
+	//Makes a node that's already in the file a root as well. It mustn't be one already.
+	void add_root( const offset_ptr<node_type> &nodep );
+
+	//Null if there is no such node
+	offset_ptr<node_type> find( const std::string &callsign ) const;
+
+	//The routing table entries most recently emitted, so that the next run need only emit the difference
+	std::vector<state_file_blocks::route_record> emitted_routes() const;
+	void emitted_routes( const std::vector<state_file_blocks::route_record> &records );
+
+	//Node access by way of these verifies the record
+	node_type &fetch( const offset_ptr<node_type> & );
+	const node_type &fetch( const offset_ptr<node_type> & ) const;
+
+	//Record that "to" was found to be reachable from "from". Returns false if it already was.
+	bool link_nodes( const offset_ptr<node_type> &from, const offset_ptr<node_type> &to );
+
+	//Call f(const node_type &) for each node linked from n, most recently linked first
+	template<typename F>
+	void for_each_link( const node_type &n, F &&f ) const{
+		auto lock = m_state.bfile.make_lock();
+		if(!n.link_list)
+			return;
+
+		for(const link_type *linkp = n.link_list->next ? &*n.link_list->next : nullptr; linkp; linkp = linkp->next ? &*linkp->next : nullptr)
+			f( static_cast<const node_type &>(*linkp->value_ptr) );
+	}
+
+	//Call f(const node_type &) for each root node, most recently added first
+	template<typename F>
+	void for_each_root( F &&f ) const{
+		auto lock = m_state.bfile.make_lock();
+		auto &head = header().get().root_nodes;
+
+		for(const link_type *linkp = head.next ? &*head.next : nullptr; linkp; linkp = linkp->next ? &*linkp->next : nullptr)
+			f( static_cast<const node_type &>(*linkp->value_ptr) );
+	}
 
 	auto pending_nodes() const{
 		return jab::util::range_property( 
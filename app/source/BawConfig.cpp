@@ -1,16 +1,43 @@
 #include <string>
 #include <iostream>
 #include "BawConfig.hpp"
+#include "export.hpp"
+#include "log.hpp"
 
 using namespace std::string_literals;
 using namespace k3yab::bawns;
 
 void Config::show_usage(int argc, char *argv[]){
-	std::cout << "Usage: " << std::string(argv[0]) << " [--help | -h] [-j <no. of threads>] [-f state file path] <local node>" << std::endl << std::endl;
+	std::cout << "Usage: " << std::string(argv[0]) << " [--help | -h] [-j <no. of threads>] [-m <min. threads>] [-a <placement>] [-q <queue limit>] [-s <seconds>] [-e <event log>] [-v <log levels>] [--no-dashboard] [-f state file path] [--no-checksums] <local node>" << std::endl;
+	std::cout << "       " << std::string(argv[0]) << " [-f state file path] -x <format> [-o output path]" << std::endl;
+	std::cout << "       " << std::string(argv[0]) << " [-f state file path] -r <hops | quality> [-o output path]" << std::endl;
+	std::cout << "       " << std::string(argv[0]) << " [-f state file path] -n <port> [--dry-run] [-o output path]" << std::endl << std::endl;
 	std::cout << "	--help, -h		This help" << std::endl;
 	std::cout << "	-j <count>		Max number of simultaneous parallel AX.25 connections" << std::endl;
+	std::cout << "	-m <count>		Number of query threads kept when there's nothing to query, defaults to 1" << std::endl;
+	std::cout << "	-a <placement>	Pin query threads to CPUs: compact, to fill one NUMA node and core at a time," << std::endl;
+	std::cout << "					scatter, to spread them across nodes and cores, or a CPU list such as 0-3,8." << std::endl;
+	std::cout << "					It only pins them. They still share the one priority queue, so no thread's work stays local to it" << std::endl;
+	std::cout << "	-q <count>		Max nodes waiting for a query thread before reading more from stdin waits, defaults to " << Config::default_queue_limit << std::endl;
+	std::cout << "	-s <seconds>	Print query thread and queue statistics this often, and at the end" << std::endl;
+	std::cout << "					only when built with -DLEVITATOR_POOL_STATS=1" << std::endl;
+	std::cout << "	-e <path>		Log every connection, prompt, timeout and discovery to a binary event log, for baw-log to read." << std::endl;
+	std::cout << "					Old logs are kept as <path>.1, <path>.2 and so on" << std::endl;
+	std::cout << "	-v <levels>		Console log levels, trace, debug, info, warn, error or off, for all messages or by subsystem:" << std::endl;
+	std::cout << "					-v debug, or -v warn,query=debug. Subsystems are " << jab::util::LogChannel::names() << ". Defaults to info" << std::endl;
+	std::cout << "	--no-dashboard	Print each query's progress, rather than a line of totals and rates kept up to date." << std::endl;
+	std::cout << "					The dashboard turns the query messages down to warn, unless -v says otherwise" << std::endl;
 	std::cout << "	-f <path>		Path of state file to load and append node discoveries" << std::endl;
 	std::cout << "					defaults to '" << Config::default_state_path  << "'" << std::endl;
+	std::cout << "	--no-checksums	Create a new state file without per-record and whole-file CRC32C checksums" << std::endl;
+	std::cout << "	-x <format>		Export the nodes and links in the state file rather than crawling" << std::endl;
+	std::cout << "					format is one of: " << Exporter::format_names << std::endl;
+	std::cout << "	-r <metric>		Print the best route from our port to each node rather than crawling" << std::endl;
+	std::cout << "					metric is hops, or quality for Netrom path quality" << std::endl;
+	std::cout << "	-n <port>		Generate the nrparms commands which bring the Netrom tables up to date with the best routes" << std::endl;
+	std::cout << "					out of the named AX.25 port, as a difference from the commands generated last time" << std::endl;
+	std::cout << "	--dry-run		With -n, check the commands against a stand-in routing table but don't record them as applied" << std::endl;
+	std::cout << "	-o <path>		Where to write the export, routes or commands, defaults to stdout" << std::endl;
 	std::cout << "	<local node>	Local address or callsign to use, typically the user's hyphenated callsign" << std::endl << std::endl;
 	std::cout << "On stdin, pipe or type a list of root nodes at which to begin querying, one callsign per line" << std::endl;
 	std::cout << std::endl;
@@ -55,10 +82,78 @@ static int process_switches(Config &conf, int argc, char *argv[]){
 			if(conf.threads < 1)
 				throw ConfigError("Thread count must be >= 1");						
 		}
+		else if( arg == "-m" ){
+			demand_next( argc, i, "minimum thread count" );
+			conf.min_threads = get_int( argv[i] );
+			if(conf.min_threads < 1)
+				throw ConfigError("Minimum thread count must be >= 1");
+		}
+		else if( arg == "-a" ){
+			demand_next( argc, i, "thread placement" );
+			try{
+				conf.placement = levitator::concurrency::Affinity::parse( argv[i] );
+			}
+			catch( const std::invalid_argument & ){
+				std::throw_with_nested( ConfigError("Thread placement must be compact, scatter, none or a CPU list") );
+			}
+		}
+		else if( arg == "-q" ){
+			demand_next( argc, i, "queue limit" );
+			auto limit = get_int( argv[i] );
+			if(limit < 1)
+				throw ConfigError("Queue limit must be >= 1");
+			conf.queue_limit = limit;
+		}
+		else if( arg == "-s" ){
+			demand_next( argc, i, "statistics interval" );
+			auto seconds = get_int( argv[i] );
+			if(seconds < 1)
+				throw ConfigError("Statistics interval must be >= 1");
+			conf.stats_interval = std::chrono::seconds(seconds);
+		}
+		else if( arg == "-e" ){
+			demand_next( argc, i, "event log path" );
+			conf.event_path = argv[i];
+		}
+		else if( arg == "-v" ){
+			demand_next( argc, i, "log levels" );
+			conf.log_levels = argv[i];
+			try{
+				jab::util::LogChannel::configure( conf.log_levels );
+			}
+			catch( const std::invalid_argument & ){
+				std::throw_with_nested( ConfigError("Log levels must be a level, or subsystem=level, separated by commas") );
+			}
+		}
+		else if( arg == "--no-dashboard" ){
+			conf.dashboard = false;
+		}
 		else if( arg == "-f" ){
 			demand_next( argc, i, "state file path" );
 			conf.state_path = argv[i];
 		}
+		else if( arg == "--no-checksums" ){
+			conf.checksums = false;
+		}
+		else if( arg == "-x" ){
+			demand_next( argc, i, "export format" );
+			conf.export_format = argv[i];
+		}
+		else if( arg == "-r" ){
+			demand_next( argc, i, "route metric" );
+			conf.route_metric = argv[i];
+		}
+		else if( arg == "-n" ){
+			demand_next( argc, i, "AX.25 port name" );
+			conf.nr_port = argv[i];
+		}
+		else if( arg == "--dry-run" ){
+			conf.dry_run = true;
+		}
+		else if( arg == "-o" ){
+			demand_next( argc, i, "output path" );
+			conf.output_path = argv[i];
+		}
 		else{
 			throw ConfigError("Unrecognized switch: " + arg);
 		}
@@ -70,8 +165,29 @@ static int process_switches(Config &conf, int argc, char *argv[]){
 
 Config::Config( int argc, char *argv[]){
 	int i = process_switches( *this, argc, argv ); //non-positional switches
-	demand(argc, i, "Expected local address or callsign for binding client sockets");
-	local_address = argv[i++];
+
+	//Exporting or routing doesn't go on the air, so it doesn't need an address
+	if(!offline()){
+		demand(argc, i, "Expected local address or callsign for binding client sockets");
+		local_address = argv[i++];
+	}
+
 	if(i < argc)
 		throw ConfigError("Unexpected argument: "s + argv[i]);
 }
+
+bool Config::exporting() const{
+	return export_format.size();
+}
+
+bool Config::routing() const{
+	return route_metric.size();
+}
+
+bool Config::generating() const{
+	return nr_port.size();
+}
+
+bool Config::offline() const{
+	return exporting() || routing() || generating();
+}
@@ -1,4 +1,15 @@
+#include <unistd.h>
 #include <regex>
+#include <filesystem>
+#include <chrono>
+#include <optional>
+#include <iterator>
+#include <limits>
+#include <unordered_set>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <functional>
 
 #include "util.hpp"
 #include "concurrency/thread_pool.hpp"
@@ -7,6 +18,11 @@
 #include "baw.hpp"
 #include "packet_radio.hpp"
 #include "File.hpp"
+#include "FSFile.hpp"
+#include "export.hpp"
+#include "routes.hpp"
+#include "nrparms.hpp"
+#include "sheduler.hpp"
 #include "Socket.hpp"
 #include "exception.hpp"
 #include "string.hpp"
@@ -30,6 +46,14 @@ const bawns::Config &k3yab::bawns::baw::config() const{
 	return m_config;
 }
 
+levitator::EventLog *k3yab::bawns::baw::events() const{
+	return m_events.get();
+}
+
+CrawlCounters &k3yab::bawns::baw::counters(){
+	return m_counters;
+}
+
 //unique_ptr which forwards the call operator
 class callable_task_ptr : public std::unique_ptr<node_task>{
 	using base_type = std::unique_ptr<node_task>;
@@ -42,17 +66,66 @@ public:
 	}
 };
 
-k3yab::bawns::node_task::node_task(baw &app, const std::string &callsign):
+k3yab::bawns::node_task::node_task(baw &app, const std::string &callsign, unsigned depth, bool answered):
 	m_appp(&app),
-	m_callsign(callsign){}
+	m_callsign(callsign),
+	m_depth(depth),
+	m_answered(answered){}
 
 k3yab::bawns::node_task::node_task():
 	m_appp(nullptr){}
 
+unsigned k3yab::bawns::node_task::rank() const{
+	if(!m_appp)
+		return std::numeric_limits<unsigned>::max();
+
+	return std::min( m_depth, std::numeric_limits<unsigned>::max() / 2 - 1 ) * 2 + !m_answered;
+}
+
+bool k3yab::bawns::node_task::priority_order::operator()( const node_task &a, const node_task &b ) const{
+	return a.rank() > b.rank();
+}
+
 Console::out_type k3yab::bawns::node_task::print() const{	
 	return console.out() << m_callsign << ": ";
 }
 
+//The progress of each query, prefixed with the node's callsign. Debug has every line the node sends back.
+static LogChannel query_log("query");
+#define QUERY_LOG( level ) JAB_LOG_TO( query_log, level, print() )
+
+//How the crawl as a whole is getting on
+static LogChannel crawl_log("crawl");
+
+//The hops of a route, comma-separated
+struct hop_list{
+	const std::vector<std::string> &route;
+	std::size_t first;
+};
+
+static std::ostream &operator<<( std::ostream &os, const hop_list &hops ){
+	for(auto i = hops.first; i < hops.route.size(); ++i)
+		os << (i == hops.first ? "" : ", ") << hops.route[i];
+	return os;
+}
+
+void k3yab::bawns::node_task::log( events::type type, std::int64_t a, std::int64_t b ) const{
+	auto event_log = m_appp->events();
+	if(!event_log)
+		return;
+
+	//The log is only a record, so a full disk mustn't cost the query too
+	try{
+		event_log->record( type, m_subject, a, b );
+	}
+	catch( const std::exception & ){
+	}
+}
+
+void k3yab::bawns::node_task::count( counters::counter c, std::int64_t n ) const{
+	m_appp->counters().add( c, n );
+}
+
 //Discard stream data until a timeout happens
 void k3yab::bawns::node_task::eat_stream( std::istream &stream ){
 	string buf;
@@ -79,32 +152,15 @@ void k3yab::bawns::node_task::eat_stream( std::istream &stream ){
 //Get a line allowing for four possbile line endings: \n, \r, \r\n, EOF
 //Unlike the usual getline, does not include the line ending in the result.
 //It's confusing, and what for? You know the result ends with the line.
-static std::string my_getline( std::istream &stream, std::string &result ){
-
-	using traits = std::istream::traits_type;	
+static std::string &my_getline( session_stream &stream, std::string &result ){
 
 	//Without eofbit, eof will cause empty strings to return
 	//stream.exceptions( std::ios_base::eofbit );
 
-	try{		
-		while(stream){
-			auto c = stream.get();
-			if(c == traits::eof())
-				break;
-			else if ( c == '\n')
-				break;
-			else if(c == '\r'){
-				c = stream.get();
-				if(c == '\n')
-					break;
-				else{
-					stream.putback( traits::char_type(c) );
-					break;
-				}
-			}
-			else
-				result.push_back(c);
-		}
+	try{
+		std::string_view line;
+		if( stream.getline_view(line) )
+			result.append(line);
 	}
 	catch( const std::ios_base::failure &phail ){		
 		jab::file::eof_exception::check(stream); 	//throw an eof-specific exception if applicable
@@ -154,7 +210,7 @@ static bool is_bbs_prompt( const std::string &line ){
 
 //attempt to put the remote host into BBS mode which offers various seemingly conventional
 //if not standard services.
-bool k3yab::bawns::node_task::bbs_mode( std::iostream &stream ){
+bool k3yab::bawns::node_task::bbs_mode( session_stream &stream ){
 	//Send the typical BBS-mode command, which is "BBS". Some hosts will already be in BBS mode
 	//and that will probably return an error (or a carriage return) we won't understand and result in a timeout and false failure.
 	baw::send_command(stream, "BBS");
@@ -166,8 +222,10 @@ bool k3yab::bawns::node_task::bbs_mode( std::iostream &stream ){
 		while( stream ){
 			line.clear();			
 			my_getline(stream, line);
-			if( is_bbs_prompt(line) )
+			if( is_bbs_prompt(line) ){
+				log( events::prompt, events::bbs );
 				return true;
+			}
 		}
 		return false;
 	}
@@ -179,10 +237,7 @@ bool k3yab::bawns::node_task::bbs_mode( std::iostream &stream ){
 //
 // The J L command on some BBSes will display a long-form list of contacts with routing and timestamps
 //
-k3yab::bawns::node_task::route_result_type k3yab::bawns::node_task::try_j_l_command( std::iostream &stream){
-
-	//constexpr bool c_debug = false;
-	constexpr bool c_debug = true;
+k3yab::bawns::node_task::route_result_type k3yab::bawns::node_task::try_j_l_command( session_stream &stream ){
 
 	std::vector<std::string> route;
 	std::string current_node, forward_node;
@@ -199,13 +254,12 @@ k3yab::bawns::node_task::route_result_type k3yab::bawns::node_task::try_j_l_comm
 		//to decide whether to resume a partial node or pull in more data
 		if(!line.length()){
 			my_getline(stream, line);
-
-			if(c_debug)
-				print() << "Node line: " << line << std::endl;
+			QUERY_LOG(debug) << "Node line: " << line << std::endl;
 
 			//If the line looks like a command prompt, then the query is done
 			if(is_bbs_prompt(line)){				
-				print() << "This previous line looks like a command prompt, so route scan is done." << std::endl;
+				log( events::prompt, events::routes );
+				QUERY_LOG(debug) << "This previous line looks like a command prompt, so route scan is done." << std::endl;
 				break;
 			}
 
@@ -219,7 +273,7 @@ k3yab::bawns::node_task::route_result_type k3yab::bawns::node_task::try_j_l_comm
 		}
 
 		current_node = cs;
-		print() << "Fetching node " << cs << "... " << std::endl;
+		QUERY_LOG(debug) << "Fetching node " << cs << "... " << std::endl;
 		//auto do_endl = Guard( [&](){ pr << std::endl; } );
 
 		//See if there's a destination callsign to forward to. Blank is presumably destined for same node.
@@ -229,18 +283,18 @@ k3yab::bawns::node_task::route_result_type k3yab::bawns::node_task::try_j_l_comm
 		cs = parse_callsign(line);
 		if(cs.length()){
 			line.clear();
-			print() << "Got more than two callsigns (" << cs << ") on the initial line of text from remote." << std::endl <<
-				"So, we will give up on this host since we don't understand it.";
+			QUERY_LOG(warn) << "Got more than two callsigns (" << cs << ") on the initial line of text from remote." << std::endl <<
+				"So, we will give up on this host since we don't understand it." << std::endl;
 			break;
 		}
 
 		//Fetch the next line which should either start with "VIA", or represent the next node to process
 		line.clear();
 		my_getline(stream, line);
-		if(c_debug)
-				print() << "Node line: " << line << std::endl;
+		QUERY_LOG(debug) << "Node line: " << line << std::endl;
 		if(is_bbs_prompt(line)){				
-			print() << "This previous line looks like a command prompt, so route scan is done." << std::endl;
+			log( events::prompt, events::routes );
+			QUERY_LOG(debug) << "This previous line looks like a command prompt, so route scan is done." << std::endl;
 			break;
 		}
 
@@ -255,24 +309,23 @@ k3yab::bawns::node_task::route_result_type k3yab::bawns::node_task::try_j_l_comm
 			continue;
 		}
 
-		auto pr = print() << "'" << current_node << "' route: ";
 		//This is the via list, representing the route
-		while( (cs = parse_callsign(line)).size() ){
+		auto first_hop = route.size();
+		while( (cs = parse_callsign(line)).size() )
 			route.push_back(cs);
-			pr << cs << ", ";
-		}
+		QUERY_LOG(info) << "'" << current_node << "' route: " << hop_list{ route, first_hop } << std::endl;
 		route.push_back(current_node);
-		pr << "\b" << std::endl;		
 	}
 
 	return {route, forward_node};
 }
 
-int k3yab::bawns::node_task::run(){
-	if(!m_appp)
-		return -1;	
+std::vector<std::string> k3yab::bawns::node_task::run(){
 	
-	print() << " connecting..." << endl;
+	QUERY_LOG(info) << "connecting..." << endl;
+
+	//From here on it's almost all waiting on the remote node, leaving the CPU to another query thread
+	BlockingScope blocking;
 	
 	Socket sock(AF_AX25, SOCK_SEQPACKET, 0);
 	sock.timeout_as_eof(true);
@@ -282,54 +335,113 @@ int k3yab::bawns::node_task::run(){
 
 	sock.bind( local, sizeof(local) );
 	sock.connect( addr, sizeof(addr) );
-	print() << "CONNECTED" << endl;
+	QUERY_LOG(info) << "CONNECTED" << endl;
+	log( events::connect, m_depth );
+	count( counters::active );
+
+	session_stream stream( std::move(sock) );
+	auto &link = stream.file();
 
-	File_iostream<char, Socket> stream( std::move(sock) );
+	//So that listings come apart into lines without copying any. The plain ring does the same job, only not as well.
+	try{
+		stream.mirror_read_buffer();
+	}
+	catch( const jab::exception::IOError &ex ){
+		QUERY_LOG(debug) << "No mirrored read buffer: " << ex << std::endl;
+	}
+
+	//Traffic goes on the dashboard a stage at a time, so that a long session doesn't show up all at once at the end.
+	//Timeouts count where an answer was wanted, which leaves out the one eat_stream waits for.
+	std::uint64_t bytes_in = 0, bytes_out = 0;
+	unsigned timeouts = 0;
+	auto end_stage = [&]( bool timeouts_count ){
+		count( counters::bytes_in, link.bytes_in() - bytes_in );
+		count( counters::bytes_out, link.bytes_out() - bytes_out );
+		bytes_in = link.bytes_in();
+		bytes_out = link.bytes_out();
+
+		if(timeouts_count && link.timeouts() > timeouts){
+			log( events::timeout, m_stage, link.timeouts() );
+			count( counters::timeouts );
+		}
+		timeouts = link.timeouts();
+	};
+	auto disconnect = Guard( [&](){
+		end_stage(false);
+		log( events::bytes, link.bytes_in(), link.bytes_out() );
+		count( counters::active, -1 );
+	});
 
 	//stream.exceptions( std::ios_base::badbit );
 	stream.exceptions( stream.eofbit | stream.badbit );
 
 	eat_stream(stream);
+	end_stage(false);
+
+	m_stage = events::bbs;
 	auto bbsm = bbs_mode(stream);
+	end_stage(true);
 
-	print() << (bbsm ? "BBS mode entered successfully" : "Failed getting into BBS mode, may cause failures") << std::endl;
+	if(bbsm){
+		QUERY_LOG(info) << "BBS mode entered successfully" << std::endl;
+	}
+	else{
+		QUERY_LOG(warn) << "Failed getting into BBS mode, may cause failures" << std::endl;
+	}
 
-	try_j_l_command(stream);
-	return 0;
+	m_stage = events::routes;
+	auto [route, forward_node] = try_j_l_command(stream);
+	end_stage(true);
+
+	//Everything listed, whether as a destination or a hop on the way to one, is reachable from here
+	if(!forward_node.empty())
+		route.push_back(forward_node);
+
+	std::vector<std::string> result;
+	std::unordered_set<std::string> seen{ m_callsign };
+	for(auto &call : route){
+		if(seen.insert(call).second)
+			result.push_back(call);
+	}
+	return result;
 }
 
 int k3yab::bawns::node_task::operator()(){
 
+	//Terminate task
+	if(!m_appp)
+		return -1;
+
+	node_result result{ m_callsign, m_depth };
+	if(auto event_log = m_appp->events())
+		m_subject = event_log->intern(m_callsign);
+
 	try{
-		run();
-		print() << "COMPLETE" << endl;
+		result.neighbours = run();
+		result.answered = true;
+		QUERY_LOG(info) << "COMPLETE" << endl;
 	}
 	catch( const std::exception &ex ){
-		print() << "Abandoning this node with errors..." << endl << ex << endl;
+		QUERY_LOG(error) << "Abandoning this node with errors..." << endl << ex << endl;
+		log( events::error, m_stage );
+		count( counters::errors );
 	}
+	count( counters::finished );
 
+	//Failure is a result too. Anything waiting on this one wants to hear either way.
+	m_done.set_value( std::move(result) );
 	return 0;
 }
 
-void k3yab::bawns::baw::run(){
-	using thread_pool_type = ThreadPool< node_task  >;
-
-	console.out() << "Starting..." << endl;
-	thread_pool_type workers(m_config.threads);
-	console.out() << "Using local callsign: " << m_config.local_address << endl;
-	console.out() << "Using state file: " << m_config.state_path << endl;
-	m_state = { m_config.state_path };
-	//auto pending_count = m_state.pending.size();	
-	//console.out() << "Pending or incomplete nodes from a previous run: " << pending_count << endl;
-	console.out() << "Total nodes known: " << m_state.size() << endl;
-
-	//TODO: Previous state resumption goes here (incomplete nodes, etc.)
-
-	console.out() << "Reading stdin for root node callsigns, one per line..." << endl;
+Future<node_result> k3yab::bawns::node_task::result() const{
+	return m_done.future();
+}
 
+//Next root callsign from stdin, or empty at the end of input
+static std::string read_root_callsign(){
 	string call;
-	int ct = 0;
 	while(console.in()){
+		call.clear();
 		std::getline(console.in().get_istream(), call);
 
 		//eof will count as a blank line!
@@ -344,13 +456,288 @@ void k3yab::bawns::baw::run(){
 				call.resize( call.size() - 1 );
 		}
 
-		if(call.size() <= 1)
-			continue;
+		if(call.size() > 1)
+			return call;
+	}
+	return {};
+}
+
+void k3yab::bawns::baw::run(){
+	//Queries are slow network round trips, so a shared queue costs nothing next to them, and lets the likeliest nodes go first
+	using thread_pool_type = PriorityThreadPool< node_task, node_task::priority_order >;
 
-		workers.push( { *this, call } );
-		++ct;
+	console.out() << "Starting..." << endl;
+
+	if(!m_config.event_path.empty()){
+		m_events = std::make_unique<levitator::EventLog>( m_config.event_path );
+		JAB_LOG( crawl_log, info ) << "Logging events to: " << m_config.event_path << endl;
 	}
 
-	console.out() << ct << " callsigns read. Running query threads..." << endl;
+	//Bounded, so that the roots are read only as fast as the workers get through them,
+	//but roomy enough that the priorities have something to choose between.
+	//The workers spend nearly all their time waiting on the network, so the pool grows to -j while there's a backlog.
+	thread_pool_type workers(
+		{
+			.min_threads = std::min(m_config.min_threads, m_config.threads),
+			.max_threads = m_config.threads,
+			.keepalive = Config::thread_keepalive,
+			.placement = m_config.placement
+		},
+		{}, {}, m_config.queue_limit );
+	//Whether it's the radio, the thread count or the queue holding the crawl up. The timer is declared after workers and
+	//print_stats, which every tick refers to, so it stops before either is gone.
+	std::optional<levitator::Scheduler<std::function<void ()>>> stats_timer;
+	std::function<void ()> print_stats;
+	print_stats = [&](){
+		console.out() << workers.stats();
+		stats_timer->schedule_after( m_config.stats_interval, std::function<void ()>(print_stats) );
+	};
+	if(m_config.stats_interval.count()){
+		stats_timer.emplace();
+		stats_timer->schedule_after( m_config.stats_interval, std::function<void ()>(print_stats) );
+	}
+
+	//Progress in one line in place of every query's. Declared after workers, so it's gone before they are.
+	std::optional<Dashboard> dashboard;
+	if(m_config.dashboard){
+		if(m_config.log_levels.empty())
+			LogChannel::configure("query=warn");
+		dashboard.emplace(
+			Dashboard::sources{ m_counters, [&](){ return workers.backlog(); }, [&](){ return workers.size(); } },
+			Config::dashboard_interval, Config::dashboard_log_interval );
+	}
+
+	JAB_LOG( crawl_log, info ) << "Using local callsign: " << m_config.local_address << endl;
+	JAB_LOG( crawl_log, info ) << "Using state file: " << m_config.state_path << endl;
+	m_state = { m_config.state_path, m_config.checksums };
+	JAB_LOG( crawl_log, info ) << "Total nodes known: " << m_state.size() << endl;
+
+	std::unordered_set<std::string> roots;
+	m_state.for_each_root( [&roots](const auto &node){ roots.insert( node.callsign.str() ); } );
+
+	//Results are recorded as they come in, on whichever query thread got them, so the state file needs guarding from here on
+	std::mutex state_mutex;
+	const auto visit_serial = m_state.header().get().visit_serial;
+
+	//Everything this run has queued, so that a callsign read from stdin isn't queried twice. Guarded by state_mutex.
+	std::unordered_set<std::string> queued;
+
+	//Event log ids, so that each callsign's interned once rather than under the log's file lock with every answer.
+	//Guarded by state_mutex.
+	std::unordered_map<std::string, std::uint32_t> event_ids;
+	auto event_id = [&]( const std::string &call ){
+		auto it = event_ids.find(call);
+		if(it == event_ids.end())
+			it = event_ids.emplace( call, m_events->intern(call) ).first;
+		return it->second;
+	};
+
+	//Record what a node found, and crawl on to anything new. Tasks pushed from a query thread don't wait on the queue limit.
+	std::function<node_task (const std::string &, unsigned, bool)> make_task;
+	auto record = [&]( Future<node_result> &f ){
+		auto result = f.get();
+		if(!result.answered)
+			return;
+
+		std::vector<std::string> fresh;
+		std::uint32_t from_id = 0;
+		std::vector<std::uint32_t> neighbour_ids, fresh_ids;
+		{
+			std::lock_guard lock(state_mutex);
+			auto from = m_state.find(result.callsign);
+			auto &node = m_state.fetch(from);
+			node.query_count = std::max<int>( node.query_count + 1, visit_serial );
+			node.seal();
+			if(m_events)
+				from_id = event_id(result.callsign);
+
+			for(auto &call : result.neighbours){
+				auto to = m_state.find(call);
+				if(!to){
+					to = m_state.append_node(call);
+					queued.insert(call);
+					fresh.push_back(call);
+					if(m_events)
+						fresh_ids.push_back( event_id(call) );
+				}
+				m_state.link_nodes( from, to );
+				if(m_events)
+					neighbour_ids.push_back( event_id(call) );
+			}
+		}
+
+		if(m_events){
+			for(auto id : neighbour_ids)
+				m_events->record( events::edge, from_id, id );
+			for(auto id : fresh_ids)
+				m_events->record( events::discovered, id, from_id, result.depth + 1 );
+		}
+
+		m_counters.add( counters::answered );
+		m_counters.add( counters::discovered, fresh.size() );
+		for(auto &call : fresh)
+			workers.push( make_task( call, result.depth + 1, false ) );
+	};
+
+	make_task = [&]( const std::string &call, unsigned depth, bool answered_before ){
+		node_task result{ *this, call, depth, answered_before };
+		result.result().then(record);
+		return result;
+	};
+
+	//Previous state resumption. Only the nodes pending as of opening the file, since the roots read below get added to the list.
+	auto pending = m_state.pending_nodes();
+	auto pending_it = pending.begin();
+	auto pending_left = std::distance( pending.begin(), pending.end() );
+	JAB_LOG( crawl_log, info ) << "Pending or incomplete nodes from a previous run: " << pending_left << endl;
+
+	auto resumed = workers.feed( [&]() -> std::optional<node_task>{
+		if(!pending_left)
+			return {};
+
+		--pending_left;
+		std::lock_guard lock(state_mutex);
+		auto &node = m_state.fetch( *pending_it++ );
+		auto call = node.callsign.str();
+		queued.insert(call);
+
+		//Short of working out the routes, a node which isn't a root is at least one hop further out
+		return make_task( call, roots.contains(call) ? 0u : 1u, node.query_count > 0 );
+	});
+
+	JAB_LOG( crawl_log, info ) << "Reading stdin for root node callsigns, one per line..." << endl;
+
+	auto ct = workers.feed( [&]() -> std::optional<node_task>{
+		while(true){
+			auto call = read_root_callsign();
+			if(call.empty())
+				return {};
+
+			std::lock_guard lock(state_mutex);
+			auto nodep = m_state.find(call);
+			if(!nodep){
+				m_state.append_root_node(call);
+				roots.insert(call);
+				queued.insert(call);
+				return make_task( call, 0, false );
+			}
+
+			//Found as some other node's neighbour, and now heard on our own port
+			if(roots.insert(call).second)
+				m_state.add_root(nodep);
+
+			//Pending ones were already queued for resumption, and others were found and queued by this run's crawl, or
+			//read already. A node that was finished with in an earlier run is queried again, from here.
+			if(queued.insert(call).second)
+				return make_task( call, 0, m_state.fetch(nodep).query_count > 0 );
+		}
+	});
+
+	JAB_LOG( crawl_log, info ) << resumed << " nodes resumed, " << ct << " callsigns read. Waiting for query threads..." << endl;
+	workers.wait_idle();
+	dashboard.reset();
+	stats_timer.reset();
+	auto totals = m_counters.read();
+	console.out() << totals[counters::answered] << " nodes answered, " << totals[counters::discovered] << " new nodes discovered" << endl;
+	if(m_config.stats_interval.count())
+		console.out() << workers.stats();
 	workers.shutdown();
+
+	if(m_events)
+		m_events->flush();
+}
+
+//Don't create an empty one just to read nothing from it
+void k3yab::bawns::baw::open_existing_state(){
+	if(!std::filesystem::exists(m_config.state_path))
+		throw baw_exception("State file not found: " + m_config.state_path.string());
+
+	m_state = { m_config.state_path, m_config.checksums };
+}
+
+template<typename F>
+void k3yab::bawns::baw::write_output( F &&f ){
+	if(m_config.output_path.empty()){
+		//Duplicated, so that the stream can close its own descriptor and leave stdout alone
+		File out_file( posix_exception::check( ::dup(STDOUT_FILENO), "Failed duplicating stdout", jab::meta::type<IOError>() ) );
+		File_iostream<char, File> out( std::move(out_file), Config::export_buffer_size );
+		f(out);
+		out.flush();
+	}
+	else{
+		FSFile_iostream<char> out( m_config.output_path, w | create | trunc, Config::export_buffer_size );
+		f(out);
+		out.flush();
+	}
+}
+
+void k3yab::bawns::baw::export_state(){
+	auto exporter = Exporter::make(m_config.export_format);
+
+	console.out() << "Exporting state file: " << m_config.state_path << endl;
+	open_existing_state();
+	write_output( [&](std::ostream &out){ exporter->write(m_state, out); } );
+	console.out() << "Exported " << m_state.size() << " nodes" << endl;
+}
+
+void k3yab::bawns::baw::print_routes(){
+	using namespace routing;
+
+	metric by;
+	if(m_config.route_metric == "hops")
+		by = metric::hops;
+	else if(m_config.route_metric == "quality")
+		by = metric::quality;
+	else
+		throw config_exception("Unknown route metric: " + m_config.route_metric);
+
+	open_existing_state();
+
+	auto start = std::chrono::steady_clock::now();
+	RouteGraph graph( m_state, Config::default_link_quality );
+	auto routes = graph.local_routes( by, Config::default_link_quality );
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start );
+
+	console.out() << graph.size() << " nodes, " << graph.edge_count() << " links, " << graph.roots().size() << " heard on our port" << endl;
+	console.out() << "Routes computed in " << elapsed.count() << "us" << endl;
+
+	write_output( [&](std::ostream &out){
+		out << "destination\tvia\thops\tquality\n";
+		for(index_type n = 0; n < graph.size(); ++n){
+			if(!routes.reachable(n))
+				continue;
+
+			out << graph.callsign(n) << '\t' << graph.callsign( routes.first_hop(n) ) << '\t' << routes.path(n).size() << '\t';
+			if(by == metric::quality)
+				out << routes.cost[n];
+			out << '\n';
+		}
+	});
+}
+
+void k3yab::bawns::baw::generate_nrparms(){
+	using namespace routing;
+
+	open_existing_state();
+	RouteGraph graph( m_state, Config::default_link_quality );
+	RoutingTable target( graph, graph.local_routes( metric::quality, Config::default_link_quality ), m_config.nr_port );
+	RoutingTable previous( m_state.emitted_routes() );
+	auto commands = previous.diff(target);
+
+	//Play the commands against what we think the kernel has, to make sure they get it where we want it
+	auto standin = previous;
+	standin.apply(commands);
+	if(!(standin == target))
+		throw baw_exception("Generated nrparms commands don't reproduce the intended routing table");
+
+	write_output( [&](std::ostream &out){
+		for(auto &cmd : commands)
+			out << cmd << '\n';
+	});
+
+	console.out() << commands.size() << " commands take the routing table from " << previous.size() << " to " << target.size() << " entries" << endl;
+	if(m_config.dry_run)
+		console.out() << "Dry run. Not recording these as applied." << endl;
+	else
+		m_state.emitted_routes( target.records() );
 }
@@ -0,0 +1,301 @@
+#include <ctime>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <list>
+#include <queue>
+#include <tuple>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <stdexcept>
+#include "exception.hpp"
+#include "event_log.hpp"
+#include "events.hpp"
+
+//Decodes, filters and totals the event logs baw writes with -e
+
+using namespace std::string_literals;
+using namespace jab::exception;
+using namespace levitator;
+using namespace k3yab::bawns;
+
+namespace{
+
+struct Options{
+	std::set<std::uint16_t> types;		//Empty for all of them
+	std::string callsign;				//Events about this one, whether as subject or otherwise. Empty for all.
+	bool summary = false;
+	std::vector<std::string> paths;
+};
+
+//Most events held back at once, waiting to be put in time order
+constexpr std::size_t reorder_limit = 1 << 20;
+
+//Per callsign, for the summary
+struct totals{
+	std::uint64_t connects = 0, prompts = 0, timeouts = 0, errors = 0;
+	std::uint64_t bytes_in = 0, bytes_out = 0;
+	std::uint64_t edges = 0;
+};
+
+void show_usage( const char *argv0 ){
+	std::cout << "Usage: " << argv0 << " [-t <type>[,<type>...]] [-c <callsign>] [--summary] <event log>..." << std::endl << std::endl;
+	std::cout << "	-t <types>		Only these types of event, out of:";
+	for(std::size_t t = 1; t < events::type_count; ++t)
+		std::cout << " " << events::type_names[t];
+	std::cout << std::endl;
+	std::cout << "	-c <callsign>	Only events about this callsign" << std::endl;
+	std::cout << "	--summary		Totals by event type and by callsign, rather than every event" << std::endl;
+	std::cout << "	<event log>		Files to read in turn. Give rotated logs oldest first: log.2 log.1 log" << std::endl << std::endl;
+	std::cout << "Events are printed in time order. Each is held back until every thread has logged one as late, so one which stops" << std::endl;
+	std::cout << "logging partway holds the rest up, until " << reorder_limit << " are waiting and the earliest go anyway." << std::endl;
+}
+
+std::uint16_t parse_type( const std::string &name ){
+	auto it = std::find( events::type_names.begin() + 1, events::type_names.end(), name );
+	if(it == events::type_names.end())
+		throw std::invalid_argument("Unknown event type: " + name);
+	return std::uint16_t( it - events::type_names.begin() );
+}
+
+Options parse_options( int argc, char *argv[] ){
+	Options result;
+	for(int i = 1; i < argc; ++i){
+		std::string arg = argv[i];
+		if(arg == "-h" || arg == "--help"){
+			show_usage(argv[0]);
+			std::exit(0);
+		}
+		else if(arg == "-t" || arg == "-c"){
+			if(++i >= argc)
+				throw std::invalid_argument("Missing expected argument to " + arg);
+			if(arg == "-c")
+				result.callsign = argv[i];
+			else{
+				std::stringstream ss(argv[i]);
+				std::string name;
+				while(std::getline( ss, name, ',' ))
+					result.types.insert( parse_type(name) );
+			}
+		}
+		else if(arg == "--summary")
+			result.summary = true;
+		else if(arg[0] == '-')
+			throw std::invalid_argument("Unrecognized switch: " + arg);
+		else
+			result.paths.push_back(arg);
+	}
+
+	if(result.paths.empty())
+		throw std::invalid_argument("No event log given");
+	return result;
+}
+
+//UTC, to the nanosecond
+std::string format_time( std::uint64_t ns ){
+	std::time_t seconds = ns / 1000000000;
+	std::tm tm;
+	gmtime_r( &seconds, &tm );
+
+	char text[32];
+	std::strftime( text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &tm );
+	std::ostringstream os;
+	os << text << "." << std::setw(9) << std::setfill('0') << ns % 1000000000 << "Z";
+	return os.str();
+}
+
+std::string_view stage_name( std::int64_t stage ){
+	return stage > 0 && stage < events::stage_count ? events::stage_names[stage] : "unknown";
+}
+
+void print_event( const EventLogReader &reader, const event_record &e ){
+	std::cout << format_time(e.time_ns) << " t" << e.thread << " ";
+	if(e.type < events::type_count)
+		std::cout << events::type_names[e.type];
+	else
+		std::cout << "type" << e.type;
+	std::cout << " " << reader.name(e.subject);
+
+	switch(e.type){
+	case events::connect:
+		std::cout << " depth=" << e.a;
+		break;
+	case events::bytes:
+		std::cout << " in=" << e.a << " out=" << e.b;
+		break;
+	case events::prompt:
+	case events::error:
+		std::cout << " stage=" << stage_name(e.a);
+		break;
+	case events::discovered:
+		std::cout << " from=" << reader.name( std::uint32_t(e.a) ) << " depth=" << e.b;
+		break;
+	case events::edge:
+		std::cout << " to=" << reader.name( std::uint32_t(e.a) );
+		break;
+	case events::timeout:
+		std::cout << " stage=" << stage_name(e.a) << " timeouts=" << e.b;
+		break;
+	default:
+		std::cout << " a=" << e.a << " b=" << e.b;
+	}
+	std::cout << "\n";
+}
+
+//Each thread's events reach the file a buffer at a time, so they're in order for each thread, but one thread's can
+//come after later ones of the others'. An event is held back until every thread seen so far has logged one as late,
+//after which none of them can log an earlier one. Threads are numbered as they start logging, so one numbered below
+//the highest seen is waited for even before its first event turns up. A thread which stops logging holds the rest
+//up until reorder_limit events are waiting, and then they go anyway.
+class Reorder{
+	struct held{
+		event_record event;
+		const EventLogReader *reader;
+		std::uint64_t sequence;		//To keep events at the same time in file order
+	};
+
+	struct later{
+		bool operator()( const held &a, const held &b ) const{
+			return std::tie(a.event.time_ns, a.sequence) > std::tie(b.event.time_ns, b.sequence);
+		}
+	};
+
+	std::priority_queue<held, std::vector<held>, later> m_held;
+	std::uint64_t m_sequence = 0;
+	std::vector<std::uint64_t> m_latest = { 0 };	//By thread number, from 1. Zero for one not seen yet.
+
+	void print_next(){
+		auto &next = m_held.top();
+		print_event( *next.reader, next.event );
+		m_held.pop();
+	}
+
+public:
+	//reader has to stay around until the event is printed, for the names
+	void push( const EventLogReader &reader, const event_record &e ){
+		std::size_t thread = std::max<std::uint16_t>( e.thread, 1 );
+		if(thread >= m_latest.size())
+			m_latest.resize( thread + 1, 0 );
+		m_latest[thread] = std::max( m_latest[thread], e.time_ns );
+		m_held.push( { e, &reader, m_sequence++ } );
+
+		const auto caught_up = *std::min_element( m_latest.begin() + 1, m_latest.end() );
+		while(!m_held.empty() && (m_held.top().event.time_ns <= caught_up || m_held.size() > reorder_limit))
+			print_next();
+	}
+
+	void finish(){
+		while(!m_held.empty())
+			print_next();
+	}
+};
+
+bool wanted( const Options &opts, const EventLogReader &reader, const event_record &e ){
+	if(!opts.types.empty() && !opts.types.contains(e.type))
+		return false;
+	if(opts.callsign.empty() || reader.name(e.subject) == opts.callsign)
+		return true;
+
+	//The other callsign these carry
+	return (e.type == events::discovered || e.type == events::edge) && reader.name( std::uint32_t(e.a) ) == opts.callsign;
+}
+
+void print_summary( const std::vector<std::uint64_t> &counts, const std::map<std::string, totals> &by_callsign,
+	std::uint64_t first_ns, std::uint64_t last_ns ){
+
+	std::uint64_t total = 0;
+	for(auto c : counts)
+		total += c;
+	if(!total){
+		std::cout << "No events" << std::endl;
+		return;
+	}
+
+	std::cout << total << " events from " << format_time(first_ns) << " to " << format_time(last_ns) << std::endl;
+	for(std::size_t t = 1; t < counts.size(); ++t){
+		if(counts[t])
+			std::cout << "  " << std::left << std::setw(12) << (t < events::type_count ? std::string(events::type_names[t]) : "type" + std::to_string(t))
+				<< std::right << counts[t] << std::endl;
+	}
+
+	std::cout << std::endl << std::left << std::setw(12) << "callsign" << std::right
+		<< std::setw(9) << "connects" << std::setw(9) << "prompts" << std::setw(9) << "timeouts" << std::setw(9) << "errors"
+		<< std::setw(12) << "bytes in" << std::setw(12) << "bytes out" << std::setw(9) << "edges" << std::endl;
+	for(auto &[call, t] : by_callsign){
+		std::cout << std::left << std::setw(12) << call << std::right
+			<< std::setw(9) << t.connects << std::setw(9) << t.prompts << std::setw(9) << t.timeouts << std::setw(9) << t.errors
+			<< std::setw(12) << t.bytes_in << std::setw(12) << t.bytes_out << std::setw(9) << t.edges << std::endl;
+	}
+}
+
+int run( int argc, char *argv[] ){
+	auto opts = parse_options( argc, argv );
+
+	std::vector<std::uint64_t> counts( events::type_count );
+	std::map<std::string, totals> by_callsign;
+	std::uint64_t first_ns = std::numeric_limits<std::uint64_t>::max(), last_ns = 0;
+
+	//Kept open for the names of events still held back for reordering
+	std::list<EventLogReader> readers;
+	Reorder reorder;
+
+	for(auto &path : opts.paths){
+		auto &reader = readers.emplace_back(path);
+		event_record e;
+		while(reader.next(e)){
+			if(!wanted( opts, reader, e ))
+				continue;
+
+			if(!opts.summary){
+				reorder.push( reader, e );
+				continue;
+			}
+
+			if(e.type >= counts.size())
+				counts.resize( e.type + 1 );
+			++counts[e.type];
+			first_ns = std::min( first_ns, e.time_ns );
+			last_ns = std::max( last_ns, e.time_ns );
+
+			auto &t = by_callsign[ reader.name(e.subject) ];
+			switch(e.type){
+			case events::connect:	++t.connects; break;
+			case events::prompt:	++t.prompts; break;
+			case events::timeout:	++t.timeouts; break;
+			case events::error:		++t.errors; break;
+			case events::edge:		++t.edges; break;
+			case events::bytes:
+				t.bytes_in += e.a;
+				t.bytes_out += e.b;
+				break;
+			}
+		}
+	}
+
+	reorder.finish();
+	if(opts.summary)
+		print_summary( counts, by_callsign, first_ns, last_ns );
+	std::cout << std::flush;
+	return 0;
+}
+
+}
+
+int main( int argc, char *argv[] ){
+	try{
+		return run(argc, argv);
+	}
+	catch( const std::invalid_argument &ex ){
+		std::cerr << ex.what() << std::endl << std::endl;
+		show_usage(argv[0]);
+	}
+	catch( const std::exception &ex ){
+		std::cerr << ex;
+	}
+	return 1;
+}
@@ -0,0 +1,104 @@
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sstream>
+#include <iomanip>
+#include "console.hpp"
+#include "dashboard.hpp"
+
+using namespace k3yab::bawns;
+using namespace jab::util;
+
+namespace{
+
+//h:mm:ss
+std::string format_duration( std::chrono::seconds s ){
+	auto count = s.count();
+	std::ostringstream os;
+	os << count / 3600 << ":" << std::setfill('0') << std::setw(2) << count / 60 % 60 << ":" << std::setw(2) << count % 60;
+	return os.str();
+}
+
+std::string format_rate( double bytes_per_second ){
+	std::ostringstream os;
+	os << std::fixed << std::setprecision(1);
+	if(bytes_per_second < 1000)
+		os << bytes_per_second << " B/s";
+	else
+		os << bytes_per_second / 1000 << " kB/s";
+	return os.str();
+}
+
+//Columns, or 0 if it isn't a terminal
+int terminal_width( int fd ){
+	winsize ws;
+	return ioctl( fd, TIOCGWINSZ, &ws ) == 0 ? ws.ws_col : 0;
+}
+
+}
+
+Dashboard::Dashboard( const sources &src, clock_type::duration terminal_interval, clock_type::duration log_interval ):
+	m_sources(src),
+	m_terminal( isatty(console.out_fd) ),
+	m_interval( m_terminal ? terminal_interval : log_interval ){
+
+	m_samples.push_back( { m_start, m_sources.counters.read() } );
+	m_timer.emplace();
+	m_timer->schedule_after( m_interval, std::function<void ()>( [this](){ refresh(); } ) );
+}
+
+Dashboard::~Dashboard(){
+	//Stop redrawing before taking the line back for whatever's said next
+	m_timer.reset();
+	if(m_terminal)
+		console.clear_status();
+}
+
+void Dashboard::refresh(){
+	sample now{ clock_type::now(), m_sources.counters.read() };
+	m_samples.push_back(now);
+	while(m_samples.size() > 2 && now.time - m_samples[1].time >= rate_window)
+		m_samples.pop_front();
+
+	auto line = render(now);
+	if(m_terminal){
+		if(auto width = terminal_width(console.out_fd); width > 1 && line.size() >= std::size_t(width))
+			line.resize(width - 1);
+		console.status(line);
+	}
+	else
+		console.out() << line << std::endl;
+
+	m_timer->schedule_after( m_interval, std::function<void ()>( [this](){ refresh(); } ) );
+}
+
+std::string Dashboard::render( const sample &now ) const{
+	using namespace counters;
+
+	auto &then = m_samples.front();
+	auto &v = now.values;
+	std::chrono::duration<double> window = now.time - then.time;
+	auto rate = [&](counter c){
+		return window.count() > 0 ? (v[c] - then.values[c]) / window.count() : 0.0;
+	};
+
+	auto backlog = m_sources.backlog();
+	auto per_second = rate(finished);
+
+	std::ostringstream os;
+	os << format_duration( std::chrono::duration_cast<std::chrono::seconds>(now.time - m_start) )
+		<< " | " << v[active] << " connected, " << m_sources.threads() << " threads"
+		<< " | " << backlog << " queued"
+		<< " | " << v[finished] << " done, " << v[answered] << " answered, "
+		<< std::fixed << std::setprecision(1) << per_second * 60 << "/min"
+		<< " | " << v[discovered] << " new"
+		<< " | in " << format_rate( rate(bytes_in) ) << ", out " << format_rate( rate(bytes_out) )
+		<< " | " << v[timeouts] << " timeouts, " << v[errors] << " errors"
+		<< " | ETA ";
+	if(!backlog && !v[active])
+		os << "-";
+	else if(per_second > 0)
+		os << format_duration( std::chrono::seconds( std::int64_t( (backlog + v[active]) / per_second ) ) );
+	else
+		os << "?";
+	return os.str();
+}
@@ -0,0 +1,172 @@
+#include <string>
+#include <ostream>
+#include <memory>
+#include "export.hpp"
+
+using namespace k3yab::bawns;
+using namespace std::string_literals;
+
+namespace{
+
+//Callsigns are tame, so these only have to cover the corner cases of each format
+
+std::ostream &csv_field( std::ostream &stream, const char *str ){
+	std::string s(str);
+	if(s.find_first_of(",\"\r\n") == std::string::npos)
+		return stream << s;
+
+	stream << '"';
+	for(auto c : s){
+		if(c == '"')
+			stream << '"';
+		stream << c;
+	}
+	return stream << '"';
+}
+
+std::ostream &json_string( std::ostream &stream, const char *str ){
+	static constexpr char hex[] = "0123456789abcdef";
+	stream << '"';
+	for(; *str; ++str){
+		auto c = static_cast<unsigned char>(*str);
+		if(c == '"' || c == '\\')
+			stream << '\\' << *str;
+		else if(c < 0x20)
+			stream << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+		else
+			stream << *str;
+	}
+	return stream << '"';
+}
+
+std::ostream &xml_text( std::ostream &stream, const char *str ){
+	for(; *str; ++str){
+		switch(*str){
+			case '&': stream << "&amp;"; break;
+			case '<': stream << "&lt;"; break;
+			case '>': stream << "&gt;"; break;
+			case '"': stream << "&quot;"; break;
+			default: stream << *str;
+		}
+	}
+	return stream;
+}
+
+std::ostream &dot_id( std::ostream &stream, const char *str ){
+	stream << '"';
+	for(; *str; ++str){
+		if(*str == '"' || *str == '\\')
+			stream << '\\';
+		stream << *str;
+	}
+	return stream << '"';
+}
+
+//One row per node or edge, distinguished by the first column
+class CSVExporter:public Exporter{
+protected:
+	virtual void begin( std::ostream &stream ) override{
+		stream << "type,callsign,query_count,target\n";
+	}
+
+	virtual void node( std::ostream &stream, const node_type &n ) override{
+		stream << "node,";
+		csv_field(stream, n.callsign.c_str()) << ',' << n.query_count << ",\n";
+	}
+
+	virtual void edge( std::ostream &stream, const node_type &from, const node_type &to ) override{
+		stream << "edge,";
+		csv_field(stream, from.callsign.c_str()) << ",,";
+		csv_field(stream, to.callsign.c_str()) << '\n';
+	}
+};
+
+//Newline-delimited JSON, one object per node or edge
+class NDJSONExporter:public Exporter{
+protected:
+	virtual void node( std::ostream &stream, const node_type &n ) override{
+		stream << "{\"type\":\"node\",\"callsign\":";
+		json_string(stream, n.callsign.c_str()) << ",\"query_count\":" << n.query_count << "}\n";
+	}
+
+	virtual void edge( std::ostream &stream, const node_type &from, const node_type &to ) override{
+		stream << "{\"type\":\"edge\",\"from\":";
+		json_string(stream, from.callsign.c_str()) << ",\"to\":";
+		json_string(stream, to.callsign.c_str()) << "}\n";
+	}
+};
+
+//GraphML doesn't care whether an edge appears before the nodes it references
+class GraphMLExporter:public Exporter{
+protected:
+	virtual void begin( std::ostream &stream ) override{
+		stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			"<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
+			"  <key id=\"query_count\" for=\"node\" attr.name=\"query_count\" attr.type=\"int\"/>\n"
+			"  <graph id=\"baw\" edgedefault=\"directed\">\n";
+	}
+
+	virtual void node( std::ostream &stream, const node_type &n ) override{
+		stream << "    <node id=\"";
+		xml_text(stream, n.callsign.c_str()) << "\"><data key=\"query_count\">" << n.query_count << "</data></node>\n";
+	}
+
+	virtual void edge( std::ostream &stream, const node_type &from, const node_type &to ) override{
+		stream << "    <edge source=\"";
+		xml_text(stream, from.callsign.c_str()) << "\" target=\"";
+		xml_text(stream, to.callsign.c_str()) << "\"/>\n";
+	}
+
+	virtual void end( std::ostream &stream ) override{
+		stream << "  </graph>\n</graphml>\n";
+	}
+};
+
+class DOTExporter:public Exporter{
+protected:
+	virtual void begin( std::ostream &stream ) override{
+		stream << "digraph baw {\n";
+	}
+
+	virtual void node( std::ostream &stream, const node_type &n ) override{
+		stream << "  ";
+		dot_id(stream, n.callsign.c_str()) << " [query_count=" << n.query_count << "];\n";
+	}
+
+	virtual void edge( std::ostream &stream, const node_type &from, const node_type &to ) override{
+		stream << "  ";
+		dot_id(stream, from.callsign.c_str()) << " -> ";
+		dot_id(stream, to.callsign.c_str()) << ";\n";
+	}
+
+	virtual void end( std::ostream &stream ) override{
+		stream << "}\n";
+	}
+};
+
+}
+
+std::unique_ptr<Exporter> Exporter::make( const std::string &format ){
+	if(format == "csv")
+		return std::make_unique<CSVExporter>();
+	else if(format == "ndjson" || format == "json")
+		return std::make_unique<NDJSONExporter>();
+	else if(format == "graphml")
+		return std::make_unique<GraphMLExporter>();
+	else if(format == "dot")
+		return std::make_unique<DOTExporter>();
+	else
+		throw ExportError("Unrecognized export format: '"s + format + "'. Expected one of: " + format_names);
+}
+
+void Exporter::write( const state::StateFile &state, std::ostream &stream ){
+	begin(stream);
+
+	for(auto &n : state){
+		node(stream, n);
+		state.for_each_link( n, [&](const node_type &to){ edge(stream, n, to); } );
+	}
+
+	end(stream);
+	stream.flush();
+}
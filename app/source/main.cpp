@@ -19,25 +19,41 @@ static void show_banner(){
 
 int run( int argc, char *argv[] ){
 	console.init();
-	show_banner();
-
     k3yab::bawns::Config config(argc, argv);
+
+	//An export to stdout needs stdout to itself
+	if(config.offline() && config.output_path.empty())
+		console.out_fd = STDERR_FILENO;
+
+	show_banner();
     baw app(config);
-	app.run();
+
+	if(config.exporting())
+		app.export_state();
+	else if(config.routing())
+		app.print_routes();
+	else if(config.generating())
+		app.generate_nrparms();
+	else
+		app.run();
+
 	return 0;	
 }
 
 int main( int argc, char *argv[]){
 	try{
 		auto result = run(argc, argv);
-		std::cout << "Done" << std::endl;
+		console.out() << "Done" << std::endl;
+		console.flush();
 		return result;
 	}
 	catch(const std::exception &ex){
+		console.flush();
 		std::cout << "Unexpected exception..." << std::endl;
 		std::cout << ex;		
 	}
 	catch(...){
+		console.flush();
 		std::cout << "Unhandled exception type! Madness and chaos prevail!" << std::endl;
 	}
 
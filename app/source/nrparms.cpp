@@ -0,0 +1,158 @@
+#include <algorithm>
+#include "nrparms.hpp"
+
+using namespace k3yab::bawns;
+using namespace k3yab::bawns::routing;
+
+nr_entry::nr_entry( kind_type kind_, const std::string &callsign_, const std::string &neighbour_, const std::string &port_, quality_type quality_ ):
+	kind(kind_),
+	callsign(callsign_),
+	neighbour(neighbour_),
+	ident( kind_ == record_type::node ? default_ident(callsign_) : std::string() ),
+	port(port_),
+	quality(quality_){}
+
+nr_entry::nr_entry( const record_type &record ):
+	kind( static_cast<kind_type>(record.kind) ),
+	callsign( record.callsign.str() ),
+	neighbour( record.neighbour.str() ),
+	ident( record.ident.str() ),
+	port( record.port.str() ),
+	quality( record.quality ){}
+
+nr_entry::record_type nr_entry::record() const{
+	record_type result;
+	result.kind = kind;
+	result.callsign = callsign;
+	result.neighbour = neighbour;
+	result.ident = ident;
+	result.port = port;
+	result.quality = quality;
+	return result;
+}
+
+std::string nr_entry::default_ident( const std::string &callsign ){
+	return callsign.substr( 0, std::min<std::size_t>(callsign.find('-'), 6) );
+}
+
+std::ostream &k3yab::bawns::routing::operator<<( std::ostream &stream, const nr_command &cmd ){
+	const auto &e = cmd.entry;
+	const char op = cmd.add ? '+' : '-';
+
+	if(e.kind == nr_entry::record_type::route)
+		return stream << "nrparms -routes " << e.port << ' ' << e.callsign << ' ' << op << ' ' << int(e.quality);
+	else
+		return stream << "nrparms -nodes " << e.callsign << ' ' << op << ' ' << e.ident << ' ' << int(e.quality) << ' '
+			<< nr_command::obsolescence_count << ' ' << e.port << ' ' << e.neighbour;
+}
+
+RoutingTable::key_type RoutingTable::key( const nr_entry &e ){
+	return { e.kind, e.callsign, e.neighbour, e.port };
+}
+
+bool RoutingTable::routes_through( const nr_entry &route ) const{
+	return std::any_of( m_entries.begin(), m_entries.end(), [&](const auto &entry){
+		auto &e = entry.second;
+		return e.kind == nr_entry::record_type::node && e.neighbour == route.callsign && e.port == route.port;
+	});
+}
+
+RoutingTable::RoutingTable( const std::vector<state_file_blocks::route_record> &records ){
+	for(auto &r : records){
+		nr_entry e(r);
+		m_entries.insert_or_assign( key(e), e );
+	}
+}
+
+RoutingTable::RoutingTable( const RouteGraph &graph, const route_tree &routes, const std::string &port ){
+	using record_type = nr_entry::record_type;
+
+	if(routes.by != metric::quality)
+		throw RoutingError("Netrom routing tables need routes chosen by quality");
+
+	for(index_type n = 0; n < graph.size(); ++n){
+		if(!routes.reachable(n))
+			continue;
+
+		auto via = routes.first_hop(n);
+		auto &call = graph.callsign(n), &via_call = graph.callsign(via);
+
+		//Starred names are Netrom aliases, which can't be addressed as callsigns
+		if(call.starts_with('*') || via_call.starts_with('*'))
+			continue;
+
+		//A first hop is a source of the tree, so its cost is the quality of our port to it
+		nr_entry route( record_type::route, via_call, via_call, port, quality_type(routes.cost[via]) );
+		m_entries.insert_or_assign( key(route), route );
+
+		nr_entry node( record_type::node, call, via_call, port, quality_type(routes.cost[n]) );
+		m_entries.insert_or_assign( key(node), node );
+	}
+}
+
+std::size_t RoutingTable::size() const{
+	return m_entries.size();
+}
+
+bool RoutingTable::operator==( const RoutingTable &rhs ) const{
+	return m_entries == rhs.m_entries;
+}
+
+std::vector<state_file_blocks::route_record> RoutingTable::records() const{
+	std::vector<state_file_blocks::route_record> result;
+	result.reserve( m_entries.size() );
+	for(auto &entry : m_entries)
+		result.push_back( entry.second.record() );
+	return result;
+}
+
+void RoutingTable::apply( const nr_command &cmd ){
+	using record_type = nr_entry::record_type;
+	const auto &e = cmd.entry;
+	const auto k = key(e);
+
+	if(cmd.add){
+		if(e.kind == record_type::node && !m_entries.contains( { record_type::route, e.neighbour, e.neighbour, e.port } ))
+			throw RoutingError("Node " + e.callsign + " added by way of unknown neighbour " + e.neighbour);
+		m_entries.insert_or_assign(k, e);
+	}
+	else{
+		if(!m_entries.contains(k))
+			throw RoutingError("Deleting a routing table entry which doesn't exist: " + e.callsign + " via " + e.neighbour);
+		if(e.kind == record_type::route && routes_through(e))
+			throw RoutingError("Deleting neighbour " + e.callsign + " while nodes are still routed through it");
+		m_entries.erase(k);
+	}
+}
+
+void RoutingTable::apply( const std::vector<nr_command> &cmds ){
+	for(auto &cmd : cmds)
+		apply(cmd);
+}
+
+std::vector<nr_command> RoutingTable::diff( const RoutingTable &target ) const{
+	using record_type = nr_entry::record_type;
+	std::vector<nr_command> result;
+
+	//Adds and changes, neighbours first. A change is just an add over the top, which updates the quality.
+	for(auto kind : { record_type::route, record_type::node }){
+		for(auto &[k, e] : target.m_entries){
+			if(e.kind != kind)
+				continue;
+
+			auto it = m_entries.find(k);
+			if(it == m_entries.end() || !(it->second == e))
+				result.push_back( { true, e } );
+		}
+	}
+
+	//Then deletes, neighbours last
+	for(auto kind : { record_type::node, record_type::route }){
+		for(auto &[k, e] : m_entries){
+			if(e.kind == kind && !target.m_entries.contains(k))
+				result.push_back( { false, e } );
+		}
+	}
+
+	return result;
+}
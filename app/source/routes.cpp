@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <exception>
+#include <array>
+#include "concurrency/thread_pool.hpp"
+#include "concurrency/inline_task.hpp"
+#include "routes.hpp"
+
+using namespace k3yab::bawns;
+using namespace k3yab::bawns::routing;
+using namespace levitator::concurrency;
+
+bool route_tree::reachable( index_type n ) const{
+	return by == metric::hops ? cost[n] != none : cost[n] != 0;
+}
+
+index_type route_tree::first_hop( index_type n ) const{
+	if(!reachable(n))
+		return none;
+
+	while(parent[n] != none)
+		n = parent[n];
+	return n;
+}
+
+std::vector<index_type> route_tree::path( index_type n ) const{
+	std::vector<index_type> result;
+	if(!reachable(n))
+		return result;
+
+	for(; n != none; n = parent[n])
+		result.push_back(n);
+	std::reverse(result.begin(), result.end());
+	return result;
+}
+
+//Two passes over the file: one to number the nodes and one to lay out their links by number
+RouteGraph::RouteGraph( const state::StateFile &state, quality_type link_quality ){
+	using node_type = state_file_blocks::node;
+	std::unordered_map<const node_type *, index_type> numbers;
+
+	const auto count = state.size();
+	m_callsigns.reserve(count);
+	m_index.reserve(count);
+	numbers.reserve(count);
+
+	for(auto &n : state){
+		numbers.emplace( &n, index_type(m_callsigns.size()) );
+		m_index.emplace( n.callsign.str(), index_type(m_callsigns.size()) );
+		m_callsigns.push_back( n.callsign.str() );
+	}
+
+	m_row.reserve(count + 1);
+	m_row.push_back(0);
+	for(auto &n : state){
+		state.for_each_link( n, [&](const node_type &to){ m_column.push_back( numbers.at(&to) ); } );
+		m_row.push_back( index_type(m_column.size()) );
+	}
+	m_quality.assign( m_column.size(), link_quality );
+
+	state.for_each_root( [&](const node_type &n){ m_roots.push_back( numbers.at(&n) ); } );
+}
+
+std::size_t RouteGraph::size() const{
+	return m_callsigns.size();
+}
+
+std::size_t RouteGraph::edge_count() const{
+	return m_column.size();
+}
+
+const std::string &RouteGraph::callsign( index_type n ) const{
+	return m_callsigns.at(n);
+}
+
+index_type RouteGraph::index( const std::string &callsign ) const{
+	auto it = m_index.find(callsign);
+	if(it == m_index.end())
+		throw RoutingError("Unknown node: " + callsign);
+	return it->second;
+}
+
+const std::vector<index_type> &RouteGraph::roots() const{
+	return m_roots;
+}
+
+quality_type RouteGraph::combine( std::uint32_t path_quality, quality_type link_quality ){
+	return quality_type( (path_quality * link_quality + 128) / 256 );
+}
+
+//Plain BFS
+void RouteGraph::tree_by_hops( route_tree &tree, const std::vector<index_type> &sources, std::uint32_t source_cost ) const{
+	tree.cost.assign( size(), route_tree::none );
+	std::vector<index_type> queue;
+	queue.reserve( size() );
+
+	for(auto s : sources){
+		if(tree.cost[s] == route_tree::none){
+			tree.cost[s] = source_cost;
+			queue.push_back(s);
+		}
+	}
+
+	for(std::size_t head = 0; head < queue.size(); ++head){
+		const auto u = queue[head];
+		const auto next_cost = tree.cost[u] + 1;
+
+		for(auto e = m_row[u]; e < m_row[u + 1]; ++e){
+			const auto v = m_column[e];
+			if(tree.cost[v] == route_tree::none){
+				tree.cost[v] = next_cost;
+				tree.parent[v] = u;
+				queue.push_back(v);
+			}
+		}
+	}
+}
+
+//Dijkstra, maximizing quality. Combining qualities never increases them, so nodes can be settled
+//best-first, and since there are only 256 possible qualities, a bucket per quality stands in for the heap.
+//Quality 0 is Netrom for "no route", so paths that decay to it are dropped.
+void RouteGraph::tree_by_quality( route_tree &tree, const std::vector<index_type> &sources, std::uint32_t source_cost ) const{
+	tree.cost.assign( size(), 0 );
+	std::array<std::vector<index_type>, 256> buckets;
+
+	for(auto s : sources){
+		tree.cost[s] = source_cost;
+		buckets[source_cost].push_back(s);
+	}
+
+	for(auto q = source_cost; q > 0; --q){
+		auto &bucket = buckets[q];
+
+		//Links of quality 255 can put more into this bucket while it is being drained
+		while(!bucket.empty()){
+			const auto u = bucket.back();
+			bucket.pop_back();
+
+			//Stale entry for a node which has since been reached with a better quality
+			if(tree.cost[u] != q)
+				continue;
+
+			for(auto e = m_row[u]; e < m_row[u + 1]; ++e){
+				const auto v = m_column[e];
+				const auto vq = combine(q, m_quality[e]);
+				if(vq > tree.cost[v]){
+					tree.cost[v] = vq;
+					tree.parent[v] = u;
+					buckets[vq].push_back(v);
+				}
+			}
+		}
+	}
+}
+
+route_tree RouteGraph::tree( const std::vector<index_type> &sources, metric by, std::uint32_t source_cost ) const{
+	route_tree result{ by };
+	result.parent.assign( size(), route_tree::none );
+
+	if(by == metric::hops)
+		tree_by_hops( result, sources, source_cost );
+	else
+		tree_by_quality( result, sources, source_cost );
+
+	return result;
+}
+
+route_tree RouteGraph::local_routes( metric by, quality_type port_quality ) const{
+	return tree( m_roots, by, by == metric::hops ? 1 : port_quality );
+}
+
+std::vector<route_tree> RouteGraph::routes_from( const std::vector<index_type> &sources, metric by, unsigned int thread_count ) const{
+	for(auto s : sources){
+		if(s >= size())
+			throw RoutingError("Route source out of range: " + std::to_string(s));
+	}
+
+	const auto source_cost = by == metric::hops ? 0 : 255;
+	thread_count = std::max( 1u, std::min<unsigned int>(thread_count, sources.size()) );
+
+	//Each tree is independent
+	ThreadPool<InlineTask<>> workers( thread_count );
+	std::vector<Future<route_tree>> trees;
+	trees.reserve( sources.size() );
+	for(auto source : sources)
+		trees.push_back( workers.submit( [this, source, by, source_cost](){ return tree( { source }, by, source_cost ); } ) );
+
+	//In order, so the first failure reported is the first source's
+	std::vector<route_tree> result;
+	result.reserve( sources.size() );
+	for(auto &t : trees)
+		result.push_back( t.get() );
+
+	workers.shutdown();
+	return result;
+}
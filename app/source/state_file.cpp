@@ -1,15 +1,31 @@
 #include <cstring>
 #include <utility>
 #include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <list>
 #include "meta.hpp"
 #include "util.hpp"
+#include "crc32c.hpp"
 #include "state_file.hpp"
 #include "FSFile.hpp"		//Needed just for truncating files
+#include "console.hpp"
 
 using namespace k3yab::bawns;
 using namespace k3yab::bawns::state_file_blocks;
 using namespace jab::file;
 using namespace levitator::binfile;
+using namespace levitator::concurrency;
+using jab::util::LogChannel;
+
+//Opening, verifying and closing the state file
+static LogChannel state_log("state");
 
 state_file_blocks::callsign_type::callsign_type(){
 	m_callsign[0] = '\0';
@@ -54,9 +70,69 @@ state_file_blocks::node::node( const std::string &csign ):
 	callsign(csign){
 }
 
-void state_file_blocks::node::verify() const{
+//Field by field, so that padding doesn't figure into it
+std::uint32_t state_file_blocks::node::compute_checksum() const{
+	using jab::util::crc32c;
+	auto crc = crc32c( &rstart, sizeof(rstart) );
+	crc = crc32c( &callsign, sizeof(callsign), crc );
+	crc = crc32c( &link_list, sizeof(link_list), crc );
+	return crc32c( &query_count, sizeof(query_count), crc );
+}
+
+void state_file_blocks::node::seal(){
+	checksum = compute_checksum();
+}
+
+void state_file_blocks::node::verify( bool check_sum ) const{
 	check_record_ends(*this);	
 	callsign.verify();
+
+	if(check_sum && checksum != compute_checksum())
+		throw StateFileError("State file record checksum mismatch for node: " + callsign.str());
+}
+
+void state_file_blocks::route_record::verify() const{
+	check_record_ends(*this);
+	callsign.verify();
+	neighbour.verify();
+	ident.verify();
+	port.verify();
+
+	if(kind != route && kind != node)
+		throw StateFileError("Unrecognized route record in state file.");
+}
+
+state_file_blocks::route_record *state_file_blocks::route_set::records(){
+	return reinterpret_cast<route_record *>(this + 1);
+}
+
+const state_file_blocks::route_record *state_file_blocks::route_set::records() const{
+	return reinterpret_cast<const route_record *>(this + 1);
+}
+
+std::uint32_t state_file_blocks::route_set::compute_checksum() const{
+	auto crc = jab::util::crc32c( &count, sizeof(count) );
+	return jab::util::crc32c( records(), count * sizeof(route_record), crc );
+}
+
+void state_file_blocks::route_set::verify( bool check_sum ) const{
+	check_record_ends(*this);
+
+	if(count > capacity)
+		throw StateFileError("Route set in state file claims more records than it has room for.");
+
+	if(check_sum && checksum != compute_checksum())
+		throw StateFileError("State file checksum mismatch for the emitted route set.");
+
+	std::for_each( records(), records() + count, [](const route_record &r){ r.verify(); } );
+}
+
+bool state_file_blocks::header::checksums() const{
+	return flags & record_checksums;
+}
+
+bool state_file_blocks::header::closed_cleanly() const{
+	return flags & clean_close;
 }
 
 void state_file_blocks::header::verify() const{
@@ -72,15 +148,141 @@ void state_file_blocks::header::verify() const{
 		throw StateFileError("State file version numbers don't match");
 }
 
+//Bounded, because this can run before the node has been verified. Anything too long to be a callsign in the file has
+//to be at least the whole of the field, so it can't match one either.
+state::StateFile::index_entry::key_type state::StateFile::index_key( const char *callsign, std::size_t length ){
+	index_entry::key_type result{};
+	std::copy( callsign, callsign + ::strnlen(callsign, std::min(length, result.size())), result.begin() );
+	return result;
+}
+
+state::StateOffsetPtr<state_file_blocks::node> state::StateFile::find_loaded( const std::string &callsign ) const{
+	auto &loaded = m_state.loaded_nodes;
+	index_entry key{ index_key(callsign.c_str(), callsign.size() + 1), 0 };
+	auto it = std::lower_bound( loaded.begin(), loaded.end(), key );
+	if(it == loaded.end() || it->callsign != key.callsign)
+		return {};
+
+	//The index is the file's own, so it hands out pointers it can write through even from here
+	auto &bfile = const_cast<BinaryFile &>(m_state.bfile);
+	return { bfile.fetch<node_type>(it->offset), &bfile };
+}
+
 void state::StateFile::insert_all_nodes_node( node_type &nd){
-	auto call = std::string(nd.callsign.c_str());
+	auto call = nd.callsign.str();
 	auto ptr = offset_ptr<node>(&nd, &m_state.bfile );
 
-	//TODO
-	//auto value = typename node_map_type::value_type(call, ptr );
-	//auto result = m_state.nodes.insert( value );
-	//if(!result.second)
-	//	throw StateFileError("There's a duplicate entry in the state file, which means it's corrupt: " + nd.callsign.str());
+	auto value = typename node_map_type::value_type(call, ptr );
+	if(find_loaded(call) || !m_state.nodes.insert( value ).second)
+		throw StateFileError("There's a duplicate entry in the state file, which means it's corrupt: " + call);
+}
+
+//CRC32C of the whole image with the header's checksum field read as zero
+std::uint32_t state::StateFile::compute_file_checksum() const{
+	using jab::util::crc32c;
+	constexpr auto field_pos = offsetof(state_file_blocks::header, file_checksum);
+	constexpr auto field_end = field_pos + sizeof(header_type::file_checksum);
+	constexpr decltype(header_type::file_checksum) zero = 0;
+
+	auto lock = m_state.bfile.make_lock();
+	auto image = m_state.bfile.fetch<char>(0);
+	auto crc = crc32c( image, field_pos );
+	crc = crc32c( &zero, sizeof(zero), crc );
+	return crc32c( image + field_end, m_state.bfile.size() - field_end, crc );
+}
+
+void state::StateFile::verify_file_checksum() const{
+	if(compute_file_checksum() != header().get().file_checksum)
+		throw StateFileError("State file checksum mismatch. The file is corrupt or was modified externally.");
+}
+
+//Point the in-memory views at the structures in the file
+void state::StateFile::bind_views(){
+	auto head = offset_ptr<typename node_list_type::link_type>( &header().get().all_nodes, &m_state.bfile );
+	m_state.file_nodes = { head, BinaryFile::allocator<node_type>(m_state.bfile) };
+}
+
+//Verify and index all of the nodes in an existing file.
+//Walking the list is just pointer-chasing, so that's done up front. Then each slab is verified, and its part of the index
+//sorted and its pending nodes listed, by a thread pool, and the sorted runs are merged pairwise on the pool as well.
+//Nothing may allocate from the file until this is done, because the raw node pointers would go stale.
+void state::StateFile::load_nodes(){
+	std::vector<node_type *> nodes;
+	for(auto &node : m_state.file_nodes)
+		nodes.push_back(&node);
+
+	const auto slab_count = (nodes.size() + verify_slab_size - 1) / verify_slab_size;
+	const auto checksums = header().get().checksums();
+	const auto file_checksum = whole_file_checksum();
+	const auto task_count = slab_count + (file_checksum ? 1 : 0);
+	const auto thread_count = std::min<std::size_t>( task_count, std::max(1u, std::thread::hardware_concurrency()) );
+	const auto visit_serial = header().get().visit_serial;
+	const char *base = m_state.bfile.fetch<char>(0);
+	auto &loaded = m_state.loaded_nodes;
+	loaded.resize( nodes.size() );
+	std::vector<std::list<offset_ptr<node_type>>> pending( slab_count );
+
+	ThreadPool<CaptureTask> loaders( thread_count );
+	std::vector<Future<void>> tasks;
+
+	//The whole-file checksum is the biggest single piece, so get it started first
+	std::optional<Future<void>> whole_file;
+	if(file_checksum)
+		whole_file = loaders.submit( [this](){ verify_file_checksum(); } );
+
+	for(std::size_t i = 0; i < slab_count; ++i){
+		auto begin = i * verify_slab_size;
+		auto end = std::min( begin + verify_slab_size, nodes.size() );
+		tasks.push_back( loaders.submit( [&, begin, end, i](){
+			for(auto j = begin; j != end; ++j){
+				auto nodep = nodes[j];
+				nodep->verify(checksums);
+				loaded[j] = { index_key(nodep->callsign.c_str(), sizeof(nodep->callsign)), reinterpret_cast<const char *>(nodep) - base };
+				if(nodep->query_count < visit_serial)
+					pending[i].push_back( {nodep, &m_state.bfile} );
+			}
+			std::sort( loaded.begin() + begin, loaded.begin() + end );
+		}));
+	}
+
+	//Report the first corrupt slab in file order, or else the file checksum, once they've all finished with the nodes
+	std::exception_ptr error;
+	auto wait = [&error](Future<void> &task){
+		try{
+			task.get();
+		}
+		catch(...){
+			if(!error)
+				error = std::current_exception();
+		}
+	};
+	for(auto &task : tasks)
+		wait(task);
+	if(whole_file)
+		wait(*whole_file);
+	if(error)
+		std::rethrow_exception(error);
+
+	for(auto width = verify_slab_size; width < loaded.size(); width *= 2){
+		tasks.clear();
+		for(std::size_t begin = 0; begin + width < loaded.size(); begin += 2 * width){
+			auto middle = begin + width;
+			auto end = std::min( middle + width, loaded.size() );
+			tasks.push_back( loaders.submit( [&loaded, begin, middle, end](){
+				std::inplace_merge( loaded.begin() + begin, loaded.begin() + middle, loaded.begin() + end );
+			}));
+		}
+		for(auto &task : tasks)
+			task.get();
+	}
+
+	//Catch duplicates, which are side by side now
+	auto duplicate = std::adjacent_find( loaded.begin(), loaded.end(), [](const index_entry &a, const index_entry &b){ return a.callsign == b.callsign; } );
+	if(duplicate != loaded.end())
+		throw StateFileError("There's a duplicate entry in the state file, which means it's corrupt: " + std::string(duplicate->callsign.data()));
+
+	for(auto &slab : pending)
+		m_state.pending.splice( m_state.pending.end(), slab );
 }
 
 std::fstream null_stream;
@@ -98,7 +300,7 @@ static std::fstream open_file( const std::filesystem::path &path ){
 	return {path, std::fstream::binary | std::fstream::in | std::fstream::out };
 } 
 
-state::StateFile::StateFile( const std::filesystem::path &path ):m_state{
+state::StateFile::StateFile( const std::filesystem::path &path, bool checksums ):m_state{
 	open_file(path),
 	{m_state.stream, 4096},
 	{path}}{
@@ -106,32 +308,50 @@ state::StateFile::StateFile( const std::filesystem::path &path ):m_state{
 	//New/empty file case
 	if(m_state.bfile.size_on_disk() == 0){
 		m_state.bfile.construct<state_file_blocks::header>();
+		if(checksums)
+			header().get().flags |= header_type::record_checksums;
+		bind_views();
 	}
 	else{
 		header().get().verify();
-		//No nodes to process
-		if(!header().get().all_nodes.next)
-			return;
+		bind_views();
 
-		//Post-process an existing file with possible nodes in it
-		//First, build a dictionary of all of the node callsigns so that duplicates can be caught
-		//and while we are at it, we will build a list of those which are incomplete and need visiting.
-		for(auto &node : m_state.file_nodes){
-			node.verify();
-			insert_all_nodes_node(node);
-
-			if(node.query_count < header().get().visit_serial)
-				m_state.pending.push_back( {&node, &m_state.bfile });
+		//No nodes to process
+		if(!header().get().all_nodes.next){
+			if(whole_file_checksum())
+				verify_file_checksum();
 		}
+		//Post-process an existing file with possible nodes in it
+		else
+			load_nodes();
+
+		//Until the destructor says otherwise, whatever reaches the disk is from a run that hasn't finished
+		header().get().flags &= ~header_type::clean_close;
 	}
 }
 
+//Only a file the destructor last wrote has a checksum to go by. One from a run which was cut short, or which
+//only got as far as a flush() partway through, is checked a record at a time.
+bool state::StateFile::whole_file_checksum() const{
+	auto &head = header().get();
+	if(!head.checksums())
+		return false;
+
+	if(!head.closed_cleanly()){
+		JAB_LOG( state_log, warn ) << "State file " << m_state.file_path.string() << " wasn't closed cleanly. " <<
+			"Checking it a record at a time, rather than by the whole-file checksum." << std::endl;
+		return false;
+	}
+	return true;
+}
+
 state::StateFile::~StateFile(){
 
 	if(!m_state.bfile)
 		return;
 
-	m_state.bfile.flush();
+	header().get().flags |= header_type::clean_close;
+	flush();
 
 	const auto sz = m_state.bfile.size();
 	const auto dsz = m_state.bfile.size_on_disk();
@@ -150,6 +370,17 @@ state::StateFile::~StateFile(){
 state::StateFile &state::StateFile::operator=( state::StateFile &&rhs ){
 	m_state = std::move(rhs.m_state);
 	m_state.bfile.file(m_state.stream);
+
+	//Everything pointing into the file still refers to rhs's BinaryFile, so re-point it all at ours
+	if(m_state.bfile){
+		bind_views();
+
+		for(auto &p : m_state.pending)
+			p = { m_state.bfile.fetch<node_type>(p.offset()), &m_state.bfile };
+
+		for(auto &entry : m_state.nodes)
+			entry.second = { m_state.bfile.fetch<node_type>(entry.second.offset()), &m_state.bfile };
+	}
 	return *this;
 }
 
@@ -160,12 +391,34 @@ static BinaryFile::locked_ref< typename jab::util::copy_cv<BF, header>::type> fe
 	return bf.make_lock( *bf.template fetch<header>(0) );
 }
 
+void state::StateFile::flush(){
+	auto lock = m_state.bfile.make_lock();
+	if(header().get().checksums())
+		header().get().file_checksum = compute_file_checksum();
+	m_state.bfile.flush();
+}
+
+template<typename SF, typename Ptr>
+static auto &fetch_node( SF &sf, const Ptr &ptr ){
+	auto &result = *ptr;
+	result.verify( sf.header().get().checksums() );
+	return result;
+}
+
+state_file_blocks::node &state::StateFile::fetch( const offset_ptr<node_type> &ptr ){
+	return fetch_node(*this, ptr);
+}
+
+const state_file_blocks::node &state::StateFile::fetch( const offset_ptr<node_type> &ptr ) const{
+	return fetch_node(*this, ptr);
+}
+
 BinaryFile::locked_ref<header> state::StateFile::header(){
 	return fetch_header(m_state.bfile);
 }
 
 std::size_t state::StateFile::size() const{
-	return m_state.nodes.size();
+	return m_state.loaded_nodes.size() + m_state.nodes.size();
 }
 
 BinaryFile::locked_ref<const header> state::StateFile::header() const{
@@ -179,24 +432,22 @@ state::StateFile::const_iterator_type state::StateFile::begin() const{
 	return it.lock( std::move(guard) );
 }
 
-/*
 state::StateFile::const_iterator_type state::StateFile::end() const{
 	auto guard = m_state.bfile.make_lock();
-	return header::node_list_type::cend( &*header().get().all_node_listp ).lock_rebound( std::move(guard) );
+	return m_state.file_nodes.cend().lock( std::move(guard) );
 }
 
 state::StateFile::iterator_type state::StateFile::begin(){
 	auto guard = m_state.bfile.make_lock();
-	return header::node_list_type::begin( &*header().get().all_node_listp ).lock_rebound( std::move(guard) );
+	return m_state.file_nodes.begin().lock( std::move(guard) );
 }
 
 state::StateFile::iterator_type state::StateFile::end(){
 	auto guard = m_state.bfile.make_lock();
-	return header::node_list_type::end( &*header().get().all_node_listp ).lock_rebound( std::move(guard) );
+	return m_state.file_nodes.end().lock( std::move(guard) );
 }
-*/
 
-state::StateFile::node_pointer_type state::StateFile::append_node(const std::string &callsign){
+state::StateOffsetPtr<state_file_blocks::node> state::StateFile::append_node(const std::string &callsign){
 
 	//Update the state file
 	auto lock = m_state.bfile.make_lock();
@@ -206,18 +457,91 @@ state::StateFile::node_pointer_type state::StateFile::append_node(const std::str
 	//header().all_node_listp = linkp;
 	//auto nodep = m_state.bfile.list_insert<state_file_blocks::node>( header().get().all_node_listp, callsign );
 	auto &node = m_state.file_nodes.push_front(  {callsign} );
+	node.seal();
 
 	//Update table of all nodes
 	insert_all_nodes_node(node);
 
 	//Remember that this node has not been visited
 	m_state.pending.push_back( {&node, &m_state.bfile} );
-	return {&node};
+	return {&node, &m_state.bfile};
 }
 
-/*
-state::StateFile::node_pointer_type state::StateFile::append_root_node(const std::string &callsign){	
-	//Don't guard here because then you wind up with a list pointing to nothing
-	auto result = append_node(callsign);		
+bool state::StateFile::link_nodes( const offset_ptr<node_type> &from, const offset_ptr<node_type> &to ){
+	using list_type = state_file_blocks::header::node_list_type;
+	auto lock = m_state.bfile.make_lock();
+
+	bool found = false;
+	for_each_link( *from, [&](const node_type &n){ found = found || &n == &*to; } );
+	if(found)
+		return false;
+
+	//Allocations can relocate the file image, so raw pointers are only taken after the last one
+	if(!from->link_list){
+		auto headp = m_state.bfile.construct<list_type>();
+		from->link_list = headp;
+	}
+
+	auto linkp = m_state.bfile.construct<link_type>();
+	auto &head = *from->link_list;
+	linkp->value_ptr = &*to;
+	linkp->next = head.next;
+	head.next = linkp;
+	from->seal();
+	return true;
+}
+
+state::StateOffsetPtr<state_file_blocks::node> state::StateFile::append_root_node(const std::string &callsign){
+	auto lock = m_state.bfile.make_lock();
+	auto result = append_node(callsign);
+	add_root(result);
+	return result;
+}
+
+void state::StateFile::add_root( const offset_ptr<node_type> &nodep ){
+	auto lock = m_state.bfile.make_lock();
+
+	//The root list only refers to nodes which live in the list of all nodes
+	auto linkp = m_state.bfile.construct<link_type>();
+	auto &head = header().get().root_nodes;
+	linkp->value_ptr = &*nodep;
+	linkp->next = head.next;
+	head.next = linkp;
+}
+
+state::StateOffsetPtr<state_file_blocks::node> state::StateFile::find( const std::string &callsign ) const{
+	if(auto result = find_loaded(callsign))
+		return result;
+
+	auto it = m_state.nodes.find(callsign);
+	return it == m_state.nodes.end() ? offset_ptr<node_type>() : it->second;
+}
+
+std::vector<state_file_blocks::route_record> state::StateFile::emitted_routes() const{
+	auto lock = m_state.bfile.make_lock();
+	auto &hdr = header().get();
+	if(!hdr.emitted_routes)
+		return {};
+
+	auto &set = *hdr.emitted_routes;
+	set.verify( hdr.checksums() );
+	return { set.records(), set.records() + set.count };
+}
+
+void state::StateFile::emitted_routes( const std::vector<state_file_blocks::route_record> &records ){
+	auto lock = m_state.bfile.make_lock();
+	route_set *setp = header().get().emitted_routes ? &*header().get().emitted_routes : nullptr;
+
+	if(!setp || setp->capacity < records.size()){
+		//Leave some room to grow, so that every new node doesn't mean abandoning the old set
+		auto capacity = records.size() + records.size() / 2;
+		auto blockp = m_state.bfile.allocate( sizeof(route_set) + capacity * sizeof(route_record), alignof(route_set) );
+		setp = new(blockp) route_set();
+		setp->capacity = capacity;
+		header().get().emitted_routes = setp;
+	}
+
+	std::copy( records.begin(), records.end(), setp->records() );
+	setp->count = records.size();
+	setp->checksum = setp->compute_checksum();
 }
-*/
@@ -0,0 +1,61 @@
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "console.hpp"
+#include "crc32c.hpp"
+#include "checksum.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+
+void ChecksumTests::run(){
+
+	{
+		EllipsisGuard eg("Checking CRC32C against the standard check value ("s + (crc32c_hardware() ? "SSE4.2" : "table") + ")...");
+		if( crc32c("123456789", 9) != 0xe3069283 )
+			throw TestException("CRC32C check value is wrong");
+		if( crc32c_software("123456789", 9) != 0xe3069283 )
+			throw TestException("CRC32C check value is wrong from the table");
+		if( crc32c_hardware() && crc32c_sse42("123456789", 9) != 0xe3069283 )
+			throw TestException("CRC32C check value is wrong from SSE4.2");
+		eg.ok();
+	}
+
+	if(crc32c_hardware()){
+		EllipsisGuard eg("Checking that the SSE4.2 and table CRC32C agree at every length and alignment up to "s + std::to_string(Conf::checksum_test_max_length) + "...");
+		RandStream rng( Conf::checksum_test_seed );
+		std::vector<char> buf( Conf::checksum_test_max_length + 8 );
+		for(auto &c : buf)
+			c = rng.get();
+
+		for(int offset = 0; offset < 8; ++offset){
+			for(int len = 0; len <= Conf::checksum_test_max_length; ++len){
+				auto seed = std::uint32_t( rng.get() );
+				auto hw = crc32c_sse42( buf.data() + offset, len, seed );
+				auto sw = crc32c_software( buf.data() + offset, len, seed );
+				if(hw != sw)
+					throw TestException("CRC32C differs between SSE4.2 and the table, " + std::to_string(len) + " bytes at offset " + std::to_string(offset));
+			}
+		}
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that CRC32C computed in "s + std::to_string(Conf::checksum_test_splits) + " random pieces matches the whole...");
+		RandStream rng( Conf::checksum_test_seed );
+		std::vector<char> buf( Conf::checksum_test_buffer_size );
+		for(auto &c : buf)
+			c = rng.get();
+
+		const auto whole = crc32c( buf.data(), buf.size() );
+
+		for(int i = 0; i < Conf::checksum_test_splits; ++i){
+			auto split = rng.int_between(0, buf.size() + 1);
+			auto crc = crc32c( buf.data(), split );
+			crc = crc32c( buf.data() + split, buf.size() - split, crc );
+			if(crc != whole)
+				throw TestException("CRC32C split at " + std::to_string(split) + " doesn't match the whole");
+		}
+		eg.ok();
+	}
+}
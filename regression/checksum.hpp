@@ -0,0 +1,15 @@
+#pragma once
+#include "test.hpp"
+
+struct ChecksumTestsConfig{
+	static constexpr int checksum_test_seed = 0;
+	static constexpr int checksum_test_buffer_size = 1 << 20;
+	static constexpr int checksum_test_splits = 1000;
+	static constexpr int checksum_test_max_length = 1000;
+};
+
+class ChecksumTests{
+public:
+	using Conf = ChecksumTestsConfig;
+	void run();
+};
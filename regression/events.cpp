@@ -0,0 +1,111 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <filesystem>
+#include <unistd.h>
+#include "console.hpp"
+#include "event_log.hpp"
+#include "events.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+using namespace levitator;
+
+namespace{
+
+using Conf = EventLogTestsConfig;
+
+std::string test_name( int n ){
+	return n % 3 ? "N" + std::to_string(n) + "CALL-" + std::to_string(n % 16) : "A-LONGER-NAME-THAN-FITS-IN-ONE-RECORD-" + std::to_string(n);
+}
+
+//Each thread logs events 0, 1, 2... in turn, against a name of its own choosing, with a = the event number and b = which thread
+void log_events( EventLog &log ){
+	std::vector<std::uint32_t> ids;
+	for(int n = 0; n < Conf::names; ++n)
+		ids.push_back( log.intern( test_name(n) ) );
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < Conf::threads; ++t){
+		threads.emplace_back( [&, t](){
+			for(int i = 0; i < Conf::events; ++i)
+				log.record( 1 + i % 7, ids[(t + i) % Conf::names], i, t );
+		});
+	}
+	for(auto &th : threads)
+		th.join();
+	log.flush();
+}
+
+//Checks every event that turns up is what its thread logged, in order, and returns how many there were.
+//next is each thread's next expected event number, carried on from one file to the next. A thread's first event
+//can be anywhere, since older files may have been rotated away, but from then on there are no gaps.
+int check_events( const std::filesystem::path &path, std::map<std::int64_t, std::int64_t> &next ){
+	EventLogReader reader(path);
+	event_record e;
+	int count = 0;
+	while(reader.next(e)){
+		auto seen = next.contains(e.b);
+		auto &expect = next[e.b];
+		if(seen ? e.a != expect : e.a < 0)
+			throw TestException("Event " + std::to_string(e.a) + " from thread " + std::to_string(e.b) + " out of order in " + path.string());
+		if(e.type != 1 + e.a % 7 || reader.name(e.subject) != test_name( (e.b + e.a) % Conf::names ))
+			throw TestException("Event " + std::to_string(e.a) + " from thread " + std::to_string(e.b) + " mangled in " + path.string());
+		expect = e.a + 1;
+		++count;
+	}
+	return count;
+}
+
+}
+
+void EventLogTests::run(){
+	auto dir = std::filesystem::temp_directory_path() / ("event_log_test." + std::to_string( getpid() ));
+	std::filesystem::create_directories(dir);
+	auto path = dir / "events.bin";
+
+	{
+		EllipsisGuard eg("Logging "s + std::to_string(Conf::threads * Conf::events) + " events from " + std::to_string(Conf::threads) + " threads and reading them back...");
+		{
+			EventLog log( path, { .max_bytes = 0 } );
+			log_events(log);
+		}
+
+		std::map<std::int64_t, std::int64_t> next;
+		auto count = check_events( path, next );
+		if(count != Conf::threads * Conf::events)
+			throw TestException("Read back " + std::to_string(count) + " events, expected " + std::to_string(Conf::threads * Conf::events));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Rotating an event log every "s + std::to_string(Conf::rotate_bytes) + " bytes, keeping " + std::to_string(Conf::keep) + "...");
+		{
+			//The last test's log gets moved aside, and then rotated out of existence
+			EventLog log( path, { .max_bytes = Conf::rotate_bytes, .keep = Conf::keep } );
+			if(!std::filesystem::exists( EventLog::rotated_path(path, 1) ))
+				throw TestException("Opening an event log didn't keep the one already there");
+			log_events(log);
+		}
+		if(std::filesystem::exists( EventLog::rotated_path(path, Conf::keep + 1) ))
+			throw TestException("Event log rotation kept more files than it was asked to");
+
+		//The oldest ones are gone, so the events start part way in, but each file has all it needs to be read on its own
+		std::map<std::int64_t, std::int64_t> next;
+		int count = 0;
+		for(auto n = Conf::keep; n > 0; --n)
+			count += check_events( EventLog::rotated_path(path, n), next );
+		count += check_events( path, next );
+
+		for(int t = 0; t < Conf::threads; ++t){
+			if(next[t] != Conf::events)
+				throw TestException("Thread " + std::to_string(t) + "'s last events didn't make it to the newest file");
+		}
+		if(!count || count > Conf::threads * Conf::events)
+			throw TestException("Rotated event logs held " + std::to_string(count) + " events");
+		eg.ok();
+	}
+
+	std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include "test.hpp"
+
+struct EventLogTestsConfig{
+	static constexpr int threads = 4;
+	static constexpr int events = 10000;			//Per thread
+	static constexpr int names = 50;				//Some longer than a name record holds
+	static constexpr std::uint64_t rotate_bytes = 64 << 10;
+	static constexpr unsigned keep = 2;
+};
+
+class EventLogTests{
+public:
+	using Conf = EventLogTestsConfig;
+	void run();
+};
@@ -3,9 +3,17 @@
 #include <filesystem>
 #include <iostream>
 #include <sstream>
+#include <vector>
+#include <chrono>
+#include <iomanip>
+#include <cstring>
+#include <deque>
 #include "console.hpp"
 #include "io.hpp"
 #include "FSFile.hpp"
+#include "UringFile.hpp"
+#include "ringbuf.hpp"
+#include "mirror_buffer.hpp"
 #include "test.hpp"
 
 using namespace std;
@@ -107,3 +115,601 @@ void IOTests::run(){
 
 }
 
+
+namespace{
+
+//Random pushes and pops, checking what the ring holds against a deque
+void exercise_ring( jab::io::ringbuffer<char> &ring, RandStream &rnd, int operations ){
+	std::deque<char> expected;
+	char next = 0;
+	for(int i = 0; i < operations; ++i){
+		if(rnd.get() % 2){
+			auto n = std::min<std::streamsize>( ring.putavail(), rnd.int_between(0, ring.capacity() + 1) );
+			for(std::streamsize j = 0; j < n; ++j){
+				ring.put_begin()[j] = next;
+				expected.push_back(next++);
+			}
+			ring.push(n);
+		}
+		else{
+			auto n = std::min<std::streamsize>( ring.getavail(), rnd.int_between(0, ring.capacity() + 1) );
+			ring.pop(n);
+			expected.erase( expected.begin(), expected.begin() + n );
+		}
+
+		if(ring.size() != std::streamsize(expected.size()))
+			throw TestException("Ring size " + std::to_string(ring.size()) + " != " + std::to_string(expected.size()));
+		if(ring.mirrored() && ring.getavail() != expected.size())
+			throw TestException("A mirrored ring split what it holds");
+		if(ring.size() < ring.capacity() && !ring.putavail())
+			throw TestException("A ring with room had no put range");
+		if(!std::equal( ring.get_begin(), ring.get_end(), expected.begin() ))
+			throw TestException("Ring contents didn't match after " + std::to_string(i) + " operations");
+	}
+}
+
+const filesystem::path line_test_file_path = "line_test_data.txt";
+
+struct test_line{
+	std::string text, ending;
+};
+
+//Lines, with every ending, some empty and some long. No empty line follows a lone \r with a \n, which would be \r\n.
+std::vector<test_line> make_test_lines( RandStream &rnd ){
+	using Conf = LineReaderTestsConfig;
+	static const char *endings[] = { "\n", "\r\n", "\r" };
+	std::vector<test_line> result;
+	for(int i = 0; i < Conf::test_lines; ++i){
+		auto &line = result.emplace_back();
+		auto len = i % Conf::long_line_every ? rnd.int_between(0, Conf::max_line_size + 1) : 5000 + rnd.int_between(0, 100);
+		for(int c = 0; c < len; ++c)
+			line.text.push_back( IOTestsConfig::text_characters[rnd.get() % (sizeof(IOTestsConfig::text_characters) - 1)] );
+
+		do{
+			line.ending = endings[rnd.get() % 3];
+		}while( i && result[i - 1].ending == "\r" && line.text.empty() && line.ending == "\n" );
+	}
+
+	//And one with no ending, which EOF ends
+	result.push_back( { "LAST", "" } );
+	return result;
+}
+
+//Hands out a text over and over, in reads no bigger than a packet, as a replayed session would
+class ReplayFile : public File{
+	const std::string *m_text = nullptr;
+	std::size_t m_pos = 0, m_remaining = 0, m_calls = 0;
+	std::streamsize m_read_size = 1;
+
+public:
+	ReplayFile() = default;
+	ReplayFile( const std::string &text, std::size_t total, std::streamsize read_size ):
+		m_text(&text),
+		m_remaining(total),
+		m_read_size(read_size){}
+
+	virtual std::streamsize read( char *data, std::streamsize len ) override{
+		::iovec iov{ data, std::size_t(len) };
+		return readv(&iov, 1);
+	}
+
+	//As much as one read would give, spread over the segments
+	virtual std::streamsize readv( const ::iovec *iov, int iovcnt ) override{
+		std::streamsize total = 0, limit = std::min( m_read_size, std::streamsize(m_remaining) );
+		for(int i = 0; i < iovcnt; ++i){
+			auto data = static_cast<char *>(iov[i].iov_base);
+			auto len = std::min( std::streamsize(iov[i].iov_len), limit - total );
+			for(std::streamsize ct; len; data += ct, len -= ct, total += ct){
+				ct = std::min( len, std::streamsize(m_text->size() - m_pos) );
+				std::memcpy( data, m_text->data() + m_pos, ct );
+				m_pos = (m_pos + ct) % m_text->size();
+			}
+		}
+		m_remaining -= total;
+		++m_calls;
+		return total;
+	}
+
+	//Reads and readvs
+	std::size_t calls() const{
+		return m_calls;
+	}
+};
+
+//Takes no more than a few bytes a write, as a busy socket might, keeping what it's given
+class TrickleFile : public File{
+	std::string *m_out = nullptr;
+	std::size_t m_calls = 0;
+
+public:
+	static constexpr std::streamsize max_write = 5;
+
+	TrickleFile() = default;
+	TrickleFile( std::string &out ):
+		m_out(&out){}
+
+	virtual std::streamsize write( const char *data, std::streamsize len ) override{
+		::iovec iov{ const_cast<char *>(data), std::size_t(len) };
+		return writev(&iov, 1);
+	}
+
+	virtual std::streamsize writev( const ::iovec *iov, int iovcnt ) override{
+		std::streamsize total = 0;
+		for(int i = 0; i < iovcnt && total < max_write; ++i){
+			auto ct = std::min( std::streamsize(iov[i].iov_len), max_write - total );
+			m_out->append( static_cast<const char *>(iov[i].iov_base), ct );
+			total += ct;
+		}
+		++m_calls;
+		return total;
+	}
+
+	virtual void flush() override{}
+};
+
+//The way baw's my_getline read lines before getline_view
+std::size_t getline_by_character( std::istream &stream, std::string &result ){
+	using traits = std::istream::traits_type;
+	result.clear();
+	while(stream){
+		auto c = stream.get();
+		if(c == traits::eof() || c == '\n')
+			break;
+		else if(c == '\r'){
+			c = stream.get();
+			if(c != '\n' && c != traits::eof())
+				stream.putback( traits::char_type(c) );
+			break;
+		}
+		else
+			result.push_back(c);
+	}
+	return result.size();
+}
+
+}
+
+void RingBufferTests::run(){
+	RandStream rng(2);
+	{
+		EllipsisGuard eg("Pushing and popping " + std::to_string(Conf::test_operations) + " times on a " + std::to_string(Conf::plain_capacity) + "-character ring...");
+		std::vector<char> storage(Conf::plain_capacity);
+		jab::io::ringbuffer<char> ring( storage.data(), storage.size() );
+		exercise_ring( ring, rng, Conf::test_operations );
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that a mirror_buffer's second copy is its first...");
+		jab::io::mirror_buffer mirror(1);
+		for(std::size_t i = 0; i < mirror.size(); ++i)
+			mirror.data()[i] = char(i * 7);
+		for(std::size_t i = 0; i < mirror.size(); ++i){
+			if(mirror.data()[mirror.size() + i] != char(i * 7))
+				throw TestException("mirror_buffer's copies differ at " + std::to_string(i));
+		}
+		eg.ok();
+	}
+
+	{
+		jab::io::mirror_buffer mirror(1);
+		EllipsisGuard eg("Pushing and popping " + std::to_string(Conf::test_operations) + " times on a " + std::to_string(mirror.size()) + "-character mirrored ring...");
+		jab::io::ringbuffer<char> ring;
+		ring.buf( mirror.data(), mirror.size(), true );
+		exercise_ring( ring, rng, Conf::test_operations );
+		eg.ok();
+	}
+}
+
+void LineReaderTests::run(){
+	RandStream rng(1);
+	auto lines = make_test_lines(rng);
+
+	{
+		EllipsisGuard eg("Writing " + std::to_string(lines.size()) + " lines with mixed line endings...");
+		FSFile_iostream<char> s( line_test_file_path, flags::w | flags::create | flags::trunc );
+		for(auto &l : lines)
+			s << l.text << l.ending;
+		s.flush();
+		eg.ok();
+	}
+
+	for(auto size : Conf::buffer_sizes){
+		EllipsisGuard eg("Reading them back with getline_view through a " + std::to_string(size) + "-character buffer...");
+		FSFile_iostream<char> s( line_test_file_path, flags::r, size );
+		std::string_view line;
+		for(std::size_t i = 0; i < lines.size(); ++i){
+			if(!s.getline_view(line))
+				throw TestException("getline_view ran out of lines at line " + std::to_string(i));
+			if(line != lines[i].text)
+				throw TestException("getline_view line " + std::to_string(i) + " did not match: '" + std::string(line) + "'!='" + lines[i].text + "'");
+		}
+		if(!s.eof() || s.fail())
+			throw TestException("The last line, with no ending, should leave the stream at EOF, but not failed");
+		if(s.getline_view(line) || !s.fail())
+			throw TestException("getline_view should fail after the last line");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Reading them back with getline_view through a mirrored buffer...");
+		FSFile_iostream<char> s( line_test_file_path, flags::r );
+		s.mirror_read_buffer();
+		std::string_view line;
+		for(std::size_t i = 0; i < lines.size(); ++i){
+			if(!s.getline_view(line) || line != lines[i].text)
+				throw TestException("getline_view line " + std::to_string(i) + " through a mirrored buffer did not match");
+		}
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Mixing getline_view with formatted reads...");
+		{
+			FSFile_iostream<char> s( line_test_file_path, flags::w | flags::create | flags::trunc );
+			s << "J L\r\nN0CALL-7 K3YAB-2\r\nVIA W1AW\r\r\n42 end";
+			s.flush();
+		}
+		FSFile_iostream<char> s( line_test_file_path, flags::r, 3 );
+		std::string word, rest;
+		std::string_view line;
+		s >> word;
+		s.getline_view(line);
+		if(word != "J" || line != " L")
+			throw TestException("getline_view after >> got '" + std::string(line) + "'");
+		s >> word;
+		s.getline_view(line);
+		s.getline_view(line);
+		if(word != "N0CALL-7" || line != "VIA W1AW")
+			throw TestException("getline_view after >> and a line got '" + std::string(line) + "'");
+		s.getline_view(line);
+		if(!line.empty())
+			throw TestException("An empty \\r\\n line came back as '" + std::string(line) + "'");
+		int n = 0;
+		s >> n;
+		s.getline_view(line);
+		if(n != 42 || line != " end" || !s.eof())
+			throw TestException("A formatted read, then getline_view to EOF, got '" + std::string(line) + "'");
+		eg.ok();
+	}
+
+	filesystem::remove(line_test_file_path);
+}
+
+void ScatterGatherTests::run(){
+	RandStream rng(3);
+	std::string text;
+	for(int i = 0; i < 100000; ++i)
+		text.push_back( IOTestsConfig::text_characters[rng.get() % (sizeof(IOTestsConfig::text_characters) - 1)] );
+
+	{
+		EllipsisGuard eg("Writing through a 13-character buffer to a file taking " + std::to_string(TrickleFile::max_write) + " bytes at a time...");
+		std::string out;
+		File_iostream<char, TrickleFile> s( TrickleFile(out), 13 );
+		for(std::size_t pos = 0; pos < text.size(); ){
+			auto n = std::min<std::size_t>( rng.int_between(1, 20), text.size() - pos );
+			if(n % 2)
+				s << text.substr(pos, n);
+			else
+				s.write( text.data() + pos, n );
+			pos += n;
+		}
+		s.flush();
+		if(out != text)
+			throw TestException("What was written came out different, from byte " + std::to_string( std::mismatch(out.begin(), out.end(), text.begin()).first - out.begin() ));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Reading lines through a 13-character buffer, as much at a time as it has room for...");
+		std::string listing;
+		for(std::size_t pos = 0; pos < text.size(); pos += 11)
+			listing += text.substr(pos, 11) + "\r\n";
+		File_iostream<char, ReplayFile> s( ReplayFile(listing, listing.size(), 1 << 20), 13 );
+		std::string_view line;
+		for(std::size_t pos = 0; pos < text.size(); pos += 11){
+			if(!s.getline_view(line) || line != text.substr(pos, 11))
+				throw TestException("Line " + std::to_string(pos / 11) + " came out different");
+		}
+		eg.ok();
+	}
+}
+
+void ReadUntilTests::run(){
+	RandStream rng(9);
+	std::vector<std::string> records;
+	std::string text;
+	for(int i = 0; i < Conf::test_lines; ++i){
+		auto len = i % Conf::long_line_every ? rng.int_between(0, Conf::max_line_size) : rng.int_between(5000, 20000);
+		std::string r;
+		for(int j = 0; j < len; ++j)
+			r.push_back( IOTestsConfig::text_characters[rng.get() % (sizeof(IOTestsConfig::text_characters) - 1)] );
+		text += r;
+		records.push_back( std::move(r) );
+		if(i + 1 < Conf::test_lines)
+			text += '\r';
+	}
+
+	using ending = File::record_ending;
+	for(std::streamsize read_size : { 1, 3, 64, 4096, 1 << 20 }){
+		EllipsisGuard eg("Reading "s + std::to_string(records.size()) + " records with File::read_until, read up to " + std::to_string(read_size) + " bytes at a time...");
+		ReplayFile f( text, text.size(), read_size );
+		std::span<const char> record;
+		for(std::size_t i = 0; i < records.size(); ++i){
+			auto want = i + 1 < records.size() ? ending::delimiter : ending::eof;
+			if(f.read_until('\r', record) != want || std::string_view(record.data(), record.size()) != records[i])
+				throw TestException("Record " + std::to_string(i) + " came out different");
+		}
+		if(f.read_until('\r', record) != ending::none || !record.empty())
+			throw TestException("Something after the last record");
+		//About a read per block of the file, against one a byte as it used to be. Twice that allows for reads into what's
+		//left at the end of the buffer.
+		auto block = std::min<std::size_t>( read_size, jab::util::Config::io_block_size );
+		if(f.calls() > 2 * (text.size() / block + 1))
+			throw TestException(std::to_string(f.calls()) + " reads for " + std::to_string(text.size()) + " bytes");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Mixing File::read_until with read_exactly...");
+		std::string mixed = "abc\rdefgh\rij";
+		ReplayFile f( mixed, mixed.size(), 4096 );
+		char def[3];
+		if(f.read_until('\r') != "abc" || f.read_exactly(def, 3) != 3 || std::string_view(def, 3) != "def"
+			|| f.read_until('\r') != "gh" || f.read_until('\r') != "ij" || f.read_until('\r') != "")
+			throw TestException("Records and reads came out different");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Seeking and telling between File::read_until and read_exactly...");
+		std::string mixed = "abc\rdefgh\rij";
+		{
+			FSFile f( line_test_file_path, flags::w | flags::create | flags::trunc );
+			f.write_exactly( mixed.data(), mixed.size() );
+		}
+		FSFile f( line_test_file_path, flags::r );
+		char got[3];
+		if(f.read_until('\r') != "abc" || f.tell() != 4)
+			throw TestException("After the first record, tell() said " + std::to_string(f.tell()));
+		f.seek( 1, std::ios_base::beg );
+		if(f.read_exactly(got, 3) != 3 || std::string_view(got, 3) != "bc\r" || f.tell() != 4)
+			throw TestException("Reading after a seek back got what was read ahead from elsewhere");
+		if(f.read_until('\r') != "defgh")
+			throw TestException("Record after a seek came out different");
+		f.seek( -4, std::ios_base::cur );
+		if(f.read_exactly(got, 2) != 2 || std::string_view(got, 2) != "fg")
+			throw TestException("Seeking from the current position went from the end of the lookahead");
+		if(f.read_until('\r') != "h" || f.read_until('\r') != "ij" || f.tell() != std::streamsize(mixed.size()))
+			throw TestException("Records after seeking came out different");
+		eg.ok();
+	}
+	filesystem::remove(line_test_file_path);
+}
+
+void LineReaderBenchmark::run(){
+	//A made-up J L listing, CR-terminated as they are on the air
+	std::string listing;
+	for(int r = 0; r < 1000; ++r){
+		listing += "K" + std::to_string(r % 10) + "ABC-" + std::to_string(r % 16) + "  W1XYZ-2  11/0" + std::to_string(r % 10) + " 12:34\r";
+		listing += "  VIA W0HOP-" + std::to_string(r % 16) + " W1HOP-" + std::to_string((r + 1) % 16) + "\r";
+	}
+
+	std::streamsize read_size;
+	auto report = [&]( const char *name, auto &&read_all ){
+		File_iostream<char, ReplayFile> s( ReplayFile( listing, Conf::bench_bytes, read_size ) );
+		auto start = std::chrono::steady_clock::now();
+		std::size_t lines = read_all(s);
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::setw(24) << name << std::fixed << std::setprecision(1) << std::setw(12) << elapsed.count() / 1000
+			<< std::setw(12) << Conf::bench_bytes / elapsed.count() << std::setw(12) << lines << std::setw(12) << s.file().calls() << std::endl;
+	};
+
+	for(auto size : Conf::bench_read_sizes){
+		read_size = size;
+		std::cout << "Splitting " << (Conf::bench_bytes >> 20) << " MiB of replayed J L listing into lines, read up to " << read_size << " bytes at a time" << std::endl;
+		std::cout << std::setw(24) << "reader" << std::setw(12) << "ms" << std::setw(12) << "MB/s" << std::setw(12) << "lines" << std::setw(12) << "reads" << std::endl;
+
+		report( "get() per character", []( auto &s ){
+			std::size_t lines = 0;
+			std::string line;
+			while( getline_by_character(s, line) || s )
+				++lines;
+			return lines;
+		} );
+
+		report( "std::getline", []( auto &s ){
+			std::size_t lines = 0;
+			std::string line;
+			while( std::getline(s, line, '\r') )
+				++lines;
+			return lines;
+		} );
+
+		auto by_view = []( auto &s ){
+			std::size_t lines = 0;
+			std::string_view line;
+			while( s.getline_view(line) )
+				++lines;
+			return lines;
+		};
+		report( "getline_view", by_view );
+		report( "getline_view, mirrored", [&]( auto &s ){
+			s.mirror_read_buffer();
+			return by_view(s);
+		} );
+
+		//On the file, not the stream, as read_until was and is
+		report( "read_exactly per byte", []( auto &s ){
+			std::size_t lines = 0;
+			char ch = '\r';
+			while( s.file().read_exactly(&ch, 1) )
+				lines += ch == '\r';
+			return lines + (ch != '\r');		//The last line, cut short
+		} );
+		report( "File::read_until", []( auto &s ){
+			std::size_t lines = 0;
+			std::span<const char> record;
+			while( s.file().read_until('\r', record) != File::record_ending::none )
+				++lines;
+			return lines;
+		} );
+	}
+}
+
+namespace{
+
+const filesystem::path uring_test_file_path = "uring_test_data.bin";
+
+struct uring_variant{
+	const char *name;
+	UringFile::options opts;
+};
+
+const uring_variant uring_variants[] = {
+	{ "through the ring", {} },
+	{ "through 3 16-byte buffers", { 3, 16 } },
+	{ "fallen back", { UringFile::default_buffers, UringFile::default_buffer_size, false } }
+};
+
+std::string read_whole( const filesystem::path &path ){
+	FSFile f( path, r );
+	std::string result( filesystem::file_size(path), 0 );
+	f.read_exactly( result.data(), result.size() );
+	return result;
+}
+
+void check_same( const std::string &got, const std::string &want ){
+	if(got.size() != want.size())
+		throw TestException("File came out " + std::to_string(got.size()) + " bytes, not " + std::to_string(want.size()));
+	if(got != want)
+		throw TestException("File came out different, from byte " + std::to_string( std::mismatch(got.begin(), got.end(), want.begin()).first - got.begin() ));
+}
+
+}
+
+void UringFileTests::run(){
+	RandStream rng(5);
+	std::string text;
+	for(std::size_t i = 0; i < Conf::test_bytes; ++i)
+		text.push_back( IOTestsConfig::text_characters[rng.get() % (sizeof(IOTestsConfig::text_characters) - 1)] );
+
+	for(auto &v : uring_variants){
+		{
+			EllipsisGuard eg("Writing "s + std::to_string(text.size()) + " bytes to a UringFile " + v.name + "...");
+			{
+				UringFile f( uring_test_file_path, w | create | trunc, v.opts );
+				if(f.ring() != (v.opts.ring && jab::io::uring::supported()))
+					throw TestException(f.ring() ? "Went through a ring when it shouldn't have" : "Fell back when it shouldn't have");
+
+				int writes = 0;
+				for(std::size_t pos = 0; pos < text.size(); ){
+					auto n = std::min<std::size_t>( rng.int_between(1, Conf::max_write), text.size() - pos );
+					if(n % 2)
+						f.write_exactly( text.data() + pos, n );
+					else{
+						::iovec iov[2] = { { text.data() + pos, n / 2 }, { text.data() + pos + n / 2, n - n / 2 } };
+						if(f.writev( iov, 2 ) != std::streamsize(n))
+							throw TestException("writev() took less than it was given");
+					}
+					pos += n;
+					if(!(++writes % Conf::flush_every))
+						f.flush();
+				}
+			}
+			check_same( read_whole(uring_test_file_path), text );
+			eg.ok();
+		}
+
+		{
+			EllipsisGuard eg("Reading, seeking and overwriting part way through, "s + v.name + "...");
+			auto half = text.size() / 2;
+			std::string expect = text;
+			{
+				UringFile f( uring_test_file_path, r | w | create | trunc, v.opts );
+				f.write_exactly( text.data(), half );
+				f.seek( 0, std::ios_base::beg );
+				char start[100];
+				f.read_exactly( start, sizeof(start) );
+				if(std::string_view(start, sizeof(start)) != std::string_view(text.data(), sizeof(start)))
+					throw TestException("Read back something other than was written");
+				if(f.tell() != sizeof(start))
+					throw TestException("Reading left the file at " + std::to_string(f.tell()));
+
+				f.write_exactly( "XYZ", 3 );
+				expect.replace( sizeof(start), 3, "XYZ" );
+				if(f.seek( 0, std::ios_base::end ) != std::streamsize(half))
+					throw TestException("The end wasn't where it should have been");
+				f.write_exactly( text.data() + half, text.size() - half );
+				f.flush();
+				check_same( read_whole(uring_test_file_path), expect );
+			}
+			eg.ok();
+		}
+
+		{
+			EllipsisGuard eg("Writing lines through a stream on a UringFile "s + v.name + "...");
+			std::string expect;
+			{
+				File_iostream<char, UringFile> s( UringFile( uring_test_file_path, w | create | trunc, v.opts ), 13 );
+				for(std::size_t pos = 0; pos + 40 <= text.size() / 8; pos += 40){
+					s << std::string_view( text.data() + pos, 40 ) << "\r\n";
+					expect.append( text.data() + pos, 40 ).append("\r\n");
+				}
+				s.flush();
+			}
+			check_same( read_whole(uring_test_file_path), expect );
+			eg.ok();
+		}
+	}
+	filesystem::remove(uring_test_file_path);
+}
+
+void UringFileBenchmark::run(){
+	std::vector<char> record( Conf::bench_write_size );
+	for(std::size_t i = 0; i < record.size(); ++i)
+		record[i] = IOTestsConfig::text_characters[i % (sizeof(IOTestsConfig::text_characters) - 1)];
+
+	std::size_t flush_bytes;
+	auto report = [&]( const char *name, auto &&open ){
+		//Not truncating the last run's file, which would be timed along with this one
+		filesystem::remove(uring_test_file_path);
+		auto start = std::chrono::steady_clock::now();
+		{
+			auto f = open();
+			for(std::size_t done = record.size(); done <= Conf::bench_bytes; done += record.size()){
+				f.write_exactly( record.data(), record.size() );
+				if(flush_bytes && !(done % flush_bytes))
+					f.flush();
+			}
+			f.flush();
+		}
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::setw(24) << name << std::fixed << std::setprecision(1) << std::setw(12) << elapsed.count() / 1000
+			<< std::setw(12) << Conf::bench_bytes / elapsed.count() << std::endl;
+	};
+
+	for(auto f : Conf::bench_flush_bytes){
+		flush_bytes = f;
+		std::cout << "Writing " << (Conf::bench_bytes >> 20) << " MiB, " << Conf::bench_write_size << " bytes at a time, with an fsync ";
+		if(flush_bytes)
+			std::cout << "every " << (flush_bytes >> 20) << " MiB" << std::endl;
+		else
+			std::cout << "at the end" << std::endl;
+		std::cout << std::setw(24) << "writer" << std::setw(12) << "ms" << std::setw(12) << "MB/s" << std::endl;
+
+		report( "FSFile", [](){
+			return FSFile( uring_test_file_path, w | create | trunc );
+		} );
+		report( "UringFile, fallen back", [](){
+			return UringFile( uring_test_file_path, w | create | trunc, { UringFile::default_buffers, UringFile::default_buffer_size, false } );
+		} );
+		if(jab::io::uring::supported())
+			report( "UringFile", [](){
+				return UringFile( uring_test_file_path, w | create | trunc );
+			} );
+		else
+			std::cout << "No io_uring here" << std::endl;
+	}
+	filesystem::remove(uring_test_file_path);
+}
@@ -19,6 +19,84 @@ public:
     void run();
 };
 
+struct RingBufferTestsConfig{
+	static constexpr int test_operations = 200000;
+	static constexpr std::streamsize plain_capacity = 13;
+};
+
+//ringbuffer, plain and on a mirror_buffer, against a deque, through random pushes and pops
+class RingBufferTests{
+public:
+	using Conf = RingBufferTestsConfig;
+	void run();
+};
+
+struct LineReaderTestsConfig{
+	static constexpr int test_lines = 20000;
+	static constexpr int max_line_size = 40;
+	static constexpr int long_line_every = 100;		//Lines longer than the larger buffers tested with, now and then
+	static constexpr std::streamsize buffer_sizes[] = { 1, 2, 3, 5, 8, 13, 64, 4096 };
+
+	//Benchmark: a J L listing replayed from memory, in reads the size of a packet, and as big as the buffer will take
+	static constexpr std::size_t bench_bytes = std::size_t(256) << 20;
+	static constexpr std::streamsize bench_read_sizes[] = { 256, 1 << 20 };
+};
+
+//Filestreambuf::getline_view, against every line ending, across the ring's wrap, and with lines longer than the buffer
+class LineReaderTests{
+public:
+	using Conf = LineReaderTestsConfig;
+	void run();
+};
+
+//Filestreambuf filling and draining both segments of a wrapped ring at once, by File::readv and File::writev
+class ScatterGatherTests{
+public:
+	using Conf = LineReaderTestsConfig;
+	void run();
+};
+
+//File::read_until, on records up to several times its first buffer, read from a byte at a time up to a megabyte at a
+//time, and mixed with read_exactly, seek and tell
+class ReadUntilTests{
+public:
+	using Conf = LineReaderTestsConfig;
+	void run();
+};
+
+//Lines a character at a time through the stream, as baw used to get them, against getline_view, and a byte at a time
+//from the file, as File::read_until used to, against read_until
+class LineReaderBenchmark{
+public:
+	using Conf = LineReaderTestsConfig;
+	void run();
+};
+
+struct UringFileTestsConfig{
+	static constexpr std::size_t test_bytes = 1 << 20;
+	static constexpr int max_write = 300;
+	static constexpr int flush_every = 500;			//Writes
+
+	//Benchmark: writes the size of an EventLog thread buffer, with an fsync now and then, as a journal would, or only at the end
+	static constexpr std::size_t bench_bytes = std::size_t(256) << 20;
+	static constexpr std::size_t bench_write_size = 8192;
+	static constexpr std::size_t bench_flush_bytes[] = { 0, std::size_t(4) << 20 };
+};
+
+//UringFile through the ring, through buffers smaller than its writes, and fallen back, against what was written to it
+class UringFileTests{
+public:
+	using Conf = UringFileTestsConfig;
+	void run();
+};
+
+//Small writes by FSFile, one syscall each, and by UringFile
+class UringFileBenchmark{
+public:
+	using Conf = UringFileTestsConfig;
+	void run();
+};
+
 class IOTestOperation{
 public:
 	using Conf = IOTestsConfig;
@@ -0,0 +1,144 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include "console.hpp"
+#include "log.hpp"
+#include "logging.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+
+namespace{
+
+LogChannel test_log("test", log_level::warn);
+LogChannel bench_log("bench");
+
+using Conf = LoggingTestsConfig;
+
+//What a query says about one node's J L listing, as node_task does, to the given console
+void replay_node( Console &out, const std::string &call, const std::vector<std::string> &lines ){
+	auto print = [&](){ return out.out() << call << ": "; };
+	JAB_LOG_TO( bench_log, info, print() ) << "connecting..." << std::endl;
+	JAB_LOG_TO( bench_log, info, print() ) << "CONNECTED" << std::endl;
+	for(std::size_t i = 0; i + 1 < lines.size(); i += 2){
+		JAB_LOG_TO( bench_log, debug, print() ) << "Node line: " << lines[i] << std::endl;
+		JAB_LOG_TO( bench_log, debug, print() ) << "Fetching node " << lines[i].substr(0, 9) << "... " << std::endl;
+		JAB_LOG_TO( bench_log, debug, print() ) << "Node line: " << lines[i + 1] << std::endl;
+		JAB_LOG_TO( bench_log, info, print() ) << "'" << lines[i].substr(0, 9) << "' route: " << lines[i + 1].substr(4) << std::endl;
+	}
+	JAB_LOG_TO( bench_log, debug, print() ) << "This previous line looks like a command prompt, so route scan is done." << std::endl;
+	JAB_LOG_TO( bench_log, info, print() ) << "COMPLETE" << std::endl;
+}
+
+}
+
+void LoggingTests::run(){
+	{
+		EllipsisGuard eg("Checking that log statements below their channel's level aren't evaluated...");
+		int evaluated = 0;
+		auto count = [&](){ ++evaluated; return ""; };
+
+		LogChannel::configure("test=warn");
+		JAB_LOG( test_log, info ) << count();
+		JAB_LOG_TO( test_log, debug, (++evaluated, console.out()) ) << count();
+		if(evaluated)
+			throw TestException("A log statement below its channel's level was evaluated");
+
+		//trace is below what's compiled in, so even turning the channel right up leaves it out
+		LogChannel::configure("test=trace");
+		JAB_LOG_TO( test_log, trace, (++evaluated, console.out()) ) << count();
+		if(evaluated != (compiled_log_level <= log_level::trace ? 2 : 0))
+			throw TestException("A trace statement was evaluated though trace isn't compiled in");
+
+		//Nothing to see, just making sure they are evaluated when they're let through
+		LogChannel::configure("off,test=debug");
+		JAB_LOG_TO( test_log, debug, (++evaluated, std::ostringstream()) ) << count();
+		if(evaluated < 2)
+			throw TestException("A log statement at its channel's level wasn't evaluated");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Setting log levels by channel...");
+		LogChannel::configure("error,test=debug");
+		if(test_log.level() != log_level::debug || bench_log.level() != log_level::error || LogChannel::find("test") != &test_log)
+			throw TestException("Log levels weren't set as specified");
+
+		for(auto spec : { "test=loud", "nosuchchannel=info", "verbose" }){
+			try{
+				LogChannel::configure(spec);
+				throw TestException("Bad log level spec '"s + spec + "' was accepted");
+			}
+			catch( const std::invalid_argument & ){
+			}
+		}
+		LogChannel::configure("info");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that a message clears the status line in the same write as it goes out in...");
+		const char *path = "console_test.txt";
+		Console out;
+		out.out_fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+		out.status("S");
+		out.queue_out("x\n");
+		out.clear_status();
+		out.flush();
+		close(out.out_fd);
+
+		std::ifstream in(path, std::ios::binary);
+		std::string written{ std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+		in.close();
+		std::remove(path);
+		if(written != "\rS\x1b[K\r\x1b[Kx\n")
+			throw TestException("A status line and the message after it were written as '" + written + "'");
+		eg.ok();
+	}
+}
+
+void LoggingBenchmark::run(){
+	//A made-up crawl, but with the shape of a real one's listings
+	std::vector<std::string> calls;
+	std::vector<std::vector<std::string>> listings;
+	for(int n = 0; n < Conf::bench_nodes; ++n){
+		calls.push_back( "N" + std::to_string(n % 10) + "CALL-" + std::to_string(n % 16) );
+		auto &lines = listings.emplace_back();
+		for(int r = 0; r < Conf::bench_routes; ++r){
+			lines.push_back( "K" + std::to_string(r % 10) + "ABC-" + std::to_string(r % 16) + "  W1XYZ-2  11/0" + std::to_string(r % 10) + " 12:34" );
+			std::string via = "VIA";
+			for(int h = 0; h < Conf::bench_hops; ++h)
+				via += " W" + std::to_string(h) + "HOP-" + std::to_string((r + h) % 16);
+			lines.push_back(via);
+		}
+	}
+
+	std::cout << "Console logging of a replayed crawl, " << Conf::bench_nodes << " nodes listing " << Conf::bench_routes << " routes each, to /dev/null" << std::endl;
+	std::cout << std::setw(10) << "level" << std::setw(12) << "ms" << std::setw(16) << "statements/us" << std::endl;
+	const double statements = Conf::bench_nodes * (4.0 + 2 * Conf::bench_routes);
+	for(auto level : { "debug", "info", "off" }){
+		LogChannel::configure( "bench="s + level );
+		Console out;
+		out.out_fd = open( "/dev/null", O_WRONLY );
+
+		auto start = std::chrono::steady_clock::now();
+		for(int n = 0; n < Conf::bench_nodes; ++n)
+			replay_node( out, calls[n], listings[n] );
+		out.flush();
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+		close(out.out_fd);
+		std::cout << std::setw(10) << level << std::fixed << std::setprecision(2) << std::setw(12) << elapsed.count() / 1000
+			<< std::setw(16) << statements / elapsed.count() << std::endl;
+	}
+	LogChannel::configure("info");
+}
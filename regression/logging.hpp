@@ -0,0 +1,22 @@
+#pragma once
+#include "test.hpp"
+
+struct LoggingTestsConfig{
+	//Benchmark: a crawl's worth of J L listings, replayed through the log statements a query makes
+	static constexpr int bench_nodes = 2000;		//Nodes queried
+	static constexpr int bench_routes = 40;			//Routes each one lists
+	static constexpr int bench_hops = 3;
+};
+
+class LoggingTests{
+public:
+	using Conf = LoggingTestsConfig;
+	void run();
+};
+
+//The same replay with the query channel at debug, as it was before there were levels, at info, and turned off
+class LoggingBenchmark{
+public:
+	using Conf = LoggingTestsConfig;
+	void run();
+};
@@ -1,13 +1,101 @@
 #include <exception>
 #include <iostream>
+#include <string>
 #include "exception.hpp"
 #include "io.hpp"
+#include "checksum.hpp"
+#include "work_stealing.hpp"
+#include "queue.hpp"
+#include "thread_pool.hpp"
+#include "timer.hpp"
+#include "events.hpp"
+#include "logging.hpp"
+#include "polling.hpp"
+#include "routing.hpp"
+#include "state.hpp"
 
 using namespace jab::exception;
 
-int main(){
+//Benchmarks take a while, so they only run when asked for with --bench
+static void run_benchmarks(){
+    WorkStealingBenchmark work_stealing_benchmark;
+    work_stealing_benchmark.run();
+
+    QueueBenchmark queue_benchmark;
+    queue_benchmark.run();
+
+    ThreadPoolBenchmark thread_pool_benchmark;
+    thread_pool_benchmark.run();
+
+    TimerBenchmark timer_benchmark;
+    timer_benchmark.run();
+
+    LoggingBenchmark logging_benchmark;
+    logging_benchmark.run();
+
+    LineReaderBenchmark line_reader_benchmark;
+    line_reader_benchmark.run();
+
+    UringFileBenchmark uring_file_benchmark;
+    uring_file_benchmark.run();
+
+    StateFileBenchmark state_file_benchmark;
+    state_file_benchmark.run();
+}
+
+int main( int argc, char *argv[] ){
 
     try{
+        if(argc > 1 && std::string(argv[1]) == "--bench"){
+            run_benchmarks();
+            return 0;
+        }
+
+        ChecksumTests checksum_tests;
+        checksum_tests.run();
+
+        WorkStealingTests work_stealing_tests;
+        work_stealing_tests.run();
+
+        QueueTests queue_tests;
+        queue_tests.run();
+
+        ThreadPoolTests thread_pool_tests;
+        thread_pool_tests.run();
+
+        TimerTests timer_tests;
+        timer_tests.run();
+
+        EventLogTests event_log_tests;
+        event_log_tests.run();
+
+        LoggingTests logging_tests;
+        logging_tests.run();
+
+        RingBufferTests ring_buffer_tests;
+        ring_buffer_tests.run();
+
+        LineReaderTests line_reader_tests;
+        line_reader_tests.run();
+
+        ScatterGatherTests scatter_gather_tests;
+        scatter_gather_tests.run();
+
+        ReadUntilTests read_until_tests;
+        read_until_tests.run();
+
+        UringFileTests uring_file_tests;
+        uring_file_tests.run();
+
+        ReactorTests reactor_tests;
+        reactor_tests.run();
+
+        RoutingTests routing_tests;
+        routing_tests.run();
+
+        StateFileTests state_file_tests;
+        state_file_tests.run();
+
         IOTests io_tests;
         io_tests.run();        
     }
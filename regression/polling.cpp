@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "console.hpp"
+#include "File.hpp"
+#include "reactor.hpp"
+#include "polling.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+using namespace jab::file;
+using namespace levitator;
+
+namespace{
+
+using clock_type = Reactor::clock_type;
+
+struct socket_pair{
+	File a, b;
+
+	socket_pair(){
+		int fds[2];
+		if(::socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) == -1)
+			throw TestException("Couldn't make a socket pair");
+		a = File(fds[0]);
+		b = File(fds[1]);
+	}
+};
+
+//Runs the loop until done says so, or a second has gone by
+template<typename F>
+void run_until( Reactor &reactor, F done ){
+	auto deadline = clock_type::now() + std::chrono::seconds(1);
+	while(!done() && clock_type::now() < deadline)
+		reactor.run_once( std::chrono::milliseconds(10) );
+	if(!done())
+		throw TestException("Reactor didn't get round to it");
+}
+
+void check_readiness(){
+	Reactor reactor;
+	socket_pair s;
+	s.a.nonblocking(true);
+	s.a.reactor(&reactor);
+	if(!reactor.contains(s.a))
+		throw TestException("Nonblocking file wasn't registered");
+
+	int calls = 0;
+	std::uint32_t seen = 0;
+	auto handler = [&](std::uint32_t events){
+		++calls;
+		seen = events;
+	};
+
+	reactor.arm( s.a, Reactor::readable, handler );
+	reactor.run_once( std::chrono::milliseconds(10) );
+	if(calls)
+		throw TestException("Handler ran with nothing to read");
+
+	s.b.write_exactly( "x", 1 );
+	run_until( reactor, [&](){ return calls > 0; } );
+	if(!(seen & Reactor::readable))
+		throw TestException("Handler wasn't told the socket was readable");
+
+	//One-shot: more data, but nothing armed, so nothing runs
+	s.b.write_exactly( "y", 1 );
+	reactor.run_once( std::chrono::milliseconds(10) );
+	if(calls != 1)
+		throw TestException("Handler ran again without being rearmed");
+
+	//Edge-triggered, but rearming with data already waiting reports it
+	reactor.arm( s.a, Reactor::readable, handler );
+	run_until( reactor, [&](){ return calls > 1; } );
+
+	s.a.nonblocking(false);
+	if(reactor.contains(s.a))
+		throw TestException("Blocking file was left in the reactor");
+	s.a.nonblocking(true);
+	auto fd = s.a.fd();
+	s.a.close();
+	if(reactor.contains(fd))
+		throw TestException("Closed file was left in the reactor");
+}
+
+void check_deadlines(){
+	using Conf = ReactorTestsConfig;
+
+	Reactor reactor;
+	socket_pair s;
+	s.a.nonblocking(true);
+	s.a.reactor(&reactor);
+
+	int calls = 0;
+	std::uint32_t seen = Reactor::readable;
+	auto start = clock_type::now();
+	auto due = start + std::chrono::milliseconds(Conf::deadline_ms);
+	reactor.arm( s.a, Reactor::readable, [&](std::uint32_t events){ ++calls; seen = events; }, due );
+	run_until( reactor, [&](){ return calls > 0; } );
+	if(seen != Reactor::timed_out)
+		throw TestException("Deadline didn't report timed_out");
+	if(clock_type::now() < due)
+		throw TestException("Deadline went off early");
+
+	//Readiness cancels the deadline
+	reactor.arm( s.a, Reactor::readable, [&](std::uint32_t events){ ++calls; seen = events; }, clock_type::now() + std::chrono::milliseconds(Conf::deadline_ms) );
+	s.b.write_exactly( "x", 1 );
+	run_until( reactor, [&](){ return calls > 1; } );
+	if(!(seen & Reactor::readable))
+		throw TestException("Readiness before the deadline wasn't reported");
+	auto wait_out = clock_type::now() + std::chrono::milliseconds(2 * Conf::deadline_ms);
+	while(clock_type::now() < wait_out)
+		reactor.run_once( std::chrono::milliseconds(5) );
+	if(calls != 2)
+		throw TestException("Deadline went off after the socket was ready");
+
+	bool ran = false, cancelled_ran = false;
+	reactor.schedule_after( std::chrono::milliseconds(1), [&](){ ran = true; } );
+	auto id = reactor.schedule_after( std::chrono::milliseconds(1), [&](){ cancelled_ran = true; } );
+	reactor.cancel(id);
+	run_until( reactor, [&](){ return ran; } );
+	if(cancelled_ran)
+		throw TestException("Cancelled task ran");
+}
+
+//More descriptors than select() could ever be given, each written to and each seen
+void check_many(){
+	using Conf = ReactorTestsConfig;
+
+	::rlimit limit;
+	::getrlimit( RLIMIT_NOFILE, &limit );
+	if(limit.rlim_cur < rlim_t(3 * Conf::socket_pairs)){
+		limit.rlim_cur = std::min<rlim_t>( limit.rlim_max, 3 * Conf::socket_pairs );
+		::setrlimit( RLIMIT_NOFILE, &limit );
+	}
+
+	Reactor reactor;
+	std::vector<socket_pair> pairs( Conf::socket_pairs );
+	if(pairs.back().a.fd() < FD_SETSIZE)
+		throw TestException("Didn't get past FD_SETSIZE");
+
+	std::vector<int> calls( pairs.size() );
+	for(std::size_t i = 0; i < pairs.size(); ++i){
+		pairs[i].a.nonblocking(true);
+		pairs[i].a.reactor(&reactor);
+		reactor.arm( pairs[i].a, Reactor::readable, [&calls, i](std::uint32_t){ ++calls[i]; } );
+	}
+	for(auto &p : pairs)
+		p.b.write_exactly( "x", 1 );
+
+	std::size_t total = 0;
+	while(total < pairs.size()){
+		auto n = reactor.run_once( std::chrono::milliseconds(100) );
+		if(!n)
+			throw TestException("Only " + std::to_string(total) + " descriptors were seen to be ready");
+		total += n;
+	}
+	for(std::size_t i = 0; i < pairs.size(); ++i){
+		if(calls[i] != 1)
+			throw TestException("Descriptor " + std::to_string(pairs[i].a.fd()) + " was handled " + std::to_string(calls[i]) + " times");
+	}
+}
+
+//Just enough of a coroutine type to start one and leave it to the reactor
+struct detached{
+	struct promise_type{
+		detached get_return_object(){ return {}; }
+		std::suspend_never initial_suspend(){ return {}; }
+		std::suspend_never final_suspend() noexcept{ return {}; }
+		void return_void(){}
+		void unhandled_exception(){ std::terminate(); }
+	};
+};
+
+detached echo( Reactor &reactor, File &f, std::string &out, bool &done ){
+	while(true){
+		auto events = co_await reactor.ready( f, Reactor::readable );
+		if(!(events & Reactor::readable))
+			break;
+		char buf[64];
+		auto n = f.read( buf, sizeof(buf) );
+		if(!n)
+			break;
+		out.append( buf, n );
+	}
+	done = true;
+}
+
+void check_coroutine(){
+	Reactor reactor;
+	socket_pair s;
+	s.a.nonblocking(true);
+	s.a.reactor(&reactor);
+
+	std::string out;
+	bool done = false;
+	echo( reactor, s.a, out, done );
+	s.b.write_exactly( "hello, ", 7 );
+	run_until( reactor, [&](){ return out.size() == 7; } );
+	s.b.write_exactly( "world", 5 );
+	s.b.close();
+	run_until( reactor, [&](){ return done; } );
+	if(out != "hello, world")
+		throw TestException("Coroutine read \"" + out + "\"");
+}
+
+//A nonblocking socket that fills up over and over, while the loop runs on a thread of its own and the far end reads slowly
+void check_write_exactly(){
+	using Conf = ReactorTestsConfig;
+
+	Reactor reactor;
+	std::thread loop( [&reactor](){ reactor.run(); } );
+	socket_pair s;
+	s.a.nonblocking(true);
+	s.a.reactor(&reactor);
+
+	std::vector<char> data( Conf::write_bytes );
+	for(std::size_t i = 0; i < data.size(); ++i)
+		data[i] = char(i * 31 + i / 4096);
+
+	std::vector<char> received;
+	std::thread reader( [&](){
+		std::vector<char> buf( Conf::drain_chunk );
+		while(std::size_t n = s.b.read( buf.data(), buf.size() )){
+			received.insert( received.end(), buf.begin(), buf.begin() + n );
+			if(received.size() % (Conf::drain_chunk * 64) < Conf::drain_chunk)
+				std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		}
+	});
+
+	std::exception_ptr error;
+	try{
+		s.a.write_exactly( data.data(), data.size() );
+		s.a.close();
+	}
+	catch(...){
+		error = std::current_exception();
+		s.a.close();
+	}
+	reader.join();
+	reactor.stop();
+	loop.join();
+	if(error)
+		std::rethrow_exception(error);
+	if(received != data)
+		throw TestException("write_exactly through the reactor sent " + std::to_string(received.size()) + " bytes, not all of them right");
+}
+
+//Waits for writing, from other threads and two at once, leave the reading arm be
+void check_sides(){
+	using Conf = ReactorTestsConfig;
+
+	Reactor reactor;
+	std::thread loop( [&reactor](){ reactor.run(); } );
+	socket_pair s;
+	s.a.nonblocking(true);
+	s.a.reactor(&reactor);
+
+	std::atomic<int> reads = 0;
+	reactor.arm( s.a, Reactor::readable, [&reads](std::uint32_t){ ++reads; } );
+	while(!reactor.can_wait())
+		std::this_thread::yield();
+	auto writable = reactor.wait( s.a, Reactor::writable, clock_type::now() + std::chrono::seconds(1) );
+
+	//Full, so that both waits are still waiting when the far end starts reading
+	std::vector<char> block( Conf::drain_chunk );
+	while(true){
+		try{
+			s.a.write( block.data(), block.size() );
+		}
+		catch(const std::exception &){
+			break;
+		}
+	}
+	std::atomic<std::uint32_t> first = 0, second = 0;
+	std::thread w1( [&](){ first = reactor.wait( s.a, Reactor::writable, clock_type::now() + std::chrono::seconds(1) ); } );
+	std::thread w2( [&](){ second = reactor.wait( s.a, Reactor::writable, clock_type::now() + std::chrono::seconds(1) ); } );
+	std::this_thread::sleep_for( std::chrono::milliseconds(Conf::deadline_ms) );
+	std::vector<char> buf( Conf::drain_chunk );
+	while(s.b.available())
+		s.b.read( buf.data(), buf.size() );
+	w1.join();
+	w2.join();
+
+	s.b.write_exactly( "x", 1 );
+	auto deadline = clock_type::now() + std::chrono::seconds(1);
+	while(!reads && clock_type::now() < deadline)
+		std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+	reactor.stop();
+	loop.join();
+
+	if(!(writable & Reactor::writable))
+		throw TestException("Waiting for an empty socket to be writable didn't say it was");
+	if(!(first & Reactor::writable) || !(second & Reactor::writable))
+		throw TestException("Two threads waiting on one socket weren't both told it was writable");
+	if(reads != 1)
+		throw TestException("Reading arm ran " + std::to_string(reads) + " times, after waits for writing");
+}
+
+//A handler writing more than the socket holds to its own descriptor, and a write with no loop running at all, each
+//poll() rather than waiting on a reactor that can't answer
+void check_write_in_loop(){
+	using Conf = ReactorTestsConfig;
+
+	Reactor reactor;
+	socket_pair s;
+	s.a.nonblocking(true);
+	s.a.reactor(&reactor);
+
+	std::vector<char> data( Conf::write_bytes );
+	for(std::size_t i = 0; i < data.size(); ++i)
+		data[i] = char(i * 7 + i / 4096);
+
+	std::vector<char> received;
+	std::thread reader( [&](){
+		std::vector<char> buf( Conf::drain_chunk );
+		while(received.size() < 2 * data.size()){
+			auto n = s.b.read( buf.data(), buf.size() );
+			if(!n)
+				break;
+			received.insert( received.end(), buf.begin(), buf.begin() + n );
+		}
+	});
+
+	std::exception_ptr error;
+	try{
+		s.a.write_exactly( data.data(), data.size() );
+
+		bool done = false;
+		reactor.arm( s.a, Reactor::writable, [&](std::uint32_t){
+			try{
+				s.a.write_exactly( data.data(), data.size() );
+			}
+			catch(...){
+				error = std::current_exception();
+			}
+			done = true;
+		});
+		auto deadline = clock_type::now() + std::chrono::seconds(10);
+		while(!done && clock_type::now() < deadline)
+			reactor.run_once( std::chrono::milliseconds(10) );
+		if(!done)
+			throw TestException("Handler's write never finished");
+	}
+	catch(...){
+		if(!error)
+			error = std::current_exception();
+	}
+	s.a.close();
+	reader.join();
+	if(error)
+		std::rethrow_exception(error);
+	if(received.size() != 2 * data.size() || !std::equal( data.begin(), data.end(), received.begin() ) || !std::equal( data.begin(), data.end(), received.begin() + data.size() ))
+		throw TestException("Writes outside the loop and from its handler sent " + std::to_string(received.size()) + " bytes, not all of them right");
+}
+
+}
+
+void ReactorTests::run(){
+
+	{
+		EllipsisGuard eg("Reactor readiness and one-shot arming...");
+		check_readiness();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Reactor deadlines and timers...");
+		check_deadlines();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Reactor with "s + std::to_string(2 * Conf::socket_pairs) + " descriptors...");
+		check_many();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Coroutine resumed by the reactor...");
+		check_coroutine();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("File::write_exactly on a nonblocking socket, waiting on the reactor...");
+		check_write_exactly();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Reactor waits for writing alongside a reading arm...");
+		check_sides();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("File::write_exactly from a handler, and with no loop running...");
+		check_write_in_loop();
+		eg.ok();
+	}
+}
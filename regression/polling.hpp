@@ -0,0 +1,16 @@
+#pragma once
+#include "test.hpp"
+
+struct ReactorTestsConfig{
+	static constexpr int socket_pairs = 1000;			//Enough for descriptors well past select()'s FD_SETSIZE
+	static constexpr int deadline_ms = 20;
+	static constexpr std::size_t write_bytes = std::size_t(4) << 20;	//Many times what a socket buffers
+	static constexpr std::size_t drain_chunk = 4096;
+};
+
+//Reactor readiness, one-shot arming, deadlines, coroutines, and File::write_exactly waiting on it
+class ReactorTests{
+public:
+	using Conf = ReactorTestsConfig;
+	void run();
+};
@@ -0,0 +1,414 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <fstream>
+#include <map>
+#include <filesystem>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include "console.hpp"
+#include "concurrency/MessageQueue.hpp"
+#include "concurrency/mpmc_ring.hpp"
+#include "concurrency/priority_queue.hpp"
+#include "concurrency/thread_pool.hpp"
+#include "concurrency/log_ring.hpp"
+#include "event_log.hpp"
+#include "queue.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+using namespace levitator::concurrency;
+
+namespace{
+
+//Zero is the end-of-stream message, so producers send from 1 up.
+//Half of the producers and consumers work in batches.
+template<class Queue>
+long long pump( Queue &queue, int producers, int consumers, long long per_producer, int batch ){
+	std::atomic<long long> total = 0;
+	std::vector<std::thread> threads;
+
+	for(int c = 0; c < consumers; ++c){
+		threads.emplace_back( [&, c](){
+			long long sum = 0;
+			std::vector<long long> buf(batch);
+			int ends = 0;
+			while(!ends){
+				std::size_t n = c % 2 && batch > 1 ? queue.pop_n( buf.begin(), batch ) : (buf[0] = queue.pop(), 1);
+				for(std::size_t i = 0; i < n; ++i){
+					sum += buf[i];
+					ends += !buf[i];
+				}
+			}
+
+			//A batch can take more than one consumer's end, so pass the spares on
+			for(; ends > 1; --ends)
+				queue.push_back( 0 );
+			total += sum;
+		});
+	}
+
+	std::vector<std::thread> senders;
+	for(int p = 0; p < producers; ++p){
+		senders.emplace_back( [&, p](){
+			std::vector<long long> buf;
+			for(long long v = 1; v <= per_producer;){
+				if(p % 2 && batch > 1){
+					buf.clear();
+					for(int i = 0; i < batch && v <= per_producer; ++i)
+						buf.push_back(v++);
+					queue.push_n( buf.begin(), buf.size() );
+				}
+				else
+					queue.push_back( v++ );
+			}
+		});
+	}
+
+	for(auto &t : senders)
+		t.join();
+
+	//One end per consumer, once everything else is in
+	for(int c = 0; c < consumers; ++c)
+		queue.push_back( 0 );
+
+	for(auto &t : threads)
+		t.join();
+
+	return total;
+}
+
+template<class Queue>
+double bench( Queue &queue, int producers, int consumers, int batch ){
+	const long long per_producer = QueueTestsConfig::bench_messages / producers;
+	auto start = std::chrono::steady_clock::now();
+	pump( queue, producers, consumers, per_producer, batch );
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return per_producer * producers / elapsed.count() / 1e6;
+}
+
+
+//Mmsg/s for pushing n random priorities and then popping them all, the way a pool's backlog builds up and drains
+template<class Queue>
+double bench_priority( Queue &queue, int n ){
+	RandStream rand(1);
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0; i < n; ++i)
+		queue.push_back( rand.get() );
+	for(int i = 0; i < n; ++i)
+		queue.pop();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return n / elapsed.count() / 1e6;
+}
+
+//With everything equal, and aging after a single pop, the terminate tasks are the only ones out of order
+struct unordered{
+	bool operator()( const CaptureTask &, const CaptureTask & ) const{
+		return false;
+	}
+};
+
+//A std::priority_queue behind the same lock, for comparison
+template<class T>
+class heap_container{
+	std::priority_queue<T> m_heap;
+
+public:
+	std::size_t size() const{ return m_heap.size(); }
+	bool empty() const{ return m_heap.empty(); }
+	void push_back( T &&v ){ m_heap.push( std::move(v) ); }
+	void push_front( T &&v ){ m_heap.push( std::move(v) ); }
+	const T &front() const{ return m_heap.top(); }
+	void pop_front(){ m_heap.pop(); }
+};
+
+//Log lines of varied length, each saying who wrote it, which one it is, and how long it should be
+std::string log_line( int producer, int i ){
+	auto line = std::to_string(producer) + " " + std::to_string(i) + " ";
+	auto length = 16 + (i * 37) % QueueTestsConfig::log_max_length;
+	line += std::to_string(length) + " ";
+	line.resize( length - 1, 'x' );
+	return line + "\n";
+}
+
+//Messages per second, from producer threads each saying count things through out(), until finish() has seen them all written
+template<typename F, typename G>
+double bench_log( int producers, int count, F &&out, G &&finish ){
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for(int p = 0; p < producers; ++p){
+		threads.emplace_back( [&, p](){
+			for(int i = 0; i < count; ++i)
+				out( p, i );
+		});
+	}
+	for(auto &t : threads)
+		t.join();
+	finish();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return producers * count / elapsed.count() / 1e6;
+}
+
+}
+
+void QueueTests::run(){
+	const long long expect = (long long)Conf::producers * Conf::messages_per_producer * (Conf::messages_per_producer + 1) / 2;
+
+	{
+		EllipsisGuard eg("Passing "s + std::to_string(Conf::producers * Conf::messages_per_producer) + " messages through a " + std::to_string(Conf::ring_capacity) + "-cell MPMC ring queue...");
+		MessageQueue<long long, MPMCQueue> queue( Conf::ring_capacity );
+		auto sum = pump( queue, Conf::producers, Conf::consumers, Conf::messages_per_producer, Conf::batch_size );
+		if(sum != expect)
+			throw TestException("MPMC queue messages summed to " + std::to_string(sum) + ", expected " + std::to_string(expect));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Passing "s + std::to_string(Conf::producers * Conf::messages_per_producer) + " messages through a locking queue with a high-water mark of " + std::to_string(Conf::ring_capacity) + "...");
+		MessageQueue<long long> queue( Conf::ring_capacity );
+		auto sum = pump( queue, Conf::producers, Conf::consumers, Conf::messages_per_producer, Conf::batch_size );
+		if(sum != expect)
+			throw TestException("Bounded locking queue messages summed to " + std::to_string(sum) + ", expected " + std::to_string(expect));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that a full locking queue refuses try_push_back...");
+		MessageQueue<long long> queue( 2 );
+		if(!queue.try_push_back(1) || !queue.try_push_back(2) || queue.try_push_back(3))
+			throw TestException("Locking queue with a high-water mark of 2 took the wrong number of messages");
+		queue.pop();
+		if(!queue.try_push_back(3))
+			throw TestException("Locking queue still refused a message after one was popped");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking the order of "s + std::to_string(Conf::priority_messages) + " messages through a priority queue...");
+		PriorityQueue<int> queue( 0, AgingHeap<int>( {}, std::numeric_limits<std::uint64_t>::max() ) );
+		RandStream rand(1);
+		for(int i = 0; i < Conf::priority_messages; ++i)
+			queue.push_back( rand.int_between(0, Conf::priority_levels) );
+
+		int last = Conf::priority_levels;
+		for(int i = 0; i < Conf::priority_messages; ++i){
+			auto v = queue.pop();
+			if(v > last)
+				throw TestException("Priority queue gave " + std::to_string(v) + " after " + std::to_string(last));
+			last = v;
+		}
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that a priority queue's least message ages past a stream of greater ones...");
+		PriorityQueue<int> queue( 0, AgingHeap<int>( {}, Conf::priority_max_age ) );
+		queue.push_back(0);
+		int pops = 0;
+		for(int v = 1; ; ++pops){
+			queue.push_back(v++);
+			queue.push_back(v++);
+			if(!queue.pop())
+				break;
+			if(pops > Conf::priority_max_age)
+				throw TestException("Priority queue starved its least message for " + std::to_string(pops) + " pops");
+		}
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that a priority thread pool runs everything before shutting down...");
+		std::atomic<int> count = 0;
+		{
+			PriorityThreadPool<CaptureTask, unordered> pool( 2, {}, {}, 0, AgingHeap<CaptureTask, unordered>( {}, 1 ) );
+			std::exception_ptr error;
+			for(int i = 0; i < Conf::priority_messages; ++i)
+				pool.push( CaptureTask( [&count](){ ++count; }, error ) );
+			pool.shutdown();
+		}
+		if(count != Conf::priority_messages)
+			throw TestException("Priority thread pool ran " + std::to_string(count) + " tasks, expected " + std::to_string(Conf::priority_messages));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that MPMC queue push_front messages come out first...");
+		MessageQueue<long long, MPMCQueue> queue( Conf::ring_capacity );
+		queue.push_back(2);
+		queue.push_back(3);
+		queue.push_front(1);
+		for(long long expect : {1, 2, 3}){
+			if(queue.pop() != expect)
+				throw TestException("MPMC queue messages out of order");
+		}
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that MPMC queue messages spilled past a full ring come out in order...");
+		MessageQueue<long long, MPMCQueue> queue( Conf::spill_capacity );
+		for(long long i = 0; i < 4 * Conf::spill_capacity; ++i)
+			queue.push_back_unbounded( std::move(i) );
+		for(long long expect = 0; expect < 4 * Conf::spill_capacity; ++expect){
+			if(queue.pop() != expect)
+				throw TestException("Spilled MPMC queue messages out of order");
+		}
+		eg.ok();
+	}
+
+	{
+		const int expect = (std::pow(Conf::spawn_fanout, Conf::spawn_depth + 1) - 1) / (Conf::spawn_fanout - 1);
+		EllipsisGuard eg("Spawning "s + std::to_string(expect) + " tasks from the threads of a pool on a " + std::to_string(Conf::spill_capacity) + "-cell MPMC ring...");
+		using handler_type = jab::exception::DefaultBackgroundExceptionHandler;
+		using pool_type = ThreadPool<CaptureTask, handler_type, PoolThread<CaptureTask, handler_type>, MessageQueue<CaptureTask, MPMCQueue>>;
+		std::atomic<int> count = 0;
+		std::exception_ptr error;
+		{
+			pool_type pool( 2, {}, {}, Conf::spill_capacity );
+			std::function<void (int)> spawn = [&](int depth){
+				++count;
+				for(int i = 0; depth && i < Conf::spawn_fanout; ++i)
+					pool.push( CaptureTask( [&spawn, depth](){ spawn(depth - 1); }, error ) );
+			};
+			pool.push( CaptureTask( [&spawn](){ spawn(Conf::spawn_depth); }, error ) );
+			pool.wait_idle();
+			pool.shutdown();
+		}
+		if(error)
+			std::rethrow_exception(error);
+		if(count != expect)
+			throw TestException("Pool on an MPMC ring ran " + std::to_string(count) + " tasks, expected " + std::to_string(expect));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Writing "s + std::to_string(Conf::producers * Conf::log_messages) + " messages from " + std::to_string(Conf::producers) + " threads through a log ring...");
+		int fds[2];
+		if(pipe(fds))
+			throw TestException("Couldn't make a pipe for the log ring");
+
+		//Read it all as it comes, or the pipe would fill and stop the writer thread
+		std::string output;
+		std::thread reader( [&](){
+			char buf[65536];
+			ssize_t n;
+			while((n = read( fds[0], buf, sizeof(buf) )) > 0)
+				output.append( buf, n );
+		});
+
+		{
+			LogRing log( 64 );
+			std::vector<std::thread> writers;
+			for(int p = 0; p < Conf::producers; ++p){
+				writers.emplace_back( [&log, fd = fds[1], p](){
+					for(int i = 0; i < Conf::log_messages; ++i)
+						log.write( fd, log_line(p, i) );
+				});
+			}
+			for(auto &t : writers)
+				t.join();
+			log.flush();
+		}
+		close(fds[1]);
+		reader.join();
+		close(fds[0]);
+
+		//Every line whole, and each thread's in the order it wrote them
+		std::map<int, int> next;
+		std::istringstream lines(output);
+		std::string line;
+		int count = 0;
+		while(std::getline( lines, line )){
+			std::istringstream fields(line);
+			int p, i, length;
+			fields >> p >> i >> length;
+			if(line + "\n" != log_line(p, i) || next[p] != i)
+				throw TestException("Log line " + std::to_string(count) + " was mangled or out of order: " + line.substr(0, 40));
+			++next[p];
+			++count;
+		}
+		if(count != Conf::producers * Conf::log_messages)
+			throw TestException("Log ring wrote " + std::to_string(count) + " lines, expected " + std::to_string(Conf::producers * Conf::log_messages));
+		eg.ok();
+	}
+}
+
+void QueueBenchmark::run(){
+	std::cout << "Message queue throughput, Mmsg/s. " << Conf::bench_messages << " messages, batches of " << Conf::bench_batch_size << std::endl;
+	std::cout << std::setw(10) << "threads" << std::setw(12) << "locking" << std::setw(12) << "mpmc" << std::setw(14) << "locking-n" << std::setw(12) << "mpmc-n" << std::endl;
+
+	for(int threads = 2; threads <= Conf::bench_max_threads; threads *= 2){
+		const int producers = threads / 2, consumers = threads - producers;
+		std::cout << std::setw(10) << (std::to_string(producers) + "/" + std::to_string(consumers)) << std::fixed << std::setprecision(2);
+
+		for(int batch : {1, Conf::bench_batch_size}){
+			{
+				MessageQueue<long long> queue;
+				std::cout << std::setw(batch == 1 ? 12 : 14) << bench( queue, producers, consumers, batch ) << std::flush;
+			}
+			{
+				MessageQueue<long long, MPMCQueue> queue( Conf::bench_ring_capacity );
+				std::cout << std::setw(12) << bench( queue, producers, consumers, batch ) << std::flush;
+			}
+		}
+		std::cout << std::endl;
+	}
+
+	std::cout << std::endl << "Priority queue, " << Conf::bench_priority_messages << " messages queued and drained, Mmsg/s" << std::endl << std::fixed << std::setprecision(2);
+	{
+		PriorityQueue<int> queue;
+		std::cout << std::setw(24) << "4-ary aging heap" << std::setw(12) << bench_priority( queue, Conf::bench_priority_messages ) << std::endl;
+	}
+	{
+		LockingQueue< int, heap_container<int> > queue;
+		std::cout << std::setw(24) << "std::priority_queue" << std::setw(12) << bench_priority( queue, Conf::bench_priority_messages ) << std::endl;
+	}
+
+	std::cout << std::endl << "Console output to /dev/null, or the same as an event log, " << Conf::bench_log_messages << " short messages per thread, Mmsg/s" << std::endl;
+	std::cout << std::setw(10) << "threads" << std::setw(16) << "stringstream" << std::setw(12) << "log ring" << std::setw(12) << "event log" << std::endl;
+	for(int threads = 1; threads <= Conf::producers; threads *= 2){
+		std::cout << std::setw(10) << threads << std::flush;
+		{
+			//As Console used to do it: format into a fresh stringstream, then copy the string into a task for a one-thread pool
+			std::ofstream null("/dev/null");
+			ThreadPool<CaptureTask> writer(1);
+			std::cout << std::setw(16) << bench_log( threads, Conf::bench_log_messages, [&](int p, int i){
+				std::stringstream ss;
+				ss << "N0CALL-" << p << ": Node line: " << i << " via K1ABC" << std::endl;
+				writer.push( CaptureTask( [&null, msg = ss.str()](){ null << msg << std::flush; } ) );
+			}, [&](){ writer.shutdown(); }) << std::flush;
+		}
+		{
+			Console console;
+			console.out_fd = open( "/dev/null", O_WRONLY );
+			std::cout << std::setw(12) << bench_log( threads, Conf::bench_log_messages, [&](int p, int i){
+				console.out() << "N0CALL-" << p << ": Node line: " << i << " via K1ABC" << std::endl;
+			}, [&](){ console.flush(); }) << std::flush;
+			close(console.out_fd);
+		}
+		{
+			//The same as a binary event, with the callsigns interned beforehand
+			auto path = std::filesystem::temp_directory_path() / ("queue_bench_events." + std::to_string( getpid() ));
+			{
+				levitator::EventLog log( path, { .max_bytes = 0 } );
+				std::vector<std::uint32_t> calls;
+				for(int p = 0; p < threads; ++p)
+					calls.push_back( log.intern( "N0CALL-" + std::to_string(p) ) );
+				auto via = log.intern("K1ABC");
+				std::cout << std::setw(12) << bench_log( threads, Conf::bench_log_messages, [&](int p, int i){
+					log.record( 1, calls[p], i, via );
+				}, [&](){ log.flush(); }) << std::endl;
+			}
+			std::filesystem::remove(path);
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "test.hpp"
+
+struct QueueTestsConfig{
+	static constexpr int producers = 4;
+	static constexpr int consumers = 4;
+	static constexpr int messages_per_producer = 200000;
+	static constexpr int batch_size = 16;
+	static constexpr int ring_capacity = 64;	//Small, so that producers and consumers both spend time blocked
+	static constexpr int priority_messages = 100000;
+	static constexpr int priority_levels = 1000;
+	static constexpr int priority_max_age = 64;
+	static constexpr int log_messages = 20000;	//Per producer
+	static constexpr int log_max_length = 700;		//Some messages span several log ring records
+	static constexpr int spill_capacity = 4;		//Far less than a pool's tasks push...
+	static constexpr int spawn_fanout = 3;
+	static constexpr int spawn_depth = 7;			//...by spawning this deep
+
+	//Benchmark
+	static constexpr int bench_messages = 1 << 21;
+	static constexpr int bench_max_threads = 64;
+	static constexpr int bench_batch_size = 32;
+	static constexpr int bench_ring_capacity = 4096;
+	static constexpr int bench_priority_messages = 100000;	//All queued at once, then all popped
+	static constexpr int bench_log_messages = 200000;		//Per producer
+};
+
+class QueueTests{
+public:
+	using Conf = QueueTestsConfig;
+	void run();
+};
+
+//Message throughput of each MessageQueue backend, from 2 to 64 threads split evenly between producers and consumers.
+//Then priority queues, and Console output against the stringstream and one-thread ThreadPool it used to go through.
+class QueueBenchmark{
+public:
+	using Conf = QueueTestsConfig;
+	void run();
+};
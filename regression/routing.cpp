@@ -0,0 +1,337 @@
+#include <string>
+#include <vector>
+#include <queue>
+#include <utility>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include "console.hpp"
+#include "state_file.hpp"
+#include "routes.hpp"
+#include "nrparms.hpp"
+#include "routing.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+using namespace k3yab::bawns;
+using namespace k3yab::bawns::routing;
+
+namespace{
+
+using Conf = RoutingTestsConfig;
+using record_type = nr_entry::record_type;
+using adjacency_type = std::vector<std::vector<index_type>>;
+
+const char *const state_path = "routing_test_state.bin";
+
+std::string test_callsign( int i ){
+	return "T" + std::to_string(i);
+}
+
+//Random links between the first count nodes, added to whatever's in the file already
+void add_links( state::StateFile &state, RandStream &rng, int count, int links ){
+	for(int i = 0; i < links; ++i){
+		auto from = rng.int_between(0, count), to = rng.int_between(0, count);
+		if(from != to)
+			state.link_nodes( state.find(test_callsign(from)), state.find(test_callsign(to)) );
+	}
+}
+
+//The links again, but by the graph's numbering, to check its routes against
+adjacency_type adjacency( const state::StateFile &state, const RouteGraph &graph ){
+	adjacency_type result( graph.size() );
+	for(auto &n : state){
+		auto &out = result[ graph.index(n.callsign.str()) ];
+		state.for_each_link( n, [&](const auto &to){ out.push_back( graph.index(to.callsign.str()) ); } );
+	}
+	return result;
+}
+
+//Textbook Dijkstra on a binary heap, maximizing quality
+std::vector<std::uint32_t> reference_quality( const adjacency_type &adj, const std::vector<index_type> &sources, std::uint32_t source_cost ){
+	std::vector<std::uint32_t> result( adj.size(), 0 );
+	std::priority_queue<std::pair<std::uint32_t, index_type>> heap;
+	for(auto s : sources){
+		result[s] = source_cost;
+		heap.push( {source_cost, s} );
+	}
+
+	while(!heap.empty()){
+		auto [q, u] = heap.top();
+		heap.pop();
+		if(q != result[u])
+			continue;
+
+		for(auto v : adj[u]){
+			auto vq = RouteGraph::combine( q, Conf::link_quality );
+			if(vq > result[v]){
+				result[v] = vq;
+				heap.push( {vq, v} );
+			}
+		}
+	}
+	return result;
+}
+
+std::vector<std::uint32_t> reference_hops( const adjacency_type &adj, const std::vector<index_type> &sources, std::uint32_t source_cost ){
+	std::vector<std::uint32_t> result( adj.size(), route_tree::none );
+	std::queue<index_type> queue;
+	for(auto s : sources){
+		result[s] = source_cost;
+		queue.push(s);
+	}
+
+	for(; !queue.empty(); queue.pop()){
+		auto u = queue.front();
+		for(auto v : adj[u]){
+			if(result[v] == route_tree::none){
+				result[v] = result[u] + 1;
+				queue.push(v);
+			}
+		}
+	}
+	return result;
+}
+
+//The costs have to be the reference's, and each node's parent a real link which gives it that cost.
+//Ties can be broken either way, so the parents themselves needn't match.
+void check_tree( const route_tree &tree, const adjacency_type &adj, const std::vector<index_type> &sources, const std::vector<std::uint32_t> &expected ){
+	for(index_type n = 0; n < adj.size(); ++n){
+		if(tree.cost[n] != expected[n])
+			throw TestException("Route cost to node " + std::to_string(n) + " is " + std::to_string(tree.cost[n]) + ", expected " + std::to_string(expected[n]));
+
+		auto p = tree.parent[n];
+		if(!tree.reachable(n) || std::find(sources.begin(), sources.end(), n) != sources.end()){
+			if(p != route_tree::none)
+				throw TestException("Source or unreachable node " + std::to_string(n) + " has a parent");
+			continue;
+		}
+
+		if(p == route_tree::none || std::find(adj[p].begin(), adj[p].end(), n) == adj[p].end())
+			throw TestException("Node " + std::to_string(n) + " is routed over a link that isn't there");
+
+		auto by_parent = tree.by == metric::hops ? tree.cost[p] + 1 : RouteGraph::combine( tree.cost[p], Conf::link_quality );
+		if(by_parent != tree.cost[n])
+			throw TestException("Node " + std::to_string(n) + "'s cost doesn't follow from its parent's");
+
+		auto hop = tree.first_hop(n);
+		if(std::find(sources.begin(), sources.end(), hop) == sources.end())
+			throw TestException("Node " + std::to_string(n) + "'s first hop isn't a source");
+	}
+}
+
+void check_combine(){
+	for(std::uint32_t path = 0; path < 256; ++path){
+		for(std::uint32_t link = 0; link < 256; ++link){
+			auto expected = std::uint32_t( std::floor(path * link / 256.0 + 0.5) );
+			if(RouteGraph::combine(path, link) != expected)
+				throw TestException("combine(" + std::to_string(path) + ", " + std::to_string(link) + ") isn't rounded to nearest");
+		}
+	}
+
+	//Halves round up, and a route that decays below half a point is gone
+	if(RouteGraph::combine(255, 255) != 254 || RouteGraph::combine(192, 200) != 150 || RouteGraph::combine(1, 128) != 1 || RouteGraph::combine(1, 127) != 0)
+		throw TestException("combine() rounds the wrong way");
+}
+
+nr_entry route( const std::string &neighbour, int quality ){
+	return { record_type::route, neighbour, neighbour, "port0", quality_type(quality) };
+}
+
+nr_entry node( const std::string &callsign, const std::string &neighbour, int quality ){
+	return { record_type::node, callsign, neighbour, "port0", quality_type(quality) };
+}
+
+RoutingTable make_table( const std::vector<nr_entry> &entries ){
+	RoutingTable result;
+	for(auto &e : entries)
+		result.apply( { true, e } );
+	return result;
+}
+
+//Neighbours added, then nodes added, then nodes deleted, then neighbours deleted
+void check_order( const std::vector<nr_command> &cmds ){
+	auto phase = [](const nr_command &cmd){
+		bool is_route = cmd.entry.kind == record_type::route;
+		return cmd.add ? (is_route ? 0 : 1) : (is_route ? 3 : 2);
+	};
+
+	for(std::size_t i = 1; i < cmds.size(); ++i){
+		if(phase(cmds[i]) < phase(cmds[i-1]))
+			throw TestException("Commands out of order at " + std::to_string(i) + ": " + cmds[i].entry.callsign);
+	}
+}
+
+//Diffs from one to the other, checks the order, and checks that the kernel's rules let it through to the same table
+void check_diff( const RoutingTable &from, const RoutingTable &to ){
+	auto cmds = from.diff(to);
+	check_order(cmds);
+
+	auto applied = from;
+	applied.apply(cmds);
+	if(!(applied == to))
+		throw TestException("Applying the diff doesn't give the target table");
+
+	if(!applied.diff(to).empty())
+		throw TestException("A table differs from itself");
+}
+
+void check_refused( const RoutingTable &table, const nr_command &cmd, const std::string &what ){
+	auto copy = table;
+	try{
+		copy.apply(cmd);
+	}
+	catch( const RoutingError & ){
+		if(!(copy == table))
+			throw TestException("A refused command changed the table: " + what);
+		return;
+	}
+	throw TestException("Wasn't refused: " + what);
+}
+
+}
+
+void RoutingTests::run(){
+
+	{
+		EllipsisGuard eg("Checking that Netrom qualities combine rounded to nearest...");
+		check_combine();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking the order of routing table diffs...");
+		auto from = make_table( { route("N1", 200), route("N2", 180), route("N3", 150),
+			node("A", "N1", 150), node("B", "N2", 140), node("C", "N1", 120), node("D", "N3", 100) } );
+		auto to = make_table( { route("N1", 210), route("N3", 150), route("N4", 190),
+			node("A", "N4", 160), node("C", "N1", 130), node("D", "N3", 100), node("E", "N4", 90) } );
+		check_diff( from, to );
+		check_diff( to, from );
+		check_diff( RoutingTable(), to );
+		check_diff( from, RoutingTable() );
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Re-routing a node by way of a new neighbour...");
+		auto from = make_table( { route("N1", 200), node("A", "N1", 150) } );
+		auto to = make_table( { route("N2", 200), node("A", "N2", 150) } );
+
+		std::vector<nr_command> expected = { { true, route("N2", 200) }, { true, node("A", "N2", 150) },
+			{ false, node("A", "N1", 150) }, { false, route("N1", 200) } };
+		auto cmds = from.diff(to);
+		if(cmds.size() != expected.size())
+			throw TestException("Re-routing took " + std::to_string(cmds.size()) + " commands");
+		for(std::size_t i = 0; i < cmds.size(); ++i){
+			if(cmds[i].add != expected[i].add || !(cmds[i].entry == expected[i].entry))
+				throw TestException("Re-routing command " + std::to_string(i) + " is wrong");
+		}
+		check_diff( from, to );
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that the stand-in table refuses what nrparms would...");
+		auto table = make_table( { route("N1", 200), route("N2", 200), node("A", "N1", 150) } );
+		check_refused( table, { true, node("B", "N9", 150) }, "a node by way of an unknown neighbour" );
+		check_refused( table, { true, nr_entry( record_type::node, "B", "N1", "port1", 150 ) }, "a node by way of a neighbour on another port" );
+		check_refused( table, { false, node("B", "N1", 150) }, "deleting a node that isn't there" );
+		check_refused( table, { false, route("N9", 200) }, "deleting a neighbour that isn't there" );
+		check_refused( table, { false, route("N1", 200) }, "deleting a neighbour with a node routed through it" );
+
+		//Which is fine once the node's gone, and a neighbour nothing uses can go straight away
+		table.apply( { false, node("A", "N1", 150) } );
+		table.apply( { false, route("N1", 200) } );
+		table.apply( { false, route("N2", 200) } );
+		if(table.size())
+			throw TestException("Table should be empty");
+		eg.ok();
+	}
+
+	//The rest share a state file, which is closed at the end of the block so that it can be removed
+	std::remove(state_path);
+	{
+		RandStream rng( Conf::seed );
+		state::StateFile state( state_path );
+		for(int i = 0; i < Conf::nodes; ++i){
+			if(i < Conf::roots)
+				state.append_root_node( test_callsign(i) );
+			else
+				state.append_node( test_callsign(i) );
+		}
+		add_links( state, rng, Conf::nodes, Conf::nodes * Conf::links_per_node );
+
+		RouteGraph graph( state, Conf::link_quality );
+		auto adj = adjacency( state, graph );
+
+		{
+			EllipsisGuard eg("Checking local routes over "s + std::to_string(graph.size()) + " nodes and " + std::to_string(graph.edge_count()) + " links against a binary heap Dijkstra and a BFS...");
+			auto &roots = graph.roots();
+			if(roots.size() != Conf::roots)
+				throw TestException("RouteGraph has " + std::to_string(roots.size()) + " roots, expected " + std::to_string(Conf::roots));
+
+			auto by_quality = graph.local_routes( metric::quality, Conf::port_quality );
+			check_tree( by_quality, adj, roots, reference_quality( adj, roots, Conf::port_quality ) );
+
+			//Some have to have decayed away for the test to mean anything
+			auto reachable = std::count_if( by_quality.cost.begin(), by_quality.cost.end(), [](auto q){ return q != 0; } );
+			if(reachable == 0 || reachable == graph.size())
+				throw TestException("The test graph should leave some nodes out of reach by quality, and reach some");
+
+			auto by_hops = graph.local_routes( metric::hops, Conf::port_quality );
+			check_tree( by_hops, adj, roots, reference_hops( adj, roots, 1 ) );
+			eg.ok();
+		}
+
+		{
+			EllipsisGuard eg("Checking routes from "s + std::to_string(Conf::sources) + " sources on " + std::to_string(Conf::threads) + " threads...");
+			std::vector<index_type> sources;
+			for(int i = 0; i < Conf::sources; ++i)
+				sources.push_back( rng.int_between(0, graph.size()) );
+
+			for(auto by : { metric::quality, metric::hops }){
+				auto trees = graph.routes_from( sources, by, Conf::threads );
+				for(std::size_t i = 0; i < sources.size(); ++i){
+					std::vector<index_type> source = { sources[i] };
+					auto expected = by == metric::hops ? reference_hops( adj, source, 0 ) : reference_quality( adj, source, 255 );
+					check_tree( trees[i], adj, source, expected );
+				}
+			}
+
+			try{
+				graph.routes_from( { index_type(graph.size()) }, metric::hops, 1 );
+				throw TestException("routes_from() took a source out of range");
+			}
+			catch( const RoutingError & ){
+			}
+			eg.ok();
+		}
+
+		{
+			EllipsisGuard eg("Bringing a routing table built from the routes up to date after more of the network is found...");
+			RoutingTable before( graph, graph.local_routes( metric::quality, Conf::port_quality ), "port0" );
+			check_diff( RoutingTable(), before );
+			if(!(RoutingTable( before.records() ) == before))
+				throw TestException("A routing table doesn't survive being recorded");
+
+			try{
+				RoutingTable( graph, graph.local_routes( metric::hops, Conf::port_quality ), "port0" );
+				throw TestException("Made a routing table from routes by hops");
+			}
+			catch( const RoutingError & ){
+			}
+
+			//New roots, which take over some first hops, and new links
+			for(int i = Conf::roots; i < 2 * Conf::roots; ++i)
+				state.add_root( state.find(test_callsign(i)) );
+			add_links( state, rng, Conf::nodes, Conf::nodes );
+
+			RouteGraph after_graph( state, Conf::link_quality );
+			RoutingTable after( after_graph, after_graph.local_routes( metric::quality, Conf::port_quality ), "port0" );
+			check_diff( before, after );
+			eg.ok();
+		}
+	}
+	std::remove(state_path);
+}
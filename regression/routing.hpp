@@ -0,0 +1,20 @@
+#pragma once
+#include "test.hpp"
+
+struct RoutingTestsConfig{
+	static constexpr int seed = 11;
+	static constexpr int nodes = 2000;
+	static constexpr int links_per_node = 3;	//On average, and one way
+	static constexpr int roots = 8;
+	static constexpr int link_quality = 200;	//Low enough that the longer paths decay to nothing
+	static constexpr int port_quality = 192;
+	static constexpr int sources = 16;			//For routes_from()...
+	static constexpr int threads = 4;			//...spread across this many
+};
+
+//RouteGraph over a state file, and RoutingTable's diffs against the rules nrparms runs into
+class RoutingTests{
+public:
+	using Conf = RoutingTestsConfig;
+	void run();
+};
@@ -0,0 +1,260 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include "console.hpp"
+#include "state_file.hpp"
+#include "state.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+using namespace k3yab::bawns;
+using namespace k3yab::bawns::state_file_blocks;
+
+namespace{
+
+using Conf = StateFileTestsConfig;
+
+const char *const state_path = "state_file_test_state.bin";
+
+std::string test_callsign( std::size_t i ){
+	return "S" + std::to_string(i);
+}
+
+void make_file( std::size_t count ){
+	std::remove(state_path);
+	state::StateFile state( state_path );
+	for(std::size_t i = 0; i < count; ++i)
+		state.append_node( test_callsign(i) );
+}
+
+//Callsigns in the order the file lists them, which is the order it's verified in
+std::vector<std::string> file_order(){
+	std::vector<std::string> result;
+	state::StateFile state( state_path );
+	for(auto &n : state)
+		result.push_back( n.callsign.str() );
+	return result;
+}
+
+std::string read_file(){
+	std::ifstream in( state_path, std::ios::binary );
+	return { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+}
+
+void write_file( const std::string &image ){
+	std::ofstream out( state_path, std::ios::binary | std::ios::trunc );
+	out.write( image.data(), image.size() );
+}
+
+//Where in the image the node for callsign starts
+std::size_t node_position( const std::string &image, const std::string &callsign ){
+	auto pos = image.find( "["s + callsign + '\0' );
+	if(pos == std::string::npos)
+		throw TestException("Couldn't find " + callsign + " in the state file");
+	return pos;
+}
+
+//Flips a bit of the node's visit count, which leaves it well formed but not matching its checksum
+void corrupt_node( std::string &image, const std::string &callsign ){
+	image[ node_position(image, callsign) + offsetof(node, query_count) ] ^= 1;
+}
+
+int header_flags( const std::string &image ){
+	int result;
+	std::memcpy( &result, image.data() + offsetof(header, flags), sizeof(result) );
+	return result;
+}
+
+void header_flags( std::string &image, int flags ){
+	std::memcpy( image.data() + offsetof(header, flags), &flags, sizeof(flags) );
+}
+
+//What opening the file throws, if anything
+std::string open_error(){
+	try{
+		state::StateFile state( state_path );
+	}
+	catch(const StateFileError &ex){
+		return ex.what();
+	}
+	return {};
+}
+
+void check_index(){
+	const auto count = Conf::slabs * state::StateFile::verify_slab_size + Conf::extra_nodes;
+	make_file(count);
+
+	state::StateFile state( state_path );
+	if(state.size() != count)
+		throw TestException("Opened with " + std::to_string(state.size()) + " nodes, not " + std::to_string(count));
+	for(std::size_t i = 0; i < count; ++i){
+		auto p = state.find( test_callsign(i) );
+		if(!p || state.fetch(p).callsign.str() != test_callsign(i))
+			throw TestException("Didn't find " + test_callsign(i) + " after opening");
+	}
+	if(state.find( test_callsign(count) ) || state.find( "S" ) || state.find( std::string(20, 'S') ))
+		throw TestException("Found a node that isn't there");
+
+	//Appended since, alongside what was loaded
+	auto p = state.append_node( test_callsign(count) );
+	if(state.find( test_callsign(count) ) != p || state.size() != count + 1 || !state.find( test_callsign(0) ))
+		throw TestException("Appended node wasn't indexed along with the rest");
+
+	bool refused = false;
+	try{
+		state.append_node( test_callsign(count / 2) );
+	}
+	catch(const StateFileError &){
+		refused = true;
+	}
+	if(!refused)
+		throw TestException("Appended a node the file was opened with");
+}
+
+//Two bad nodes in later slabs, and so a bad file checksum as well. Only the first in the file is reported.
+void check_first_error(){
+	const auto slab = state::StateFile::verify_slab_size;
+	make_file( Conf::slabs * slab + Conf::extra_nodes );
+	auto order = file_order();
+	auto first = order[ 2 * slab + 5 ], second = order[ 3 * slab + 7 ];
+
+	auto image = read_file();
+	corrupt_node( image, second );
+	corrupt_node( image, first );
+	write_file(image);
+
+	auto error = open_error();
+	if(error.empty())
+		throw TestException("Opened a file with corrupt nodes");
+	if(error != "State file record checksum mismatch for node: " + first)
+		throw TestException("Opening reported \"" + error + "\", not the first corrupt node, " + first);
+}
+
+//A flipped byte in a node, in the file or in memory afterwards, against the record's checksum
+void check_flipped_node(){
+	make_file( Conf::round_trip_nodes );
+	auto victim = test_callsign( Conf::round_trip_nodes / 3 );
+	auto good = read_file();
+
+	auto image = good;
+	corrupt_node( image, victim );
+	write_file(image);
+	if(open_error() != "State file record checksum mismatch for node: " + victim)
+		throw TestException("Opening didn't reject a node with a flipped byte");
+
+	write_file(good);
+	state::StateFile state( state_path );
+	auto p = state.find(victim);
+	state.fetch(p);
+	p->query_count ^= 1;
+	bool refused = false;
+	try{
+		state.fetch(p);
+	}
+	catch(const StateFileError &){
+		refused = true;
+	}
+	if(!refused)
+		throw TestException("fetch() handed out a node with a flipped byte");
+	p->query_count ^= 1;
+}
+
+//A file from a run that didn't close it has a whole-file checksum from whenever it was last flushed, if at all, so it's
+//checked a record at a time instead. Clearing clean_close is what such a run leaves, and it breaks that checksum as well.
+void check_unclean_close(){
+	make_file( Conf::round_trip_nodes );
+	auto good = read_file();
+	if(!(header_flags(good) & header::clean_close))
+		throw TestException("Closing the file didn't mark it closed cleanly");
+
+	//The same whole-file checksum failure is fatal to a file that was closed cleanly
+	auto image = good;
+	image[ offsetof(header, file_checksum) ] ^= 1;
+	write_file(image);
+	if(open_error().find("State file checksum mismatch") != 0)
+		throw TestException("Opening didn't go by the whole-file checksum of a file that was closed cleanly");
+
+	//Which it warns about, every time, but that's not what's being looked at here
+	auto state_log = LogChannel::find("state");
+	auto level = state_log->level();
+	state_log->level( log_level::error );
+
+	image = good;
+	header_flags( image, header_flags(image) & ~header::clean_close );
+	write_file(image);
+	{
+		state::StateFile state( state_path );
+		if(state.size() != Conf::round_trip_nodes)
+			throw TestException("File that wasn't closed cleanly opened with " + std::to_string(state.size()) + " nodes");
+	}
+	if(!(header_flags(read_file()) & header::clean_close) || !open_error().empty())
+		throw TestException("Closing the file again didn't leave it closed cleanly, with a checksum to go by");
+
+	//Record by record is still checking
+	corrupt_node( image, test_callsign(1) );
+	write_file(image);
+	if(open_error() != "State file record checksum mismatch for node: " + test_callsign(1))
+		throw TestException("Checking a record at a time let a corrupt node through");
+	state_log->level(level);
+}
+
+}
+
+void StateFileTests::run(){
+	{
+		EllipsisGuard eg("Indexing "s + std::to_string(Conf::slabs) + " slabs and a bit of state file nodes on opening...");
+		check_index();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that opening a corrupt state file reports the first bad node in the file...");
+		check_first_error();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that a flipped byte in a node is caught at opening and by fetch()...");
+		check_flipped_node();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Opening a state file that wasn't closed cleanly a record at a time...");
+		check_unclean_close();
+		eg.ok();
+	}
+	std::remove(state_path);
+}
+
+void StateFileBenchmark::run(){
+	make_file( Conf::bench_nodes );
+	std::cout << "Opening a state file of " << Conf::bench_nodes << " nodes" << std::endl;
+	std::cout << std::setw(24) << "open" << std::setw(12) << "ms" << std::setw(12) << "map ms" << std::endl;
+	for(int i = 0; i < Conf::bench_opens; ++i){
+		auto start = std::chrono::steady_clock::now();
+		state::StateFile state( state_path );
+		std::chrono::duration<double, std::milli> opened = std::chrono::steady_clock::now() - start;
+
+		//What opening used to do on its own thread once the nodes were walked
+		start = std::chrono::steady_clock::now();
+		std::map<std::string, const node *> index;
+		for(auto &n : state){
+			if(!index.insert( { n.callsign.str(), &n } ).second)
+				throw TestException("Duplicate node " + n.callsign.str());
+		}
+		std::chrono::duration<double, std::milli> mapped = std::chrono::steady_clock::now() - start;
+
+		std::cout << std::setw(24) << i + 1 << std::fixed << std::setprecision(1) << std::setw(12) << opened.count()
+			<< std::setw(12) << mapped.count() << std::endl;
+	}
+	std::remove(state_path);
+}
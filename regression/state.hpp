@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include "test.hpp"
+
+struct StateFileTestsConfig{
+	static constexpr std::size_t slabs = 4;			//Of StateFile::verify_slab_size nodes each...
+	static constexpr std::size_t extra_nodes = 100;	//...and a part one
+	static constexpr std::size_t round_trip_nodes = 1000;
+
+	//Benchmark: opening a file this big, a few times over
+	static constexpr std::size_t bench_nodes = 1000000;
+	static constexpr int bench_opens = 5;
+};
+
+//StateFile's index of the nodes it's opened with, which corruption it reports first, and how it checks a file depending
+//on whether it was closed cleanly
+class StateFileTests{
+public:
+	using Conf = StateFileTestsConfig;
+	void run();
+};
+
+//Opening a big state file, against building the std::map index it used to build a node at a time
+class StateFileBenchmark{
+public:
+	using Conf = StateFileTestsConfig;
+	void run();
+};
@@ -0,0 +1,327 @@
+#include <string>
+#include <atomic>
+#include <thread>
+#include <stdexcept>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <type_traits>
+#include "console.hpp"
+#include "concurrency/thread_pool.hpp"
+#include "concurrency/inline_task.hpp"
+#include "concurrency/thread_counters.hpp"
+#include "thread_pool.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+using namespace levitator::concurrency;
+
+namespace{
+
+using pool_type = ThreadPool<CaptureTask>;
+
+//Each task counts itself and pushes its children from the pool thread it's on
+void spawn( pool_type &pool, std::atomic<long> &count, int depth ){
+	pool.push( CaptureTask( [&pool, &count, depth](){
+		++count;
+		if(depth > 0){
+			for(int i = 0; i < ThreadPoolTestsConfig::fanout; ++i)
+				spawn(pool, count, depth - 1);
+		}
+	}));
+}
+
+
+//Counts its live copies, to check that InlineTask destroys whatever it holds exactly once
+struct tracked{
+	static inline std::atomic<int> live = 0;
+	std::array<char, 32> padding{};
+
+	tracked(){ ++live; }
+	tracked( const tracked & ){ ++live; }
+	tracked( tracked && ) noexcept{ ++live; }
+	~tracked(){ --live; }
+};
+
+//A task of the sort a single-type pool would be instantiated on
+struct count_task{
+	std::atomic<long> *count = nullptr;
+	long add = 0;
+
+	int operator()(){
+		if(!count)
+			return -1;
+		*count += add;
+		return 0;
+	}
+};
+
+template<class Pool, typename F>
+double bench_pool( int threads, F &&make ){
+	auto start = std::chrono::steady_clock::now();
+	{
+		Pool pool( threads );
+		for(int i = 0; i < ThreadPoolTestsConfig::bench_tasks; ++i)
+			pool.push( make(i) );
+		pool.shutdown();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return ThreadPoolTestsConfig::bench_tasks / elapsed.count() / 1e6;
+}
+
+}
+
+void ThreadPoolTests::run(){
+
+	{
+		EllipsisGuard eg("Checking that InlineTask keeps small callables inline and destroys them once...");
+		using task_type = InlineTask<>;
+		static_assert( task_type::stored_inline<count_task> );
+		static_assert( !task_type::stored_inline<std::array<char, 128>> );
+
+		int small = 0, large = 0;
+		{
+			tracked t;
+			std::array<char, 128> big{};
+			std::vector<task_type> tasks;
+			for(int i = 0; i < 100; ++i){
+				tasks.emplace_back( [t, &small](){ ++small; } );
+				tasks.emplace_back( [t, big, &large](){ large += big.size() ? 1 : 0; } );
+			}
+
+			//Moving them about, as a queue does
+			std::vector<task_type> moved;
+			for(auto &task : tasks)
+				moved.push_back( std::move(task) );
+			for(auto &task : tasks){
+				if(task() != -1)
+					throw TestException("A moved-from InlineTask wasn't the terminate task");
+			}
+			for(auto &task : moved)
+				task();
+		}
+
+		if(small != 100 || large != 100)
+			throw TestException("InlineTasks ran " + std::to_string(small) + " small and " + std::to_string(large) + " large callables, expected 100 each");
+		if(tracked::live)
+			throw TestException(std::to_string(tracked::live) + " callables held by InlineTasks were never destroyed");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Running mixed kinds of InlineTask on one pool...");
+		std::atomic<long> count = 0;
+		{
+			ThreadPool<InlineTask<>> pool( Conf::threads );
+			for(int i = 0; i < Conf::submissions; ++i){
+				if(i % 2)
+					pool.push( count_task{ &count, 1 } );
+				else
+					pool.push( [&count](){ ++count; } );
+			}
+			auto square = pool.submit( [](){ return 12 * 12; } );
+			if(square.get() != 144)
+				throw TestException("An InlineTask pool's future had the wrong result");
+			pool.shutdown();
+		}
+		if(count != Conf::submissions)
+			throw TestException("InlineTask pool ran " + std::to_string(count) + " tasks, expected " + std::to_string(Conf::submissions));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Collecting "s + std::to_string(Conf::submissions) + " results from thread pool futures...");
+		pool_type pool( Conf::threads );
+		std::vector<Future<long long>> results;
+		for(long long i = 0; i < Conf::submissions; ++i)
+			results.push_back( pool.submit( [i](){ return i * i; } ) );
+
+		for(long long i = 0; i < Conf::submissions; ++i){
+			if(results[i].get() != i * i)
+				throw TestException("Future " + std::to_string(i) + " had the wrong result");
+		}
+		pool.shutdown();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that a future rethrows what its task threw...");
+		pool_type pool( Conf::threads );
+		auto result = pool.submit( []() -> int { throw std::runtime_error("expected"); } );
+		bool caught = false;
+		try{
+			result.get();
+		}
+		catch( const std::runtime_error & ){
+			caught = true;
+		}
+		if(!caught)
+			throw TestException("A future didn't rethrow its task's exception");
+		pool.shutdown();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking that continuations run on the pool thread...");
+		std::atomic<int> on_pool = 0, off_pool = 0;
+		{
+			pool_type pool( Conf::threads );
+			const auto caller = std::this_thread::get_id();
+			for(int i = 0; i < Conf::submissions; ++i){
+				pool.submit( [](){}, [&, caller]( Future<void> &f ){
+					f.get();
+					++(std::this_thread::get_id() == caller ? off_pool : on_pool);
+				});
+			}
+			pool.wait_idle();
+		}
+		if(on_pool != Conf::submissions)
+			throw TestException(std::to_string(off_pool) + " continuations ran off the pool, and " + std::to_string(on_pool) + " on it, of " + std::to_string(Conf::submissions));
+		eg.ok();
+	}
+
+	{
+		long expect = 0;
+		for(long level = 1, i = 0; i <= Conf::depth; ++i, level *= Conf::fanout)
+			expect += level;
+
+		EllipsisGuard eg("Waiting for "s + std::to_string(expect) + " recursively pushed tasks to go idle...");
+		pool_type pool( Conf::threads );
+		std::atomic<long> count = 0;
+		spawn(pool, count, Conf::depth);
+		pool.wait_idle();
+		if(count != expect)
+			throw TestException("Thread pool went idle after " + std::to_string(count) + " tasks, expected " + std::to_string(expect));
+		pool.shutdown();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking thread pool statistics"s + (pool_stats_enabled ? "" : ", which are compiled out") + "...");
+		static_assert( pool_stats_enabled || (std::is_empty_v<stats::QueueCounters<>> && std::is_empty_v<stats::PoolCounters<>>) );
+
+		pool_type pool( Conf::threads );
+		for(int i = 0; i < Conf::submissions; ++i)
+			pool.push( CaptureTask( [](){} ) );
+		pool.wait_idle();
+		auto snapshot = pool.stats();
+
+		if(snapshot.enabled != pool_stats_enabled)
+			throw TestException("Thread pool statistics claim to be "s + (snapshot.enabled ? "on" : "off") + " when they aren't");
+		if(pool_stats_enabled){
+			std::uint64_t tasks = 0;
+			for(auto &w : snapshot.workers)
+				tasks += w.tasks;
+			if(snapshot.run_time.count != std::uint64_t(Conf::submissions) || tasks != snapshot.run_time.count)
+				throw TestException("Thread pool statistics counted " + std::to_string(snapshot.run_time.count) + " tasks run, and " + std::to_string(tasks) + " across threads, expected " + std::to_string(Conf::submissions));
+			if(snapshot.queue.pushed != std::uint64_t(Conf::submissions) || snapshot.queue.popped != snapshot.queue.pushed || snapshot.queue.depth)
+				throw TestException("Queue statistics counted " + std::to_string(snapshot.queue.pushed) + " pushed and " + std::to_string(snapshot.queue.popped) + " popped, expected " + std::to_string(Conf::submissions));
+			if(snapshot.workers.size() != std::size_t(Conf::threads) || snapshot.queue.lock_wait.count < snapshot.queue.pushed)
+				throw TestException("Thread pool statistics are missing threads or lock waits");
+		}
+		else if(snapshot.run_time.count || snapshot.queue.pushed || !snapshot.workers.empty())
+			throw TestException("Compiled-out thread pool statistics weren't empty");
+		pool.shutdown();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Growing an elastic pool while its tasks block, and retiring threads once idle...");
+		pool_type pool( pool_type::sizing{ 1, Conf::elastic_max_threads, Conf::elastic_keepalive } );
+
+		//Every task blocks until all of them have started, which only happens if the pool grows to run them at once
+		std::atomic<int> started = 0, finished = 0;
+		for(int i = 0; i < Conf::elastic_max_threads; ++i){
+			pool.push( CaptureTask( [&](){
+				BlockingScope blocking;
+				++started;
+				while(started < Conf::elastic_max_threads)
+					std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+				++finished;
+			}));
+		}
+		pool.wait_idle();
+		if(finished != Conf::elastic_max_threads)
+			throw TestException("Elastic pool finished " + std::to_string(finished) + " tasks, expected " + std::to_string(Conf::elastic_max_threads));
+		if(pool.size() != std::size_t(Conf::elastic_max_threads))
+			throw TestException("Elastic pool grew to " + std::to_string(pool.size()) + " threads, expected " + std::to_string(Conf::elastic_max_threads));
+
+		auto deadline = std::chrono::steady_clock::now() + Conf::elastic_keepalive * 20;
+		while(pool.size() > 1 && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::sleep_for( Conf::elastic_keepalive );
+		if(pool.size() != 1)
+			throw TestException("Elastic pool still had " + std::to_string(pool.size()) + " threads after going idle, expected 1");
+
+		//And it still works after shrinking
+		auto result = pool.submit( [](){ return 7; } );
+		if(result.get() != 7)
+			throw TestException("A shrunken elastic pool's future had the wrong result");
+		pool.shutdown();
+		eg.ok();
+	}
+	{
+		EllipsisGuard eg("Adding to per-thread counters from "s + std::to_string(Conf::threads) + " pool threads...");
+		enum{ tasks, units, open, counter_count };
+		ThreadCounters<counter_count> counters;
+
+		//Each task opens on one thread and closes on another, so the gauge only comes to 0 in total
+		pool_type pool( Conf::threads );
+		for(int i = 0; i < Conf::submissions; ++i){
+			counters.add(open);
+			pool.push( CaptureTask( [&counters, i](){
+				counters.add(tasks);
+				counters.add( units, i );
+				counters.add( open, -1 );
+			}));
+		}
+		pool.wait_idle();
+		pool.shutdown();
+
+		auto totals = counters.read();
+		const std::int64_t expect = std::int64_t(Conf::submissions) * (Conf::submissions - 1) / 2;
+		if(totals[tasks] != Conf::submissions || totals[units] != expect || totals[open])
+			throw TestException("Per-thread counters came to " + std::to_string(totals[tasks]) + " tasks, " + std::to_string(totals[units]) + " units and "
+				+ std::to_string(totals[open]) + " open, expected " + std::to_string(Conf::submissions) + ", " + std::to_string(expect) + " and 0");
+		eg.ok();
+	}
+	{
+		EllipsisGuard eg("Checking that a thread drops its slots in "s + std::to_string(Conf::counters_owners) + " per-thread counters as they go...");
+		const auto before = ThreadCache::thread_entries();
+		for(int i = 0; i < Conf::counters_owners; ++i){
+			ThreadCounters<1> counters;
+			counters.add(0, i);
+			if(counters.read()[0] != i)
+				throw TestException("Per-thread counters made over another's address read " + std::to_string(counters.read()[0]) + ", expected " + std::to_string(i));
+		}
+		if(ThreadCache::thread_entries() > before + 1)
+			throw TestException("A thread still has " + std::to_string(ThreadCache::thread_entries()) + " per-thread slots, for counters which are gone");
+		eg.ok();
+	}
+}
+
+void ThreadPoolBenchmark::run(){
+	std::cout << std::endl << "Thread pool throughput, Mtasks/s. " << Conf::bench_tasks << " tasks pushed from one thread" << std::endl;
+	std::cout << std::setw(10) << "threads" << std::setw(14) << "single type" << std::setw(16) << "std::function" << std::setw(14) << "InlineTask" << std::endl << std::fixed << std::setprecision(2);
+
+	std::atomic<long> count = 0;
+	std::array<long, 3> padding{};	//Enough captures to put a std::function on the heap
+
+	for(int threads = 1; threads <= Conf::bench_max_threads; threads *= 2){
+		std::cout << std::setw(10) << threads;
+		std::cout << std::setw(14) << bench_pool<ThreadPool<count_task>>( threads, [&](int i){ return count_task{ &count, i }; } ) << std::flush;
+
+		std::exception_ptr error;
+		std::cout << std::setw(16) << bench_pool<ThreadPool<CaptureTask>>( threads, [&](int i){
+			return CaptureTask( [&count, padding, i](){ count += i + padding[0]; }, error );
+		}) << std::flush;
+
+		//Half one kind and half another, which a single-type pool couldn't do at all
+		std::cout << std::setw(14) << bench_pool<ThreadPool<InlineTask<>>>( threads, [&](int i) -> InlineTask<> {
+			if(i % 2)
+				return count_task{ &count, i };
+			return [&count, padding, i](){ count += i + padding[0]; };
+		}) << std::endl;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include "test.hpp"
+
+struct ThreadPoolTestsConfig{
+	static constexpr int threads = 4;
+	static constexpr int submissions = 10000;
+	static constexpr int fanout = 4;		//For the wait_idle test, each task pushes this many more...
+	static constexpr int depth = 6;			//...down to this many levels
+	static constexpr int elastic_max_threads = 8;
+	static constexpr std::chrono::milliseconds elastic_keepalive{50};
+	static constexpr int counters_owners = 1000;	//Made and destroyed one after another on one thread
+
+	//Benchmark
+	static constexpr int bench_tasks = 1 << 20;
+	static constexpr int bench_max_threads = 4;
+};
+
+//InlineTask, futures, continuations, wait_idle(), statistics, elastic sizing and per-thread counters
+class ThreadPoolTests{
+public:
+	using Conf = ThreadPoolTestsConfig;
+	void run();
+};
+
+//Tasks per second through a ThreadPool of a single task type, of CaptureTask's std::function, and of InlineTask
+class ThreadPoolBenchmark{
+public:
+	using Conf = ThreadPoolTestsConfig;
+	void run();
+};
@@ -0,0 +1,225 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <poll.h>
+#include "console.hpp"
+#include "timer_wheel.hpp"
+#include "sheduler.hpp"
+#include "timer.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+using namespace levitator;
+
+namespace{
+
+using clock_type = std::chrono::steady_clock;
+
+struct expiry{
+	int index;
+};
+
+struct timed_task{
+	std::function<void ()> proc;
+
+	void operator()(){
+		proc();
+	}
+};
+
+//Check that every timer fires exactly on its tick, however the wheel is advanced and whatever happens to the others
+void check_wheel(){
+	using Conf = TimerTestsConfig;
+	using wheel_type = TimerWheel<expiry>;
+
+	RandStream rand(7);
+	wheel_type wheel;
+	std::vector<wheel_type::tick_type> when( Conf::timers + Conf::far_timers );
+	std::vector<timer_id> ids( when.size() );
+	std::vector<int> state( when.size() );		//0 pending, 1 fired, 2 cancelled
+
+	auto random_tick = [&rand](int bits){
+		return wheel_type::tick_type( (unsigned(rand.get()) << 16) ^ unsigned(rand.get()) ) & ((wheel_type::tick_type(1) << bits) - 1);
+	};
+
+	for(int i = 0; i < Conf::timers; ++i){
+		when[i] = 1 + random_tick( rand.int_between(4, Conf::horizon_bits + 1) );
+		ids[i] = wheel.arm( when[i], {i} );
+	}
+	for(int i = Conf::timers; i < int(when.size()); ++i){
+		when[i] = (wheel_type::tick_type(1) << 32) + random_tick(20);
+		ids[i] = wheel.arm( when[i], {i} );
+	}
+
+	//A quarter cancelled and a quarter moved
+	for(int i = 0; i < Conf::timers; i += 4){
+		if(!wheel.cancel( ids[i] ))
+			throw TestException("Couldn't cancel pending timer " + std::to_string(i));
+		state[i] = 2;
+		when[i + 1] = 1 + random_tick(Conf::horizon_bits);
+		if(!wheel.rearm( ids[i + 1], when[i + 1] ))
+			throw TestException("Couldn't rearm pending timer " + std::to_string(i + 1));
+	}
+	if(wheel.cancel( ids[0] ))
+		throw TestException("Cancelled a timer twice");
+
+	std::size_t fired = 0;
+	auto on_expire = [&](expiry &&e){
+		if(state[e.index])
+			throw TestException("Timer " + std::to_string(e.index) + " fired after it had been fired or cancelled");
+		if(wheel.now() != when[e.index])
+			throw TestException("Timer " + std::to_string(e.index) + " due on tick " + std::to_string(when[e.index]) + " fired on " + std::to_string(wheel.now()));
+		state[e.index] = 1;
+		++fired;
+	};
+
+	//Steps of all sizes, from single ticks to great leaps
+	while(!wheel.empty()){
+		auto step = wheel.now() < 1000 ? 1 : random_tick( rand.int_between(1, 28) );
+		wheel.advance( wheel.now() + step, on_expire );
+	}
+
+	const auto expect = when.size() - Conf::timers / 4;
+	if(fired != expect)
+		throw TestException("Timer wheel fired " + std::to_string(fired) + " timers, expected " + std::to_string(expect));
+}
+
+}
+
+void TimerTests::run(){
+
+	{
+		EllipsisGuard eg("Firing, cancelling and rearming "s + std::to_string(Conf::timers + Conf::far_timers) + " timers on a timer wheel...");
+		check_wheel();
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Running "s + std::to_string(Conf::scheduled) + " scheduled tasks, none of them early...");
+		const int expect = Conf::scheduled - Conf::scheduled / 10;
+		std::atomic<int> ran = 0, early = 0, cancelled_ran = 0;	//The cancelled ones can only run if they were due straight away
+		{
+			Scheduler<timed_task> scheduler;
+			RandStream rand(3);
+			std::vector<timer_id> cancel;
+			for(int i = 0; i < Conf::scheduled; ++i){
+				auto due = clock_type::now() + std::chrono::milliseconds( rand.int_between(0, Conf::max_delay_ms) );
+				auto id = scheduler.schedule( due, { [&, due, i](){
+					++(i % 10 ? ran : cancelled_ran);
+					if(clock_type::now() < due)
+						++early;
+				}});
+				if(!(i % 10))
+					cancel.push_back(id);
+			}
+			for(auto id : cancel)
+				scheduler.cancel(id);
+
+			auto deadline = clock_type::now() + std::chrono::seconds(5);
+			while(ran < expect && clock_type::now() < deadline)
+				std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+		}
+
+		if(ran != expect || early)
+			throw TestException("Scheduler ran " + std::to_string(ran) + " tasks of " + std::to_string(expect) + ", " + std::to_string(early) + " of them early");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Dispatching scheduled tasks from a poll loop on the timerfd...");
+		Scheduler<timed_task> scheduler( Scheduler<timed_task>::external );
+		int ran = 0;
+		for(int delay : {5, 1, 3})
+			scheduler.schedule_after( std::chrono::milliseconds(delay), { [&ran](){ ++ran; } } );
+
+		auto deadline = clock_type::now() + std::chrono::seconds(5);
+		while(ran < 3 && clock_type::now() < deadline){
+			pollfd pfd{ scheduler.fd(), POLLIN, 0 };
+			if(::poll( &pfd, 1, 1000 ) > 0)
+				scheduler.dispatch();
+		}
+		if(ran != 3)
+			throw TestException("Only " + std::to_string(ran) + " of 3 timerfd-driven tasks ran");
+		eg.ok();
+	}
+}
+
+void TimerBenchmark::run(){
+	using wheel_type = TimerWheel<expiry>;
+	using tick_type = wheel_type::tick_type;
+
+	std::cout << std::endl << "Timers, " << Conf::bench_live_timers << " live, " << Conf::bench_rearms << " rearms, Mops/s" << std::endl;
+	std::cout << std::setw(24) << "" << std::setw(12) << "arm" << std::setw(12) << "rearm" << std::setw(12) << "expire" << std::endl << std::fixed << std::setprecision(2);
+
+	auto rate = [](int ops, clock_type::time_point start){
+		std::chrono::duration<double> elapsed = clock_type::now() - start;
+		return ops / elapsed.count() / 1e6;
+	};
+
+	//Each live timer is a session's timeout, pushed back on every bit of traffic
+	std::vector<tick_type> due( Conf::bench_live_timers );
+	std::vector<int> sessions( Conf::bench_rearms );
+	{
+		RandStream rand(5);
+		for(auto &d : due)
+			d = rand.int_between(1, Conf::bench_timeout_ticks);
+		for(auto &s : sessions)
+			s = rand.int_between(0, Conf::bench_live_timers);
+	}
+
+	long long check = 0;
+	{
+		wheel_type wheel;
+		std::vector<timer_id> ids( due.size() );
+
+		auto start = clock_type::now();
+		for(int i = 0; i < Conf::bench_live_timers; ++i)
+			ids[i] = wheel.arm( due[i], {i} );
+		auto arm = rate( Conf::bench_live_timers, start );
+
+		start = clock_type::now();
+		tick_type now = 0;
+		for(int i = 0; i < Conf::bench_rearms; ++i)
+			wheel.rearm( ids[sessions[i]], now + i / 64 + Conf::bench_timeout_ticks );
+		auto rearm = rate( Conf::bench_rearms, start );
+
+		start = clock_type::now();
+		wheel.advance( std::numeric_limits<std::uint32_t>::max(), [&check](expiry &&e){ check += e.index; } );
+		auto expire = rate( Conf::bench_live_timers, start );
+
+		std::cout << std::setw(24) << "timer wheel" << std::setw(12) << arm << std::setw(12) << rearm << std::setw(12) << expire << std::endl;
+	}
+	{
+		std::multimap<tick_type, int> timers;
+		std::vector<std::multimap<tick_type, int>::iterator> ids( due.size() );
+
+		auto start = clock_type::now();
+		for(int i = 0; i < Conf::bench_live_timers; ++i)
+			ids[i] = timers.insert( {due[i], i} );
+		auto arm = rate( Conf::bench_live_timers, start );
+
+		start = clock_type::now();
+		for(int i = 0; i < Conf::bench_rearms; ++i){
+			auto s = sessions[i];
+			timers.erase( ids[s] );
+			ids[s] = timers.insert( {i / 64 + Conf::bench_timeout_ticks, s} );
+		}
+		auto rearm = rate( Conf::bench_rearms, start );
+
+		start = clock_type::now();
+		while(!timers.empty()){
+			check -= timers.begin()->second;
+			timers.erase( timers.begin() );
+		}
+		auto expire = rate( Conf::bench_live_timers, start );
+
+		std::cout << std::setw(24) << "std::multimap" << std::setw(12) << arm << std::setw(12) << rearm << std::setw(12) << expire << std::endl;
+	}
+
+	if(check)
+		std::cout << "Timer wheel and multimap fired different timers!" << std::endl;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "test.hpp"
+
+struct TimerTestsConfig{
+	static constexpr int timers = 100000;
+	static constexpr int horizon_bits = 26;			//Most timers are due within 2^26 ticks, across three levels of the wheel...
+	static constexpr int far_timers = 100;			//...and these are out past its 2^32, on the overflow list
+	static constexpr int scheduled = 200;			//For the Scheduler tests
+	static constexpr int max_delay_ms = 50;
+
+	//Benchmark
+	static constexpr int bench_live_timers = 100000;
+	static constexpr int bench_rearms = 1000000;	//Session timeouts being pushed back
+	static constexpr int bench_timeout_ticks = 30000;
+};
+
+class TimerTests{
+public:
+	using Conf = TimerTestsConfig;
+	void run();
+};
+
+//TimerWheel against a std::multimap, the way Scheduler used to keep its timers
+class TimerBenchmark{
+public:
+	using Conf = TimerTestsConfig;
+	void run();
+};
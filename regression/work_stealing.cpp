@@ -0,0 +1,210 @@
+#include <string>
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <set>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+#include <sched.h>
+#include "console.hpp"
+#include "concurrency/work_stealing_pool.hpp"
+#include "concurrency/thread_pool.hpp"
+#include "concurrency/affinity.hpp"
+#include "work_stealing.hpp"
+
+using namespace std::string_literals;
+using namespace jab::util;
+using namespace levitator::concurrency;
+
+namespace{
+
+class test_task{
+	std::function<void ()> m_proc;
+
+public:
+	test_task() = default;
+
+	test_task( std::function<void ()> &&proc ):
+		m_proc(std::move(proc)){}
+
+	int operator()(){
+		if(!m_proc)
+			return -1;
+
+		m_proc();
+		return 0;
+	}
+};
+
+using pool_type = WorkStealingThreadPool<test_task>;
+
+//Each task counts itself and then spawns its children onto its own thread's deque
+void spawn( pool_type &pool, std::atomic<long> &count, int depth ){
+	pool.push( test_task( [&pool, &count, depth](){
+		++count;
+		if(depth > 0){
+			for(int i = 0; i < WorkStealingTestsConfig::fanout; ++i)
+				spawn(pool, count, depth - 1);
+		}
+	}));
+}
+
+}
+
+void WorkStealingTests::run(){
+
+	{
+		long expect = 0;
+		for(long level = 1, i = 0; i <= Conf::depth; ++i, level *= Conf::fanout)
+			expect += level;
+		expect *= Conf::roots;
+
+		EllipsisGuard eg("Running "s + std::to_string(expect) + " recursively spawned tasks on a " + std::to_string(Conf::threads) + "-thread work-stealing pool...");
+		std::atomic<long> count = 0;
+		{
+			pool_type pool( Conf::threads );
+			for(int i = 0; i < Conf::roots; ++i)
+				spawn(pool, count, Conf::depth);
+			pool.shutdown();
+		}
+
+		if(count != expect)
+			throw TestException("Work-stealing pool ran " + std::to_string(count) + " tasks, expected " + std::to_string(expect));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Feeding "s + std::to_string(Conf::fed) + " tasks to a work-stealing pool with a high-water mark of " + std::to_string(Conf::high_water) + "...");
+		std::atomic<long> count = 0;
+		std::atomic<bool> release = false;
+		{
+			pool_type pool( 1, {}, {}, Conf::high_water );
+
+			//Hold up the only thread, so the injection queue fills
+			pool.push( test_task( [&release](){
+				while(!release)
+					std::this_thread::yield();
+			}));
+
+			int accepted = 0;
+			while(accepted <= Conf::high_water && pool.try_push( test_task( [&count](){ ++count; } ) ))
+				++accepted;
+
+			//The blocking task may or may not have been taken off the queue yet
+			if(accepted < Conf::high_water - 1 || accepted > Conf::high_water)
+				throw TestException("Bounded pool accepted " + std::to_string(accepted) + " tasks with a high-water mark of " + std::to_string(Conf::high_water));
+
+			release = true;
+			long left = Conf::fed - accepted;
+			auto fed = pool.feed( [&]() -> std::optional<test_task>{
+				if(!left)
+					return {};
+				--left;
+				return test_task( [&count](){ ++count; } );
+			});
+			pool.shutdown();
+
+			if(long(fed) + accepted != Conf::fed)
+				throw TestException("Feeding the pool pushed " + std::to_string(fed) + " tasks, expected " + std::to_string(Conf::fed - accepted));
+		}
+
+		if(count != Conf::fed)
+			throw TestException("Bounded pool ran " + std::to_string(count) + " tasks, expected " + std::to_string(Conf::fed));
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Checking compact, scatter and listed thread placements...");
+		auto &topology = CpuTopology::system();
+		if(topology.cpus().empty())
+			throw TestException("Found no CPUs to run on");
+
+		std::vector<int> all;
+		for(auto &c : topology.cpus())
+			all.push_back(c.cpu);
+		for(auto placement : { Affinity::compact(), Affinity::scatter() }){
+			auto order = placement.order();
+			std::sort( order.begin(), order.end() );
+			if(order != all)
+				throw TestException("A placement's order didn't cover each CPU we can run on exactly once");
+		}
+
+		if(parse_cpu_list("0,2-4,7") != std::vector<int>{ 0, 2, 3, 4, 7 })
+			throw TestException("Misread a CPU list");
+		bool threw = false;
+		try{
+			Affinity::parse("3-1");
+		}
+		catch( const std::invalid_argument & ){
+			threw = true;
+		}
+		if(!threw)
+			throw TestException("Took a backwards CPU range for a placement");
+
+		//Everything should run on the one CPU listed, whichever pool thread it's on
+		const int cpu = all.back();
+		std::mutex mutex;
+		std::set<int> seen;
+		auto record = [&](){
+			std::lock_guard lock(mutex);
+			seen.insert( sched_getcpu() );
+		};
+		{
+			pool_type pool( Conf::threads, {}, {}, 0, Affinity::cpus({ cpu }) );
+			for(int i = 0; i < Conf::pinned_tasks; ++i)
+				pool.push( test_task(record) );
+			pool.shutdown();
+		}
+		{
+			ThreadPool<CaptureTask> pool( { .min_threads = 2, .max_threads = 2, .placement = Affinity::cpus({ cpu }) } );
+			for(int i = 0; i < Conf::pinned_tasks; ++i)
+				pool.push( CaptureTask(record) );
+			pool.shutdown();
+		}
+		if(seen != std::set<int>{ cpu })
+			throw TestException("Tasks on threads pinned to CPU " + std::to_string(cpu) + " ran on " + std::to_string(seen.size()) + " CPUs");
+		eg.ok();
+	}
+
+	{
+		EllipsisGuard eg("Starting and stopping a work-stealing pool "s + std::to_string(Conf::shutdown_rounds) + " times...");
+		for(int i = 0; i < Conf::shutdown_rounds; ++i){
+			pool_type pool( Conf::threads );
+			if(i % 2)
+				pool.shutdown();
+		}
+		eg.ok();
+	}
+}
+
+void WorkStealingBenchmark::run(){
+	const int threads = 2 * std::max( 1, int(CpuTopology::system().cpus().size()) );
+	long tasks = 0;
+	for(long level = 1, i = 0; i <= Conf::bench_depth; ++i, level *= Conf::fanout)
+		tasks += level;
+	tasks *= Conf::bench_roots;
+
+	std::cout << std::endl << "Work-stealing pool of " << threads << " threads on " << CpuTopology::system().cpus().size() << " CPUs in "
+		<< CpuTopology::system().nodes() << " NUMA nodes, " << tasks << " recursively spawned tasks, Mtasks/s" << std::endl;
+	std::cout << std::setw(12) << "none" << std::setw(12) << "compact" << std::setw(12) << "scatter" << std::endl;
+
+	for(auto &placement : { Affinity(), Affinity::compact(), Affinity::scatter() }){
+		std::atomic<long> count = 0;
+		auto start = std::chrono::steady_clock::now();
+		{
+			pool_type pool( threads, {}, {}, 0, placement );
+			for(int i = 0; i < Conf::bench_roots; ++i)
+				spawn( pool, count, Conf::bench_depth );
+			pool.shutdown();
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::setw(12) << std::fixed << std::setprecision(2) << count / elapsed.count() / 1e6 << std::flush;
+	}
+	std::cout << std::endl;
+}
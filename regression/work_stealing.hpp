@@ -0,0 +1,30 @@
+#pragma once
+#include "test.hpp"
+
+struct WorkStealingTestsConfig{
+	static constexpr int threads = 8;
+	static constexpr int fanout = 4;			//Each task spawns this many children...
+	static constexpr int depth = 9;				//...down to this many levels below the roots
+	static constexpr int roots = 16;			//Pushed from outside the pool
+	static constexpr int shutdown_rounds = 100;	//Pools started and shut down straight away
+	static constexpr int high_water = 8;		//For the bounded pool...
+	static constexpr int fed = 100000;			//...fed this many tasks from outside
+	static constexpr int pinned_tasks = 10000;
+
+	//Benchmark, at twice as many threads as CPUs, as a crawl would have
+	static constexpr int bench_depth = 8;
+	static constexpr int bench_roots = 64;
+};
+
+class WorkStealingTests{
+public:
+	using Conf = WorkStealingTestsConfig;
+	void run();
+};
+
+//Tasks per second through work-stealing pools with each thread placement
+class WorkStealingBenchmark{
+public:
+	using Conf = WorkStealingTestsConfig;
+	void run();
+};
@@ -1,9 +1,14 @@
 #pragma once
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <utility>
+#include <array>
 #include <type_traits>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <span>
+#include <vector>
 #include <algorithm>
 #include "Config.hpp"
 #include "exception.hpp"
@@ -11,6 +16,11 @@
 #include "meta.hpp"
 #include "varargs.hpp"
 #include "ringbuf.hpp"
+#include "mirror_buffer.hpp"
+
+namespace levitator{
+class Reactor;
+}
 
 namespace jab{
 namespace file{
@@ -22,13 +32,19 @@ enum flags{
     noctty = w << 1,
     ndelay = noctty << 1,
     nonblock = ndelay << 1,
-    create = nonblock << 1
+    create = nonblock << 1,
+    trunc = create << 1
 };
 
 struct File_state{
     using fd_t = int;
     fd_t m_fd = -1;
     bool m_debug = false;
+    levitator::Reactor *m_reactor = nullptr;
+
+    //What read_until() has read past the records it's returned, from ahead_begin to ahead_end
+    std::vector<char> ahead;
+    std::size_t ahead_begin = 0, ahead_end = 0;
 };
 
 class File{
@@ -78,6 +94,11 @@ public:
     virtual void close();
     virtual std::streamsize read(char *data, std::streamsize len);
     virtual std::streamsize write(const char *data, std::streamsize len);
+
+	//Scatter/gather, for both segments of a wrapped ringbuffer in one call. By default, readv() and writev().
+	virtual std::streamsize readv(const ::iovec *iov, int iovcnt);
+	virtual std::streamsize writev(const ::iovec *iov, int iovcnt);
+
 	virtual std::streamsize seek(std::streamsize pos, std::ios_base::seekdir dir);
 	virtual std::streamsize seek_exactly(std::streamsize pos, std::ios_base::seekdir dir);
     virtual std::streamsize available() const;
@@ -90,9 +111,33 @@ public:
     File &operator=(File &&);
     std::streamsize read_exactly(char *data, std::streamsize len);
     void write_exactly(const char *data, std::streamsize len);
+
+    //How read_until() found a record to end
+    enum class record_ending{
+        none,           //End of file, with nothing before it
+        delimiter,
+        eof             //End of file, with a record before it but no delimiter
+    };
+
+    //The next record up to delimiter, which isn't part of it, as a view into a lookahead buffer which holds until the
+    //next read. The file is read a block at a time and scanned with memchr, and a record longer than the buffer grows it.
+    //read_exactly() takes what's been read ahead before it reads the file. read(), readv(), available(), a stream on the
+    //file and anything else that calls the file's own read don't see it.
+    record_ending read_until(char delimiter, std::span<const char> &record);
+
+    //A copy of the record. At end of file, whatever there was, or an empty string.
     std::string read_until(char c);
     void debug(bool v);
     bool debug() const;
+
+    //write_exactly() on a nonblocking file waits on the reactor for it to be writable, rather than poll() it, so long
+    //as some other thread is running the reactor's loop. From a handler on that thread it poll()s.
+    //The file is in the reactor while it's both nonblocking and open, since only then is there anything to wait for.
+    //Null takes it back out.
+    void reactor(levitator::Reactor *r);
+    levitator::Reactor *reactor() const;
+    bool nonblocking() const;
+    void nonblocking(bool v);
     
     template<typename T>
     void write( const jab::util::as_bin<T> &obj ){
@@ -255,13 +300,15 @@ class Filestreambuf : public std::basic_streambuf<Char, Traits> {
 	struct State{
 		char_type rbuf_bak, wbuf_bak; //single-character fallback buffers in case none are provided
 		jab::io::ringbuffer<char_type> rbuf, wbuf;
-		File *file;				
+		File *file;
+		std::basic_string<char_type, traits_type> line;	//getline_view's copy of a line which runs around the end of rbuf
+		char_type line_end_hint = '\r';					//How the last line ended, which is what the next is looked for by
 	} m_state;
 
     //Synchronize the streambuf get-pointers with the get-ringbuffer
     void update_gptrs(){
-		//If the buffer is more than 1-sized, then reserve a character as a reliable put-back space
-		auto end = m_state.rbuf.size() > 1 ? m_state.rbuf.get_end() - 1 : m_state.rbuf.get_end();
+		//If the segment is more than 1-sized, then reserve a character as a reliable put-back space
+		auto end = m_state.rbuf.getavail() > 1 ? m_state.rbuf.get_end() - 1 : m_state.rbuf.get_end();
         this->setg(m_state.rbuf.get_begin(), m_state.rbuf.get_begin(), end);
     }
 
@@ -313,7 +360,16 @@ class Filestreambuf : public std::basic_streambuf<Char, Traits> {
         }
     };
 
-public:	
+public:
+	using view_type = std::basic_string_view<char_type, traits_type>;
+
+	//How getline_view found the end of a line
+	enum class line_ending{
+		none,		//End-of-file, with nothing read
+		newline,	//\n, \r\n or a lone \r, none of which is in the line
+		eof			//End-of-file after part of a line, which is returned as the last line
+	};
+
     Filestreambuf(File &file = null_file, char_type *buf = nullptr,  std::streamsize bufn = 0):
 		m_state({ 0, 0, {}, {}, &file }){
 
@@ -351,6 +407,14 @@ public:
         return this;
     }
 
+	//Reads through a mirrored ring instead: n characters mapped twice over, as by a mirror_buffer. What's been read and
+	//not yet got is then always in one piece, so getline_view has no lines to copy across the wrap, and xsgetn drains it
+	//in one go. Purges the read buffer, as setbuf does, and setbuf goes back to a plain ring.
+	void mirror_rbuf( char_type *buf, streamsize n ){
+		m_state.rbuf.buf(buf, n, true);
+		update_gptrs();
+	}
+
     virtual pos_type seekpos (pos_type pos, std::ios_base::openmode which) override{
 		return seekoff(pos, std::ios_base::beg, which);
     }
@@ -480,40 +544,81 @@ private:
 		return m_state.file->read(buf, n);
 	}
 
+	using segments = std::array<typename jab::io::ringbuffer<char_type>::segment, 2>;
+
+	//Both segments of a ring in one call, if it takes both, or else just the one. This and do_write/do_read only pass
+	//along what the streambuf's given, so they're for char, which is what File reads and writes.
+	streamsize do_readv( const segments &s ){
+		if(!s[1].size())
+			return do_read( s[0].begin, s[0].size() );
+		::iovec iov[2] = { { s[0].begin, ::size_t(s[0].size()) }, { s[1].begin, ::size_t(s[1].size()) } };
+		return m_state.file->readv(iov, 2);
+	}
+
+	streamsize do_writev( const segments &s ){
+		if(!s[1].size())
+			return do_write( s[0].begin, s[0].size() );
+		::iovec iov[2] = { { s[0].begin, ::size_t(s[0].size()) }, { s[1].begin, ::size_t(s[1].size()) } };
+		return m_state.file->writev(iov, 2);
+	}
+
+	//Read whatever fits into the read buffer, around its wrap as well. 0 at EOF.
+	streamsize fill_rbuf(){
+		auto ct = do_readv( m_state.rbuf.put_segments() );
+		m_state.rbuf.push(ct);
+		return ct;
+	}
+
+	//The first \r or \n in [begin, end), or end. It looks for whichever ended the last line first, and then for the other
+	//only up to there, so that neither search runs past the end of the line unless the line endings are mixed.
+	const char_type *find_line_end( const char_type *begin, const char_type *end ){
+		const char_type cr = '\r', lf = '\n';
+		auto first = m_state.line_end_hint, second = traits_type::eq(first, cr) ? lf : cr;
+		auto p = traits_type::find(begin, end - begin, first);
+		if(!p)
+			p = end;
+		auto q = traits_type::find(begin, p - begin, second);
+		return q ? q : p;
+	}
+
 public:
     virtual streamsize xsputn(const char_type* s, streamsize n) override{
 
-        streamsize ct=0, ct2=0;
+        streamsize ct, tot = 0;
 
         PutGuard pg(*this);
 
-        //If the buffer is already partially populated than try to fill it
-        if( m_state.wbuf.size() ){
+        //A file may take less than it's given, as a busy socket can, so keep on until it all goes or nothing does
+        while(n > 0){
+
+            //If the buffer is empty, and would overflow anyway, write directly to the file
+            if( !m_state.wbuf.size() && n >= m_state.wbuf.capacity() ){
+                if( !(ct = do_write(s, n)) )
+                    break;
+                s += ct;
+                n -= ct;
+                tot += ct;
+                continue;
+            }
+
+            //Otherwise fill the buffer, around its wrap as well
             ct = fill_wbuf(s, n);
+            ct += fill_wbuf(s + ct, n - ct);
             s += ct;
             n -= ct;
+            tot += ct;
 
-            if( m_state.wbuf.size() >= m_state.wbuf.capacity()){
+            //And drain it if there's more, which overflow does around the wrap in one call
+            if(n > 0){
+                auto before = m_state.wbuf.size();
                 update_pptrs();
                 overflow( traits_type::eof() );
+                if(m_state.wbuf.size() == before)
+                    break;
             }
-
-            //If buffer failed to flush, then top it off and finish
-            if(m_state.wbuf.size())
-                return ct + fill_wbuf(s, n);            
-        }
-
-        //Write buffer should be empty here
-
-        //If the buffer is going to overflow anyway, write directly to the file
-        if( n >= m_state.wbuf.capacity()){
-			ct2 = do_write( s, n );						
-            s += ct2;
-            n -= ct2;
         }
 
-        //Now top off the buffer with any excess and finish        
-        return ct + ct2 + fill_wbuf(s, n);        
+        return tot;
     }	
 
     //TODO: Handle no-op eof character
@@ -522,10 +627,9 @@ public:
 		::ssize_t ct;
         PutGuard pg(*this);
 
-		auto avail = m_state.wbuf.getavail();
-	
-		if(avail){
-			ct = do_write( m_state.wbuf.get_begin(), m_state.wbuf.getavail() );			
+		//All of it, around the wrap as well
+		if(m_state.wbuf.size()){
+			ct = do_writev( m_state.wbuf.get_segments() );
 			if(ct == 0)
 				return traits_type::eof();
 			else{				
@@ -543,15 +647,84 @@ public:
 
     virtual int_type underflow() override{
         GetGuard gg(*this);
-        auto space = m_state.rbuf.putavail();
-		auto ct = do_read(m_state.rbuf.put_begin(), space);
 
-        if(ct == 0)
+		//There may be a character held back for put-back, or the rest of the ring past its end, still to get.
+		//Reading then would find no room when the ring is full, and look like EOF.
+		if( !m_state.rbuf.size() && !fill_rbuf() )
             return traits_type::eof();
 
-        m_state.rbuf.push(ct);
         return traits_type::to_int_type(*m_state.rbuf.get_begin());
     }
+
+	//Get a line straight out of the read buffer, rather than a character at a time through the stream, which is where
+	//reading lines that way spends nearly all of its time. The line ending is scanned for with traits_type::find, which
+	//is memchr for char. Line endings are the same four that baw has always taken: \n, \r\n, a lone \r, and EOF.
+	//
+	//The line is a view into the buffer. It's only copied aside when it runs around the end of the ring, is longer than
+	//the whole buffer, or ends in a \r at the end of what's been read. Either way, it's good until the next operation on
+	//this streambuf, and no longer.
+	line_ending getline_view( view_type &line ){
+		GetGuard gg(*this);
+		auto &rb = m_state.rbuf;
+		auto &copy = m_state.line;
+		bool copied = false;
+		copy.clear();
+
+		while(true){
+			auto begin = rb.get_begin(), end = rb.get_end();
+			streamsize segment = end - begin;
+			auto p = find_line_end(begin, end);
+
+			if(p == end){
+				//Set the segment aside if the line goes on past the end of the ring, or it fills the buffer
+				if( segment && (rb.size() > segment || rb.size() >= rb.capacity()) ){
+					copy.append(begin, segment);
+					copied = true;
+					rb.pop(segment);
+				}
+				else if( !fill_rbuf() ){
+					if(!segment && !copied)
+						return line_ending::none;
+
+					if(copied){
+						copy.append(begin, segment);
+						line = copy;
+					}
+					else
+						line = view_type(begin, segment);
+					rb.pop(segment);
+					return line_ending::eof;
+				}
+				continue;
+			}
+
+			auto ending = *p;
+			if(copied){
+				copy.append(begin, p - begin);
+				line = copy;
+			}
+			else
+				line = view_type(begin, p - begin);
+
+			rb.pop(p + 1 - begin);
+			m_state.line_end_hint = ending;
+
+			//Whether there's a \n with a \r may not have been read yet. The buffer's just been emptied, if so, and
+			//reading into it would overwrite the line, which is set aside first.
+			if( traits_type::eq(ending, '\r') ){
+				if(!rb.size()){
+					if(!copied){
+						copy.assign(line);
+						line = copy;
+					}
+					fill_rbuf();
+				}
+				if( rb.size() && traits_type::eq(*rb.get_begin(), '\n') )
+					rb.pop(1);
+			}
+			return line_ending::newline;
+		}
+	}
 };
 
 template< typename Ch, class File, typename Traits = std::char_traits<Ch> >
@@ -562,12 +735,15 @@ public:
 	using file_type = File;
 	using char_type = typename base_type::char_type;
 	using traits_type = typename base_type::traits_type;
+	using sb_type = Filestreambuf<char_type, traits_type>;
+	using view_type = typename sb_type::view_type;
 
 private:
 	struct State{
 		std::unique_ptr<char_type []> m_bufspace;
+		jab::io::mirror_buffer m_mirror;
 		file_type file;
-		Filestreambuf<char_type, traits_type> m_sb;
+		sb_type m_sb;
 		
 		State( char_type *buf = nullptr, file_type &&file_arg = file_type()):
 			m_bufspace(buf),
@@ -596,6 +772,13 @@ public:
 		return *this;
 	}
 
+	//Moves reading onto a mirror_buffer of at least sz characters, rounded up to whole pages. Anything read and not yet
+	//got is dropped, so it's for before the first read. Throws IOError if the buffer can't be mapped.
+	void mirror_read_buffer( std::streamsize sz = jab::util::Config::io_block_size ){
+		m_state.m_mirror = jab::io::mirror_buffer( sz * sizeof(char_type) );
+		m_state.m_sb.mirror_rbuf( reinterpret_cast<char_type *>( m_state.m_mirror.data() ), m_state.m_mirror.size() / sizeof(char_type) );
+	}
+
 	const file_type &file() const{
 		return m_state.file;
 	}
@@ -603,6 +786,36 @@ public:
 	file_type &file(){
 		return m_state.file;
 	}
+
+	//Filestreambuf::getline_view, with the stream's state set the way std::getline sets it: eofbit after a last line
+	//with no ending, and failbit as well when there's no line at all. Either throws if exceptions() asks for it.
+	bool getline_view( view_type &line ){
+		//What a sentry would check, without its cost, which is most of the call for short lines. A File_iostream isn't tied.
+		if(!this->good()){
+			this->setstate( std::ios_base::failbit );
+			return false;
+		}
+
+		typename sb_type::line_ending ending;
+		try{
+			ending = m_state.m_sb.getline_view(line);
+		}
+		catch(...){
+			//As the stream's own extractors do, except that they can mark the stream bad before rethrowing
+			if( this->exceptions() & std::ios_base::badbit )
+				throw;
+			this->setstate( std::ios_base::badbit );
+			return false;
+		}
+
+		if(ending == sb_type::line_ending::none){
+			this->setstate( std::ios_base::eofbit | std::ios_base::failbit );
+			return false;
+		}
+		if(ending == sb_type::line_ending::eof)
+			this->setstate( std::ios_base::eofbit );
+		return true;
+	}
 };
 
 //Seems kind of surprising that there is not an existing IO exception class
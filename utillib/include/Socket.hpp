@@ -2,6 +2,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <cstdint>
 
 #include "File.hpp"
 
@@ -9,6 +10,11 @@ namespace jab::file{
 
 class Socket : public jab::file::File{
     bool m_timeout_as_eof = false;
+	std::uint64_t m_bytes_in = 0, m_bytes_out = 0;
+	unsigned m_timeouts = 0;
+
+	//What a send or receive came to: the count, added to total, or 0 for a timeout if those are EOF, or else it throws
+	std::streamsize transferred(::ssize_t result, std::uint64_t &total, const char *msg);
 
 public:
     Socket(int domain, int type, int protocol);
@@ -40,6 +46,15 @@ public:
 
 	virtual std::streamsize read(char *data, std::streamsize len) override;
     virtual std::streamsize write(const char *data, std::streamsize len) override;
+
+	//By recvmsg() and sendmsg(), which keep to the same rules as read and write
+	virtual std::streamsize readv(const ::iovec *iov, int iovcnt) override;
+	virtual std::streamsize writev(const ::iovec *iov, int iovcnt) override;
+
+	//Totals since the socket was made
+	std::uint64_t bytes_in() const;
+	std::uint64_t bytes_out() const;
+	unsigned timeouts() const;	//Reads and writes which timed out as EOF
 };
 
 template<typename Char = char, typename Traits = std::char_traits<Char>>
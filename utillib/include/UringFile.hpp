@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "FSFile.hpp"
+#include "uring.hpp"
+
+namespace jab::file{
+
+//An FSFile whose writes go through an io_uring, for logs and journals which write often and a little at a time.
+//Writes are copied into a few buffers registered with the ring, and each buffer goes to the kernel as one write as soon
+//as it fills, while the next one fills, so a run of small writes costs a syscall per buffer rather than one apiece.
+//flush() sends off what's buffered with an fsync linked behind it, and waits for both, in one syscall.
+//
+//Where the kernel has no io_uring, or the file has no offsets to write at, as a pipe or a terminal hasn't, it's a plain
+//FSFile. If the buffers can't be registered, as under a small RLIMIT_MEMLOCK on older kernels, they're used unregistered.
+//
+//Reads and seeks wait for the writes to land, and then go the ordinary way. What's been written only reaches the file,
+//as any other descriptor sees it, on settle(), flush() or close().
+class UringFile:public FSFile{
+public:
+	static constexpr unsigned default_buffers = 4;
+	static constexpr std::size_t default_buffer_size = 64 << 10;
+
+	struct options{
+		unsigned buffers = default_buffers;
+		std::size_t buffer_size = default_buffer_size;
+		bool ring = true;		//false for a plain FSFile, as for comparison
+	};
+
+private:
+	struct Buffer{
+		::iovec iov;					//Where it is, and how much of it is filled
+		std::uint64_t offset = 0;		//In the file, of the first byte
+		bool in_flight = false;
+	};
+
+	struct State{
+		jab::io::uring ring;
+		std::unique_ptr<char[]> memory;
+		std::vector<Buffer> buffers;
+		std::size_t buffer_size = 0;
+		unsigned current = 0;			//Filling
+		bool fixed = false;				//Registered
+		std::uint64_t offset = 0;		//Where the next byte written goes
+	} m_state;
+
+	static constexpr std::uint64_t fsync_tag = ~std::uint64_t(0);
+
+	void start( const options &opts );
+	Buffer &writable();
+	bool send( std::uint8_t flags = 0 );						//The buffer being filled, if anything's in it
+	bool complete( const jab::io::uring::completion &c );	//False for an fsync cancelled by a write before it
+
+public:
+	UringFile() = default;
+	UringFile( const std::filesystem::path &path, int fl, const options &opts );
+	UringFile( const std::filesystem::path &path, int fl ): UringFile(path, fl, options{}){}
+	~UringFile();
+
+	UringFile( UringFile &&rhs );
+	UringFile &operator=( UringFile &&rhs );
+	UringFile( const UringFile & ) = delete;
+	UringFile &operator=( const UringFile & ) = delete;
+
+	//Whether writes are going through a ring, or this fell back to being a plain FSFile
+	bool ring() const;
+
+	//Sends off whatever's buffered and waits for every write to finish, without an fsync
+	void settle();
+
+	void close() override;
+	std::streamsize read( char *data, std::streamsize len ) override;
+	std::streamsize readv( const ::iovec *iov, int iovcnt ) override;
+
+	//Always take everything, though they may have to wait for a buffer to come back from the kernel
+	std::streamsize write( const char *data, std::streamsize len ) override;
+	std::streamsize writev( const ::iovec *iov, int iovcnt ) override;
+
+	std::streamsize seek( std::streamsize pos, std::ios_base::seekdir dir ) override;
+	void flush() override;
+};
+
+}
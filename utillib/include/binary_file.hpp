@@ -181,6 +181,9 @@ public:
 
 template<typename T>
 class BinaryFile_allocator{
+	template<typename U>
+	friend class BinaryFile_allocator;
+
 	BinaryFile *m_file;
 
 public:
@@ -264,11 +267,15 @@ public:
 	}
 
 	value_type *operator->() const{
-		return *m_linkp->value_ptr;
+		return &*m_linkp->value_ptr;
 	}
 
+	//A null RelPtr dereferences to itself, so the end of the list has to be checked explicitly
 	linked_list_iterator &operator++(){
-		m_linkp = &*m_linkp->next;
+		if(m_linkp->next)
+			m_linkp = &*m_linkp->next;
+		else
+			m_linkp = nullptr;
 		return *this;
 	}
 
@@ -358,8 +365,11 @@ private:
 	}
 	*/
 
+	//The offset is relative to whatever the traits say the base is, which is usually, but not always, this
 	inline pointer_type make_pointer() const{
-		auto thisc = reinterpret_cast<const volatile char *>(this);
+		using this_type = const typename traits_type::RelPtr_type;
+		auto basep = traits_type::base_ptr( *static_cast<this_type *>(this) );
+		auto thisc = reinterpret_cast<const volatile char *>(basep);
 		auto p = thisc + offset();
 		auto p2 = reinterpret_cast<cv_pointer_type>(p);
 		return const_cast<pointer_type>(p2);
@@ -476,9 +486,12 @@ public:
 		this->base_type::operator=(pobj);
 	}
 
+	//Same story as above. The base can't compute an offset before it knows what it's relative to.
 	OffsetPtr(const OffsetPtr &rhs):
-		base_type(rhs),
-		m_base_f(rhs.m_base_f){			
+		base_type(),
+		m_base_f(rhs.m_base_f){
+
+		this->base_type::operator=( rhs );
 	}		
 
 
@@ -585,6 +598,9 @@ private:
 
 	template<class This>
 	static discern_iterator_t<This *> begin_impl( This *thisp ){
+		if(!thisp->m_head->next)
+			return { nullptr };
+
 		auto tmp = thisp->m_head;
 		tmp = &*thisp->m_head->next;
 		return { tmp };
@@ -595,11 +611,16 @@ private:
 		return { nullptr };
 	}
 
-	void link_front( value_type *vp ){
-		auto lp = new( link_allocator_traits::allocate(m_link_alloc, 1) ) link_type();
+	//Allocating from a file can relocate everything in it, so the link is held by link_pointer,
+	//which is expected to survive that, and nothing is wired together until both allocations are done.
+	value_type *link_front( value_type &&v ){
+		auto lp = m_head;
+		lp = new( link_allocator_traits::allocate(m_link_alloc, 1) ) link_type();
+		auto vp = new( allocator_traits::allocate(m_alloc, 1) ) value_type( std::move(v) );
 		lp->value_ptr = vp;
 		lp->next = m_head->next;
-		m_head->next = lp;
+		m_head->next = &*lp;
+		return vp;
 	}
 
 public:
@@ -622,9 +643,7 @@ public:
 	*/
 
 	value_type &push_front(value_type &&v){
-		auto objp = new( allocator_traits::allocate(m_alloc, 1) ) value_type( std::move(v) );
-		link_front(objp);
-		return *objp;
+		return *link_front( std::move(v) );
 	}
 	
 	auto begin() const{
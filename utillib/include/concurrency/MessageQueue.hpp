@@ -2,80 +2,206 @@
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <algorithm>
+#include <optional>
+#include <chrono>
 #include "meta.hpp"
+#include "pool_stats.hpp"
 
 namespace levitator{
 namespace concurrency{
 
-template<class T>
-class MessageQueue{
-
+//A std::deque behind a mutex, optionally bounded. The default MessageQueue backend.
+//Any container with the deque's push_back, push_front, front, pop_front and size will do in place of the deque,
+//such as the AgingHeap of priority_queue.hpp.
+template<class T, class Container = std::deque<T>>
+class LockingQueue{
+public:
     using message_type = T;
-    using container_type = std::deque<message_type>;
+    using container_type = Container;
+
+private:
 	using mutex_type = std::mutex;
 
     mutex_type m_mutex;
     using lock_type = decltype( std::unique_lock(m_mutex)  );
     std::condition_variable m_cv;
+    std::condition_variable m_space_cv;		//For pushes held up at the high-water mark
     container_type m_messages;
+	std::size_t m_high_water;
+	[[no_unique_address]] stats::QueueCounters<> m_stats;
+
+	bool full() const{
+		return m_high_water && m_messages.size() >= m_high_water;
+	}
+
+	void wait_for_space(lock_type &lock){
+		m_space_cv.wait(lock, [this](){ return !full(); } );
+	}
 
     message_type pop_impl(lock_type &lock){
         m_cv.wait(lock, [this](){ return !m_messages.empty(); } );
         auto result = std::move(m_messages.front());
         m_messages.pop_front();
+		m_stats.resized( m_messages.size() );
+		if(m_high_water)
+			m_space_cv.notify_one();
         return result;
     }
 
 	class MutateGuard{
-		MessageQueue &m_queue;
+		LockingQueue &m_queue;
 		lock_type m_lock;
 
 	public:
-		MutateGuard(MessageQueue &q):
+		MutateGuard(LockingQueue &q):
 			m_queue(q),
-			m_lock(q.m_mutex){}
+			m_lock( q.m_stats.lock(q.m_mutex) ){}
 		
 		~MutateGuard(){
+			m_queue.m_stats.resized( m_queue.m_messages.size() );
 			m_queue.m_cv.notify_all();
 		}
+
+		lock_type &lock(){
+			return m_lock;
+		}
 	};
 
 public:
+	//Past high_water messages, push_back blocks and try_push_back fails. Zero for no limit.
+	LockingQueue( std::size_t high_water = 0, container_type messages = {} ):
+		m_messages( std::move(messages) ),
+		m_high_water(high_water){}
+
     void push_back( message_type &&msg){
-        MutateGuard(*this);
+        MutateGuard guard(*this);
+		wait_for_space(guard.lock());
         m_messages.push_back( std::move(msg));        
     }
 
 	void push_back( const message_type &msg){
-        MutateGuard(*this);
+        MutateGuard guard(*this);
+		wait_for_space(guard.lock());
         m_messages.push_back( msg);        
     }
+
+	//Ignores the high-water mark, for producers who would deadlock waiting for space they have to make themselves
+	void push_back_unbounded( message_type &&msg ){
+		MutateGuard guard(*this);
+		m_messages.push_back( std::move(msg) );
+	}
+
+	bool try_push_back( message_type &&msg ){
+		MutateGuard guard(*this);
+		if(full())
+			return false;
+		m_messages.push_back( std::move(msg) );
+		return true;
+	}
 		
+	//Jumps the queue, and the high-water mark, because it's meant for the urgent stuff
 	void push_front( message_type &&msg ){
-        MutateGuard(*this);
+        MutateGuard guard(*this);
         m_messages.push_front( std::move(msg));        
     }
 
 	void push_front( const message_type &msg ){
-        MutateGuard(*this);
+        MutateGuard guard(*this);
         m_messages.push_front( msg );
     }
 
+	//Goes out only after everything else, for containers which order their messages, and ignores the high-water mark.
+	//Meant for a pool's terminate tasks. Otherwise the same as push_back.
+	void push_last( message_type &&msg ){
+		MutateGuard guard(*this);
+		if constexpr( requires{ m_messages.push_last( std::move(msg) ); } )
+			m_messages.push_last( std::move(msg) );
+		else
+			m_messages.push_back( std::move(msg) );
+	}
+
+	template<typename It>
+	void push_n( It first, std::size_t n ){
+		MutateGuard guard(*this);
+		for(std::size_t i = 0; i < n; ++i, ++first){
+			if(full()){
+				//Let consumers at what's there so far
+				m_cv.notify_all();
+				wait_for_space(guard.lock());
+			}
+			m_messages.push_back( std::move(*first) );
+		}
+	}
+
     message_type pop(){
-        auto lock = std::unique_lock(m_mutex);
+        auto lock = m_stats.lock(m_mutex);
         return pop_impl(lock);
     }
 
+	//Empty if nothing came within timeout
+	template<class Rep, class Period>
+	std::optional<message_type> pop_for( const std::chrono::duration<Rep, Period> &timeout ){
+		auto lock = m_stats.lock(m_mutex);
+		if(!m_cv.wait_for(lock, timeout, [this](){ return !m_messages.empty(); } ))
+			return {};
+		return pop_impl(lock);
+	}
+
+	std::size_t size(){
+		auto lock = m_stats.lock(m_mutex);
+		return m_messages.size();
+	}
+
+	//Zeroed unless built with LEVITATOR_POOL_STATS
+	stats::queue_snapshot stats(){
+		auto lock = std::unique_lock(m_mutex);
+		return m_stats.snapshot();
+	}
+
+	//Block for at least one message, then take up to n of whatever is there
+	template<typename It>
+	std::size_t pop_n( It out, std::size_t n ){
+		auto lock = m_stats.lock(m_mutex);
+		m_cv.wait(lock, [this](){ return !m_messages.empty(); } );
+		auto count = std::min( n, m_messages.size() );
+		for(std::size_t i = 0; i < count; ++i, ++out){
+			*out = std::move(m_messages.front());
+			m_messages.pop_front();
+		}
+		m_stats.resized( m_messages.size() );
+		if(m_high_water)
+			m_space_cv.notify_all();
+		return count;
+	}
+
+	bool try_pop( message_type &result ){
+		auto lock = m_stats.lock(m_mutex);
+		if(m_messages.empty())
+			return false;
+		result = pop_impl(lock);
+		return true;
+	}
+
     //Pop only if a message is immediately available
     //Returns nullptr for no messages
     //Cannot distinguish between a null message and no messages
     message_type try_pop(){
-        auto lock = std::unique_lock(m_mutex);
+        auto lock = m_stats.lock(m_mutex);
         if(m_messages.empty())
             return nullptr;
         else
-            return m_messages.pop_impl(lock);
+            return pop_impl(lock);
     }
 };
 
+//A queue of messages for passing between threads, on top of one of the backends:
+//LockingQueue, or MPMCQueue from mpmc_ring.hpp, which is lock-free and bounded, except for what a pool's own threads push.
+template<class T, template<class> class Backend = LockingQueue>
+class MessageQueue:public Backend<T>{
+public:
+	using backend_type = Backend<T>;
+	using backend_type::backend_type;
+};
+
 }}
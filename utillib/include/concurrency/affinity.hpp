@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+
+namespace levitator::concurrency {
+
+//The CPUs this process may run on, and where they sit, as sysfs has it
+struct cpu_info{
+	int cpu;
+	int node = 0;		//NUMA node
+	int package = 0;	//Socket
+	int core = 0;		//Physical core within the package
+	int smt = 0;		//Which hardware thread of its core, 0 for the first
+};
+
+class CpuTopology{
+	std::vector<cpu_info> m_cpus;
+
+public:
+	//Only the CPUs in the calling thread's affinity mask. Without sysfs, every one of them is on node 0 in its own core.
+	CpuTopology();
+
+	//As read the first time anyone asks
+	static const CpuTopology &system();
+
+	const std::vector<cpu_info> &cpus() const{
+		return m_cpus;
+	}
+
+	std::size_t nodes() const;
+};
+
+//"0-3,8,10-11" as the kernel writes CPU and node lists. Throws std::invalid_argument for anything else.
+std::vector<int> parse_cpu_list( const std::string &list );
+
+//Where a pool puts its threads: the i'th thread started goes on the i'th CPU of the order, wrapping round.
+//Since Linux allocates a page on the node of the thread which first touches it, a pinned thread's own allocations,
+//such as a WorkStealingThreadPool thread's deque, stay on its node.
+//
+//compact fills a node, and each core on it, before moving on, to keep threads which share data close together.
+//scatter goes round the nodes, and takes every core once before doubling up on hardware threads, for the most
+//memory bandwidth and cache between them. A default-constructed Affinity leaves threads wherever the scheduler puts them.
+class Affinity{
+	std::vector<int> m_order;
+
+	Affinity( std::vector<int> &&order ):
+		m_order(std::move(order)){}
+
+public:
+	Affinity() = default;
+
+	static Affinity compact( const CpuTopology &topology = CpuTopology::system() );
+	static Affinity scatter( const CpuTopology &topology = CpuTopology::system() );
+	static Affinity cpus( std::vector<int> list );
+
+	//compact, scatter, none, or a CPU list. Throws std::invalid_argument for anything else.
+	static Affinity parse( const std::string &spec );
+
+	explicit operator bool() const{
+		return !m_order.empty();
+	}
+
+	const std::vector<int> &order() const{
+		return m_order;
+	}
+
+	//-1 for anywhere
+	int cpu_for( std::size_t index ) const{
+		return m_order.empty() ? -1 : m_order[index % m_order.size()];
+	}
+
+	//Pin the calling thread as the index'th of a pool. Placement is only advice, so this returns false
+	//rather than throwing if the CPU isn't there to have, as when a cpuset has been narrowed since.
+	bool pin( std::size_t index ) const;
+};
+
+}
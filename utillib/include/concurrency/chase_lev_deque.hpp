@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace levitator::concurrency {
+
+//Chase-Lev work-stealing deque, with the memory orderings from Lê, Pop, Cohen and Zappa Nardelli,
+//"Correct and Efficient Work-Stealing for Weak Memory Models".
+//The owning thread pushes and takes at the bottom without any locking, and other threads steal from the top.
+//It holds pointers, so that a thief can never see a half-copied element. Ownership of the pointee
+//passes to whoever pops or steals it.
+//Outgrown buffers are kept until destruction, because a thief may still be reading one.
+template<typename T>
+class ChaseLevDeque{
+public:
+	using value_type = T;
+	using pointer = T *;
+	using index_type = std::int64_t;
+
+	static constexpr std::size_t initial_capacity = 64;
+
+private:
+	class Buffer{
+		std::size_t m_mask;
+		std::unique_ptr<std::atomic<pointer>[]> m_slots;
+
+	public:
+		Buffer( std::size_t capacity ):
+			m_mask(capacity - 1),
+			m_slots( new std::atomic<pointer>[capacity] ){}
+
+		index_type capacity() const{
+			return m_mask + 1;
+		}
+
+		pointer get( index_type i ) const{
+			return m_slots[i & m_mask].load( std::memory_order_relaxed );
+		}
+
+		void put( index_type i, pointer p ){
+			m_slots[i & m_mask].store( p, std::memory_order_relaxed );
+		}
+
+		std::unique_ptr<Buffer> grow( index_type top, index_type bottom ) const{
+			auto result = std::make_unique<Buffer>( capacity() * 2 );
+			for(auto i = top; i < bottom; ++i)
+				result->put( i, get(i) );
+			return result;
+		}
+	};
+
+	//Top and bottom on their own cache lines, since thieves hammer one and the owner the other
+	alignas(64) std::atomic<index_type> m_top = 0;
+	alignas(64) std::atomic<index_type> m_bottom = 0;
+	std::atomic<Buffer *> m_buffer;
+	std::vector<std::unique_ptr<Buffer>> m_buffers;	//Owner-only
+
+public:
+	ChaseLevDeque( std::size_t capacity = initial_capacity ){
+		m_buffers.push_back( std::make_unique<Buffer>(capacity) );
+		m_buffer.store( m_buffers.back().get(), std::memory_order_relaxed );
+	}
+
+	ChaseLevDeque( const ChaseLevDeque & ) = delete;
+	ChaseLevDeque &operator=( const ChaseLevDeque & ) = delete;
+
+	~ChaseLevDeque(){
+		while(auto p = take())
+			delete p;
+	}
+
+	//Owner only
+	void push( pointer p ){
+		auto b = m_bottom.load( std::memory_order_relaxed );
+		auto t = m_top.load( std::memory_order_acquire );
+		auto buf = m_buffer.load( std::memory_order_relaxed );
+
+		if(b - t > buf->capacity() - 1){
+			m_buffers.push_back( buf->grow(t, b) );
+			buf = m_buffers.back().get();
+			m_buffer.store( buf, std::memory_order_release );
+		}
+
+		buf->put( b, p );
+		std::atomic_thread_fence( std::memory_order_release );
+		m_bottom.store( b + 1, std::memory_order_relaxed );
+	}
+
+	//Owner only. Most recently pushed first. Null when empty.
+	pointer take(){
+		auto b = m_bottom.load( std::memory_order_relaxed ) - 1;
+		auto buf = m_buffer.load( std::memory_order_relaxed );
+		m_bottom.store( b, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		auto t = m_top.load( std::memory_order_relaxed );
+
+		pointer result = nullptr;
+		if(t <= b){
+			result = buf->get(b);
+
+			//Last one, so race any thieves for it
+			if(t == b){
+				if(!m_top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ))
+					result = nullptr;
+				m_bottom.store( b + 1, std::memory_order_relaxed );
+			}
+		}
+		else
+			m_bottom.store( b + 1, std::memory_order_relaxed );
+
+		return result;
+	}
+
+	//Any thread. Least recently pushed first. Null when empty or when another thread won the race.
+	pointer steal(){
+		auto t = m_top.load( std::memory_order_acquire );
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		auto b = m_bottom.load( std::memory_order_acquire );
+
+		if(t >= b)
+			return nullptr;
+
+		auto result = m_buffer.load( std::memory_order_acquire )->get(t);
+		if(!m_top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ))
+			return nullptr;
+		return result;
+	}
+
+	//Approximate, when other threads are at it
+	bool empty() const{
+		return m_bottom.load( std::memory_order_relaxed ) <= m_top.load( std::memory_order_relaxed );
+	}
+};
+
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <optional>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+namespace levitator::concurrency {
+
+template<typename R>
+class Promise;
+
+namespace impl{
+
+//void results are stored as this, so that the rest needn't care
+struct no_value{};
+
+template<typename R>
+using stored_type = std::conditional_t< std::is_void_v<R>, no_value, R >;
+
+template<typename R>
+class FutureState{
+public:
+	using continuation_type = std::function<void ()>;
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::optional<stored_type<R>> m_value;
+	std::exception_ptr m_error;
+	bool m_ready = false;
+	continuation_type m_continuation;
+
+	//Whoever makes it ready runs the continuation, outside the lock
+	void finish( std::unique_lock<std::mutex> &lock ){
+		m_ready = true;
+		auto continuation = std::move(m_continuation);
+		lock.unlock();
+		m_cv.notify_all();
+		if(continuation)
+			continuation();
+	}
+
+public:
+	void set_value( stored_type<R> v ){
+		std::unique_lock lock(m_mutex);
+		m_value.emplace( std::move(v) );
+		finish(lock);
+	}
+
+	void set_exception( std::exception_ptr error ){
+		std::unique_lock lock(m_mutex);
+		m_error = error;
+		finish(lock);
+	}
+
+	//Runs f now if already ready, otherwise it's left for whoever makes it ready
+	void then( continuation_type &&f ){
+		std::unique_lock lock(m_mutex);
+		if(!m_ready){
+			m_continuation = std::move(f);
+			return;
+		}
+		lock.unlock();
+		f();
+	}
+
+	bool ready(){
+		std::lock_guard lock(m_mutex);
+		return m_ready;
+	}
+
+	void wait(){
+		std::unique_lock lock(m_mutex);
+		m_cv.wait( lock, [this](){ return m_ready; } );
+	}
+
+	stored_type<R> take(){
+		wait();
+		if(m_error)
+			std::rethrow_exception(m_error);
+		return std::move(*m_value);
+	}
+};
+
+}
+
+//The result of a task run elsewhere, usually on a ThreadPool by way of submit().
+//Lighter than std::future in that there's no allocator or launch policy business, and it can take a continuation.
+//Copies share the one result, which get() moves out, so only get() it once.
+//A Promise dropped without a result leaves its Future waiting forever, so whatever holds one has to see it set.
+template<typename R>
+class Future{
+	friend class Promise<R>;
+	using state_type = impl::FutureState<R>;
+
+	std::shared_ptr<state_type> m_state;
+
+	Future( const std::shared_ptr<state_type> &state ):
+		m_state(state){}
+
+public:
+	using value_type = R;
+
+	Future() = default;
+
+	bool valid() const{
+		return bool(m_state);
+	}
+
+	bool ready() const{
+		return m_state->ready();
+	}
+
+	void wait() const{
+		m_state->wait();
+	}
+
+	//Blocks until ready. Rethrows whatever the task threw.
+	R get(){
+		if constexpr( std::is_void_v<R> )
+			m_state->take();
+		else
+			return m_state->take();
+	}
+
+	//Call f(Future &) once ready. That's on the thread which makes it ready, typically a pool thread,
+	//or right here if it already is. One continuation per result.
+	template<typename F>
+	void then( F &&f ){
+		//Weak, or the state would own itself until it was ready
+		m_state->then( [weak = std::weak_ptr<state_type>(m_state), f = std::forward<F>(f)]() mutable {
+			Future self( weak.lock() );
+			f(self);
+		});
+	}
+};
+
+template<typename R>
+class Promise{
+	using state_type = impl::FutureState<R>;
+
+	std::shared_ptr<state_type> m_state = std::make_shared<state_type>();
+
+public:
+	Future<R> future() const{
+		return { m_state };
+	}
+
+	template<typename V = R>
+		requires (!std::is_void_v<V>)
+	void set_value( V &&v ){
+		m_state->set_value( std::forward<V>(v) );
+	}
+
+	void set_value() requires std::is_void_v<R> {
+		m_state->set_value( {} );
+	}
+
+	void set_exception( std::exception_ptr error ){
+		m_state->set_exception(error);
+	}
+
+	//Set the result from calling f(), or whatever it throws
+	template<typename F>
+	void set_from( F &&f ){
+		try{
+			if constexpr( std::is_void_v<R> ){
+				f();
+				set_value();
+			}
+			else
+				set_value( f() );
+		}
+		catch(...){
+			set_exception( std::current_exception() );
+		}
+	}
+};
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <new>
+#include <cstddef>
+#include <concepts>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace levitator::concurrency {
+
+//A move-only task which can hold any callable, so that one ThreadPool can run several kinds of task.
+//Unlike std::function, a callable of up to Capacity bytes is kept inline instead of on the heap,
+//so queueing one costs no allocation. Anything bigger, or which might throw when moved, still goes on the heap.
+//
+//Callables returning void count as returning 0. As with any pool task, returning non-zero ends the thread which ran it,
+//and a default-constructed, or moved-from, InlineTask is the terminate task.
+template<std::size_t Capacity = 64>
+class InlineTask{
+	struct Ops{
+		int (*invoke)( void * );
+		void (*move)( void *from, void *to );	//Leaves from destroyed
+		void (*destroy)( void * );
+	};
+
+	template<typename F>
+	static constexpr bool fits = sizeof(F) <= Capacity && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<F>;
+
+	template<typename F>
+	static int call( F &f ){
+		if constexpr( std::is_void_v<std::invoke_result_t<F &>> ){
+			f();
+			return 0;
+		}
+		else
+			return int( f() );
+	}
+
+	template<typename F>
+	static F &inline_ref( void *p ){
+		return *std::launder( static_cast<F *>(p) );
+	}
+
+	template<typename F>
+	static F *&heap_ref( void *p ){
+		return *std::launder( static_cast<F **>(p) );
+	}
+
+	template<typename F>
+	static constexpr Ops inline_ops = {
+		[](void *p){ return call( inline_ref<F>(p) ); },
+		[](void *from, void *to){
+			new(to) F( std::move( inline_ref<F>(from) ) );
+			inline_ref<F>(from).~F();
+		},
+		[](void *p){ inline_ref<F>(p).~F(); }
+	};
+
+	template<typename F>
+	static constexpr Ops heap_ops = {
+		[](void *p){ return call( *heap_ref<F>(p) ); },
+		[](void *from, void *to){ new(to) F *( heap_ref<F>(from) ); },
+		[](void *p){ delete heap_ref<F>(p); }
+	};
+
+	alignas(std::max_align_t) unsigned char m_storage[Capacity];
+	const Ops *m_ops = nullptr;
+
+public:
+	static constexpr std::size_t capacity = Capacity;
+
+	//Whether a callable of type F is kept inline
+	template<typename F>
+	static constexpr bool stored_inline = fits< std::decay_t<F> >;
+
+	InlineTask() = default;
+
+	template<typename F>
+		requires (!std::same_as< std::decay_t<F>, InlineTask >) && std::invocable< std::decay_t<F> & >
+	InlineTask( F &&f ){
+		using callable_type = std::decay_t<F>;
+		if constexpr( fits<callable_type> ){
+			new(m_storage) callable_type( std::forward<F>(f) );
+			m_ops = &inline_ops<callable_type>;
+		}
+		else{
+			new(m_storage) callable_type *( new callable_type( std::forward<F>(f) ) );
+			m_ops = &heap_ops<callable_type>;
+		}
+	}
+
+	InlineTask( InlineTask &&other ) noexcept:
+		m_ops(other.m_ops){
+		if(m_ops){
+			m_ops->move( other.m_storage, m_storage );
+			other.m_ops = nullptr;
+		}
+	}
+
+	InlineTask &operator=( InlineTask &&other ) noexcept{
+		if(this != &other){
+			reset();
+			if(other.m_ops){
+				other.m_ops->move( other.m_storage, m_storage );
+				m_ops = other.m_ops;
+				other.m_ops = nullptr;
+			}
+		}
+		return *this;
+	}
+
+	InlineTask( const InlineTask & ) = delete;
+	InlineTask &operator=( const InlineTask & ) = delete;
+
+	~InlineTask(){
+		reset();
+	}
+
+	void reset(){
+		if(m_ops){
+			m_ops->destroy(m_storage);
+			m_ops = nullptr;
+		}
+	}
+
+	explicit operator bool() const{
+		return m_ops;
+	}
+
+	int operator()(){
+		if(!m_ops)
+			return -1;
+		return m_ops->invoke(m_storage);
+	}
+};
+
+}
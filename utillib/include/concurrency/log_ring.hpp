@@ -0,0 +1,100 @@
+#pragma once
+#include <sys/uio.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include "mpmc_ring.hpp"
+
+namespace levitator::concurrency {
+
+//One piece of a log message, as it sits in a LogRing. Copies only the text in use.
+//Messages longer than a record go as a run of them from the one producer, all but the last marked more.
+struct log_record{
+	static constexpr std::size_t text_size = 240;
+
+	std::uint32_t producer = 0;
+	int fd = -1;		//-1 tells the writer thread to stop
+	std::uint16_t length = 0;
+	bool more = false;
+	char text[text_size];
+
+	log_record() = default;
+
+	log_record( std::uint32_t producer_id, int file, const char *p, std::size_t n, bool continued ):
+		producer(producer_id),
+		fd(file),
+		length( std::uint16_t(n) ),
+		more(continued){
+		std::memcpy( text, p, n );
+	}
+
+	log_record( const log_record &rhs ){
+		*this = rhs;
+	}
+
+	log_record &operator=( const log_record &rhs ){
+		producer = rhs.producer;
+		length = rhs.length;
+		fd = rhs.fd;
+		more = rhs.more;
+		std::memcpy( text, rhs.text, length );
+		return *this;
+	}
+};
+
+//Log output for many threads at once, written out by a thread of its own.
+//Writers copy their text into an MPMCRing of preallocated records, which takes no lock and no allocation,
+//and only waits if the ring is full. The writer thread takes records off in batches and hands each run
+//bound for the same file descriptor to a single writev().
+//
+//Writes to standard output or error flush C stdio's buffer first, so that text written through std::cout
+//and the like doesn't come out of order with the ring's, so long as that was itself written before.
+class LogRing{
+public:
+	static constexpr std::size_t default_capacity = 4096;	//Records
+	static constexpr std::size_t batch_size = 256;
+
+private:
+	MPMCRing<log_record> m_ring;
+	std::atomic<std::uint64_t> m_pushed = 0;	//Records
+	std::atomic<std::uint64_t> m_written = 0;
+
+	//For flush(). The writer thread only takes the lock when someone is waiting.
+	std::mutex m_flush_mutex;
+	std::condition_variable m_flush_cv;
+	std::atomic<int> m_flushers = 0;
+
+	//Only touched by the writer thread
+	std::vector<log_record> m_batch;
+	std::unordered_map<std::uint32_t, std::string> m_partial;	//Messages with more to come, by producer
+	std::vector<std::string> m_joined;
+	std::vector<iovec> m_iov;
+
+	std::thread m_thread;
+
+	void thread_proc();
+	void write_batch( std::size_t count );
+
+public:
+	LogRing( std::size_t capacity = default_capacity );
+	~LogRing();
+
+	LogRing( const LogRing & ) = delete;
+	LogRing &operator=( const LogRing & ) = delete;
+
+	//Queue text for fd, in one piece however long it is
+	void write( int fd, std::string_view text );
+
+	//Wait until everything queued so far, by any thread, has been written
+	void flush();
+};
+
+}
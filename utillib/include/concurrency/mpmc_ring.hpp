@@ -0,0 +1,453 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <deque>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+
+namespace levitator::concurrency {
+
+//Bounded lock-free multi-producer multi-consumer ring, after Dmitry Vyukov's.
+//Each cell carries a sequence number which says whose turn it is: a producer may fill cell i
+//on lap n when its sequence is i + n * capacity, and a consumer may empty it when the sequence is one more than that.
+//So producers only contend with each other on the enqueue index, and consumers on the dequeue index.
+//
+//The blocking calls only sleep, on a futex by way of std::atomic::wait, when the ring is empty or full.
+template<typename T>
+class MPMCRing{
+public:
+	using value_type = T;
+	using index_type = std::size_t;
+
+	static constexpr std::size_t default_capacity = 1024;
+
+private:
+	static constexpr std::size_t line_size = 64;
+
+	struct Cell{
+		std::atomic<index_type> sequence;
+		alignas(value_type) unsigned char storage[sizeof(value_type)];
+
+		value_type &value(){
+			return *std::launder( reinterpret_cast<value_type *>(storage) );
+		}
+	};
+
+	std::size_t m_mask;
+	std::unique_ptr<Cell[]> m_cells;
+	alignas(line_size) std::atomic<index_type> m_enqueue = 0;
+	alignas(line_size) std::atomic<index_type> m_dequeue = 0;
+
+	//Bumped after a push or pop respectively, but only when someone may be sleeping for one,
+	//so that a ring which isn't running empty or full costs nothing more than the Vyukov ring itself.
+	//The sleepers flag is raised by whoever is about to sleep and lowered by whoever wakes them,
+	//so a burst of pushes to an empty ring only wakes the consumers once.
+	alignas(line_size) std::atomic<std::uint32_t> m_pushes = 0;
+	std::atomic<bool> m_pop_sleepers = false;
+	alignas(line_size) std::atomic<std::uint32_t> m_pops = 0;
+	std::atomic<bool> m_push_sleepers = false;
+
+	static std::size_t round_capacity( std::size_t n ){
+		std::size_t result = 2;
+		while(result < n)
+			result <<= 1;
+		return result;
+	}
+
+	//The fence here and the one in wait_for() make sure that either the waiter sees what was just done,
+	//or this sees the waiter
+	static void signal( std::atomic<std::uint32_t> &counter, std::atomic<bool> &sleepers ){
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if(sleepers.load( std::memory_order_relaxed ) && sleepers.exchange(false)){
+			counter.fetch_add(1);
+			counter.notify_all();
+		}
+	}
+
+	void pushed(){
+		signal( m_pushes, m_pop_sleepers );
+	}
+
+	void popped(){
+		signal( m_pops, m_push_sleepers );
+	}
+
+	//Claim the next cell to fill. Null if the ring is full.
+	Cell *claim_push( index_type &pos ){
+		pos = m_enqueue.load( std::memory_order_relaxed );
+		while(true){
+			auto &cell = m_cells[pos & m_mask];
+			auto seq = cell.sequence.load( std::memory_order_acquire );
+			auto dif = std::intptr_t(seq) - std::intptr_t(pos);
+
+			if(dif == 0){
+				if(m_enqueue.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ))
+					return &cell;
+			}
+			else if(dif < 0)
+				return nullptr;
+			else
+				pos = m_enqueue.load( std::memory_order_relaxed );
+		}
+	}
+
+	//Claim the next cell to empty. Null if the ring is empty.
+	Cell *claim_pop( index_type &pos ){
+		pos = m_dequeue.load( std::memory_order_relaxed );
+		while(true){
+			auto &cell = m_cells[pos & m_mask];
+			auto seq = cell.sequence.load( std::memory_order_acquire );
+			auto dif = std::intptr_t(seq) - std::intptr_t(pos + 1);
+
+			if(dif == 0){
+				if(m_dequeue.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ))
+					return &cell;
+			}
+			else if(dif < 0)
+				return nullptr;
+			else
+				pos = m_dequeue.load( std::memory_order_relaxed );
+		}
+	}
+
+	void fill_cell( Cell &cell, index_type pos, value_type &&v ){
+		new(cell.storage) value_type( std::move(v) );
+		cell.sequence.store( pos + 1, std::memory_order_release );
+	}
+
+	value_type drain_cell( Cell &cell, index_type pos ){
+		auto &v = cell.value();
+		value_type result( std::move(v) );
+		v.~value_type();
+		cell.sequence.store( pos + m_mask + 1, std::memory_order_release );
+		return result;
+	}
+
+	//A batch claims a run of cells at once. Cells in the run may still be in the middle of being emptied
+	//or filled by whoever had them on the previous turn, so wait those out. It's only ever a few instructions,
+	//unless that thread got preempted in the middle of them.
+	static void await_turn( Cell &cell, index_type seq ){
+		while(cell.sequence.load( std::memory_order_acquire ) != seq)
+			std::this_thread::yield();
+	}
+
+	//Sleep until counter moves on from what it was before ready() was found false
+	template<typename F>
+	static void wait_for( std::atomic<std::uint32_t> &counter, std::atomic<bool> &sleepers, F &&ready ){
+		auto seen = counter.load();
+		sleepers.store(true);
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+
+		//Ready but not yet poppable or pushable, means a cell is mid-way through changing hands
+		if(ready())
+			std::this_thread::yield();
+		else
+			counter.wait(seen);
+	}
+
+public:
+	MPMCRing( std::size_t capacity = default_capacity ):
+		m_mask( round_capacity(capacity) - 1 ),
+		m_cells( new Cell[m_mask + 1] ){
+
+		for(index_type i = 0; i <= m_mask; ++i)
+			m_cells[i].sequence.store( i, std::memory_order_relaxed );
+	}
+
+	MPMCRing( const MPMCRing & ) = delete;
+	MPMCRing &operator=( const MPMCRing & ) = delete;
+
+	~MPMCRing(){
+		value_type v;
+		while(try_pop(v))
+			;
+	}
+
+	std::size_t capacity() const{
+		return m_mask + 1;
+	}
+
+	//Approximate, when other threads are at it
+	std::size_t size() const{
+		auto enq = m_enqueue.load( std::memory_order_relaxed ), deq = m_dequeue.load( std::memory_order_relaxed );
+		return enq > deq ? enq - deq : 0;
+	}
+
+	bool try_push( value_type &&v ){
+		index_type pos;
+		auto cellp = claim_push(pos);
+		if(!cellp)
+			return false;
+
+		fill_cell( *cellp, pos, std::move(v) );
+		pushed();
+		return true;
+	}
+
+	bool try_push( const value_type &v ){
+		return try_push( value_type(v) );
+	}
+
+	bool try_pop( value_type &result ){
+		index_type pos;
+		auto cellp = claim_pop(pos);
+		if(!cellp)
+			return false;
+
+		result = drain_cell( *cellp, pos );
+		popped();
+		return true;
+	}
+
+	//Blocks while full
+	void push( value_type &&v ){
+		while(!try_push( std::move(v) ))
+			wait_for( m_pops, m_push_sleepers, [this](){ return size() < capacity(); } );
+	}
+
+	void push( const value_type &v ){
+		push( value_type(v) );
+	}
+
+	//Blocks while empty
+	value_type pop(){
+		value_type result;
+		while(!try_pop(result))
+			wait_for( m_pushes, m_pop_sleepers, [this](){ return size() > 0; } );
+		return result;
+	}
+
+	//Push all n, claiming as many cells at a time as there is room for. Blocks while full.
+	template<typename It>
+	void push_n( It first, std::size_t n ){
+		while(n){
+			auto pos = m_enqueue.load( std::memory_order_relaxed );
+			auto room = capacity() - std::min( capacity(), pos - std::min(pos, m_dequeue.load( std::memory_order_acquire )) );
+			if(!room){
+				wait_for( m_pops, m_push_sleepers, [this](){ return size() < capacity(); } );
+				continue;
+			}
+
+			auto count = std::min(n, room);
+			if(!m_enqueue.compare_exchange_weak( pos, pos + count, std::memory_order_relaxed ))
+				continue;
+
+			for(std::size_t i = 0; i < count; ++i, ++first){
+				auto &cell = m_cells[(pos + i) & m_mask];
+				await_turn( cell, pos + i );
+				fill_cell( cell, pos + i, value_type( std::move(*first) ) );
+			}
+			n -= count;
+			pushed();
+		}
+	}
+
+	//Take up to n of whatever is there without blocking
+	template<typename It>
+	std::size_t try_pop_n( It out, std::size_t n ){
+		while(n){
+			auto pos = m_dequeue.load( std::memory_order_relaxed );
+			auto enq = m_enqueue.load( std::memory_order_acquire );
+			auto available = enq > pos ? enq - pos : 0;
+			if(!available)
+				return 0;
+
+			auto count = std::min(n, available);
+			if(!m_dequeue.compare_exchange_weak( pos, pos + count, std::memory_order_relaxed ))
+				continue;
+
+			for(std::size_t i = 0; i < count; ++i, ++out){
+				auto &cell = m_cells[(pos + i) & m_mask];
+				await_turn( cell, pos + i + 1 );
+				*out = drain_cell( cell, pos + i );
+			}
+			popped();
+			return count;
+		}
+		return 0;
+	}
+
+	//Block for at least one, then take up to n of whatever is there
+	template<typename It>
+	std::size_t pop_n( It out, std::size_t n ){
+		if(!n)
+			return 0;
+
+		std::size_t result;
+		while(!(result = try_pop_n(out, n)))
+			wait_for( m_pushes, m_pop_sleepers, [this](){ return size() > 0; } );
+		return result;
+	}
+
+	//For layering other things which can wake consumers on top of the ring, as MPMCQueue does.
+	//Sleeps until there's been a push or a notify_push(), unless ready() already says there's no need.
+	template<typename F>
+	void wait_push( F &&ready ){
+		wait_for( m_pushes, m_pop_sleepers, std::forward<F>(ready) );
+	}
+
+	void notify_push(){
+		pushed();
+	}
+};
+
+//MessageQueue backend on an MPMCRing.
+//The ring only goes one way, so push_front goes into a small locked queue that pop checks first.
+//That's only meant for the odd urgent message, like the terminate tasks of ThreadPool::shutdown_now().
+//
+//push_back_unbounded spills into another locked queue when the ring is full, so that a pool's own threads, which are
+//what empties the ring, never wait on it. Each pop from the ring moves what it can of the spill back in, in order.
+template<typename T>
+class MPMCQueue{
+public:
+	using message_type = T;
+
+private:
+	MPMCRing<message_type> m_ring;
+	std::mutex m_front_mutex;
+	std::deque<message_type> m_front;
+	std::atomic<std::size_t> m_front_count = 0;
+	std::mutex m_spill_mutex;
+	std::deque<message_type> m_spill;
+	std::atomic<std::size_t> m_spill_count = 0;
+
+	static bool try_pop_locked( std::mutex &mutex, std::deque<message_type> &queue, std::atomic<std::size_t> &count, message_type &result ){
+		if(!count.load())
+			return false;
+
+		std::lock_guard lock(mutex);
+		if(queue.empty())
+			return false;
+
+		result = std::move(queue.front());
+		queue.pop_front();
+		--count;
+		return true;
+	}
+
+	bool try_pop_front( message_type &result ){
+		return try_pop_locked( m_front_mutex, m_front, m_front_count, result );
+	}
+
+	//Only once the ring's empty, since the spill's messages came after everything in it
+	bool try_pop_spill( message_type &result ){
+		return try_pop_locked( m_spill_mutex, m_spill, m_spill_count, result );
+	}
+
+	//After a pop from the ring has made room
+	void refill(){
+		if(!m_spill_count.load())
+			return;
+
+		std::lock_guard lock(m_spill_mutex);
+		while(!m_spill.empty() && m_ring.try_push( std::move(m_spill.front()) )){
+			m_spill.pop_front();
+			--m_spill_count;
+		}
+	}
+
+	bool ready(){
+		return m_front_count.load() || m_spill_count.load() || m_ring.size();
+	}
+
+public:
+	MPMCQueue( std::size_t capacity = MPMCRing<message_type>::default_capacity ):
+		m_ring(capacity){}
+
+	std::size_t capacity() const{
+		return m_ring.capacity();
+	}
+
+	//Blocks while full
+	void push_back( message_type &&msg ){
+		m_ring.push( std::move(msg) );
+	}
+
+	void push_back( const message_type &msg ){
+		m_ring.push( msg );
+	}
+
+	//Never blocks. Behind whatever's spilled already, so that what one thread pushes stays in order.
+	void push_back_unbounded( message_type &&msg ){
+		if(!m_spill_count.load() && m_ring.try_push( std::move(msg) ))
+			return;
+
+		{
+			std::lock_guard lock(m_spill_mutex);
+			m_spill.push_back( std::move(msg) );
+			++m_spill_count;
+		}
+		m_ring.notify_push();
+	}
+
+	bool try_push_back( message_type &&msg ){
+		return m_ring.try_push( std::move(msg) );
+	}
+
+	void push_front( message_type &&msg ){
+		{
+			std::lock_guard lock(m_front_mutex);
+			m_front.push_front( std::move(msg) );
+			++m_front_count;
+		}
+
+		//Wake any sleeping consumers by way of the ring. They'll look at the front queue first.
+		m_ring.notify_push();
+	}
+
+	void push_front( const message_type &msg ){
+		push_front( message_type(msg) );
+	}
+
+	//The ring is already in order, so this is only push_back
+	void push_last( message_type &&msg ){
+		m_ring.push( std::move(msg) );
+	}
+
+	template<typename It>
+	void push_n( It first, std::size_t n ){
+		m_ring.push_n( first, n );
+	}
+
+	message_type pop(){
+		message_type result;
+		while(!try_pop(result))
+			m_ring.wait_push( [this](){ return ready(); } );
+		return result;
+	}
+
+	template<typename It>
+	std::size_t pop_n( It out, std::size_t n ){
+		if(!n)
+			return 0;
+
+		while(true){
+			if(try_pop_front(*out))
+				return 1;
+			if(auto result = m_ring.try_pop_n(out, n)){
+				refill();
+				return result;
+			}
+			if(try_pop_spill(*out))
+				return 1;
+			m_ring.wait_push( [this](){ return ready(); } );
+		}
+	}
+
+	bool try_pop( message_type &result ){
+		if(try_pop_front(result))
+			return true;
+		if(m_ring.try_pop(result)){
+			refill();
+			return true;
+		}
+		return try_pop_spill(result);
+	}
+};
+
+}
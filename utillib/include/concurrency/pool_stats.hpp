@@ -0,0 +1,305 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <iosfwd>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Counters and histograms for ThreadPool, WorkStealingThreadPool and LockingQueue.
+//Off unless built with -DLEVITATOR_POOL_STATS=1, in which case each queue operation and each task costs a couple of clock reads
+//and relaxed atomic adds. Off, the counters are empty classes whose members do nothing, so it all compiles away,
+//and stats() snapshots come back zeroed with enabled false.
+#ifndef LEVITATOR_POOL_STATS
+#define LEVITATOR_POOL_STATS 0
+#endif
+
+namespace levitator::concurrency {
+
+inline constexpr bool pool_stats_enabled = LEVITATOR_POOL_STATS;
+
+namespace stats{
+
+using clock_type = std::chrono::steady_clock;
+using nanoseconds = std::uint64_t;
+
+inline nanoseconds now(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( clock_type::now().time_since_epoch() ).count();
+}
+
+struct histogram_snapshot{
+	//Bucket 0 counts zeroes, bucket b values from 2^(b-1) up to 2^b - 1
+	static constexpr std::size_t buckets = 65;
+
+	std::array<std::uint64_t, buckets> counts{};
+	std::uint64_t count = 0, sum = 0, max = 0;
+
+	double mean() const{
+		return count ? double(sum) / count : 0;
+	}
+
+	//The top of the bucket holding the p'th fraction of the values, so within a factor of two above the real one
+	std::uint64_t percentile( double p ) const;
+};
+
+//Log2-bucketed, so recording is a few relaxed adds and no allocation
+class Histogram{
+	std::array<std::atomic<std::uint64_t>, histogram_snapshot::buckets> m_counts{};
+	std::atomic<std::uint64_t> m_count = 0, m_sum = 0, m_max = 0;
+
+public:
+	void record( std::uint64_t value ){
+		m_counts[ std::bit_width(value) ].fetch_add( 1, std::memory_order_relaxed );
+		m_count.fetch_add( 1, std::memory_order_relaxed );
+		m_sum.fetch_add( value, std::memory_order_relaxed );
+		auto max = m_max.load( std::memory_order_relaxed );
+		while(value > max && !m_max.compare_exchange_weak( max, value, std::memory_order_relaxed ));
+	}
+
+	histogram_snapshot snapshot() const{
+		histogram_snapshot result;
+		for(std::size_t i = 0; i < result.counts.size(); ++i)
+			result.counts[i] = m_counts[i].load( std::memory_order_relaxed );
+		result.count = m_count.load( std::memory_order_relaxed );
+		result.sum = m_sum.load( std::memory_order_relaxed );
+		result.max = m_max.load( std::memory_order_relaxed );
+		return result;
+	}
+};
+
+struct queue_snapshot{
+	std::uint64_t pushed = 0, popped = 0;
+	std::size_t depth = 0, max_depth = 0;
+	double depth_ns = 0;				//Depth integrated over time
+	histogram_snapshot depth_at_push;	//Depth just after each push, which is what the queue looks like over time to whoever feeds it
+	histogram_snapshot lock_wait;		//Nanoseconds spent waiting for the queue's mutex, zero when it was free
+
+	//Mean time from push to pop, by Little's law: the time-averaged depth over the throughput.
+	//Exact over a stretch which starts and ends empty, whatever order the queue keeps, which a per-task stamp would not be for a heap.
+	double mean_wait_ns() const{
+		return popped ? depth_ns / popped : 0;
+	}
+};
+
+struct worker_snapshot{
+	std::thread::id id;
+	nanoseconds idle = 0, busy = 0;
+	std::uint64_t tasks = 0;
+};
+
+struct pool_snapshot{
+	bool enabled = pool_stats_enabled;
+	std::size_t threads = 0;
+	std::uint64_t steals = 0, failed_steals = 0;	//Work-stealing pools only
+	histogram_snapshot run_time, idle_time;		//Nanoseconds per task run, and per wait for one
+	queue_snapshot queue;						//For pools whose queue keeps stats
+	std::vector<worker_snapshot> workers;			//The threads running now
+	worker_snapshot retired;					//Totals for threads which have finished
+};
+
+std::ostream &operator<<( std::ostream &os, const histogram_snapshot &h );
+std::ostream &operator<<( std::ostream &os, const queue_snapshot &q );
+std::ostream &operator<<( std::ostream &os, const pool_snapshot &p );
+
+template<bool Enabled = pool_stats_enabled>
+class QueueCounters;
+
+//Everything but the lock wait is only touched with the queue's mutex held
+template<>
+class QueueCounters<true>{
+	Histogram m_lock_wait, m_depth_at_push;
+	std::uint64_t m_pushed = 0, m_popped = 0;
+	std::size_t m_depth = 0, m_max_depth = 0;
+	double m_depth_ns = 0;
+	nanoseconds m_changed = now();
+
+	void integrate( nanoseconds t ){
+		m_depth_ns += double(m_depth) * (t - m_changed);
+		m_changed = t;
+	}
+
+public:
+	//Only reads the clock when it has to wait
+	template<class Mutex>
+	std::unique_lock<Mutex> lock( Mutex &mutex ){
+		std::unique_lock result( mutex, std::try_to_lock );
+		if(result.owns_lock())
+			m_lock_wait.record(0);
+		else{
+			auto start = now();
+			result.lock();
+			m_lock_wait.record( now() - start );
+		}
+		return result;
+	}
+
+	//Whenever the depth might have changed
+	void resized( std::size_t depth ){
+		if(depth == m_depth)
+			return;
+
+		integrate( now() );
+		if(depth > m_depth){
+			m_pushed += depth - m_depth;
+			m_depth_at_push.record(depth);
+		}
+		else
+			m_popped += m_depth - depth;
+
+		m_depth = depth;
+		if(depth > m_max_depth)
+			m_max_depth = depth;
+	}
+
+	queue_snapshot snapshot(){
+		integrate( now() );
+		return { m_pushed, m_popped, m_depth, m_max_depth, m_depth_ns, m_depth_at_push.snapshot(), m_lock_wait.snapshot() };
+	}
+};
+
+template<>
+class QueueCounters<false>{
+public:
+	template<class Mutex>
+	std::unique_lock<Mutex> lock( Mutex &mutex ){
+		return std::unique_lock( mutex );
+	}
+
+	void resized( std::size_t ){}
+
+	queue_snapshot snapshot(){
+		return {};
+	}
+};
+
+template<bool Enabled = pool_stats_enabled>
+class PoolCounters;
+
+template<bool Enabled = pool_stats_enabled>
+class WorkerCounters;
+
+//One per pool thread, which alone writes to it. Timestamps go in and out so that each task costs two clock reads in all.
+template<>
+class WorkerCounters<true>{
+	friend class PoolCounters<true>;
+
+	PoolCounters<true> &m_pool;
+	std::thread::id m_id = std::this_thread::get_id();
+	std::atomic<nanoseconds> m_idle = 0, m_busy = 0;
+	std::atomic<std::uint64_t> m_tasks = 0;
+
+public:
+	WorkerCounters( PoolCounters<true> &pool ):
+		m_pool(pool){}
+
+	nanoseconds mark() const{
+		return now();
+	}
+
+	//The thread waited for a task from since until now. Returns now, for ran().
+	inline nanoseconds idled( nanoseconds since );
+
+	//The thread ran a task from since until now. Returns now, for idled().
+	inline nanoseconds ran( nanoseconds since );
+};
+
+template<>
+class WorkerCounters<false>{
+public:
+	nanoseconds mark() const{
+		return 0;
+	}
+
+	nanoseconds idled( nanoseconds ){
+		return 0;
+	}
+
+	nanoseconds ran( nanoseconds ){
+		return 0;
+	}
+};
+
+template<>
+class PoolCounters<true>{
+	friend class WorkerCounters<true>;
+
+	Histogram m_run_time, m_idle_time;
+	std::atomic<std::uint64_t> m_steals = 0, m_failed_steals = 0;
+
+	std::mutex m_mutex;
+	std::list<WorkerCounters<true>> m_workers;
+	worker_snapshot m_retired;
+
+public:
+	//For each thread as it starts. The result lasts until it's passed to leave().
+	WorkerCounters<true> &join(){
+		std::lock_guard lock(m_mutex);
+		return m_workers.emplace_back(*this);
+	}
+
+	void leave( WorkerCounters<true> &worker ){
+		std::lock_guard lock(m_mutex);
+		m_retired.idle += worker.m_idle.load();
+		m_retired.busy += worker.m_busy.load();
+		m_retired.tasks += worker.m_tasks.load();
+		m_workers.remove_if( [&](const auto &w){ return &w == &worker; } );
+	}
+
+	void stole( bool success ){
+		(success ? m_steals : m_failed_steals).fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	pool_snapshot snapshot(){
+		pool_snapshot result;
+		result.steals = m_steals.load( std::memory_order_relaxed );
+		result.failed_steals = m_failed_steals.load( std::memory_order_relaxed );
+		result.run_time = m_run_time.snapshot();
+		result.idle_time = m_idle_time.snapshot();
+
+		std::lock_guard lock(m_mutex);
+		for(auto &w : m_workers)
+			result.workers.push_back( { w.m_id, w.m_idle.load( std::memory_order_relaxed ), w.m_busy.load( std::memory_order_relaxed ), w.m_tasks.load( std::memory_order_relaxed ) } );
+		result.retired = m_retired;
+		return result;
+	}
+};
+
+template<>
+class PoolCounters<false>{
+public:
+	WorkerCounters<false> join(){
+		return {};
+	}
+
+	void leave( WorkerCounters<false> & ){}
+
+	void stole( bool ){}
+
+	pool_snapshot snapshot(){
+		return {};
+	}
+};
+
+nanoseconds WorkerCounters<true>::idled( nanoseconds since ){
+	auto t = now();
+	m_idle.fetch_add( t - since, std::memory_order_relaxed );
+	m_pool.m_idle_time.record( t - since );
+	return t;
+}
+
+nanoseconds WorkerCounters<true>::ran( nanoseconds since ){
+	auto t = now();
+	m_busy.fetch_add( t - since, std::memory_order_relaxed );
+	m_tasks.fetch_add( 1, std::memory_order_relaxed );
+	m_pool.m_run_time.record( t - since );
+	return t;
+}
+
+}
+
+}
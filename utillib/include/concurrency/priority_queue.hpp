@@ -0,0 +1,218 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <optional>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "MessageQueue.hpp"
+
+namespace levitator::concurrency {
+
+//A d-ary heap of messages with the deque-like interface LockingQueue wants of its container.
+//As with std::priority_queue, the greatest by Compare comes out first, and equals come out in the order they went in.
+//
+//To keep the low priority ones from starving, anything which has sat through max_age pops goes next regardless,
+//oldest first. So under a steady stream of urgent work it degrades towards FIFO rather than never getting round to the rest.
+//
+//push_front() messages bypass the ordering altogether and come out ahead of everything, as with a deque.
+//push_last() ones come out only once there is nothing else, which is what a pool's terminate tasks want.
+template<typename T, class Compare = std::less<T>, std::size_t Arity = 4>
+class AgingHeap{
+public:
+	using value_type = T;
+	using compare_type = Compare;
+
+	static constexpr std::uint64_t default_max_age = 4096;
+
+private:
+	static_assert(Arity >= 2);
+
+	struct Entry{
+		std::optional<value_type> value;
+		std::size_t heap_pos = 0;
+		std::uint64_t ticket = 0;	//Push order, which also tells a reused slot from the one an arrival refers to
+		std::uint64_t born = 0;		//Pop count when pushed
+	};
+
+	struct Arrival{
+		std::size_t slot;
+		std::uint64_t ticket;
+	};
+
+	compare_type m_compare;
+	std::uint64_t m_max_age;
+	std::vector<Entry> m_entries;
+	std::vector<std::size_t> m_free;		//Empty slots of m_entries
+	std::vector<std::size_t> m_heap;		//Slots of m_entries, in heap order
+	std::deque<Arrival> m_arrivals;			//Oldest first. Entries already popped are only cleared away once they reach the front.
+	std::deque<value_type> m_first, m_last;
+	std::uint64_t m_pushes = 0, m_pops = 0;
+
+	//Whether slot a should come out before slot b
+	bool before( std::size_t a, std::size_t b ) const{
+		auto &ea = m_entries[a], &eb = m_entries[b];
+		if(m_compare( *eb.value, *ea.value ))
+			return true;
+		if(m_compare( *ea.value, *eb.value ))
+			return false;
+		return ea.ticket < eb.ticket;
+	}
+
+	void place( std::size_t pos, std::size_t slot ){
+		m_heap[pos] = slot;
+		m_entries[slot].heap_pos = pos;
+	}
+
+	void sift_up( std::size_t pos ){
+		auto slot = m_heap[pos];
+		while(pos){
+			auto parent = (pos - 1) / Arity;
+			if(!before( slot, m_heap[parent] ))
+				break;
+			place( pos, m_heap[parent] );
+			pos = parent;
+		}
+		place( pos, slot );
+	}
+
+	void sift_down( std::size_t pos ){
+		auto slot = m_heap[pos];
+		const auto count = m_heap.size();
+		while(true){
+			auto child = pos * Arity + 1;
+			if(child >= count)
+				break;
+
+			auto best = child;
+			for(auto end = std::min( child + Arity, count ); ++child < end;){
+				if(before( m_heap[child], m_heap[best] ))
+					best = child;
+			}
+
+			if(!before( m_heap[best], slot ))
+				break;
+			place( pos, m_heap[best] );
+			pos = best;
+		}
+		place( pos, slot );
+	}
+
+	void remove_at( std::size_t pos ){
+		auto last = m_heap.back();
+		m_heap.pop_back();
+		if(pos == m_heap.size())
+			return;
+
+		place( pos, last );
+		if(pos && before( last, m_heap[(pos - 1) / Arity] ))
+			sift_up(pos);
+		else
+			sift_down(pos);
+	}
+
+	bool live( const Arrival &a ) const{
+		auto &e = m_entries[a.slot];
+		return e.value && e.ticket == a.ticket;
+	}
+
+	//The slot the next pop_front() takes from the heap
+	std::size_t next_slot(){
+		while(!m_arrivals.empty() && !live( m_arrivals.front() ))
+			m_arrivals.pop_front();
+
+		if(!m_arrivals.empty()){
+			auto slot = m_arrivals.front().slot;
+			if(m_pops - m_entries[slot].born >= m_max_age)
+				return slot;
+		}
+		return m_heap.front();
+	}
+
+public:
+	AgingHeap( const compare_type &compare = {}, std::uint64_t max_age = default_max_age ):
+		m_compare(compare),
+		m_max_age(max_age){}
+
+	std::size_t size() const{
+		return m_first.size() + m_heap.size() + m_last.size();
+	}
+
+	bool empty() const{
+		return !size();
+	}
+
+	void push_back( value_type &&v ){
+		std::size_t slot;
+		if(m_free.empty()){
+			slot = m_entries.size();
+			m_entries.emplace_back();
+		}
+		else{
+			slot = m_free.back();
+			m_free.pop_back();
+		}
+
+		auto &e = m_entries[slot];
+		e.value.emplace( std::move(v) );
+		e.ticket = m_pushes++;
+		e.born = m_pops;
+		m_arrivals.push_back( {slot, e.ticket} );
+
+		m_heap.push_back(slot);
+		sift_up( m_heap.size() - 1 );
+	}
+
+	void push_back( const value_type &v ){
+		push_back( value_type(v) );
+	}
+
+	void push_front( value_type &&v ){
+		m_first.push_front( std::move(v) );
+	}
+
+	void push_front( const value_type &v ){
+		m_first.push_front(v);
+	}
+
+	void push_last( value_type &&v ){
+		m_last.push_back( std::move(v) );
+	}
+
+	void push_last( const value_type &v ){
+		m_last.push_back(v);
+	}
+
+	value_type &front(){
+		if(!m_first.empty())
+			return m_first.front();
+		if(m_heap.empty())
+			return m_last.front();
+		return *m_entries[next_slot()].value;
+	}
+
+	void pop_front(){
+		if(!m_first.empty()){
+			m_first.pop_front();
+			return;
+		}
+		if(m_heap.empty()){
+			m_last.pop_front();
+			return;
+		}
+
+		auto slot = next_slot();
+		auto &e = m_entries[slot];
+		remove_at( e.heap_pos );
+		e.value.reset();
+		m_free.push_back(slot);
+		++m_pops;
+	}
+};
+
+//A LockingQueue which hands out its messages by priority
+template<typename T, class Compare = std::less<T>>
+using PriorityQueue = LockingQueue< T, AgingHeap<T, Compare> >;
+
+}
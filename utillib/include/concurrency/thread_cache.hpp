@@ -0,0 +1,99 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace levitator::concurrency {
+
+//Something of each thread's, kept by an owner which any number of threads use, such as a thread's slot in a ThreadCounters
+//or its buffer in an EventLog, found again without a lock. Each thread has one list, shared by every owner, of what
+//it has put in each, by the owner's serial. Serials aren't reused, so a new owner at a dead one's address finds nothing.
+//
+//An owner going doesn't touch the threads' lists, which they read without a lock. Instead each thread drops the entries
+//of any owners gone since it last looked, the next time it looks anything up, so a list only holds live owners for long.
+class ThreadCache{
+	struct entry{
+		std::uint64_t serial;
+		void *value;
+	};
+
+	struct thread_list{
+		std::vector<entry> entries;
+		std::uint64_t retired = 0;		//As of when this thread last pruned
+	};
+
+	struct registry{
+		std::mutex mutex;
+		std::uint64_t next_serial = 1;
+		std::vector<std::uint64_t> live;	//In order, since they're handed out in order
+		std::atomic<std::uint64_t> retired = 0;
+	};
+
+	static registry &shared(){
+		static registry result;
+		return result;
+	}
+
+	static thread_list &this_thread(){
+		thread_local thread_list result;
+		return result;
+	}
+
+	static std::uint64_t make_serial(){
+		auto &reg = shared();
+		std::lock_guard lock(reg.mutex);
+		reg.live.push_back( reg.next_serial );
+		return reg.next_serial++;
+	}
+
+	static void prune( thread_list &list ){
+		auto &reg = shared();
+		std::lock_guard lock(reg.mutex);
+		list.retired = reg.retired.load( std::memory_order_relaxed );
+		std::erase_if( list.entries, [&reg](const entry &e){ return !std::binary_search( reg.live.begin(), reg.live.end(), e.serial ); } );
+	}
+
+	const std::uint64_t m_serial = make_serial();
+
+public:
+	ThreadCache() = default;
+	ThreadCache( const ThreadCache & ) = delete;
+	ThreadCache &operator=( const ThreadCache & ) = delete;
+
+	~ThreadCache(){
+		auto &reg = shared();
+		std::lock_guard lock(reg.mutex);
+		reg.live.erase( std::lower_bound( reg.live.begin(), reg.live.end(), m_serial ) );
+		reg.retired.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	//What this thread put here, or null
+	template<typename T>
+	T *find() const{
+		auto &list = this_thread();
+		if(list.retired != shared().retired.load( std::memory_order_relaxed ))
+			prune(list);
+
+		for(auto &e : list.entries){
+			if(e.serial == m_serial)
+				return static_cast<T *>(e.value);
+		}
+		return nullptr;
+	}
+
+	//Which has to outlive this
+	template<typename T>
+	void put( T &value ){
+		this_thread().entries.push_back( { m_serial, &value } );
+	}
+
+	//How many owners this thread has something in, dead ones it hasn't dropped yet included
+	static std::size_t thread_entries(){
+		return this_thread().entries.size();
+	}
+};
+
+}
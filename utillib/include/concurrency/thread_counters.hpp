@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include "thread_cache.hpp"
+
+namespace levitator::concurrency {
+
+//N counters which any number of threads add to all the time, and something reads now and then, as for a progress display.
+//Each thread adds into a cache line of its own, which only it writes, so an add is a relaxed load and store with no
+//lock, no read-modify-write, and nothing for the threads to fight over. Reading sums every thread's line.
+//
+//Counters can go down as well as up, so one can be a gauge, such as of connections open, even where a thread takes
+//off what another put on. A thread's slot stays when the thread goes, so nothing it added is lost.
+template<std::size_t N>
+class ThreadCounters{
+public:
+	using value_type = std::int64_t;
+	using snapshot_type = std::array<value_type, N>;
+	static constexpr std::size_t size = N;
+
+private:
+	struct alignas(64) Slot{
+		std::array<std::atomic<value_type>, N> values{};
+	};
+
+	mutable std::mutex m_mutex;
+	std::list<Slot> m_slots;
+	ThreadCache m_cache;		//After the slots, so it goes first
+
+	Slot &slot(){
+		if(auto result = m_cache.find<Slot>())
+			return *result;
+
+		std::lock_guard lock(m_mutex);
+		auto &result = m_slots.emplace_back();
+		m_cache.put(result);
+		return result;
+	}
+
+public:
+	ThreadCounters() = default;
+	ThreadCounters( const ThreadCounters & ) = delete;
+	ThreadCounters &operator=( const ThreadCounters & ) = delete;
+
+	void add( std::size_t counter, value_type n = 1 ){
+		auto &v = slot().values[counter];
+		v.store( v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed );
+	}
+
+	//Not all at one instant: adds made while it's reading may or may not be in it
+	snapshot_type read() const{
+		snapshot_type result{};
+		std::lock_guard lock(m_mutex);
+		for(auto &s : m_slots){
+			for(std::size_t i = 0; i < N; ++i)
+				result[i] += s.values[i].load(std::memory_order_relaxed);
+		}
+		return result;
+	}
+};
+
+}
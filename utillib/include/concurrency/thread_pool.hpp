@@ -2,9 +2,24 @@
 #include <memory>
 #include <thread>
 #include <vector>
+#include <list>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <algorithm>
+#include <functional>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <concepts>
+#include <type_traits>
 #include "exception.hpp"
 #include "util.hpp"
 #include "MessageQueue.hpp"
+#include "priority_queue.hpp"
+#include "future.hpp"
+#include "pool_stats.hpp"
+#include "affinity.hpp"
 
 namespace levitator::concurrency {
 
@@ -26,6 +41,45 @@ public:
 };
 
 
+//A piece of work for a pool whose errors belong to whoever queued it, rather than to the pool.
+//An exception is parked in the slot provided, so that it can be rethrown on the queueing thread once the pool is done.
+//Default-constructed, it's the terminate task.
+//Without a slot, exceptions go to the pool's handler as usual, which suits ThreadPool::submit(), whose futures catch their own.
+class CaptureTask{
+	std::function<void ()> m_proc;
+	std::exception_ptr *m_error = nullptr;
+
+public:
+	CaptureTask() = default;
+	CaptureTask( std::function<void ()> &&proc );
+	CaptureTask( std::function<void ()> &&proc, std::exception_ptr &error );
+	int operator()();
+};
+
+namespace impl{
+
+//How a BlockingScope finds the pool, if any, of the thread it's on
+struct blocking_hook{
+	void *pool = nullptr;
+	void (*notify)( void *pool, bool blocked ) = nullptr;
+};
+
+extern thread_local blocking_hook t_blocking_hook;
+
+}
+
+//Marks the current pool thread as blocked for the duration, on I/O or anything else that leaves its CPU idle,
+//so that an elastic ThreadPool can bring in another thread to keep the queue moving. Harmless on any other thread.
+class BlockingScope{
+	impl::blocking_hook m_hook;
+
+public:
+	BlockingScope();
+	~BlockingScope();
+	BlockingScope( const BlockingScope & ) = delete;
+	BlockingScope &operator=( const BlockingScope & ) = delete;
+};
+
 /*
 class ThreadPool;
 class PoolThread:public std::thread::thread {
@@ -36,32 +90,42 @@ public:
 };
 */
 
-template<class, class, typename>
-class ThreadPool;
-
 template<class Task, class ExHandler>
 class PoolThread:public std::thread::thread{
 
 public:
 	using task_type = Task;	
-	using thread_pool_type = ThreadPool<task_type, ExHandler, PoolThread>;
 
 private:
 
-	static int pool_thread_proc( thread_pool_type &pool){		
-		int result;
-		do{
-			auto task = pool.pop();
+	//Any ThreadPool of these, whatever its queue
+	template<class Pool>
+	static int pool_thread_proc( Pool &pool){		
+		pool.enter();
+		auto &&stats = pool.counters().join();
+		auto mark = stats.mark();
+
+		int result = 0;
+		while( result == 0 ){
+			//Nothing means an elastic pool is retiring this thread
+			auto task = pool.next();
+			mark = stats.idled(mark);
+			if(!task)
+				break;
 
 			try{
-				result = task();
+				result = (*task)();
 			}
 			catch(...){
+				result = 0;
 				pool.exception_handler()( std::current_exception() );
 			}
+			mark = stats.ran(mark);
+			pool.task_done();
+		}
 
-		}while( result  == 0 );
-
+		pool.counters().leave(stats);
+		pool.leave();
 		return result;
 	}
 
@@ -69,8 +133,9 @@ public:
 	//Caution because m_ex_handler is not initialized until after the thread has started.
 	//But then, there shouldn't be any messages in the queue until after initialization is done either.
 	//And hopefully we're not going to throw just waiting on the queue mutex. Hopefully.
-	PoolThread(thread_pool_type &pool):
-		std::thread::thread::thread(pool_thread_proc, std::ref(pool)){}
+	template<class Pool>
+	PoolThread(Pool &pool):
+		std::thread::thread::thread(pool_thread_proc<Pool>, std::ref(pool)){}
 };
 
 /*
@@ -108,40 +173,196 @@ public:
 
 //Task must be constructible from ThreadPool reference
 //Should launch a thread process on construction, as std::thread does
+//Queue is anything with LockingQueue's interface. See PriorityThreadPool below for one which isn't FIFO.
+//
+//Given a sizing with min_threads below max_threads, the pool is elastic. It adds a thread when tasks are waiting with no idle
+//thread to take them, and either enough of its threads are blocked, inside a BlockingScope, or the backlog is deep enough.
+//Threads beyond the minimum retire after sitting idle for the keepalive.
+//
+//With a placement, each thread pins itself to the CPU of the lowest slot no other thread has, so one which retires
+//leaves its CPU to the next to start. That's all it does here: every thread still pops from the one shared queue.
+//For work that stays on the thread, or at least the NUMA node, that made it, see WorkStealingThreadPool.
 template<class Task, 
 	class ExHandler = jab::exception::DefaultBackgroundExceptionHandler,
-	typename Thread = PoolThread<Task, ExHandler>>
+	typename Thread = PoolThread<Task, ExHandler>,
+	class Queue = MessageQueue<Task>>
 class ThreadPool{
 public:
 	using task_type = Task;
 	using exception_handler_type = ExHandler;
 	using thread_type = Thread;
+	using queue_type = Queue;
+
+	static constexpr std::chrono::seconds default_keepalive{30};
+
+	struct sizing{
+		int min_threads;
+		int max_threads;
+		std::chrono::milliseconds keepalive = default_keepalive;
+		double blocked_fraction = 0.5;			//Grow when at least this fraction of the threads are blocked...
+		std::size_t backlog_per_thread = 4;		//...or when this many tasks per thread are waiting
+		Affinity placement = {};
+	};
 
 private:
+	static inline thread_local const ThreadPool *t_member = nullptr;	//The pool the current thread works for, if any
+	static inline thread_local std::size_t t_slot = 0;					//And its place in the placement
+
 	exception_handler_type m_exception_handler;
 	task_type m_terminate_task;	
-	MessageQueue<task_type> m_queue;
-	std::vector<thread_type> m_threads;
+	queue_type m_queue;
+	const sizing m_sizing;
+
+	//Threads come and go only under m_threads_mutex. Retired ones are joined the next time a thread is added, or at shutdown.
+	std::mutex m_threads_mutex;
+	std::list<thread_type> m_threads;
+	std::vector<std::thread::id> m_exited;
+	std::size_t m_live = 0;
+	bool m_closing = false;
+	std::atomic<std::size_t> m_idle = 0, m_blocked = 0;
+	std::vector<bool> m_slots;		//Which of the placement's CPUs have a thread
+
+	[[no_unique_address]] stats::PoolCounters<> m_stats;
+
+	//Tasks queued or running, for wait_idle()
+	std::mutex m_idle_mutex;
+	std::condition_variable m_idle_cv;
+	std::size_t m_outstanding = 0;
+
+	void queued( std::size_t n = 1 ){
+		std::lock_guard lock(m_idle_mutex);
+		m_outstanding += n;
+	}
+
+	//Straight from the callable if the task type can hold it as it is, as InlineTask can, otherwise by way of std::function
+	template<typename F>
+	static task_type make_task( F &&f ){
+		if constexpr( std::constructible_from< task_type, F > )
+			return task_type( std::forward<F>(f) );
+		else
+			return task_type( std::function<void ()>( std::forward<F>(f) ) );
+	}
 
 	void join_each(){
 		for( auto &t : m_threads ){
 			if(t.joinable()) 
 				t.join();
 		}
+
+		std::lock_guard lock(m_threads_mutex);
+		m_live = 0;
+	}
+
+	//Only a queue which can say how deep it is, and give up waiting, will do for an elastic pool
+	static constexpr bool can_resize = requires( queue_type &q ){
+		q.size();
+		q.pop_for( std::chrono::milliseconds() );
+	};
+
+	bool elastic() const{
+		return can_resize && m_sizing.min_threads < m_sizing.max_threads;
+	}
+
+	//No more threads come or go after this. Returns how many are left to terminate.
+	std::size_t close(){
+		std::lock_guard lock(m_threads_mutex);
+		m_closing = true;
+		return m_live;
+	}
+
+	void add_thread(){
+		++m_live;
+		m_threads.push_back( { *this } );
+	}
+
+	void reap(){
+		for(auto id : m_exited){
+			for(auto it = m_threads.begin(); it != m_threads.end(); ++it){
+				if(it->get_id() == id){
+					it->join();
+					m_threads.erase(it);
+					break;
+				}
+			}
+		}
+		m_exited.clear();
+	}
+
+	void maybe_grow(){
+		if constexpr( can_resize ){
+			if(elastic())
+				grow();
+		}
+	}
+
+	void grow(){
+		//Unlocked, for the usual case of there being an idle thread ready to take whatever was just pushed
+		if(m_idle.load() && m_queue.size() <= m_idle.load())
+			return;
+
+		std::lock_guard lock(m_threads_mutex);
+		if(m_closing || m_live >= std::size_t(m_sizing.max_threads))
+			return;
+
+		const auto waiting = m_queue.size();
+		if(waiting <= m_idle.load())
+			return;
+
+		const bool blocked = m_blocked.load() >= m_sizing.blocked_fraction * m_live;
+		const bool backlogged = waiting >= m_sizing.backlog_per_thread * m_live;
+		if(!blocked && !backlogged)
+			return;
+
+		reap();
+		add_thread();
+	}
+
+	//Whether the calling thread may go, having been idle for the keepalive
+	bool retire(){
+		std::lock_guard lock(m_threads_mutex);
+		if(m_closing || m_live <= std::size_t(m_sizing.min_threads))
+			return false;
+
+		--m_live;
+		return true;
+	}
+
+	static void notify_blocking( void *pool, bool blocked ){
+		auto &self = *static_cast<ThreadPool *>(pool);
+		if(blocked){
+			++self.m_blocked;
+			self.maybe_grow();
+		}
+		else
+			--self.m_blocked;
 	}
 
 public:
+	//Anything after the terminate task goes to the queue's constructor. For LockingQueue and PriorityQueue that's
+	//a high_water mark first: push() blocks and try_push() fails while that many tasks are waiting to run,
+	//so that whatever is feeding the pool can go only as fast as the pool does. Zero for no limit.
+	template<typename... QueueArgs>
 	ThreadPool(
 		int count = std::thread::hardware_concurrency(),
 		const exception_handler_type &exh = {},
-		typename jab::util::move_or_copy<task_type>::result_ref_type terminate = {} ):
+		typename jab::util::move_or_copy<task_type>::result_ref_type terminate = {},
+		QueueArgs &&...queue_args ):
+			ThreadPool( sizing{ count, count }, exh, jab::util::move_or_copy(terminate).pass(), std::forward<QueueArgs>(queue_args)... ){}
+
+	template<typename... QueueArgs>
+	ThreadPool(
+		const sizing &size,
+		const exception_handler_type &exh = {},
+		typename jab::util::move_or_copy<task_type>::result_ref_type terminate = {},
+		QueueArgs &&...queue_args ):
 			m_exception_handler(exh),
-			m_terminate_task( jab::util::move_or_copy(terminate) ){
+			m_terminate_task( jab::util::move_or_copy(terminate).pass() ),
+			m_queue( std::forward<QueueArgs>(queue_args)... ),
+			m_sizing(size){
 
-		m_threads.reserve(count);
-		for( int i = 0; i < count; ++i ){
-			m_threads.push_back( { *this} );
-		}
+		std::lock_guard lock(m_threads_mutex);
+		for( int i = 0; i < m_sizing.min_threads; ++i )
+			add_thread();
 	}
 
 	~ThreadPool(){	
@@ -158,9 +379,9 @@ public:
 
 	//Shut down each thread as soon as it pulls a task
 	void shutdown_now(){	
-		for(auto &t : m_threads){
-			if(t.joinable())
-				m_queue.push_front(  jab::util::move_or_copy(m_terminate_task)  );
+		for(auto count = close(); count; --count){
+			queued();
+			m_queue.push_front(  jab::util::move_or_copy(m_terminate_task).pass()  );
 		}
 
 		join_each();
@@ -168,20 +389,154 @@ public:
 
 	//Shut down each thread after all pending tasks are done
 	void shutdown(){	
-		for(auto &t : m_threads){
-			if(t.joinable())
-				m_queue.push_back(  jab::util::move_or_copy(m_terminate_task)  );
+		for(auto count = close(); count; --count){
+			queued();
+			m_queue.push_last(  jab::util::move_or_copy(m_terminate_task).pass()  );
 		}
 
 		join_each();
 	}
 
+	//Threads running now
+	std::size_t size(){
+		std::lock_guard lock(m_threads_mutex);
+		return m_live;
+	}
+
+	//Tasks waiting for a thread, as of just now. Only for queues which can say.
+	std::size_t backlog(){
+		return m_queue.size();
+	}
+
+	//Zeroed unless built with LEVITATOR_POOL_STATS
+	stats::pool_snapshot stats(){
+		auto result = m_stats.snapshot();
+		if constexpr( requires{ m_queue.stats(); } )
+			result.queue = m_queue.stats();
+		result.threads = size();
+		return result;
+	}
+
+	//From a pool thread, this never waits on the high-water mark, since it's the pool threads that would have to make room
 	void push( task_type&& task ){
+		queued();
+		if constexpr( requires{ m_queue.push_back_unbounded( std::move(task) ); } ){
+			if(t_member == this){
+				m_queue.push_back_unbounded( std::move(task) );
+				maybe_grow();
+				return;
+			}
+		}
 		m_queue.push_back( std::move(task) );
+		maybe_grow();
 	}
 
 	void push( const task_type& task ){
-		m_queue.push_back( task );
+		push( task_type(task) );
+	}
+
+	bool try_push( task_type &&task ){
+		queued();
+		if(m_queue.try_push_back( std::move(task) )){
+			maybe_grow();
+			return true;
+		}
+
+		task_done();
+		return false;
+	}
+
+	//Run f() on the pool, for pools of tasks which can be made from a std::function, such as CaptureTask or InlineTask.
+	//The Future has whatever f() returns or throws.
+	template<typename F>
+		requires std::constructible_from< task_type, std::function<void ()> >
+	Future< std::invoke_result_t<F> > submit( F &&f ){
+		Promise< std::invoke_result_t<F> > promise;
+		auto result = promise.future();
+		push( make_task( [promise, f = std::forward<F>(f)]() mutable { promise.set_from(f); } ) );
+		return result;
+	}
+
+	//As above, but then call continuation(Future &) on the pool thread which ran f()
+	template<typename F, typename C>
+		requires std::constructible_from< task_type, std::function<void ()> >
+	Future< std::invoke_result_t<F> > submit( F &&f, C &&continuation ){
+		Promise< std::invoke_result_t<F> > promise;
+		auto result = promise.future();
+		result.then( std::forward<C>(continuation) );
+		push( make_task( [promise, f = std::forward<F>(f)]() mutable { promise.set_from(f); } ) );
+		return result;
+	}
+
+	//Block until every task pushed so far, and any they push in turn, has finished.
+	//Pool threads calling this would wait on themselves, and after shutdown_now() it would wait on the discarded tasks.
+	void wait_idle(){
+		std::unique_lock lock(m_idle_mutex);
+		m_idle_cv.wait( lock, [this](){ return !m_outstanding; } );
+	}
+
+	//For the pool's threads
+	stats::PoolCounters<> &counters(){
+		return m_stats;
+	}
+
+	void enter(){
+		t_member = this;
+		impl::t_blocking_hook = { this, &ThreadPool::notify_blocking };
+
+		if(m_sizing.placement){
+			{
+				std::lock_guard lock(m_threads_mutex);
+				t_slot = std::find( m_slots.begin(), m_slots.end(), false ) - m_slots.begin();
+				if(t_slot == m_slots.size())
+					m_slots.push_back(true);
+				else
+					m_slots[t_slot] = true;
+			}
+			m_sizing.placement.pin(t_slot);
+		}
+	}
+
+	void leave(){
+		impl::t_blocking_hook = {};
+		std::lock_guard lock(m_threads_mutex);
+		m_exited.push_back( std::this_thread::get_id() );
+		if(m_sizing.placement)
+			m_slots[t_slot] = false;
+	}
+
+	//The next task to run, or nothing if the thread should retire
+	std::optional<task_type> next(){
+		++m_idle;
+		auto busy = jab::util::Guard( [this](){ --m_idle; } );
+
+		if constexpr( can_resize ){
+			while(elastic()){
+				if(auto result = m_queue.pop_for( m_sizing.keepalive ))
+					return result;
+				if(retire())
+					return {};
+			}
+		}
+		return m_queue.pop();
+	}
+
+	void task_done(){
+		std::lock_guard lock(m_idle_mutex);
+		if(!--m_outstanding)
+			m_idle_cv.notify_all();
+	}
+
+	//Push tasks for as long as next() comes up with them, as a std::optional<task_type>, at the rate the pool takes them.
+	//Returns the number pushed.
+	template<typename F>
+	std::size_t feed( F &&next ){
+		std::size_t result = 0;
+		while(auto task = next()){
+			push( std::move(*task) );
+			++result;
+		}
+		return result;
 	}
 
 	task_type pop(){
@@ -189,4 +544,11 @@ public:
 	}
 };
 
+//A ThreadPool which runs the greatest task by Compare first, as std::priority_queue would pop them, with aging so
+//that the least don't starve. Give the constructor a high-water mark and then an AgingHeap to change the aging.
+template<class Task,
+	class Compare = std::less<Task>,
+	class ExHandler = jab::exception::DefaultBackgroundExceptionHandler>
+using PriorityThreadPool = ThreadPool< Task, ExHandler, PoolThread<Task, ExHandler>, PriorityQueue<Task, Compare> >;
+
 }
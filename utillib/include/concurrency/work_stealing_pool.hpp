@@ -0,0 +1,334 @@
+#pragma once
+#include <memory>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <latch>
+#include "exception.hpp"
+#include "util.hpp"
+#include "chase_lev_deque.hpp"
+#include "pool_stats.hpp"
+#include "affinity.hpp"
+
+namespace levitator::concurrency {
+
+template<class, class, typename>
+class WorkStealingThreadPool;
+
+template<class Task, class ExHandler>
+class WorkStealingThread:public std::thread::thread{
+
+public:
+	using task_type = Task;
+	using thread_pool_type = WorkStealingThreadPool<task_type, ExHandler, WorkStealingThread>;
+
+private:
+	static int pool_thread_proc( thread_pool_type &pool, std::size_t index ){
+		pool.enter(index);
+		auto &&stats = pool.m_stats.join();
+		auto mark = stats.mark();
+
+		int result;
+		do{
+			std::unique_ptr<task_type> task( pool.next(index) );
+			mark = stats.idled(mark);
+
+			try{
+				result = (*task)();
+			}
+			catch(...){
+				result = 0;
+				pool.exception_handler()( std::current_exception() );
+			}
+			mark = stats.ran(mark);
+
+		}while( result == 0 );
+
+		pool.m_stats.leave(stats);
+		return result;
+	}
+
+public:
+	WorkStealingThread( thread_pool_type &pool, std::size_t index ):
+		std::thread::thread(pool_thread_proc, std::ref(pool), index){}
+};
+
+//A ThreadPool where each thread keeps its own Chase-Lev deque of tasks.
+//Tasks pushed by a pool thread go onto that thread's deque, with no locking, and it works through them newest first.
+//Tasks pushed from outside go into a shared injection queue. A thread with nothing of its own to do
+//takes from the injection queue, or else steals the oldest task from a randomly chosen other thread.
+//
+//With a placement, each thread pins itself before allocating its deque, so that the deque is on the thread's own NUMA node.
+//
+//Otherwise it behaves as ThreadPool does: a task returning non-zero ends its thread,
+//and a default-constructed task is the one used to terminate threads.
+template<class Task,
+	class ExHandler = jab::exception::DefaultBackgroundExceptionHandler,
+	typename Thread = WorkStealingThread<Task, ExHandler>>
+class WorkStealingThreadPool{
+public:
+	using task_type = Task;
+	using exception_handler_type = ExHandler;
+	using thread_type = Thread;
+	using deque_type = ChaseLevDeque<task_type>;
+
+	friend thread_type;
+
+private:
+	//Which pool, if any, the current thread works for, and which of its threads it is
+	struct membership{
+		const WorkStealingThreadPool *pool = nullptr;
+		std::size_t index = 0;
+		std::uint32_t rand = 0;		//xorshift state for picking steal victims
+	};
+	static inline thread_local membership t_member;
+
+	exception_handler_type m_exception_handler;
+	task_type m_terminate_task;
+	Affinity m_placement;
+	std::vector<std::unique_ptr<deque_type>> m_deques;	//Each allocated by its own thread
+	std::latch m_started;								//Nobody goes stealing until they're all there
+	std::vector<thread_type> m_threads;
+
+	//The injection queue and the sleeping threads share one mutex.
+	//Every push bumps the epoch, so that a thread which found nothing can tell whether it needs to look again.
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::condition_variable m_space_cv;		//For outside pushes held up at the high-water mark
+	std::deque<std::unique_ptr<task_type>> m_injected;
+	std::size_t m_high_water;
+	std::atomic<std::size_t> m_injected_count = 0;
+	std::atomic<std::uint64_t> m_epoch = 0;
+	std::atomic<int> m_sleepers = 0;
+	std::atomic<bool> m_abandon = false;
+
+	[[no_unique_address]] stats::PoolCounters<> m_stats;
+
+	void join_each(){
+		for( auto &t : m_threads ){
+			if(t.joinable())
+				t.join();
+		}
+	}
+
+	void enter( std::size_t index ){
+		t_member = { this, index, std::uint32_t(index * 2654435761u) | 1 };
+		m_placement.pin(index);
+		m_deques[index] = std::make_unique<deque_type>();
+		m_started.arrive_and_wait();
+	}
+
+	bool is_member() const{
+		return t_member.pool == this;
+	}
+
+	void wake( bool all = false ){
+		m_epoch.fetch_add(1);
+		if(m_sleepers.load()){
+			std::lock_guard lock(m_mutex);
+			if(all)
+				m_cv.notify_all();
+			else
+				m_cv.notify_one();
+		}
+	}
+
+	bool full() const{
+		return m_high_water && m_injected.size() >= m_high_water;
+	}
+
+	//Termination tasks go to the front and aren't held up by the high-water mark
+	void inject( std::unique_ptr<task_type> &&task, bool front = false ){
+		{
+			std::unique_lock lock(m_mutex);
+			if(!front)
+				m_space_cv.wait( lock, [this](){ return !full(); } );
+
+			if(front)
+				m_injected.push_front( std::move(task) );
+			else
+				m_injected.push_back( std::move(task) );
+			++m_injected_count;
+		}
+		wake();
+	}
+
+	task_type *take_injected(){
+		if(!m_injected_count.load( std::memory_order_relaxed ))
+			return nullptr;
+
+		std::lock_guard lock(m_mutex);
+		if(m_injected.empty())
+			return nullptr;
+
+		auto result = m_injected.front().release();
+		m_injected.pop_front();
+		--m_injected_count;
+		if(m_high_water)
+			m_space_cv.notify_one();
+		return result;
+	}
+
+	task_type *steal( std::size_t index ){
+		const auto count = m_deques.size();
+		if(count < 2)
+			return nullptr;
+
+		auto &r = t_member.rand;
+		r ^= r << 13;
+		r ^= r >> 17;
+		r ^= r << 5;
+
+		auto start = r % count;
+		for(std::size_t i = 0; i < count; ++i){
+			auto victim = (start + i) % count;
+			if(victim == index)
+				continue;
+			if(auto result = m_deques[victim]->steal()){
+				m_stats.stole(true);
+				return result;
+			}
+		}
+		m_stats.stole(false);
+		return nullptr;
+	}
+
+	//Block until there's a task for thread index to run. The caller owns the result.
+	task_type *next( std::size_t index ){
+		auto &own = *m_deques[index];
+
+		while(true){
+			auto epoch = m_epoch.load();
+
+			//Termination tasks were put at the front of the injection queue, so go straight there
+			if(m_abandon.load( std::memory_order_relaxed )){
+				if(auto result = take_injected())
+					return result;
+			}
+
+			if(auto result = own.take())
+				return result;
+			if(auto result = take_injected())
+				return result;
+			if(auto result = steal(index))
+				return result;
+
+			std::unique_lock lock(m_mutex);
+			++m_sleepers;
+			m_cv.wait( lock, [&](){ return m_epoch.load() != epoch; } );
+			--m_sleepers;
+		}
+	}
+
+public:
+	//With a high_water mark, a push from outside the pool blocks, and try_push() fails, while that many
+	//are waiting in the injection queue. Pushes from pool threads are never held up, since those threads
+	//are the ones who would have to make room. Zero for no limit.
+	WorkStealingThreadPool(
+		int count = std::thread::hardware_concurrency(),
+		const exception_handler_type &exh = {},
+		typename jab::util::move_or_copy<task_type>::result_ref_type terminate = {},
+		std::size_t high_water = 0,
+		const Affinity &placement = {} ):
+			m_exception_handler(exh),
+			m_terminate_task( jab::util::move_or_copy(terminate).pass() ),
+			m_placement(placement),
+			m_deques(count),
+			m_started(count),
+			m_high_water(high_water){
+
+		m_threads.reserve(count);
+		for( int i = 0; i < count; ++i )
+			m_threads.push_back( { *this, std::size_t(i) } );
+	}
+
+	~WorkStealingThreadPool(){
+		shutdown_now();
+	}
+
+	exception_handler_type &exception_handler(){
+		return m_exception_handler;
+	}
+
+	//Zeroed unless built with LEVITATOR_POOL_STATS. A failed steal is a search of every other thread's deque which found nothing.
+	stats::pool_snapshot stats(){
+		auto result = m_stats.snapshot();
+		result.threads = m_threads.size();
+		return result;
+	}
+
+	//Shut down each thread as soon as it finishes its current task. Tasks not yet started are discarded.
+	void shutdown_now(){
+		m_abandon = true;
+		for(auto &t : m_threads){
+			if(t.joinable())
+				inject( std::make_unique<task_type>( jab::util::move_or_copy(m_terminate_task).pass() ), true );
+		}
+
+		wake(true);
+		join_each();
+	}
+
+	//Shut down each thread after all pending tasks are done
+	void shutdown(){
+		for(auto &t : m_threads){
+			if(t.joinable())
+				inject( std::make_unique<task_type>( jab::util::move_or_copy(m_terminate_task).pass() ) );
+		}
+
+		wake(true);
+		join_each();
+	}
+
+	//From a pool thread, the task goes onto that thread's own deque
+	void push( task_type &&task ){
+		push( std::make_unique<task_type>( std::move(task) ) );
+	}
+
+	void push( const task_type &task ){
+		push( std::make_unique<task_type>( task ) );
+	}
+
+	void push( std::unique_ptr<task_type> &&task ){
+		if(is_member()){
+			m_deques[t_member.index]->push( task.release() );
+			wake();
+		}
+		else
+			inject( std::move(task) );
+	}
+
+	bool try_push( task_type &&task ){
+		if(is_member()){
+			push( std::move(task) );
+			return true;
+		}
+
+		{
+			std::lock_guard lock(m_mutex);
+			if(full())
+				return false;
+			m_injected.push_back( std::make_unique<task_type>( std::move(task) ) );
+			++m_injected_count;
+		}
+		wake();
+		return true;
+	}
+
+	//Push tasks for as long as next() comes up with them, as a std::optional<task_type>, at the rate the pool takes them.
+	//Returns the number pushed.
+	template<typename F>
+	std::size_t feed( F &&next ){
+		std::size_t result = 0;
+		while(auto task = next()){
+			push( std::move(*task) );
+			++result;
+		}
+		return result;
+	}
+};
+
+}
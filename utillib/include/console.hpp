@@ -1,13 +1,15 @@
 #pragma once
+#include <unistd.h>
 #include <atomic>
 #include <iostream>
+#include <streambuf>
 #include <string>
-#include <sstream>
+#include <string_view>
 #include <mutex>
-#include <functional>
-#include "concurrency/thread_pool.hpp"
+#include <utility>
+#include "concurrency/log_ring.hpp"
 #include "concurrency/stream_forwarder.hpp"
-#include "compiler.hpp"
+#include "log.hpp"
 
 /*
 * Just a central place to put console messaging in, mainly for the purposes of exclusive locking,
@@ -18,29 +20,54 @@ namespace jab::util{
 class Console;
 
 namespace impl{
-inline static auto make_console_output_task(std::ostream *stream, const std::string &msg){
-	return [stream, msg](){ 
-		if(stream){
-			*stream << msg << std::flush;
-			return 0;
-		}
-		else{
-			return -1;
-		}
-	};
-}
-}
 
-struct ConsoleErrorHandler{
-	void operator()( const std::exception_ptr &ptr) const;
+//Appends to a string which keeps its capacity from one message to the next
+class FormatStreambuf:public std::streambuf{
+	std::string m_text;
+
+protected:
+	int_type overflow( int_type c ) override;
+	std::streamsize xsputn( const char_type *s, std::streamsize n ) override;
+
+public:
+	std::string_view text() const{
+		return m_text;
+	}
+
+	void clear(){
+		m_text.clear();
+	}
 };
 
+//Somewhere to format a message. Each thread keeps a few, so that once they've grown to size a message costs no allocation,
+//and there's no std::ostream to construct, with its locale, every time.
+class FormatBuffer{
+	FormatStreambuf m_buf;
+	std::ostream m_stream;
+
+public:
+	FormatBuffer();
+
+	//The calling thread's spare one, or a new one if it has none
+	static FormatBuffer *acquire();
+
+	//Back to the calling thread's spares, emptied and with the stream's formatting reset
+	static void release( FormatBuffer * );
+
+	std::ostream &stream(){
+		return m_stream;
+	}
+
+	std::string_view text() const{
+		return m_buf.text();
+	}
+};
+
+}
+
 struct ConsoleTypes{
 	using mutex_type = std::recursive_mutex;
 	using lock_type = std::unique_lock<mutex_type>;
-	//using ref_type = std::reference_wrapper<Console>;
-	using task_type = decltype( impl::make_console_output_task(nullptr, {}) );
-	using thread_pool_type = levitator::concurrency::ThreadPool<task_type, ConsoleErrorHandler>;	
 };
 
 class ConsoleStreamBase : public ConsoleTypes{
@@ -59,13 +86,29 @@ class ConsoleOutputBase :
 	using base_type = ConsoleStreamBase;
 
 protected:
-	std::stringstream p_sstream;
+	//Null once another has taken it over
+	mutable impl::FormatBuffer *p_buffer;
 
 public:	
-	using base_type::base_type;
+	ConsoleOutputBase( Console &cons ):
+		base_type(cons),
+		p_buffer( impl::FormatBuffer::acquire() ){}
+
+	//Copying takes the text over, rather than having both copies say it. It's only ever a temporary being copied,
+	//as in auto pr = console.out() << ..., since operator<< returns a reference.
+	ConsoleOutputBase( const ConsoleOutputBase &rhs ):
+		base_type(rhs),
+		p_buffer( std::exchange(rhs.p_buffer, nullptr) ){}
+
+	~ConsoleOutputBase(){
+		if(p_buffer)
+			impl::FormatBuffer::release(p_buffer);
+	}
+
+	ConsoleOutputBase &operator=( const ConsoleOutputBase & ) = delete;
 
-	std::stringstream &get_ostream(){
-		return p_sstream;
+	std::ostream &get_ostream(){
+		return p_buffer->stream();
 	}
 };
 
@@ -82,17 +125,12 @@ public:
 	std::istream &get_istream() const;
 };
 
-//TODO:
-//Oddly, when you chain more than one operation on a line with the stream, the compiler
-//wants to perform an object copy. This is kind of inefficient, but not enough
-//to matter for the current project.
+//Whatever was put to it goes out as one message when it goes away
 class ConsoleOutBuffer : public ConsoleOutputBase<ConsoleOutBuffer>{
 	using base_type = ConsoleOutputBase<ConsoleOutBuffer>;
 
 public:	
-	ConsoleOutBuffer( Console & );
-	ConsoleOutBuffer(ConsoleOutBuffer &&);
-	ConsoleOutBuffer(const ConsoleOutBuffer &);
+	using base_type::base_type;
 	~ConsoleOutBuffer();
 };
 
@@ -100,25 +138,18 @@ class ConsoleErrBuffer : public ConsoleOutputBase<ConsoleErrBuffer>{
 	using base_type = ConsoleOutputBase<ConsoleErrBuffer>;
 
 public:
-	ConsoleErrBuffer( Console & );
-	ConsoleErrBuffer(ConsoleErrBuffer &&);
-	ConsoleErrBuffer(const ConsoleErrBuffer &);
+	using base_type::base_type;
 	~ConsoleErrBuffer();
 };
 
-//This warning seems to be because a template is defined in terms of a lambda's type, which
-//I guess is in the anonymous namespace, and that results in a warning
-PUSH_WARN
-WARN_DISABLE_SUBOBJECT_LINKAGE
+//Output goes through a LogRing, so that threads saying things don't hold each other up
 class Console : public ConsoleTypes{
-
-	using message_type = std::function< void () >;
 	using mutex_type = ConsoleTypes::mutex_type;
 	mutex_type m_in_mutex;
-	
-	using task_type = ConsoleTypes::task_type;
-	using thread_pool_type = ConsoleTypes::thread_pool_type;
-	thread_pool_type m_queue = { 1, ConsoleErrorHandler(), impl::make_console_output_task(nullptr, {}) };	
+	levitator::concurrency::LogRing m_log;
+	std::atomic<bool> m_status_shown = false;
+
+	bool take_status_line();	//Whether there was one up to clear, which is then the caller's to do
 
 public:
 	using in_type = ConsoleInput;
@@ -126,7 +157,7 @@ public:
 	using err_type = ConsoleErrBuffer;
 
 	std::atomic<std::istream *> in_stream_pointer = nullptr;
-	std::atomic<std::ostream *> out_stream_pointer = nullptr, error_stream_pointer = nullptr;
+	std::atomic<int> out_fd = STDOUT_FILENO, error_fd = STDERR_FILENO;
 
 	//Requires an explicit call to init in order to avoid static fiasco in pre-main
 	void init();
@@ -135,10 +166,17 @@ public:
 	out_type out();
 	err_type err();
 
-	void queue_out(const std::string &msg);
-	void queue_err(const std::string &msg);
+	void queue_out( std::string_view msg );
+	void queue_err( std::string_view msg );
+
+	//Show text on the terminal's last line, without a newline, in place of the last status. The next message clears
+	//it to take the line, so whatever keeps the status up should redraw it now and then.
+	void status( std::string_view text );
+	void clear_status();
+
+	//Wait until everything said so far has been written, as before writing to std::cout directly
+	void flush();
 };
-POP_WARN
 
 extern Console console;
 
@@ -157,3 +195,7 @@ public:
 };
 
 }
+
+//To the console, as one message, if channel lets level through. See log.hpp.
+//	JAB_LOG( crawl_log, info ) << "Total nodes known: " << n << std::endl;
+#define JAB_LOG( channel, lvl ) JAB_LOG_TO( channel, lvl, jab::util::console.out() )
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace jab::util{
+
+//CRC-32C (Castagnoli polynomial), the same one used by iSCSI, ext4 and friends.
+//Uses the SSE4.2 crc32 instruction when the CPU has it, otherwise a slicing-by-8 table.
+//To checksum something in pieces, pass the result of the previous piece as crc.
+std::uint32_t crc32c( const void *data, std::size_t len, std::uint32_t crc = 0 );
+
+//Whether crc32c() is using the hardware instruction on this machine
+bool crc32c_hardware();
+
+//Each way crc32c() can go, for testing them against one another. crc32c_sse42() may only be called where
+//crc32c_hardware() is true.
+std::uint32_t crc32c_software( const void *data, std::size_t len, std::uint32_t crc = 0 );
+std::uint32_t crc32c_sse42( const void *data, std::size_t len, std::uint32_t crc = 0 );
+
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <filesystem>
+#include "FSFile.hpp"
+#include "UringFile.hpp"
+#include "concurrency/thread_cache.hpp"
+
+namespace levitator {
+
+//One event as it sits in an EventLog file. What the type, subject and the two values mean is up to whoever logs them;
+//the only type the log itself uses is name_type, which ties a subject id to the text it was interned from.
+struct event_record{
+	static constexpr std::uint16_t name_type = 0;
+	static constexpr std::size_t name_chunk = 2 * sizeof(std::int64_t);	//Name bytes carried by each name record
+
+	std::uint64_t time_ns = 0;		//Since the epoch, so traces from different runs and hosts line up
+	std::uint32_t subject = 0;		//Interned id
+	std::uint16_t type = 0;
+	std::uint16_t thread = 0;		//Numbered in the order threads first logged, from 1
+	std::int64_t a = 0, b = 0;
+};
+static_assert( sizeof(event_record) == 32 );
+
+//At the start of every file, so a reader knows it has the right kind, laid out the way it expects
+struct event_log_header{
+	static constexpr char magic_text[8] = { 'L', 'V', 'E', 'V', 'E', 'N', 'T', 'S' };
+	static constexpr std::uint32_t current_version = 1;
+
+	char magic[8];
+	std::uint32_t version = current_version;
+	std::uint32_t record_size = sizeof(event_record);
+};
+
+//Compact binary trace of whatever a program wants to count, for full detail at a few nanoseconds an event.
+//Each thread fills a buffer of its own, which only goes to the file when it's full or on flush(), so logging an event
+//is a clock read and a 32-byte copy under a lock no other thread takes outside of a flush.
+//Names such as callsigns are interned to a 32-bit id up front and written to the file once, not with every event.
+//
+//When a file passes max_bytes it's renamed path.1, the one before that path.2 and so on, up to keep of them,
+//and a new one started. Each file starts with every name interned so far, so each can be read on its own.
+//An existing file at path is moved aside the same way on opening, so a run never overwrites the last one's.
+//
+//The file is written through a UringFile, so thread buffers are gathered into larger writes which go to the kernel without
+//waiting on one another. Events still in a thread's buffer, or in the file's, are lost if the process dies before a flush().
+class EventLog{
+public:
+	static constexpr std::size_t buffer_records = 256;
+	static constexpr std::uint64_t default_max_bytes = 64 << 20;
+	static constexpr unsigned default_keep = 4;
+
+	struct options{
+		std::uint64_t max_bytes = default_max_bytes;	//0 to never rotate
+		unsigned keep = default_keep;					//Old files kept besides the current one
+	};
+
+private:
+	struct Buffer{
+		std::mutex mutex;
+		std::vector<event_record> records;
+		std::uint16_t thread;
+
+		Buffer( std::uint16_t thread_number ):
+			thread(thread_number){
+			records.reserve(buffer_records);
+		}
+	};
+
+	const std::filesystem::path m_path;
+	const options m_options;
+
+	//Everything that reaches the file goes under this
+	std::mutex m_file_mutex;
+	jab::file::UringFile m_file;
+	std::uint64_t m_size = 0;
+	std::vector<std::string> m_names;	//By id
+	std::unordered_map<std::string, std::uint32_t> m_ids;
+
+	std::mutex m_buffers_mutex;
+	std::list<Buffer> m_buffers;
+	concurrency::ThreadCache m_cache;	//Each thread's buffer
+
+	Buffer &buffer();
+	void open();
+	void rotate();
+	void write_records( const event_record *records, std::size_t count );
+	void write_name( std::uint32_t id, std::string_view name );
+	void drain( Buffer &buffer );
+
+public:
+	EventLog( const std::filesystem::path &path, const options &opts );
+	EventLog( const std::filesystem::path &path ): EventLog(path, options{}){}
+	~EventLog();
+
+	EventLog( const EventLog & ) = delete;
+	EventLog &operator=( const EventLog & ) = delete;
+
+	//The same id every time for the same name. Takes the file lock, so look ids up once and keep them.
+	std::uint32_t intern( std::string_view name );
+
+	void record( std::uint16_t type, std::uint32_t subject, std::int64_t a = 0, std::int64_t b = 0 );
+
+	//Write out every thread's buffer, and wait for it to reach the file
+	void flush();
+
+	const std::filesystem::path &path() const{
+		return m_path;
+	}
+
+	//path.n, where rotated files go
+	static std::filesystem::path rotated_path( const std::filesystem::path &path, unsigned n );
+};
+
+//Reads an EventLog file back, one event at a time, taking in the names as it goes
+class EventLogReader{
+	jab::file::FSFile m_file;
+	std::vector<event_record> m_buffer;
+	std::size_t m_next = 0, m_end = 0;
+	std::vector<std::string> m_names;
+
+	bool fill();
+
+public:
+	//Throws std::runtime_error if it isn't an event log, or is a version this can't read
+	EventLogReader( const std::filesystem::path &path );
+
+	//The next event other than a name, or false at the end
+	bool next( event_record &record );
+
+	//The name interned as id, or empty if the file hasn't had it so far
+	const std::string &name( std::uint32_t id ) const;
+};
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <string_view>
+
+//Log levels, checked twice: against JAB_LOG_LEVEL when compiling, and against the channel's own level when running.
+//Statements below JAB_LOG_LEVEL are compiled out altogether. The rest cost a relaxed load and a compare when their
+//channel is turned down, and neither the stream expression nor anything put to it is evaluated.
+//
+//0 trace, 1 debug, 2 info, 3 warn, 4 error. Build with -DJAB_LOG_LEVEL=2 to leave out debug and trace altogether.
+#ifndef JAB_LOG_LEVEL
+#define JAB_LOG_LEVEL 1
+#endif
+
+namespace jab::util{
+
+enum class log_level : unsigned char{
+	trace, debug, info, warn, error, off
+};
+
+inline constexpr log_level compiled_log_level = log_level(JAB_LOG_LEVEL);
+
+//"trace" through "off". Throws std::invalid_argument for anything else.
+log_level parse_log_level( std::string_view name );
+std::string_view log_level_name( log_level level );
+
+//A subsystem's logging, turned up or down at runtime by name.
+//Channels are meant to be statics, which register themselves on construction and stay registered for good.
+class LogChannel{
+	const char *m_name;
+	std::atomic<log_level> m_level;
+	LogChannel *m_next;			//Registry, newest first
+
+public:
+	static constexpr log_level default_level = log_level::info;
+
+	LogChannel( const char *name, log_level level = default_level );
+	LogChannel( const LogChannel & ) = delete;
+	LogChannel &operator=( const LogChannel & ) = delete;
+
+	const char *name() const{
+		return m_name;
+	}
+
+	log_level level() const{
+		return m_level.load( std::memory_order_relaxed );
+	}
+
+	void level( log_level l ){
+		m_level.store( l, std::memory_order_relaxed );
+	}
+
+	bool enabled( log_level l ) const{
+		return l >= compiled_log_level && l >= level();
+	}
+
+	//Null if there's none by that name
+	static LogChannel *find( std::string_view name );
+
+	//Comma-separated levels, each either name=level for one channel or just a level for all of them:
+	//"debug", or "warn,query=trace". Throws std::invalid_argument for a channel or level that isn't there.
+	static void configure( std::string_view spec );
+
+	//Every channel's name, comma-separated, for usage messages
+	static std::string names();
+};
+
+}
+
+//Puts whatever follows to stream_expr, if channel lets level through. Otherwise nothing from the statement is evaluated:
+//	JAB_LOG_TO( query_log, debug, print() ) << "Node line: " << line << std::endl;
+//It's a complete if-else, so it's safe as the body of an unbraced if.
+#define JAB_LOG_TO( channel, lvl, stream_expr ) \
+	if constexpr( jab::util::log_level::lvl < jab::util::compiled_log_level ) {} \
+	else if( !(channel).enabled( jab::util::log_level::lvl ) ) {} \
+	else (stream_expr)
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+
+namespace jab::io{
+
+//Memory mapped twice over, back-to-back, from one memfd, so that size() bytes on from anywhere in the first copy runs
+//on into the second, which is the first again. A ringbuffer on it never has to split what it holds in two.
+//The size is rounded up to whole pages, which is what can be mapped.
+class mirror_buffer{
+	char *m_data = nullptr;
+	std::size_t m_size = 0;
+
+	void release();
+
+public:
+	mirror_buffer() = default;
+
+	//Throws posix_exception, nested in an IOError, if the memfd or either mapping can't be made
+	explicit mirror_buffer( std::size_t min_size );
+	~mirror_buffer();
+
+	mirror_buffer( mirror_buffer &&rhs );
+	mirror_buffer &operator=( mirror_buffer &&rhs );
+	mirror_buffer( const mirror_buffer & ) = delete;
+	mirror_buffer &operator=( const mirror_buffer & ) = delete;
+
+	//The first copy. The second follows at data() + size().
+	char *data() const{
+		return m_data;
+	}
+
+	//Of one copy
+	std::size_t size() const{
+		return m_size;
+	}
+};
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <chrono>
+#include <coroutine>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "sheduler.hpp"
+
+namespace levitator {
+
+//An epoll loop, for as many descriptors as the process can open, where select() stops at FD_SETSIZE.
+//
+//A descriptor is add()ed once, and then arm()ed each time something wants to hear that it's ready. Arms are
+//edge-triggered and one-shot: the handler runs once, on the loop's thread, and that side of the descriptor is quiet from
+//then until it's armed again, so nothing has to turn an arm off and handlers can't pile up behind one another. An arm
+//can have a deadline, kept on a Scheduler on a timerfd in the same epoll set, and if it comes first the handler gets
+//timed_out.
+//
+//A descriptor has a reading arm and a writing arm, which don't disturb one another, and epoll is asked for whatever
+//either is waiting on. Handlers can instead be coroutines, which co_await ready() and are resumed on the loop's thread.
+//Other threads can wait() for a descriptor, as many at once as they like, alongside its arms; that's how
+//File::write_exactly waits on a nonblocking file registered with a reactor.
+//
+//Everything but run() and run_once() may be called from any thread.
+class Reactor{
+public:
+	//What a descriptor can be ready for, or what it was, as epoll has them
+	enum events : std::uint32_t{
+		timed_out = 0,
+		readable = 0x001,
+		writable = 0x004,
+		error = 0x008,			//Always reported, whether asked for or not, as is hangup
+		hangup = 0x010
+	};
+
+	using clock_type = std::chrono::steady_clock;
+	using time_type = clock_type::time_point;
+	using duration_type = clock_type::duration;
+	using handler_type = std::function<void (std::uint32_t events)>;
+	using task_type = std::function<void ()>;
+	using scheduler_type = Scheduler<task_type>;
+
+private:
+	struct Arm{
+		std::uint32_t events;
+		handler_type handler;
+		std::optional<timer_id> deadline;
+		std::uint64_t serial;			//Which arm a deadline belongs to
+		bool waiter;					//From wait(), so no arm() replaces it
+	};
+
+	struct Watch{
+		std::vector<Arm> arms;			//The reading arm, the writing arm, and whoever's in wait()
+	};
+
+	int m_epoll_fd;
+	int m_wake_fd;						//eventfd, for stop()
+	scheduler_type m_scheduler;
+
+	std::mutex m_mutex;
+	std::unordered_map<int, Watch> m_watches;
+	std::uint64_t m_next_serial = 0;
+	bool m_stop = false;
+	std::atomic<std::thread::id> m_loop_thread;	//Default while nothing's running the loop
+
+	void control( int op, int fd, std::uint32_t events );
+	void rearm( int fd, const Watch &watch );
+	void place( int fd, Arm arm, std::optional<time_type> deadline );
+	std::size_t ready_now( int fd, std::uint32_t events );
+	void expire( int fd, std::uint64_t serial );
+
+public:
+	static constexpr int max_events = 64;		//Taken from epoll in one go
+
+	Reactor( duration_type timer_resolution = scheduler_type::default_resolution );
+	~Reactor();
+	Reactor( const Reactor & ) = delete;
+	Reactor &operator=( const Reactor & ) = delete;
+
+	//Registers fd, unarmed. Throws if it's already registered, or can't be.
+	void add( int fd );
+
+	//Any arm which hasn't gone off never will. Unregistering a descriptor that's closed anyway is harmless.
+	void remove( int fd );
+
+	bool contains( int fd );
+
+	//handler runs once, when fd is next ready for any of events, or with timed_out once deadline has passed, whichever
+	//is first. Replaces whatever arm there was for reading, if events has readable, or else for writing, and leaves
+	//the other side's be. fd has to have been added.
+	void arm( int fd, std::uint32_t events, handler_type handler, std::optional<time_type> deadline = {} );
+
+	//Blocks until fd is ready for any of events, or until deadline. Returns what it was ready for, or timed_out.
+	//Not from the loop's own thread, which would never get round to saying so.
+	std::uint32_t wait( int fd, std::uint32_t events, std::optional<time_type> deadline = {} );
+
+	//Whether wait() would ever come back here: a loop is running, and on some other thread
+	bool can_wait() const;
+
+	timer_id schedule_after( duration_type delay, task_type task );
+	bool cancel( timer_id id );
+
+	//Waits up to timeout for something to happen, and runs whatever handlers and timers that brings on.
+	//Returns how many it ran.
+	std::size_t run_once( std::optional<duration_type> timeout = {} );
+
+	//Runs handlers and timers until stop()
+	void run();
+	void stop();
+
+	//co_await reactor.ready( fd, Reactor::readable ) suspends the coroutine until fd is, and resumes it on the loop's
+	//thread with what fd was ready for, or timed_out
+	struct awaiter{
+		Reactor &reactor;
+		int fd;
+		std::uint32_t events;
+		std::optional<time_type> deadline;
+		std::uint32_t result = timed_out;
+
+		bool await_ready() const{
+			return false;
+		}
+
+		void await_suspend( std::coroutine_handle<> coroutine ){
+			reactor.arm( fd, events, [this, coroutine](std::uint32_t ready){
+				result = ready;
+				coroutine.resume();
+			}, deadline );
+		}
+
+		std::uint32_t await_resume() const{
+			return result;
+		}
+	};
+
+	awaiter ready( int fd, std::uint32_t events, std::optional<time_type> deadline = {} ){
+		return { *this, fd, events, deadline };
+	}
+};
+
+}
@@ -2,6 +2,7 @@
 #include <functional>
 #include <algorithm>
 #include <vector>
+#include <array>
 #include "meta.hpp"
 #include "util.hpp"
 
@@ -16,6 +17,9 @@ namespace io{
 * consume the first to roll the buffer over. Further, each ringbuffer is divided into get and put areas,
 * for a total of 2 to four segments or regions.
 *
+* Unless the buffer is mirrored: mapped twice over, back-to-back, as by a mirror_buffer. Then the get and put areas
+* each run on past the end of the buffer into the second copy, so neither is ever split, and there's no rolling over.
+*
 */
 template<typename T>
 class ringbuffer{
@@ -73,6 +77,7 @@ private:
 	struct State{
     	streamsize m_capacity, m_size;
     	value_type *m_buffer, *m_buffer_end, *m_head, *m_tail;
+		bool m_mirrored;		//m_buffer_end is also the start of a second mapping of the buffer
 	} m_state;
     	
 	auto mk_get_range(){
@@ -105,20 +110,26 @@ public:
         return m_state.m_capacity;
     }
 
-    void buf(value_type *buf, streamsize sz){
+    //A mirrored buf is sz elements mapped twice, so that buf[sz] through buf[2 * sz - 1] are buf[0] through buf[sz - 1]
+    void buf(value_type *buf, streamsize sz, bool mirrored = false){
         m_state.m_capacity = sz;
         m_state.m_size = 0;
         m_state.m_tail = m_state.m_head = m_state.m_buffer = buf;
         m_state.m_buffer_end = m_state.m_buffer + sz;        
+		m_state.m_mirrored = mirrored;
     }
 
+	bool mirrored() const{
+		return m_state.m_mirrored;
+	}
+
 	//Reinitialize by calling buf() with its previous parameters, which happens to reset the ringbuffer
 	//to the same size, same buffer, but empty.
 	void clear(){
-		buf( m_state.m_buffer, m_state.m_capacity );
+		buf( m_state.m_buffer, m_state.m_capacity, m_state.m_mirrored );
 	}
 
-    //Pull in n bytes having previously been written to the input range
+    //Pull in n bytes having previously been written to the input range, which may be both of put_segments()
     //We assume that nobody will ever try to write past the end of the range
     //So, we will check for them writing right up until the end to decide whether to wrap around.
     void push(streamsize n){
@@ -129,6 +140,11 @@ public:
 
         m_state.m_tail += n;
         m_state.m_size += n;        
+
+		//Come round to the start, having pushed into both put segments at once, or the same place in the first copy
+		//from the second, if mirrored
+		if(m_state.m_tail > m_state.m_buffer_end)
+			m_state.m_tail -= m_state.m_capacity;
     }
 
     void pop(streamsize n){
@@ -138,7 +154,7 @@ public:
         if(m_state.m_size == 0)
             m_state.m_head = m_state.m_tail = m_state.m_buffer;
         else if(m_state.m_head >= m_state.m_buffer_end)
-            m_state.m_head = m_state.m_buffer;
+            m_state.m_head -= m_state.m_capacity;	//Mirrored, it may have got some way into the second copy
     }
 
     //Insert one into the head end, analogous to unreading IO
@@ -161,7 +177,11 @@ private:
 
 	template<class This, class =  EitherThis<This>>
     static auto get_end_impl(This th){
-        return th->m_state.m_tail >= th->m_state.m_head ? th->m_state.m_tail : th->m_state.m_buffer_end;
+		if(th->m_state.m_mirrored)
+			return th->m_state.m_head + th->m_state.m_size;
+
+		//Full, with the tail come round to the head, is a wrapped buffer rather than an empty one
+        return th->m_state.m_size && th->m_state.m_tail <= th->m_state.m_head ? th->m_state.m_buffer_end : th->m_state.m_tail;
     }
 
 	template<class This, class =  EitherThis<This>>
@@ -171,7 +191,13 @@ private:
 
 	template<class This, class =  EitherThis<This>>
     static auto put_end_impl(This th){
-        return th->m_state.m_tail >= th->m_state.m_head ? th->m_state.m_buffer_end : th->m_state.m_head;
+		//Measured from where the put range really begins, which is the start of the buffer once the tail reaches the end
+		auto begin = put_begin_impl(th);
+		if(th->m_state.m_mirrored)
+			return begin + (th->m_state.m_capacity - th->m_state.m_size);
+		if(th->m_state.m_size >= th->m_state.m_capacity)
+			return begin;
+        return begin >= th->m_state.m_head ? th->m_state.m_buffer_end : th->m_state.m_head;
     }
 
 public:
@@ -201,6 +227,32 @@ public:
         return put_end_impl(this);
     }
 
+	//A contiguous part of the buffer
+	struct segment{
+		value_type *begin = nullptr, *end = nullptr;
+
+		streamsize size() const{
+			return end - begin;
+		}
+	};
+
+	//All of the get range: the segment from get_begin(), and then the one which carries on from the start of the buffer,
+	//which is empty unless the range wraps. It always is empty when mirrored. One pop() can take from both.
+	std::array<segment, 2> get_segments() const{
+		segment first{ get_begin(), get_end() };
+		if(m_state.m_mirrored || first.end != m_state.m_buffer_end)
+			return { first, {} };
+		return { first, { m_state.m_buffer, m_state.m_buffer + (m_state.m_size - first.size()) } };
+	}
+
+	//Likewise for the put range. One push() can fill both.
+	std::array<segment, 2> put_segments() const{
+		segment first{ put_begin(), put_end() };
+		if(m_state.m_mirrored || first.end != m_state.m_buffer_end || first.begin == m_state.m_buffer)
+			return { first, {} };
+		return { first, { m_state.m_buffer, m_state.m_head } };
+	}
+
     //How many elements are available to fetch in the current segment, not total
     ::size_t getavail() const{
         return get_end() - get_begin();
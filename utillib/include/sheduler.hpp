@@ -2,77 +2,161 @@
 #include <mutex>
 #include <condition_variable>
 #include <thread>
-#include <map>
 #include <chrono>
+#include <vector>
+#include <functional>
+#include <optional>
+#include <cstdint>
 #include "exception.hpp"
+#include "timer_wheel.hpp"
+
+namespace levitator {
+
+//A CLOCK_MONOTONIC timerfd, which is the clock std::chrono::steady_clock reads, for waking an epoll loop
+class TimerFd{
+	int m_fd;
+
+public:
+	using time_type = std::chrono::steady_clock::time_point;
+
+	TimerFd();
+	~TimerFd();
+	TimerFd( const TimerFd & ) = delete;
+	TimerFd &operator=( const TimerFd & ) = delete;
+
+	int fd() const;
+	void arm_at( const time_type &time );
+	void disarm();
+
+	//Number of expiries since the last read, zero if none. Doesn't block.
+	std::uint64_t read();
+};
 
 //Manage a list of things to do in the future because
 //std::async does not seem to have good support for canceling tasks
+//
+//The timers are kept on a TimerWheel, so scheduling, cancelling and rescheduling are O(1) however many are live,
+//which suits per-session timeouts that keep getting pushed back. Whatever comes due on a tick is taken off in one go
+//and run outside the lock.
+//
+//By default, it keeps a thread of its own which sleeps until the next tick with anything due, and which is only woken early
+//when something is scheduled ahead of that. Due tasks run on that thread, unless a sink is given to hand them on to,
+//such as a ThreadPool's push. Constructed with Scheduler::external there is no thread; instead fd() is a timerfd
+//for an epoll loop to watch, and the loop calls dispatch() when it's readable.
 template<class Task, class ExHandler = jab::exception::DefaultBackgroundExceptionHandler>
 class Scheduler{
 public:
 	using task_type = Task;
-	using clock_type = std::chrono::high_resolution_clock;
+	using clock_type = std::chrono::steady_clock;
 	using time_type = clock_type::time_point;
+	using duration_type = clock_type::duration;
+	using sink_type = std::function<void (task_type &&)>;
+	using wheel_type = TimerWheel<task_type>;
+	using tick_type = typename wheel_type::tick_type;
 
-private:
-	using map_type = std::multimap<time_type, task_type>;	
+	static constexpr std::chrono::milliseconds default_resolution{1};
+
+	struct external_type{};
+	static constexpr external_type external{};
 
+private:
 	using mutex_type = std::mutex;
 	using lock_type = std::unique_lock<mutex_type>;
 
+	ExHandler m_error_handler;
+	const duration_type m_resolution;
+	const time_type m_epoch = clock_type::now();
+	sink_type m_sink;
+
 	mutex_type m_mutex;
 	std::condition_variable m_cv;
-	map_type m_schedule;
+	wheel_type m_wheel;
+	std::optional<tick_type> m_wake_tick;		//When the thread or timerfd is next due to look at the wheel
+	std::vector<task_type> m_batch;				//Only touched by whoever dispatches
+	std::optional<TimerFd> m_timerfd;
 	std::thread m_thread;
 	bool m_terminate = false;
 
-	void thread_proc(){
+	//Rounded up, so that nothing ever runs early
+	tick_type to_tick( const time_type &time ) const{
+		if(time <= m_epoch)
+			return 0;
+		return tick_type( (time - m_epoch + m_resolution - duration_type(1)) / m_resolution );
+	}
+
+	//The last tick which has fully arrived
+	tick_type elapsed_ticks() const{
+		return tick_type( (clock_type::now() - m_epoch) / m_resolution );
+	}
+
+	time_type to_time( tick_type tick ) const{
+		return m_epoch + m_resolution * tick;
+	}
+
+	//Make sure whoever is waiting will look at the wheel by tick
+	void wake_by( tick_type tick ){
+		if(m_wake_tick && *m_wake_tick <= tick)
+			return;
 
+		m_wake_tick = tick;
+		if(m_timerfd)
+			m_timerfd->arm_at( to_time(tick) );
+		else
+			m_cv.notify_one();
+	}
+
+	void run( task_type &&task ){
+		try{
+			if(m_sink)
+				m_sink( std::move(task) );
+			else
+				task();
+		}
+		catch(...){
+			m_error_handler( std::current_exception() );
+		}
+	}
+
+	//Take off everything due, then run it unlocked
+	std::size_t expire( lock_type &lock ){
+		m_wheel.advance( elapsed_ticks(), [this](task_type &&task){ m_batch.push_back( std::move(task) ); } );
+		if(m_batch.empty())
+			return 0;
+
+		lock.unlock();
+		for(auto &task : m_batch)
+			run( std::move(task) );
+		auto result = m_batch.size();
+		m_batch.clear();
+		lock.lock();
+		return result;
+	}
+
+	void thread_proc(){
 		auto lock = lock_type(m_mutex);
-		
+
 		while( !m_terminate ){
-			if( m_schedule.size() > 0 ){
-				auto next = m_schedule.begin();
-				auto next_time = next->first;
-				auto &next_task = next->second;
-
-				//If notified prior to next event, then start the loop over to
-				//account for any possible new task or to respond to termination
-				if( m_cv.wait_until(next_time) == std::cv_status::no_timeout)
-					continue;
-
-				//Having waited the appropriate time and not received any notifications otherwise
-				//Re-retrieve the upcoming task and double-check that it is due. This is really just in case
-				//it's possible for a timeout and notification to race, which you would hope not.
-				next = m_schedule.begin();
-				next_time = next->first;
-				next_task = next->second;
-				if(clock_type::now() < next_time)
-					continue;
-
-				//Ok, so it's really time to run this task
-				//It shouldn't be possible for the task to have been removed because
-				//we would have received a no_timeout instead, looped again, and retrieved a valid item
-				try{
-					next_task();
-					m_schedule.erase(next);
-				}
-				catch(...){
-					m_schedule.erase(next);
-					m_error_handler( std::current_exception() );
-				}
-			}
+			expire(lock);
+
+			m_wake_tick = m_wheel.next_tick();
+			if(m_wake_tick)
+				m_cv.wait_until( lock, to_time(*m_wake_tick) );
 			else
 				m_cv.wait( lock );
 		}
 	}
 
 public:
-	using iterator = typename map_type::iterator;
+	Scheduler( duration_type resolution = default_resolution, sink_type sink = {} ):
+		m_resolution(resolution),
+		m_sink( std::move(sink) ){
+		m_thread = std::thread( &Scheduler::thread_proc, this );
+	}
 
-	Scheduler(){
-		m_thread = { thread_proc, this };
+	Scheduler( external_type, duration_type resolution = default_resolution, sink_type sink = {} ):
+		m_resolution(resolution),
+		m_sink( std::move(sink) ){
+		m_timerfd.emplace();
 	}
 
 	~Scheduler(){
@@ -85,18 +169,58 @@ public:
 			m_thread.join();
 	}
 
-	iterator schedule( const time_type &time, task_type &&task ){
+	timer_id schedule( const time_type &time, task_type &&task ){
 		auto lock = lock_type(m_mutex);
-		auto result = m_schedule.insert( {time, std::move(task) } );
-		m_cv.notify_one();
+		auto tick = std::max( to_tick(time), m_wheel.now() + 1 );
+		auto result = m_wheel.arm( tick, std::move(task) );
+		wake_by(tick);
 		return result;
 	}
 
-	void cancel( const iterator &it ){
+	timer_id schedule_after( const duration_type &delay, task_type &&task ){
+		return schedule( clock_type::now() + delay, std::move(task) );
+	}
+
+	//False if it had already run or been cancelled
+	bool cancel( timer_id id ){
+		auto lock = lock_type(m_mutex);
+		return m_wheel.cancel(id);
+	}
+
+	//Moving a timeout later, the usual case, never has to wake anything
+	bool reschedule( timer_id id, const time_type &time ){
+		auto lock = lock_type(m_mutex);
+		auto tick = std::max( to_tick(time), m_wheel.now() + 1 );
+		if(!m_wheel.rearm( id, tick ))
+			return false;
+		wake_by(tick);
+		return true;
+	}
+
+	std::size_t size(){
 		auto lock = lock_type(m_mutex);
-		m_schedule.erase(it);
-		m_cv.notify_one();
+		return m_wheel.size();
+	}
+
+	//Only with Scheduler::external. Readable when dispatch() has something to do.
+	int fd() const{
+		return m_timerfd->fd();
 	}
 
+	//Only with Scheduler::external, from one thread at a time. Runs whatever is due and rearms the timerfd.
+	std::size_t dispatch(){
+		m_timerfd->read();
+
+		auto lock = lock_type(m_mutex);
+		auto result = expire(lock);
+
+		m_wake_tick.reset();
+		if(auto next = m_wheel.next_tick())
+			wake_by(*next);
+		else
+			m_timerfd->disarm();
+		return result;
+	}
 };
 
+}
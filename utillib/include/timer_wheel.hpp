@@ -0,0 +1,301 @@
+#pragma once
+#include <vector>
+#include <optional>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+
+namespace levitator {
+
+//Handle to a timer armed on a TimerWheel. Stale once the timer fires or is cancelled, and safe to use all the same.
+struct timer_id{
+	std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+	std::uint32_t generation = 0;
+
+	bool operator==( const timer_id & ) const = default;
+};
+
+//Hierarchical timing wheel, after Varghese and Lauck, in the style of the Linux kernel's.
+//Time is in whole ticks, whatever length the owner decides those are. There are four levels of 256 slots,
+//each slot of a level spanning a whole turn of the one below, so 2^32 ticks are covered directly.
+//Anything further out waits on an overflow list until the top level comes round.
+//
+//Arming, cancelling and rearming are O(1): each timer is a node in a doubly-linked slot list, kept in a slab and
+//addressed by index. Timers only ever move down a level, a whole slot at a time, when the level below comes round.
+//
+//Not thread-safe. See Scheduler in sheduler.hpp for that.
+template<typename Task>
+class TimerWheel{
+public:
+	using task_type = Task;
+	using tick_type = std::uint64_t;
+
+	static constexpr unsigned level_bits = 8;
+	static constexpr unsigned levels = 4;
+	static constexpr std::size_t slots = std::size_t(1) << level_bits;
+
+private:
+	using index_type = std::uint32_t;
+	static constexpr index_type nil = std::numeric_limits<index_type>::max();
+	static constexpr std::size_t slot_mask = slots - 1;
+
+	//The lists: every slot of every level, then the overflow, then the batch being expired
+	static constexpr std::size_t overflow_list = levels * slots;
+	static constexpr std::size_t expiring_list = overflow_list + 1;
+	static constexpr std::size_t list_count = expiring_list + 1;
+	static constexpr std::uint16_t no_list = std::numeric_limits<std::uint16_t>::max();
+
+	struct Node{
+		std::optional<task_type> task;
+		tick_type when = 0;
+		index_type prev = nil, next = nil;
+		std::uint32_t generation = 0;
+		std::uint16_t list = no_list;		//no_list when free
+	};
+
+	std::vector<Node> m_nodes;
+	index_type m_free = nil;					//Free nodes, chained through next
+	std::array<index_type, list_count> m_heads;
+	std::array<std::array<std::uint64_t, slots / 64>, levels> m_occupied{};	//Which slots have anything in them
+	tick_type m_now;							//The last tick processed
+	std::size_t m_size = 0;
+
+	void mark( std::size_t list, bool occupied ){
+		if(list >= overflow_list)
+			return;
+
+		auto &word = m_occupied[list / slots][(list % slots) / 64];
+		auto bit = std::uint64_t(1) << (list % 64);
+		word = occupied ? word | bit : word & ~bit;
+	}
+
+	void link( index_type i, std::size_t list ){
+		auto &n = m_nodes[i];
+		n.list = std::uint16_t(list);
+		n.prev = nil;
+		n.next = m_heads[list];
+		if(n.next != nil)
+			m_nodes[n.next].prev = i;
+		else
+			mark( list, true );
+		m_heads[list] = i;
+	}
+
+	void unlink( index_type i ){
+		auto &n = m_nodes[i];
+		if(n.prev != nil)
+			m_nodes[n.prev].next = n.next;
+		else
+			m_heads[n.list] = n.next;
+		if(n.next != nil)
+			m_nodes[n.next].prev = n.prev;
+		if(m_heads[n.list] == nil)
+			mark( n.list, false );
+		n.list = no_list;
+	}
+
+	//Which list a timer belongs on, from where the wheel is now
+	std::size_t list_for( tick_type when ) const{
+		auto delta = when - m_now;
+		for(unsigned level = 0; level < levels; ++level){
+			if(delta < (tick_type(1) << (level_bits * (level + 1))))
+				return level * slots + ((when >> (level_bits * level)) & slot_mask);
+		}
+		return overflow_list;
+	}
+
+	void place( index_type i ){
+		link( i, list_for( m_nodes[i].when ) );
+	}
+
+	//Move everything on a list down to wherever it now belongs
+	void cascade( std::size_t list ){
+		auto i = m_heads[list];
+		m_heads[list] = nil;
+		mark( list, false );
+		while(i != nil){
+			auto next = m_nodes[i].next;
+			place(i);
+			i = next;
+		}
+	}
+
+	bool valid( timer_id id ) const{
+		return id.index < m_nodes.size() && m_nodes[id.index].generation == id.generation && m_nodes[id.index].list != no_list;
+	}
+
+	void release( index_type i ){
+		auto &n = m_nodes[i];
+		n.task.reset();
+		++n.generation;
+		n.next = m_free;
+		m_free = i;
+		--m_size;
+	}
+
+	//First occupied slot of level 0 at or after slot, if any
+	std::optional<std::size_t> next_occupied( std::size_t slot ) const{
+		auto &bits = m_occupied[0];
+		for(auto word = slot / 64; word < bits.size(); ++word){
+			auto w = bits[word];
+			if(word == slot / 64)
+				w &= ~std::uint64_t(0) << (slot % 64);
+			if(w)
+				return word * 64 + std::countr_zero(w);
+		}
+		return {};
+	}
+
+	//Process tick t, which must be the one after m_now
+	template<typename F>
+	std::size_t process( tick_type t, F &on_expire ){
+		m_now = t;
+
+		//At the start of a turn of a level, the slot of each level above which has just come round moves down
+		if(!(t & slot_mask)){
+			unsigned top = 1;
+			while(top < levels - 1 && !((t >> (level_bits * top)) & slot_mask))
+				++top;
+			if(top == levels - 1 && !((t >> (level_bits * top)) & slot_mask))
+				cascade( overflow_list );
+			for(auto level = top; level >= 1; --level)
+				cascade( level * slots + ((t >> (level_bits * level)) & slot_mask) );
+		}
+
+		//Detach the due slot first, so that whatever the tasks do to the wheel, they can't disturb the batch
+		auto due = t & slot_mask;
+		if(m_heads[due] == nil)
+			return 0;
+
+		m_heads[expiring_list] = m_heads[due];
+		m_heads[due] = nil;
+		mark( due, false );
+		for(auto i = m_heads[expiring_list]; i != nil; i = m_nodes[i].next)
+			m_nodes[i].list = expiring_list;
+
+		std::size_t result = 0;
+		while(m_heads[expiring_list] != nil){
+			auto i = m_heads[expiring_list];
+			unlink(i);
+			auto task = std::move( *m_nodes[i].task );
+			release(i);
+			on_expire( std::move(task) );
+			++result;
+		}
+		return result;
+	}
+
+public:
+	TimerWheel( tick_type now = 0 ):
+		m_now(now){
+		m_heads.fill(nil);
+	}
+
+	TimerWheel( const TimerWheel & ) = delete;
+	TimerWheel &operator=( const TimerWheel & ) = delete;
+
+	tick_type now() const{
+		return m_now;
+	}
+
+	std::size_t size() const{
+		return m_size;
+	}
+
+	bool empty() const{
+		return !m_size;
+	}
+
+	//Fire the task on tick when, or on the next tick if when has already passed
+	timer_id arm( tick_type when, task_type &&task ){
+		index_type i;
+		if(m_free != nil){
+			i = m_free;
+			m_free = m_nodes[i].next;
+		}
+		else{
+			i = index_type( m_nodes.size() );
+			m_nodes.emplace_back();
+		}
+
+		auto &n = m_nodes[i];
+		n.task.emplace( std::move(task) );
+		n.when = std::max( when, m_now + 1 );
+		place(i);
+		++m_size;
+		return { i, n.generation };
+	}
+
+	//False if it had already fired or been cancelled
+	bool cancel( timer_id id ){
+		if(!valid(id))
+			return false;
+
+		unlink( id.index );
+		release( id.index );
+		return true;
+	}
+
+	//Move a pending timer to a new tick, keeping its task and id. False if it had already fired or been cancelled.
+	bool rearm( timer_id id, tick_type when ){
+		if(!valid(id))
+			return false;
+
+		unlink( id.index );
+		auto &n = m_nodes[id.index];
+		n.when = std::max( when, m_now + 1 );
+		place( id.index );
+		return true;
+	}
+
+	//The earliest tick at which advance() might have something to do.
+	//Exact for timers within a turn of level 0, otherwise the start of the next turn, when higher levels come down.
+	std::optional<tick_type> next_tick() const{
+		if(!m_size)
+			return {};
+
+		auto next = m_now + 1;
+		if(!(next & slot_mask))
+			return next;
+		if(auto slot = next_occupied( next & slot_mask ))
+			return (next & ~tick_type(slot_mask)) + *slot;
+		return (next | slot_mask) + 1;
+	}
+
+	//Process every tick up to and including tick, calling on_expire(task_type &&) for each timer due,
+	//in batches of a slot at a time. Skips quickly over stretches with nothing due. Returns the number fired.
+	template<typename F>
+	std::size_t advance( tick_type tick, F &&on_expire ){
+		std::size_t result = 0;
+		while(m_now < tick){
+			if(!m_size){
+				m_now = tick;
+				break;
+			}
+
+			//Next tick which either has something in level 0 or starts a new turn
+			auto next = m_now + 1;
+			auto target = (next | slot_mask) + 1;
+			if(next & slot_mask){
+				if(auto slot = next_occupied( next & slot_mask ))
+					target = (next & ~tick_type(slot_mask)) + *slot;
+			}
+			else
+				target = next;
+
+			if(target > tick){
+				m_now = tick;
+				break;
+			}
+
+			m_now = target - 1;
+			result += process( target, on_expire );
+		}
+		return result;
+	}
+};
+
+}
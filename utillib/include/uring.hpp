@@ -0,0 +1,106 @@
+#pragma once
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace jab::io{
+
+//An io_uring, set up and driven by raw syscalls, since there's no liburing to build against.
+//Operations are queued on the submission ring and only go to the kernel on submit(), or when the ring is full, so a
+//batch of them costs one syscall. Completions come back in whatever order the kernel finishes them, each with the
+//user_data it went in with.
+//
+//Whatever an operation points to, iovecs included, has to stay put until its completion has been taken.
+//Keep in_flight() within the completion ring, which is twice the entries asked for, or older kernels drop completions.
+//One thread drives a ring.
+class uring{
+public:
+	//Per-operation flags, as IOSQE_*
+	enum op_flags : std::uint8_t{
+		drain = 0x02,		//Doesn't start until everything submitted before it has completed
+		link = 0x04			//The next operation doesn't start until this one has finished, and is cancelled if it fails
+	};
+
+	struct completion{
+		std::uint64_t user_data;
+		std::int32_t result;	//What the syscall would have returned, or -errno
+	};
+
+private:
+	int m_fd = -1;
+
+	void *m_sq_map = nullptr;
+	std::size_t m_sq_map_size = 0;
+	void *m_cq_map = nullptr;
+	std::size_t m_cq_map_size = 0;
+	io_uring_sqe *m_sqes = nullptr;
+	std::size_t m_sqes_size = 0;
+
+	unsigned *m_sq_head = nullptr, *m_sq_tail = nullptr, *m_sq_array = nullptr;
+	unsigned m_sq_mask = 0, m_sq_entries = 0;
+	unsigned *m_cq_head = nullptr, *m_cq_tail = nullptr;
+	unsigned m_cq_mask = 0;
+	io_uring_cqe *m_cqes = nullptr;
+
+	unsigned m_queued = 0;		//On the submission ring, not yet submitted
+	unsigned m_in_flight = 0;	//Submitted, and the completion not yet taken
+
+	void queue( std::uint8_t opcode, int fd, const void *addr, unsigned len, std::uint64_t offset, std::uint64_t user_data,
+		std::uint8_t flags, std::uint16_t buffer = 0, std::uint32_t op_flags = 0 );
+	void release();
+
+public:
+	uring() = default;
+
+	//entries is rounded up to a power of 2 by the kernel.
+	//Throws posix_exception, nested in an IOError, if the ring can't be set up or mapped.
+	explicit uring( unsigned entries );
+	~uring();
+
+	uring( uring &&rhs );
+	uring &operator=( uring &&rhs );
+	uring( const uring & ) = delete;
+	uring &operator=( const uring & ) = delete;
+
+	//Whether this kernel will set up a ring with everything used here. Asked once, and remembered.
+	static bool supported();
+
+	//Pins the buffers, for read_fixed() and write_fixed() to name by index. Throws if they can't be, as when they're
+	//past RLIMIT_MEMLOCK on kernels which count pinned memory against it.
+	void register_buffers( const ::iovec *iov, unsigned n );
+
+	void readv( int fd, const ::iovec *iov, unsigned n, std::uint64_t offset, std::uint64_t user_data, std::uint8_t flags = 0 );
+	void writev( int fd, const ::iovec *iov, unsigned n, std::uint64_t offset, std::uint64_t user_data, std::uint8_t flags = 0 );
+
+	//buf lies within registered buffer number buffer
+	void read_fixed( int fd, void *buf, unsigned len, std::uint64_t offset, unsigned buffer, std::uint64_t user_data, std::uint8_t flags = 0 );
+	void write_fixed( int fd, const void *buf, unsigned len, std::uint64_t offset, unsigned buffer, std::uint64_t user_data, std::uint8_t flags = 0 );
+
+	void fsync( int fd, bool datasync, std::uint64_t user_data, std::uint8_t flags = 0 );
+
+	//Hands over everything queued, and then waits for at least min_complete completions to be in
+	void submit( unsigned min_complete = 0 );
+
+	//Takes a completion if one is in, without waiting
+	bool peek( completion &c );
+
+	//Submits anything queued, then waits for a completion. Throws std::logic_error if nothing's outstanding.
+	completion wait();
+
+	unsigned queued() const{
+		return m_queued;
+	}
+
+	unsigned in_flight() const{
+		return m_in_flight;
+	}
+
+	explicit operator bool() const{
+		return m_fd != -1;
+	}
+};
+
+}
@@ -30,6 +30,7 @@ static int do_open( const char *path, int fl ){
     check_ofl(fl, ofl, noctty, O_NOCTTY);
     check_ofl(fl, ofl, nonblock, O_NONBLOCK);
     check_ofl(fl, ofl, create, O_CREAT);
+    check_ofl(fl, ofl, trunc, O_TRUNC);
     
     return posix_exception::check( ::open(path, ofl, S_IRUSR | S_IWUSR),  [path](){ return "Error opening file: "s + path; }, meta::type<IOError>() );    
 }
@@ -2,12 +2,16 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/select.h>
+#include <poll.h>
+#include <sys/uio.h>
 #include <stdexcept>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <iostream> //For debugging
 #include "exception.hpp"
 #include "File.hpp"
+#include "reactor.hpp"
 
 using namespace jab;
 using namespace jab::exception;
@@ -16,6 +20,17 @@ using namespace jab::file;
 
 NullFile jab::file::null_file = {};
 
+//The first len bytes of what iov points to, in one piece, for debug output
+static std::string gather(const ::iovec *iov, int iovcnt, std::streamsize len){
+    std::string result;
+    for(int i = 0; i < iovcnt && len > 0; ++i){
+        auto n = std::min<std::streamsize>(len, iov[i].iov_len);
+        result.append(static_cast<const char *>(iov[i].iov_base), n);
+        len -= n;
+    }
+    return result;
+}
+
 jab::file::File::File(){}
 File::File(fd_t fd):m_state{fd}{}
 
@@ -32,6 +47,8 @@ void File::cleanup(){ close(); }
 
 void File::close(){
     if(*this){
+        if(m_state.m_reactor)
+            m_state.m_reactor->remove(m_state.m_fd);
         posix_exception::check(::close(m_state.m_fd), "Failed closing file", meta::type<IOError>());
         m_state.m_fd = null_fd;        
     }
@@ -42,14 +59,14 @@ File::fd_t File::fd() const{ return m_state.m_fd; }
 File::operator fd_t() const{ return fd(); }
 
 File::File(File &&rhs){
-    m_state = rhs.m_state;
-    rhs.m_state.m_fd = null_fd;
+    m_state = std::move(rhs.m_state);
+    rhs.m_state = {};
 }
 
 void File::move_assign(File &&rhs){
 	if(this == &rhs) return;
     m_state = std::move(rhs.m_state);
-    rhs.m_state.m_fd = null_fd;
+    rhs.m_state = {};
 }
 
 File &File::operator=(File &&rhs){
@@ -70,6 +87,14 @@ std::streamsize File::read(char *data, std::streamsize len){
 std::streamsize File::read_exactly(char *data, std::streamsize len){
     auto begin=data;
     len_t ct;
+
+    //Whatever read_until() read ahead comes first
+    if(auto ahead = std::min<std::streamsize>(len, m_state.ahead_end - m_state.ahead_begin)){
+        std::memcpy(data, m_state.ahead.data() + m_state.ahead_begin, ahead);
+        m_state.ahead_begin += ahead;
+        data += ahead;
+        len -= ahead;
+    }
     
     while(len){
         ct = this->read(data, len);        
@@ -91,8 +116,27 @@ std::streamsize File::write(const char *data, std::streamsize len){
     return result;
 }
 
+std::streamsize File::readv(const ::iovec *iov, int iovcnt){
+    ::ssize_t result = posix_exception::check(::readv(m_state.m_fd, iov, iovcnt), "Error reading file", meta::type<IOError>());
+
+    if(m_state.m_debug)
+        std::cerr << "R(" << m_state.m_fd << "): " << util::hex_format(gather(iov, iovcnt, result)) << std::endl;
+
+    return result;
+}
+
+std::streamsize File::writev(const ::iovec *iov, int iovcnt){
+    ::ssize_t result = posix_exception::check(::writev(m_state.m_fd, iov, iovcnt), "Error writing file", meta::type<IOError>());
+
+    if(m_state.m_debug)
+        std::cerr << "W(" << m_state.m_fd << "): " << util::hex_format(gather(iov, iovcnt, result)) << std::endl;
+
+    return result;
+}
+
+//Behind the descriptor by whatever read_until() has read ahead and not handed out
 std::streamsize File::tell() const{
-	return const_cast<File *>(this)->seek(0, std::ios_base::cur);
+	return const_cast<File *>(this)->seek(0, std::ios_base::cur) - std::streamsize(m_state.ahead_end - m_state.ahead_begin);
 }
 
 std::streamsize File::seek(std::streamsize pos, std::ios_base::seekdir dir){
@@ -105,6 +149,13 @@ std::streamsize File::seek(std::streamsize pos, std::ios_base::seekdir dir){
 
 		case std::ios_base::cur:
 			dir2 = SEEK_CUR;
+
+			//Nowhere, so the lookahead still follows on from where the reader's got to
+			if(!pos)
+				return posix_exception::check( ::lseek(m_state.m_fd, 0, SEEK_CUR), "Error seeking file", meta::type<IOError>() );
+
+			//From the reader's position, not the descriptor's
+			pos -= std::streamsize(m_state.ahead_end - m_state.ahead_begin);
 			break;
 		
 		case std::ios_base::end:
@@ -115,7 +166,11 @@ std::streamsize File::seek(std::streamsize pos, std::ios_base::seekdir dir){
 			throw std::invalid_argument("Invalid seek direction");
 	}
 
-	return posix_exception::check( ::lseek(m_state.m_fd, pos, dir2), "Error seeking file", meta::type<IOError>() );	
+	auto result = posix_exception::check( ::lseek(m_state.m_fd, pos, dir2), "Error seeking file", meta::type<IOError>() );
+
+	//What was read ahead was from somewhere else
+	m_state.ahead_begin = m_state.ahead_end = 0;
+	return result;
 }
 
 //seek to an exact position and throw if the offset comes back as anything else
@@ -147,37 +202,91 @@ std::streamsize File::seek_exactly(std::streamsize pos, std::ios_base::seekdir d
 		return got;
 }
 
+//Whether ex is, or wraps, a nonblocking file saying it isn't ready
+static bool would_block(const std::exception &ex){
+    if(auto posix = dynamic_cast<const posix_exception *>(&ex)){
+        auto code = posix->code().value();
+        return code == EAGAIN || code == EWOULDBLOCK;
+    }
+    try{
+        std::rethrow_if_nested(ex);
+    }
+    catch(const std::exception &nested){
+        return would_block(nested);
+    }
+    catch(...){
+    }
+    return false;
+}
+
 void File::write_exactly(const char *data, std::streamsize len){
     
-    ::ssize_t ct=0;
     while(len){
+        ::ssize_t ct;
         try{
             ct = write(data, len);
         }
-        catch(const posix_exception &ex){
-            //Avoid eating CPU time
-            if(ex.code().value() == EWOULDBLOCK){
-                file::select( file::FDSet(), file::FDSet(*this), file::FDSet(*this) );
-            }
-            else
+        catch(const std::exception &ex){
+            if(!would_block(ex))
                 throw;
+
+            //Avoid eating CPU time. poll() rather than select(), which can't take descriptors past FD_SETSIZE.
+            //The reactor only when another thread is running it: from a handler, or with no loop, it'd never answer.
+            auto reactor = m_state.m_reactor;
+            if(reactor && reactor->can_wait() && reactor->contains(m_state.m_fd))
+                reactor->wait(m_state.m_fd, levitator::Reactor::writable);
+            else{
+                ::pollfd p{ m_state.m_fd, POLLOUT, 0 };
+                posix_exception::check( ::poll(&p, 1, -1), "poll() call failed waiting for I/O", meta::type<IOError>() );
+            }
+            continue;
         }
         len -= ct;
         data += ct;
     }
 }
 
-std::string File::read_until(char delimiter){
-    std::vector<char> buf;
-    char ch;
-    
+File::record_ending File::read_until(char delimiter, std::span<const char> &record){
+    auto &s = m_state;
+    auto scanned = s.ahead_begin;   //No delimiter before here
+
     while(true){
-        read_exactly(&ch, 1);
-        if(ch == delimiter) break;
-        buf.push_back(ch);
+        if(scanned < s.ahead_end){
+            auto found = static_cast<const char *>( std::memchr(s.ahead.data() + scanned, delimiter, s.ahead_end - scanned) );
+            if(found){
+                record = { s.ahead.data() + s.ahead_begin, found };
+                s.ahead_begin = found + 1 - s.ahead.data();
+                return record_ending::delimiter;
+            }
+            scanned = s.ahead_end;
+        }
+
+        //Make room for another block: back to the start of the buffer with what's left of the record,
+        //or a bigger buffer if it's already taken up all of it. Nothing left means nothing to move.
+        if(s.ahead_end == s.ahead.size() || s.ahead_begin == s.ahead_end){
+            auto pending = s.ahead_end - s.ahead_begin;
+            if(pending && s.ahead_begin)
+                std::memmove(s.ahead.data(), s.ahead.data() + s.ahead_begin, pending);
+            if(pending == s.ahead.size())
+                s.ahead.resize( std::max<std::size_t>(jab::util::Config::io_block_size, 2 * s.ahead.size()) );
+            scanned = s.ahead_end = pending;
+            s.ahead_begin = 0;
+        }
+
+        auto ct = read(s.ahead.data() + s.ahead_end, s.ahead.size() - s.ahead_end);
+        if(!ct){
+            record = { s.ahead.data() + s.ahead_begin, s.ahead.data() + s.ahead_end };
+            s.ahead_begin = s.ahead_end;
+            return record.empty() ? record_ending::none : record_ending::eof;
+        }
+        s.ahead_end += ct;
     }
-    
-    return { buf.data(), buf.size() };
+}
+
+std::string File::read_until(char delimiter){
+    std::span<const char> record;
+    read_until(delimiter, record);
+    return { record.begin(), record.end() };
 }
 
 StdFile StdFile::stdin(0);
@@ -198,6 +307,36 @@ void File::flush(){
 bool File::debug() const{ return m_state.m_debug; }
 void File::debug(bool v){ m_state.m_debug = v; }
 
+void File::reactor(levitator::Reactor *r){
+    if(r == m_state.m_reactor)
+        return;
+    if(m_state.m_reactor)
+        m_state.m_reactor->remove(m_state.m_fd);
+    m_state.m_reactor = r;
+    if(r && nonblocking())
+        r->add(m_state.m_fd);
+}
+
+levitator::Reactor *File::reactor() const{ return m_state.m_reactor; }
+
+bool File::nonblocking() const{
+    return posix_exception::check( ::fcntl(m_state.m_fd, F_GETFL), "Failed getting file flags", meta::type<IOError>() ) & O_NONBLOCK;
+}
+
+void File::nonblocking(bool v){
+    auto fl = posix_exception::check( ::fcntl(m_state.m_fd, F_GETFL), "Failed getting file flags", meta::type<IOError>() );
+    if(bool(fl & O_NONBLOCK) == v)
+        return;
+    posix_exception::check( ::fcntl(m_state.m_fd, F_SETFL, v ? fl | O_NONBLOCK : fl & ~O_NONBLOCK), "Failed setting file flags", meta::type<IOError>() );
+
+    if(m_state.m_reactor){
+        if(v)
+            m_state.m_reactor->add(m_state.m_fd);
+        else
+            m_state.m_reactor->remove(m_state.m_fd);
+    }
+}
+
 //NOPs for standard streams
 //You can still close() them explicitly. They just don't close themselves because
 //we let the runtime manage their lifetime by default
@@ -54,24 +54,49 @@ void Socket::timeout_as_eof(bool v){
 	m_timeout_as_eof = v;
 }
 
-std::streamsize Socket::read(char *data, std::streamsize len){
-	auto result = ::recv(fd(), data, len, 0);
+std::streamsize Socket::transferred(::ssize_t result, std::uint64_t &total, const char *msg){
 	if(result == -1){
-		if( m_timeout_as_eof && (errno == EAGAIN || errno == EWOULDBLOCK)  )
+		if( m_timeout_as_eof && (errno == EAGAIN || errno == EWOULDBLOCK)  ){
+			++m_timeouts;
 			return 0;
+		}
 		else
-			posix_exception::check(result, "Error receiving from socket", meta::type<IOError>());
+			posix_exception::check(result, msg, meta::type<IOError>());
 	}
+	total += result;
 	return result;
 }
 
+std::streamsize Socket::read(char *data, std::streamsize len){
+	return transferred( ::recv(fd(), data, len, 0), m_bytes_in, "Error receiving from socket" );
+}
+
 std::streamsize Socket::write(const char *data, std::streamsize len){
-	auto result = ::send(fd(), data, len, 0);
-	if(result == -1){
-		if( m_timeout_as_eof && (errno == EAGAIN || errno == EWOULDBLOCK)  )
-			return 0;
-		else
-			posix_exception::check(result, "Error sending to socket", meta::type<IOError>());
-	}
-	return result;
+	return transferred( ::send(fd(), data, len, 0), m_bytes_out, "Error sending to socket" );
+}
+
+std::streamsize Socket::readv(const ::iovec *iov, int iovcnt){
+	::msghdr msg{};
+	msg.msg_iov = const_cast<::iovec *>(iov);
+	msg.msg_iovlen = iovcnt;
+	return transferred( ::recvmsg(fd(), &msg, 0), m_bytes_in, "Error receiving from socket" );
+}
+
+std::streamsize Socket::writev(const ::iovec *iov, int iovcnt){
+	::msghdr msg{};
+	msg.msg_iov = const_cast<::iovec *>(iov);
+	msg.msg_iovlen = iovcnt;
+	return transferred( ::sendmsg(fd(), &msg, 0), m_bytes_out, "Error sending to socket" );
+}
+
+std::uint64_t Socket::bytes_in() const{
+	return m_bytes_in;
+}
+
+std::uint64_t Socket::bytes_out() const{
+	return m_bytes_out;
+}
+
+unsigned Socket::timeouts() const{
+	return m_timeouts;
 }
@@ -0,0 +1,238 @@
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream> //For debugging
+#include <string>
+#include "exception.hpp"
+#include "util.hpp"
+#include "UringFile.hpp"
+
+using namespace jab;
+using namespace jab::exception;
+using namespace jab::file;
+using jab::io::uring;
+
+//result is -errno, as from a completion
+static void fail( int result, const char *msg ){
+	errno = -result;
+	posix_exception::check( -1, msg, meta::type<IOError>() );
+}
+
+UringFile::UringFile( const std::filesystem::path &path, int fl, const options &opts ):
+	FSFile(path, fl){
+
+	if(opts.ring)
+		start(opts);
+}
+
+UringFile::~UringFile(){
+	//Nowhere left to report a failure to
+	try{
+		close();
+	}
+	catch( const std::exception & ){
+	}
+}
+
+UringFile::UringFile( UringFile &&rhs ):
+	FSFile( std::move(rhs) ),
+	m_state( std::move(rhs.m_state) ){
+}
+
+UringFile &UringFile::operator=( UringFile &&rhs ){
+	if(this != &rhs){
+		close();
+		FSFile::operator=( std::move(rhs) );
+		m_state = std::move(rhs.m_state);
+	}
+	return *this;
+}
+
+void UringFile::start( const options &opts ){
+	if(!uring::supported() || !opts.buffers || !opts.buffer_size)
+		return;
+
+	//Pipes, terminals and sockets
+	auto position = ::lseek( fd(), 0, SEEK_CUR );
+	if(position == -1)
+		return;
+
+	//A write in flight for each buffer, and an fsync behind them
+	try{
+		m_state.ring = uring( opts.buffers + 1 );
+	}
+	catch( const IOError & ){
+		return;
+	}
+
+	m_state.buffer_size = opts.buffer_size;
+	m_state.memory.reset( new char[opts.buffers * opts.buffer_size] );
+	std::vector<::iovec> whole;
+	for(unsigned i = 0; i < opts.buffers; ++i){
+		auto data = m_state.memory.get() + i * opts.buffer_size;
+		m_state.buffers.push_back( { { data, 0 } } );
+		whole.push_back( { data, opts.buffer_size } );
+	}
+
+	try{
+		m_state.ring.register_buffers( whole.data(), whole.size() );
+		m_state.fixed = true;
+	}
+	catch( const IOError & ){
+	}
+
+	m_state.offset = position;
+}
+
+bool UringFile::ring() const{
+	return bool(m_state.ring);
+}
+
+UringFile::Buffer &UringFile::writable(){
+	auto &result = m_state.buffers[m_state.current];
+	while(result.in_flight)
+		complete( m_state.ring.wait() );
+	return result;
+}
+
+bool UringFile::send( std::uint8_t flags ){
+	auto i = m_state.current;
+	auto &b = m_state.buffers[i];
+	if(!b.iov.iov_len)
+		return false;
+
+	if(m_state.fixed)
+		m_state.ring.write_fixed( fd(), b.iov.iov_base, b.iov.iov_len, b.offset, i, i, flags );
+	else
+		m_state.ring.writev( fd(), &b.iov, 1, b.offset, i, flags );
+	b.in_flight = true;
+	m_state.current = (i + 1) % m_state.buffers.size();
+	return true;
+}
+
+bool UringFile::complete( const uring::completion &c ){
+	if(c.user_data == fsync_tag){
+		if(c.result == -ECANCELED)
+			return false;
+		if(c.result < 0)
+			fail( c.result, "Failed flushing file" );
+		return true;
+	}
+
+	auto &b = m_state.buffers[c.user_data];
+	b.in_flight = false;
+	auto len = b.iov.iov_len;
+	b.iov.iov_len = 0;
+	if(c.result < 0)
+		fail( c.result, "Error writing file" );
+
+	//Cut short, as when the disk fills, which the rest of it will find out for itself
+	for(std::size_t done = c.result; done < len; ){
+		done += posix_exception::check( ::pwrite( fd(), static_cast<char *>(b.iov.iov_base) + done, len - done, b.offset + done ),
+			"Error writing file", meta::type<IOError>() );
+	}
+	return true;
+}
+
+void UringFile::settle(){
+	if(!ring())
+		return;
+
+	send();
+	while(m_state.ring.queued() || m_state.ring.in_flight())
+		complete( m_state.ring.wait() );
+
+	//Writes at an offset leave the descriptor where it was, so it's moved on past them for whatever goes the ordinary way
+	FSFile::seek( m_state.offset, std::ios_base::beg );
+}
+
+void UringFile::close(){
+	if(*this && ring())
+		settle();
+	FSFile::close();
+	m_state = {};
+}
+
+std::streamsize UringFile::read( char *data, std::streamsize len ){
+	if(!ring())
+		return FSFile::read( data, len );
+
+	settle();
+	auto result = FSFile::read( data, len );
+	m_state.offset += result;
+	return result;
+}
+
+std::streamsize UringFile::readv( const ::iovec *iov, int iovcnt ){
+	if(!ring())
+		return FSFile::readv( iov, iovcnt );
+
+	settle();
+	auto result = FSFile::readv( iov, iovcnt );
+	m_state.offset += result;
+	return result;
+}
+
+std::streamsize UringFile::write( const char *data, std::streamsize len ){
+	if(!ring())
+		return FSFile::write( data, len );
+
+	if(debug())
+		std::cerr << "W(" << fd() << "): " << util::hex_format(std::string(data, len)) << std::endl;
+
+	for(auto left = len; left; ){
+		auto &b = writable();
+		if(!b.iov.iov_len)
+			b.offset = m_state.offset;
+
+		auto n = std::min<std::size_t>( left, m_state.buffer_size - b.iov.iov_len );
+		std::memcpy( static_cast<char *>(b.iov.iov_base) + b.iov.iov_len, data, n );
+		b.iov.iov_len += n;
+		m_state.offset += n;
+		data += n;
+		left -= n;
+
+		if(b.iov.iov_len == m_state.buffer_size){
+			send();
+			m_state.ring.submit();
+		}
+	}
+	return len;
+}
+
+std::streamsize UringFile::writev( const ::iovec *iov, int iovcnt ){
+	if(!ring())
+		return FSFile::writev( iov, iovcnt );
+
+	std::streamsize result = 0;
+	for(int i = 0; i < iovcnt; ++i)
+		result += write( static_cast<const char *>(iov[i].iov_base), iov[i].iov_len );
+	return result;
+}
+
+std::streamsize UringFile::seek( std::streamsize pos, std::ios_base::seekdir dir ){
+	if(!ring())
+		return FSFile::seek( pos, dir );
+
+	settle();
+	return m_state.offset = FSFile::seek( pos, dir );
+}
+
+void UringFile::flush(){
+	if(!ring())
+		return FSFile::flush();
+
+	//The last write waits for the ones before it, and the fsync for the last write
+	bool sent = send( uring::drain | uring::link );
+	m_state.ring.fsync( fd(), false, fsync_tag, sent ? 0 : uring::drain );
+
+	bool synced = true;
+	while(m_state.ring.queued() || m_state.ring.in_flight())
+		synced &= complete( m_state.ring.wait() );
+
+	//A short write breaks the link, and takes the fsync with it
+	if(!synced)
+		FSFile::flush();
+	FSFile::seek( m_state.offset, std::ios_base::beg );
+}
@@ -0,0 +1,171 @@
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <set>
+#include <map>
+#include <tuple>
+#include "concurrency/affinity.hpp"
+
+using namespace levitator::concurrency;
+
+namespace{
+
+//Empty if it isn't there
+std::string read_line( const std::string &path ){
+	std::ifstream in(path);
+	std::string result;
+	std::getline( in, result );
+	return result;
+}
+
+int read_int( const std::string &path, int otherwise ){
+	auto line = read_line(path);
+	try{
+		return line.empty() ? otherwise : std::stoi(line);
+	}
+	catch( const std::exception & ){
+		return otherwise;
+	}
+}
+
+}
+
+std::vector<int> levitator::concurrency::parse_cpu_list( const std::string &list ){
+	std::vector<int> result;
+	std::stringstream ss(list);
+	std::string range;
+	while(std::getline( ss, range, ',' )){
+		if(range.empty() || range.find_first_not_of("0123456789-") != std::string::npos)
+			throw std::invalid_argument("Bad CPU list: " + list);
+
+		auto dash = range.find('-');
+		try{
+			int first = std::stoi( range.substr(0, dash) );
+			int last = dash == std::string::npos ? first : std::stoi( range.substr(dash + 1) );
+			if(last < first)
+				throw std::invalid_argument("Bad CPU list: " + list);
+			for(int cpu = first; cpu <= last; ++cpu)
+				result.push_back(cpu);
+		}
+		catch( const std::logic_error & ){
+			throw std::invalid_argument("Bad CPU list: " + list);
+		}
+	}
+	return result;
+}
+
+CpuTopology::CpuTopology(){
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if(sched_getaffinity( 0, sizeof(allowed), &allowed ) != 0)
+		return;
+
+	//Which node each CPU is on. Node numbers can have gaps, so go by what's there.
+	std::map<int, int> node_of;
+	std::error_code ec;
+	for(auto &entry : std::filesystem::directory_iterator( "/sys/devices/system/node", ec )){
+		auto name = entry.path().filename().string();
+		if(name.size() < 5 || name.compare(0, 4, "node") || name.find_first_not_of("0123456789", 4) != std::string::npos)
+			continue;
+
+		auto list = read_line( (entry.path() / "cpulist").string() );
+		if(list.empty())
+			continue;
+		for(auto cpu : parse_cpu_list(list))
+			node_of[cpu] = std::stoi( name.substr(4) );
+	}
+
+	//Hardware threads of a core are numbered in CPU order
+	std::map<std::tuple<int, int>, int> threads_seen;
+	for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu){
+		if(!CPU_ISSET( cpu, &allowed ))
+			continue;
+
+		auto dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+		cpu_info info{ cpu };
+		info.node = node_of.contains(cpu) ? node_of[cpu] : 0;
+		info.package = read_int( dir + "physical_package_id", 0 );
+		info.core = read_int( dir + "core_id", cpu );
+		info.smt = threads_seen[{ info.package, info.core }]++;
+		m_cpus.push_back(info);
+	}
+}
+
+const CpuTopology &CpuTopology::system(){
+	static const CpuTopology result;
+	return result;
+}
+
+std::size_t CpuTopology::nodes() const{
+	std::set<int> result;
+	for(auto &c : m_cpus)
+		result.insert(c.node);
+	return result.size();
+}
+
+Affinity Affinity::compact( const CpuTopology &topology ){
+	auto cpus = topology.cpus();
+	std::sort( cpus.begin(), cpus.end(), [](const auto &a, const auto &b){
+		return std::tie(a.node, a.package, a.core, a.smt) < std::tie(b.node, b.package, b.core, b.smt);
+	});
+
+	std::vector<int> order;
+	for(auto &c : cpus)
+		order.push_back(c.cpu);
+	return { std::move(order) };
+}
+
+Affinity Affinity::scatter( const CpuTopology &topology ){
+	//Each node's CPUs, first hardware threads first, then deal one from each node in turn
+	std::map<int, std::vector<cpu_info>> by_node;
+	for(auto &c : topology.cpus())
+		by_node[c.node].push_back(c);
+	for(auto &[node, cpus] : by_node){
+		std::sort( cpus.begin(), cpus.end(), [](const auto &a, const auto &b){
+			return std::tie(a.smt, a.package, a.core) < std::tie(b.smt, b.package, b.core);
+		});
+	}
+
+	std::vector<int> order;
+	for(std::size_t i = 0; order.size() < topology.cpus().size(); ++i){
+		for(auto &[node, cpus] : by_node){
+			if(i < cpus.size())
+				order.push_back( cpus[i].cpu );
+		}
+	}
+	return { std::move(order) };
+}
+
+Affinity Affinity::cpus( std::vector<int> list ){
+	for(auto cpu : list){
+		if(cpu < 0 || cpu >= CPU_SETSIZE)
+			throw std::invalid_argument("No such CPU: " + std::to_string(cpu));
+	}
+	return { std::move(list) };
+}
+
+Affinity Affinity::parse( const std::string &spec ){
+	if(spec == "none")
+		return {};
+	if(spec == "compact")
+		return compact();
+	if(spec == "scatter")
+		return scatter();
+	return cpus( parse_cpu_list(spec) );
+}
+
+bool Affinity::pin( std::size_t index ) const{
+	auto cpu = cpu_for(index);
+	if(cpu < 0)
+		return true;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET( cpu, &set );
+	return pthread_setaffinity_np( pthread_self(), sizeof(set), &set ) == 0;
+}
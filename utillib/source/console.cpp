@@ -1,3 +1,5 @@
+#include <memory>
+#include <vector>
 #include "exception.hpp"
 #include "concurrency/concurrency.hpp"
 #include "console.hpp"
@@ -11,8 +13,6 @@ Console jab::util::console;
 
 void Console::init(){
 	in_stream_pointer = &std::cin;
-	out_stream_pointer = &std::cout;
-	error_stream_pointer = &std::cerr;
 }
 
 Console::in_type Console::in(){
@@ -26,43 +26,94 @@ Console::err_type Console::err(){
 	return { *this };
 }
 
-ConsoleOutBuffer::ConsoleOutBuffer( Console &cons ):
-	base_type(cons){}
+namespace{
+thread_local std::vector<std::unique_ptr<impl::FormatBuffer>> t_spare_buffers;
+}
 
-ConsoleOutBuffer::ConsoleOutBuffer( const ConsoleOutBuffer &rhs ):
-	base_type(*rhs.p_console){
+impl::FormatStreambuf::int_type impl::FormatStreambuf::overflow( int_type c ){
+	if(!traits_type::eq_int_type( c, traits_type::eof() ))
+		m_text.push_back( traits_type::to_char_type(c) );
+	return traits_type::not_eof(c);
+}
 
+std::streamsize impl::FormatStreambuf::xsputn( const char_type *s, std::streamsize n ){
+	m_text.append( s, n );
+	return n;
 }
 
-ConsoleOutBuffer::ConsoleOutBuffer( ConsoleOutBuffer &&rhs ):
-	ConsoleOutBuffer(rhs){
+impl::FormatBuffer::FormatBuffer():
+	m_stream(&m_buf){}
+
+impl::FormatBuffer *impl::FormatBuffer::acquire(){
+	if(t_spare_buffers.empty())
+		return new FormatBuffer;
+
+	auto result = t_spare_buffers.back().release();
+	t_spare_buffers.pop_back();
+	return result;
+}
+
+void impl::FormatBuffer::release( FormatBuffer *buffer ){
+	static const std::ios defaults(nullptr);
+
+	buffer->m_buf.clear();
+	buffer->m_stream.clear();
+	buffer->m_stream.copyfmt(defaults);
+	t_spare_buffers.emplace_back(buffer);
 }
 
 ConsoleOutBuffer::~ConsoleOutBuffer(){
-	p_console->queue_out( p_sstream.str() );
+	if(p_buffer)
+		p_console->queue_out( p_buffer->text() );
 }
 
-ConsoleErrBuffer::ConsoleErrBuffer( Console &cons ):
-	base_type(cons){}
+ConsoleErrBuffer::~ConsoleErrBuffer(){
+	if(p_buffer)
+		p_console->queue_err( p_buffer->text() );
+}
 
-ConsoleErrBuffer::ConsoleErrBuffer( const ConsoleErrBuffer &rhs ):
-	base_type(*rhs.p_console){
+//Back to the start of the line, and blank it
+static constexpr std::string_view clear_line = "\r\x1b[K";
+
+bool Console::take_status_line(){
+	return m_status_shown.load(std::memory_order_relaxed) && m_status_shown.exchange(false);
 }
 
-ConsoleErrBuffer::ConsoleErrBuffer( ConsoleErrBuffer &&rhs ):
-	ConsoleErrBuffer(rhs){
+//The clear and the message go in one record, so that no other thread's output or status gets between them
+void Console::queue_out( std::string_view msg ){
+	if(!take_status_line())
+		return m_log.write( out_fd, msg );
+
+	std::string line(clear_line);
+	line.append(msg);
+	m_log.write( out_fd, line );
 }
 
-ConsoleErrBuffer::~ConsoleErrBuffer(){
-	p_console->queue_err( p_sstream.str() );
+//The status is on the other descriptor, so it has to be cleared in a record of its own
+void Console::queue_err( std::string_view msg ){	
+	if(take_status_line())
+		m_log.write( out_fd, clear_line );
+	m_log.write( error_fd, msg );
 }
 
-void Console::queue_out( const std::string &msg ){
-	m_queue.push( jab::util::impl::make_console_output_task(out_stream_pointer, msg ) );
+void Console::flush(){
+	m_log.flush();
 }
 
-void Console::queue_err( const std::string &msg ){	
-	m_queue.push( jab::util::impl::make_console_output_task(error_stream_pointer, msg ) );
+void Console::status( std::string_view text ){
+	std::string line = "\r";
+	line.append(text);
+	line += "\x1b[K";
+
+	//Set first, so that any message queued once the line's in the ring clears it. Set after, one could go in behind
+	//the line unseen, and land on the end of it.
+	m_status_shown = true;
+	m_log.write( out_fd, line );
+}
+
+void Console::clear_status(){
+	if(take_status_line())
+		m_log.write( out_fd, clear_line );
 }
 
 ConsoleStreamBase::ConsoleStreamBase(Console &cons):p_console(&cons){
@@ -95,16 +146,6 @@ void EllipsisGuard::ok(){
 	outcome( m_success_string );
 }
 
-void ConsoleErrorHandler::operator()( const std::exception_ptr &ptr ) const{
-	try{
-		std::rethrow_exception(ptr);
-	}
-	catch(const std::exception &ex){
-		std::cerr << "Unexpected exception in Console I/O thread. That should never happen..." << std::endl;
-		std::cerr << ex << std::endl;
-	}
-}
-
 //Doesn't really make sense here, but it also doesn't make sense to create an object module for two functions
 DefaultBackgroundExceptionHandler::DefaultBackgroundExceptionHandler( const std::string &msg ):
 	m_msg(msg){}
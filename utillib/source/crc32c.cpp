@@ -0,0 +1,129 @@
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include "crc32c.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+using namespace jab::util;
+
+namespace{
+
+constexpr std::uint32_t polynomial = 0x82f63b78;	//Castagnoli, bit-reversed
+
+using table_type = std::array<std::array<std::uint32_t, 256>, 8>;
+
+//Table n covers a byte which is followed by n more bytes in the same 8-byte slice
+constexpr table_type make_tables(){
+	table_type result{};
+
+	for(std::uint32_t i = 0; i < 256; ++i){
+		std::uint32_t crc = i;
+		for(int bit = 0; bit < 8; ++bit)
+			crc = (crc >> 1) ^ (crc & 1 ? polynomial : 0);
+		result[0][i] = crc;
+	}
+
+	for(std::size_t n = 1; n < result.size(); ++n){
+		for(std::uint32_t i = 0; i < 256; ++i)
+			result[n][i] = (result[n-1][i] >> 8) ^ result[0][ result[n-1][i] & 0xff ];
+	}
+
+	return result;
+}
+
+constexpr table_type tables = make_tables();
+
+std::uint32_t table_impl( const unsigned char *p, std::size_t len, std::uint32_t crc ){
+	
+	while(len >= 8){
+		std::uint32_t lo, hi;
+		std::memcpy(&lo, p, 4);
+		std::memcpy(&hi, p + 4, 4);
+		lo ^= crc;
+
+		crc = tables[7][lo & 0xff] ^ tables[6][(lo >> 8) & 0xff] ^ tables[5][(lo >> 16) & 0xff] ^ tables[4][lo >> 24] ^
+			tables[3][hi & 0xff] ^ tables[2][(hi >> 8) & 0xff] ^ tables[1][(hi >> 16) & 0xff] ^ tables[0][hi >> 24];
+
+		p += 8;
+		len -= 8;
+	}
+
+	while(len--)
+		crc = (crc >> 8) ^ tables[0][ (crc ^ *p++) & 0xff ];
+
+	return crc;
+}
+
+#ifdef CRC32C_HAVE_SSE42
+__attribute__((target("sse4.2")))
+std::uint32_t sse42_impl( const unsigned char *p, std::size_t len, std::uint32_t crc ){
+
+	//Get aligned for the 8-byte instruction
+	while( len && reinterpret_cast<std::uintptr_t>(p) & 7 ){
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+		--len;
+	}
+
+#ifdef __x86_64__
+	std::uint64_t crc64 = crc;
+	while(len >= 8){
+		std::uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		crc64 = __builtin_ia32_crc32di(crc64, v);
+		p += 8;
+		len -= 8;
+	}
+	crc = static_cast<std::uint32_t>(crc64);
+#endif
+
+	while(len >= 4){
+		std::uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		crc = __builtin_ia32_crc32si(crc, v);
+		p += 4;
+		len -= 4;
+	}
+
+	while(len--)
+		crc = __builtin_ia32_crc32qi(crc, *p++);
+
+	return crc;
+}
+#endif
+
+using impl_type = std::uint32_t (*)( const unsigned char *, std::size_t, std::uint32_t );
+
+impl_type select_impl(){
+#ifdef CRC32C_HAVE_SSE42
+	if(__builtin_cpu_supports("sse4.2"))
+		return sse42_impl;
+#endif
+	return table_impl;
+}
+
+const impl_type crc32c_impl = select_impl();
+
+}
+
+std::uint32_t jab::util::crc32c( const void *data, std::size_t len, std::uint32_t crc ){
+	return ~crc32c_impl( static_cast<const unsigned char *>(data), len, ~crc );
+}
+
+bool jab::util::crc32c_hardware(){
+	return crc32c_impl != table_impl;
+}
+
+std::uint32_t jab::util::crc32c_software( const void *data, std::size_t len, std::uint32_t crc ){
+	return ~table_impl( static_cast<const unsigned char *>(data), len, ~crc );
+}
+
+std::uint32_t jab::util::crc32c_sse42( const void *data, std::size_t len, std::uint32_t crc ){
+#ifdef CRC32C_HAVE_SSE42
+	return ~sse42_impl( static_cast<const unsigned char *>(data), len, ~crc );
+#else
+	throw std::logic_error("No SSE4.2 CRC32C on this architecture");
+#endif
+}
@@ -0,0 +1,182 @@
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include "event_log.hpp"
+
+using namespace levitator;
+using namespace jab::file;
+
+namespace{
+
+std::uint64_t now_ns(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+}
+
+std::filesystem::path EventLog::rotated_path( const std::filesystem::path &path, unsigned n ){
+	auto result = path;
+	result += "." + std::to_string(n);
+	return result;
+}
+
+EventLog::EventLog( const std::filesystem::path &path, const options &opts ):
+	m_path(path),
+	m_options(opts){
+
+	std::error_code ec;
+	if(std::filesystem::file_size( m_path, ec ) > 0 && !ec)
+		rotate();
+	else
+		open();
+}
+
+EventLog::~EventLog(){
+	//Nowhere left to report a failure to
+	try{
+		flush();
+	}
+	catch( const std::exception & ){
+	}
+}
+
+void EventLog::open(){
+	m_file = UringFile( m_path, w | create | trunc );
+	m_size = 0;
+
+	event_log_header header;
+	std::memcpy( header.magic, event_log_header::magic_text, sizeof(header.magic) );
+	m_file.write_exactly( reinterpret_cast<const char *>(&header), sizeof(header) );
+	m_size += sizeof(header);
+
+	for(std::uint32_t id = 0; id < m_names.size(); ++id)
+		write_name( id, m_names[id] );
+}
+
+void EventLog::rotate(){
+	m_file.close();
+
+	std::error_code ec;
+	if(!m_options.keep)
+		std::filesystem::remove( m_path, ec );
+	else{
+		for(auto n = m_options.keep; n > 1; --n)
+			std::filesystem::rename( rotated_path(m_path, n - 1), rotated_path(m_path, n), ec );
+		std::filesystem::rename( m_path, rotated_path(m_path, 1), ec );
+	}
+	open();
+}
+
+void EventLog::write_records( const event_record *records, std::size_t count ){
+	auto bytes = count * sizeof(event_record);
+	m_file.write_exactly( reinterpret_cast<const char *>(records), bytes );
+	m_size += bytes;
+}
+
+void EventLog::write_name( std::uint32_t id, std::string_view name ){
+	//As many records as it takes, in order. The last is padded out with nulls.
+	std::vector<event_record> records;
+	do{
+		event_record r;
+		r.subject = id;
+		r.type = event_record::name_type;
+		auto n = std::min( name.size(), event_record::name_chunk );
+		std::memcpy( &r.a, name.data(), n );
+		records.push_back(r);
+		name.remove_prefix(n);
+	}while(!name.empty());
+
+	write_records( records.data(), records.size() );
+}
+
+std::uint32_t EventLog::intern( std::string_view name ){
+	std::lock_guard lock(m_file_mutex);
+	auto [it, fresh] = m_ids.try_emplace( std::string(name), std::uint32_t(m_names.size()) );
+	if(fresh){
+		m_names.emplace_back(name);
+		write_name( it->second, name );
+	}
+	return it->second;
+}
+
+EventLog::Buffer &EventLog::buffer(){
+	if(auto result = m_cache.find<Buffer>())
+		return *result;
+
+	std::lock_guard lock(m_buffers_mutex);
+	auto &result = m_buffers.emplace_back( std::uint16_t(m_buffers.size() + 1) );
+	m_cache.put(result);
+	return result;
+}
+
+void EventLog::drain( Buffer &buffer ){
+	if(buffer.records.empty())
+		return;
+
+	std::lock_guard lock(m_file_mutex);
+	write_records( buffer.records.data(), buffer.records.size() );
+	buffer.records.clear();
+	if(m_options.max_bytes && m_size >= m_options.max_bytes)
+		rotate();
+}
+
+void EventLog::record( std::uint16_t type, std::uint32_t subject, std::int64_t a, std::int64_t b ){
+	auto &buf = buffer();
+	std::lock_guard lock(buf.mutex);
+	buf.records.push_back( { now_ns(), subject, type, buf.thread, a, b } );
+	if(buf.records.size() >= buffer_records)
+		drain(buf);
+}
+
+void EventLog::flush(){
+	std::lock_guard lock(m_buffers_mutex);
+	for(auto &buf : m_buffers){
+		std::lock_guard buffer_lock(buf.mutex);
+		drain(buf);
+	}
+
+	std::lock_guard file_lock(m_file_mutex);
+	m_file.settle();
+}
+
+EventLogReader::EventLogReader( const std::filesystem::path &path ):
+	m_file( path, r ),
+	m_buffer(EventLog::buffer_records){
+
+	event_log_header header;
+	auto ct = m_file.read_exactly( reinterpret_cast<char *>(&header), sizeof(header) );
+	if(ct != sizeof(header) || std::memcmp( header.magic, event_log_header::magic_text, sizeof(header.magic) ))
+		throw std::runtime_error("Not an event log: " + path.string());
+	if(header.version != event_log_header::current_version || header.record_size != sizeof(event_record))
+		throw std::runtime_error("Unsupported event log version " + std::to_string(header.version) + ": " + path.string());
+}
+
+bool EventLogReader::fill(){
+	//A record cut short, as by a crash partway through a write, is dropped
+	auto ct = m_file.read_exactly( reinterpret_cast<char *>(m_buffer.data()), m_buffer.size() * sizeof(event_record) );
+	m_next = 0;
+	m_end = ct / sizeof(event_record);
+	return m_end;
+}
+
+bool EventLogReader::next( event_record &record ){
+	while(m_next < m_end || fill()){
+		auto &r = m_buffer[m_next++];
+		if(r.type != event_record::name_type){
+			record = r;
+			return true;
+		}
+
+		if(r.subject >= m_names.size())
+			m_names.resize( r.subject + 1 );
+		auto text = reinterpret_cast<const char *>(&r.a);
+		m_names[r.subject].append( text, strnlen( text, event_record::name_chunk ) );
+	}
+	return false;
+}
+
+const std::string &EventLogReader::name( std::uint32_t id ) const{
+	static const std::string none;
+	return id < m_names.size() ? m_names[id] : none;
+}
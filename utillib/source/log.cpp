@@ -0,0 +1,87 @@
+#include <mutex>
+#include <array>
+#include <stdexcept>
+#include "log.hpp"
+
+using namespace jab::util;
+
+namespace{
+
+constexpr std::array<std::string_view, 6> level_names{ "trace", "debug", "info", "warn", "error", "off" };
+
+//Function statics, since channels register from other files' static initialisers
+std::mutex &registry_mutex(){
+	static std::mutex result;
+	return result;
+}
+
+LogChannel *&registry_head(){
+	static LogChannel *result = nullptr;
+	return result;
+}
+
+}
+
+log_level jab::util::parse_log_level( std::string_view name ){
+	for(std::size_t i = 0; i < level_names.size(); ++i){
+		if(level_names[i] == name)
+			return log_level(i);
+	}
+	throw std::invalid_argument("No such log level: " + std::string(name));
+}
+
+std::string_view jab::util::log_level_name( log_level level ){
+	auto i = std::size_t(level);
+	return i < level_names.size() ? level_names[i] : "unknown";
+}
+
+LogChannel::LogChannel( const char *name, log_level level ):
+	m_name(name),
+	m_level(level){
+
+	std::lock_guard lock( registry_mutex() );
+	m_next = registry_head();
+	registry_head() = this;
+}
+
+LogChannel *LogChannel::find( std::string_view name ){
+	std::lock_guard lock( registry_mutex() );
+	for(auto c = registry_head(); c; c = c->m_next){
+		if(name == c->m_name)
+			return c;
+	}
+	return nullptr;
+}
+
+void LogChannel::configure( std::string_view spec ){
+	while(!spec.empty()){
+		auto comma = spec.find(',');
+		auto item = spec.substr(0, comma);
+		spec.remove_prefix( comma == std::string_view::npos ? spec.size() : comma + 1 );
+
+		auto equals = item.find('=');
+		if(equals == std::string_view::npos){
+			auto level = parse_log_level(item);
+			std::lock_guard lock( registry_mutex() );
+			for(auto c = registry_head(); c; c = c->m_next)
+				c->level(level);
+			continue;
+		}
+
+		auto channel = find( item.substr(0, equals) );
+		if(!channel)
+			throw std::invalid_argument("No such log channel: " + std::string( item.substr(0, equals) ));
+		channel->level( parse_log_level( item.substr(equals + 1) ) );
+	}
+}
+
+std::string LogChannel::names(){
+	std::lock_guard lock( registry_mutex() );
+	std::string result;
+	for(auto c = registry_head(); c; c = c->m_next){
+		if(!result.empty())
+			result += ", ";
+		result += c->m_name;
+	}
+	return result;
+}
@@ -0,0 +1,140 @@
+#include <sys/uio.h>
+#include <unistd.h>
+#include <limits.h>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include "concurrency/log_ring.hpp"
+
+using namespace levitator::concurrency;
+
+namespace{
+
+std::atomic<std::uint32_t> next_producer = 0;
+thread_local const std::uint32_t t_producer = next_producer.fetch_add(1);
+
+//Whatever stdio is holding for fd has to go first
+void flush_stdio( int fd ){
+	if(fd == STDOUT_FILENO)
+		std::fflush(stdout);
+	else if(fd == STDERR_FILENO)
+		std::fflush(stderr);
+}
+
+//All of it, however many goes that takes. Log output has nowhere to report its own failure, so that's dropped.
+void write_all( int fd, iovec *iov, std::size_t count ){
+	while(count){
+		auto result = ::writev( fd, iov, int( std::min<std::size_t>(count, IOV_MAX) ) );
+		if(result < 0){
+			if(errno == EINTR)
+				continue;
+			return;
+		}
+
+		auto done = std::size_t(result);
+		while(count && done >= iov->iov_len){
+			done -= iov->iov_len;
+			++iov;
+			--count;
+		}
+		if(count){
+			iov->iov_base = static_cast<char *>(iov->iov_base) + done;
+			iov->iov_len -= done;
+		}
+	}
+}
+
+}
+
+LogRing::LogRing( std::size_t capacity ):
+	m_ring(capacity),
+	m_batch(batch_size){
+	m_thread = std::thread( &LogRing::thread_proc, this );
+}
+
+LogRing::~LogRing(){
+	m_ring.push( log_record() );
+	m_thread.join();
+}
+
+void LogRing::write( int fd, std::string_view text ){
+	std::uint64_t records = 0;
+	do{
+		auto n = std::min( text.size(), log_record::text_size );
+		m_ring.push( log_record( t_producer, fd, text.data(), n, n < text.size() ) );
+		text.remove_prefix(n);
+		++records;
+	}while(!text.empty());
+
+	m_pushed.fetch_add(records);
+}
+
+void LogRing::flush(){
+	auto target = m_pushed.load();
+	if(m_written.load() >= target)
+		return;
+
+	std::unique_lock lock(m_flush_mutex);
+	++m_flushers;
+	m_flush_cv.wait( lock, [&](){ return m_written.load() >= target; } );
+	--m_flushers;
+}
+
+void LogRing::thread_proc(){
+	bool stop = false;
+	while(!stop){
+		auto count = m_ring.pop_n( m_batch.begin(), m_batch.size() );
+
+		//Anything after the stop record was written too late, so it can go with it
+		auto end = std::find_if( m_batch.begin(), m_batch.begin() + count, [](const auto &r){ return r.fd < 0; } );
+		stop = end != m_batch.begin() + count;
+		write_batch( end - m_batch.begin() );
+
+		m_written.fetch_add(count);
+		if(m_flushers.load()){
+			std::lock_guard lock(m_flush_mutex);
+			m_flush_cv.notify_all();
+		}
+	}
+}
+
+void LogRing::write_batch( std::size_t count ){
+	//Whole messages only, so a long one from one thread can't have another's text in the middle of it
+	auto &iov = m_iov;
+	iov.clear();
+	m_joined.clear();
+	m_joined.reserve(count);
+
+	int fd = -1;
+	auto flush_run = [&](){
+		if(!iov.empty()){
+			flush_stdio(fd);
+			write_all( fd, iov.data(), iov.size() );
+			iov.clear();
+		}
+	};
+
+	for(std::size_t i = 0; i < count; ++i){
+		auto &r = m_batch[i];
+		if(r.more){
+			m_partial[r.producer].append( r.text, r.length );
+			continue;
+		}
+
+		if(r.fd != fd){
+			flush_run();
+			fd = r.fd;
+		}
+
+		auto partial = m_partial.find(r.producer);
+		if(partial != m_partial.end()){
+			partial->second.append( r.text, r.length );
+			auto &joined = m_joined.emplace_back( std::move(partial->second) );
+			m_partial.erase(partial);
+			iov.push_back( { joined.data(), joined.size() } );
+		}
+		else
+			iov.push_back( { r.text, r.length } );
+	}
+	flush_run();
+}
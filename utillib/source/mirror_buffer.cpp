@@ -0,0 +1,61 @@
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+#include <algorithm>
+#include "exception.hpp"
+#include "util.hpp"
+#include "mirror_buffer.hpp"
+
+using namespace jab::io;
+using namespace jab::exception;
+using namespace jab;
+
+mirror_buffer::mirror_buffer( std::size_t min_size ){
+	const std::size_t page = ::sysconf(_SC_PAGESIZE);
+	auto size = std::max( page, (min_size + page - 1) / page * page );
+
+	int fd = posix_exception::check( ::memfd_create( "mirror_buffer", MFD_CLOEXEC ), "Failed creating memfd", meta::type<IOError>() );
+	util::Guard close_fd( [fd](){ ::close(fd); } );
+	posix_exception::check( ::ftruncate( fd, size ), "Failed sizing memfd", meta::type<IOError>() );
+
+	//Reserve room for both copies, so nothing else can be mapped between them, then map the memfd over each half
+	auto base = ::mmap( nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	posix_exception::check( base, "Failed reserving mirror mapping", meta::type<IOError>(), MAP_FAILED );
+	m_data = static_cast<char *>(base);
+	m_size = size;
+
+	for(auto copy : { m_data, m_data + size }){
+		auto mapped = ::mmap( copy, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0 );
+		try{
+			posix_exception::check( mapped, "Failed mapping memfd", meta::type<IOError>(), MAP_FAILED );
+		}
+		catch(...){
+			release();
+			throw;
+		}
+	}
+}
+
+mirror_buffer::~mirror_buffer(){
+	release();
+}
+
+mirror_buffer::mirror_buffer( mirror_buffer &&rhs ):
+	m_data( std::exchange(rhs.m_data, nullptr) ),
+	m_size( std::exchange(rhs.m_size, 0) ){}
+
+mirror_buffer &mirror_buffer::operator=( mirror_buffer &&rhs ){
+	if(this != &rhs){
+		release();
+		m_data = std::exchange(rhs.m_data, nullptr);
+		m_size = std::exchange(rhs.m_size, 0);
+	}
+	return *this;
+}
+
+void mirror_buffer::release(){
+	if(m_data)
+		::munmap( m_data, 2 * m_size );
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,86 @@
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include "concurrency/pool_stats.hpp"
+
+using namespace levitator::concurrency;
+using namespace levitator::concurrency::stats;
+
+namespace{
+
+//Nanoseconds in whichever unit keeps it readable
+struct duration_text{
+	double ns;
+};
+
+std::ostream &operator<<( std::ostream &os, duration_text d ){
+	auto flags = os.flags();
+	os << std::fixed << std::setprecision(1);
+	if(d.ns < 1e3)
+		os << d.ns << "ns";
+	else if(d.ns < 1e6)
+		os << d.ns / 1e3 << "us";
+	else if(d.ns < 1e9)
+		os << d.ns / 1e6 << "ms";
+	else
+		os << d.ns / 1e9 << "s";
+	os.flags(flags);
+	return os;
+}
+
+}
+
+std::uint64_t histogram_snapshot::percentile( double p ) const{
+	if(!count)
+		return 0;
+
+	auto rank = std::uint64_t( p * count );
+	std::uint64_t seen = 0;
+	for(std::size_t b = 0; b < counts.size(); ++b){
+		seen += counts[b];
+		if(seen > rank)
+			return b ? std::min( max, (b < 64 ? (std::uint64_t(1) << b) : 0) - 1 ) : 0;
+	}
+	return max;
+}
+
+std::ostream &levitator::concurrency::stats::operator<<( std::ostream &os, const histogram_snapshot &h ){
+	return os << "n=" << h.count << " mean=" << duration_text{ h.mean() }
+		<< " p50<=" << duration_text{ double(h.percentile(0.5)) }
+		<< " p99<=" << duration_text{ double(h.percentile(0.99)) }
+		<< " max=" << duration_text{ double(h.max) };
+}
+
+std::ostream &levitator::concurrency::stats::operator<<( std::ostream &os, const queue_snapshot &q ){
+	os << "queue: " << q.pushed << " pushed, " << q.popped << " popped, depth " << q.depth << " (max " << q.max_depth
+		<< ", mean at push " << std::fixed << std::setprecision(1) << q.depth_at_push.mean() << std::defaultfloat << ")"
+		<< ", mean wait " << duration_text{ q.mean_wait_ns() } << std::endl;
+	return os << "  lock wait: " << q.lock_wait << std::endl;
+}
+
+std::ostream &levitator::concurrency::stats::operator<<( std::ostream &os, const pool_snapshot &p ){
+	if(!p.enabled)
+		return os << "Pool statistics not built in. Build with -DLEVITATOR_POOL_STATS=1 for them." << std::endl;
+
+	os << "pool: " << p.threads << " threads";
+	if(p.steals || p.failed_steals)
+		os << ", " << p.steals << " steals, " << p.failed_steals << " failed";
+	os << std::endl;
+	os << "  run time: " << p.run_time << std::endl;
+	os << "  idle time: " << p.idle_time << std::endl;
+	if(p.queue.pushed)
+		os << "  " << p.queue;
+
+	for(auto &w : p.workers){
+		auto total = double(w.idle + w.busy);
+		os << "  thread " << w.id << ": " << w.tasks << " tasks, busy " << duration_text{ double(w.busy) }
+			<< ", idle " << duration_text{ double(w.idle) };
+		if(total)
+			os << " (" << std::fixed << std::setprecision(0) << 100 * w.idle / total << std::defaultfloat << "% idle)";
+		os << std::endl;
+	}
+	if(p.retired.tasks)
+		os << "  finished threads: " << p.retired.tasks << " tasks, busy " << duration_text{ double(p.retired.busy) }
+			<< ", idle " << duration_text{ double(p.retired.idle) } << std::endl;
+	return os;
+}
@@ -0,0 +1,251 @@
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include "exception.hpp"
+#include "reactor.hpp"
+
+using namespace levitator;
+using namespace jab::exception;
+using namespace jab;
+
+static_assert( Reactor::readable == std::uint32_t(EPOLLIN) && Reactor::writable == std::uint32_t(EPOLLOUT) && Reactor::error == std::uint32_t(EPOLLERR) && Reactor::hangup == std::uint32_t(EPOLLHUP) );
+
+//Which of a descriptor's two arms one for events is
+static std::uint32_t side( std::uint32_t events ){
+	return (events & Reactor::readable) ? Reactor::readable : Reactor::writable;
+}
+
+Reactor::Reactor( duration_type timer_resolution ):
+	m_epoll_fd( posix_exception::check( ::epoll_create1( EPOLL_CLOEXEC ), "Failed creating epoll set", meta::type<IOError>() ) ),
+	m_wake_fd( -1 ),
+	m_scheduler( scheduler_type::external, timer_resolution ){
+
+	try{
+		m_wake_fd = posix_exception::check( ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ), "Failed creating eventfd", meta::type<IOError>() );
+
+		//These two are level-triggered and stay armed, since they're drained every time they're seen
+		for(auto fd : { m_wake_fd, m_scheduler.fd() }){
+			epoll_event ev{};
+			ev.events = EPOLLIN;
+			ev.data.fd = fd;
+			posix_exception::check( ::epoll_ctl( m_epoll_fd, EPOLL_CTL_ADD, fd, &ev ), "Failed adding to epoll set", meta::type<IOError>() );
+		}
+	}
+	catch(...){
+		if(m_wake_fd != -1)
+			::close(m_wake_fd);
+		::close(m_epoll_fd);
+		throw;
+	}
+}
+
+Reactor::~Reactor(){
+	::close(m_wake_fd);
+	::close(m_epoll_fd);
+}
+
+void Reactor::control( int op, int fd, std::uint32_t events ){
+	epoll_event ev{};
+	ev.events = events | EPOLLET | EPOLLONESHOT;
+	ev.data.fd = fd;
+	posix_exception::check( ::epoll_ctl( m_epoll_fd, op, fd, &ev ), "Failed changing epoll set", meta::type<IOError>() );
+}
+
+void Reactor::add( int fd ){
+	std::lock_guard lock(m_mutex);
+	if(!m_watches.try_emplace(fd).second)
+		throw std::invalid_argument("Descriptor " + std::to_string(fd) + " is already in the reactor");
+
+	try{
+		control( EPOLL_CTL_ADD, fd, 0 );
+	}
+	catch(...){
+		m_watches.erase(fd);
+		throw;
+	}
+}
+
+void Reactor::remove( int fd ){
+	std::lock_guard lock(m_mutex);
+	auto i = m_watches.find(fd);
+	if(i == m_watches.end())
+		return;
+	for(auto &arm : i->second.arms){
+		if(arm.deadline)
+			m_scheduler.cancel( *arm.deadline );
+	}
+	m_watches.erase(i);
+
+	//Closing a descriptor takes it out of the set anyway
+	if(::epoll_ctl( m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr ) == -1 && errno != EBADF && errno != ENOENT)
+		throw posix_exception("Failed removing from epoll set");
+}
+
+bool Reactor::contains( int fd ){
+	std::lock_guard lock(m_mutex);
+	return m_watches.count(fd);
+}
+
+//One-shot goes for the whole descriptor, so whatever's still armed once some of it has gone off is asked for again
+void Reactor::rearm( int fd, const Watch &watch ){
+	std::uint32_t events = 0;
+	for(auto &arm : watch.arms)
+		events |= arm.events;
+	control( EPOLL_CTL_MOD, fd, events );
+}
+
+void Reactor::place( int fd, Arm arm, std::optional<time_type> deadline ){
+	std::lock_guard lock(m_mutex);
+	auto i = m_watches.find(fd);
+	if(i == m_watches.end())
+		throw std::invalid_argument("Descriptor " + std::to_string(fd) + " isn't in the reactor");
+
+	auto &arms = i->second.arms;
+	if(!arm.waiter){
+		std::erase_if( arms, [this, &arm](const Arm &old){
+			if(old.waiter || side(old.events) != side(arm.events))
+				return false;
+			if(old.deadline)
+				m_scheduler.cancel( *old.deadline );
+			return true;
+		});
+	}
+
+	auto serial = arm.serial = ++m_next_serial;
+	if(deadline)
+		arm.deadline = m_scheduler.schedule( *deadline, [this, fd, serial](){ expire(fd, serial); } );
+	arms.push_back( std::move(arm) );
+	rearm( fd, i->second );
+}
+
+void Reactor::arm( int fd, std::uint32_t events, handler_type handler, std::optional<time_type> deadline ){
+	place( fd, Arm{ events, std::move(handler), {}, 0, false }, deadline );
+}
+
+//Takes the handlers out under the lock, so that each is run once however the readiness and the deadlines race.
+//Errors and hangups go to everything armed, since nothing's going to be any more ready than that.
+std::size_t Reactor::ready_now( int fd, std::uint32_t events ){
+	std::vector<handler_type> handlers;
+	{
+		std::lock_guard lock(m_mutex);
+		auto i = m_watches.find(fd);
+		if(i == m_watches.end())
+			return 0;
+		std::erase_if( i->second.arms, [&](Arm &arm){
+			if(!(events & (arm.events | error | hangup)))
+				return false;
+			if(arm.deadline)
+				m_scheduler.cancel( *arm.deadline );
+			handlers.push_back( std::move(arm.handler) );
+			return true;
+		});
+		if(!i->second.arms.empty())
+			rearm( fd, i->second );
+	}
+	for(auto &handler : handlers)
+		handler(events);
+	return handlers.size();
+}
+
+void Reactor::expire( int fd, std::uint64_t serial ){
+	handler_type handler;
+	{
+		std::lock_guard lock(m_mutex);
+		auto i = m_watches.find(fd);
+		if(i == m_watches.end())
+			return;
+		auto &arms = i->second.arms;
+		auto arm = std::find_if( arms.begin(), arms.end(), [serial](const Arm &a){ return a.serial == serial; } );
+		if(arm == arms.end())
+			return;
+		handler = std::move(arm->handler);
+		arms.erase(arm);
+		rearm( fd, i->second );
+	}
+	handler(timed_out);
+}
+
+std::uint32_t Reactor::wait( int fd, std::uint32_t events, std::optional<time_type> deadline ){
+	if(std::this_thread::get_id() == m_loop_thread)
+		throw std::logic_error("Waiting on a reactor from its own thread");
+
+	auto result = std::make_shared<std::promise<std::uint32_t>>();
+	auto future = result->get_future();
+	place( fd, Arm{ events, [result](std::uint32_t ready){ result->set_value(ready); }, {}, 0, true }, deadline );
+	return future.get();
+}
+
+bool Reactor::can_wait() const{
+	auto loop = m_loop_thread.load();
+	return loop != std::thread::id() && loop != std::this_thread::get_id();
+}
+
+timer_id Reactor::schedule_after( duration_type delay, task_type task ){
+	return m_scheduler.schedule_after( delay, std::move(task) );
+}
+
+bool Reactor::cancel( timer_id id ){
+	return m_scheduler.cancel(id);
+}
+
+std::size_t Reactor::run_once( std::optional<duration_type> timeout ){
+	//Says who's running the loop for as long as it is, for wait() and can_wait()
+	struct loop_guard{
+		std::atomic<std::thread::id> &loop;
+		std::thread::id previous = loop.exchange( std::this_thread::get_id() );
+		~loop_guard(){ loop = previous; }
+	} guard{ m_loop_thread };
+
+	int ms = -1;
+	if(timeout)
+		ms = int( std::chrono::ceil<std::chrono::milliseconds>(*timeout).count() );
+
+	epoll_event ready[max_events];
+	int n = ::epoll_wait( m_epoll_fd, ready, max_events, ms );
+	if(n == -1){
+		if(errno == EINTR)
+			return 0;
+		throw posix_exception("Failed waiting on epoll set");
+	}
+
+	std::size_t result = 0;
+	for(int i = 0; i < n; ++i){
+		auto fd = ready[i].data.fd;
+		if(fd == m_wake_fd){
+			std::uint64_t count;
+			while(::read( m_wake_fd, &count, sizeof(count) ) > 0);
+		}
+		else if(fd == m_scheduler.fd())
+			result += m_scheduler.dispatch();
+		else
+			result += ready_now( fd, ready[i].events );
+	}
+	return result;
+}
+
+void Reactor::run(){
+	while(true){
+		{
+			std::lock_guard lock(m_mutex);
+			if(m_stop){
+				m_stop = false;
+				return;
+			}
+		}
+		run_once();
+	}
+}
+
+void Reactor::stop(){
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	std::uint64_t one = 1;
+	posix_exception::check( ::write( m_wake_fd, &one, sizeof(one) ), "Failed waking reactor", meta::type<IOError>() );
+}
@@ -0,0 +1,48 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include "exception.hpp"
+#include "sheduler.hpp"
+
+using namespace levitator;
+using namespace jab::exception;
+using namespace jab;
+
+TimerFd::TimerFd():
+	m_fd( posix_exception::check( ::timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC ), "Failed creating timerfd", meta::type<IOError>() ) ){}
+
+TimerFd::~TimerFd(){
+	::close(m_fd);
+}
+
+int TimerFd::fd() const{
+	return m_fd;
+}
+
+void TimerFd::arm_at( const time_type &time ){
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>( time.time_since_epoch() ).count();
+
+	//Zero would disarm it, and the time may well be in the past, which is due straight away
+	if(ns <= 0)
+		ns = 1;
+
+	itimerspec spec{};
+	spec.it_value.tv_sec = ns / 1000000000;
+	spec.it_value.tv_nsec = ns % 1000000000;
+	posix_exception::check( ::timerfd_settime( m_fd, TFD_TIMER_ABSTIME, &spec, nullptr ), "Failed setting timerfd", meta::type<IOError>() );
+}
+
+void TimerFd::disarm(){
+	itimerspec spec{};
+	posix_exception::check( ::timerfd_settime( m_fd, 0, &spec, nullptr ), "Failed disarming timerfd", meta::type<IOError>() );
+}
+
+std::uint64_t TimerFd::read(){
+	std::uint64_t result = 0;
+	if(::read( m_fd, &result, sizeof(result) ) < 0){
+		if(errno == EAGAIN)
+			return 0;
+		throw posix_exception("Failed reading timerfd");
+	}
+	return result;
+}
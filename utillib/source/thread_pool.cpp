@@ -7,6 +7,44 @@
 using namespace levitator::concurrency;
 using namespace jab::exception;
 
+thread_local levitator::concurrency::impl::blocking_hook levitator::concurrency::impl::t_blocking_hook;
+
+BlockingScope::BlockingScope():
+	m_hook(impl::t_blocking_hook){
+	if(m_hook.notify)
+		m_hook.notify( m_hook.pool, true );
+}
+
+BlockingScope::~BlockingScope(){
+	if(m_hook.notify)
+		m_hook.notify( m_hook.pool, false );
+}
+
 DefaultThreadPoolExceptionHandler::DefaultThreadPoolExceptionHandler():
 	base_type( message ){
-}
\ No newline at end of file
+}
+
+CaptureTask::CaptureTask( std::function<void ()> &&proc ):
+	m_proc(std::move(proc)){}
+
+CaptureTask::CaptureTask( std::function<void ()> &&proc, std::exception_ptr &error ):
+	m_proc(std::move(proc)),
+	m_error(&error){}
+
+int CaptureTask::operator()(){
+	if(!m_proc)
+		return -1;
+
+	if(!m_error){
+		m_proc();
+		return 0;
+	}
+
+	try{
+		m_proc();
+	}
+	catch(...){
+		*m_error = std::current_exception();
+	}
+	return 0;
+}
@@ -0,0 +1,224 @@
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include "exception.hpp"
+#include "uring.hpp"
+
+using namespace jab::io;
+using namespace jab::exception;
+using namespace jab;
+
+namespace{
+
+int io_uring_setup( unsigned entries, ::io_uring_params *params ){
+	return int( ::syscall( __NR_io_uring_setup, entries, params ) );
+}
+
+int io_uring_enter( int fd, unsigned to_submit, unsigned min_complete, unsigned flags ){
+	return int( ::syscall( __NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0 ) );
+}
+
+int io_uring_register( int fd, unsigned opcode, const void *arg, unsigned nr_args ){
+	return int( ::syscall( __NR_io_uring_register, fd, opcode, arg, nr_args ) );
+}
+
+//The kernel's side of each ring is read with acquire and ours written with release, as it does the reverse
+unsigned load_acquire( unsigned *p ){
+	return std::atomic_ref<unsigned>(*p).load( std::memory_order_acquire );
+}
+
+void store_release( unsigned *p, unsigned v ){
+	std::atomic_ref<unsigned>(*p).store( v, std::memory_order_release );
+}
+
+void *map_ring( int fd, std::size_t size, ::off_t offset ){
+	auto result = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset );
+	return posix_exception::check( result, "Failed mapping io_uring", meta::type<IOError>(), MAP_FAILED );
+}
+
+}
+
+uring::uring( unsigned entries ){
+	::io_uring_params params{};
+	m_fd = posix_exception::check( io_uring_setup( entries, &params ), "Failed setting up io_uring", meta::type<IOError>() );
+
+	//Mapped one at a time, which every kernel with io_uring takes, whether or not it could share the rings' mapping
+	try{
+		m_sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		m_sq_map = map_ring( m_fd, m_sq_map_size, IORING_OFF_SQ_RING );
+		m_cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+		m_cq_map = map_ring( m_fd, m_cq_map_size, IORING_OFF_CQ_RING );
+		m_sqes_size = params.sq_entries * sizeof(::io_uring_sqe);
+		m_sqes = static_cast<::io_uring_sqe *>( map_ring( m_fd, m_sqes_size, IORING_OFF_SQES ) );
+	}
+	catch(...){
+		release();
+		throw;
+	}
+
+	auto sq = static_cast<char *>(m_sq_map);
+	m_sq_head = reinterpret_cast<unsigned *>( sq + params.sq_off.head );
+	m_sq_tail = reinterpret_cast<unsigned *>( sq + params.sq_off.tail );
+	m_sq_array = reinterpret_cast<unsigned *>( sq + params.sq_off.array );
+	m_sq_mask = *reinterpret_cast<unsigned *>( sq + params.sq_off.ring_mask );
+	m_sq_entries = params.sq_entries;
+
+	auto cq = static_cast<char *>(m_cq_map);
+	m_cq_head = reinterpret_cast<unsigned *>( cq + params.cq_off.head );
+	m_cq_tail = reinterpret_cast<unsigned *>( cq + params.cq_off.tail );
+	m_cq_mask = *reinterpret_cast<unsigned *>( cq + params.cq_off.ring_mask );
+	m_cqes = reinterpret_cast<::io_uring_cqe *>( cq + params.cq_off.cqes );
+}
+
+uring::~uring(){
+	release();
+}
+
+uring::uring( uring &&rhs ){
+	*this = std::move(rhs);
+}
+
+uring &uring::operator=( uring &&rhs ){
+	if(this != &rhs){
+		release();
+		m_fd = std::exchange( rhs.m_fd, -1 );
+		m_sq_map = std::exchange( rhs.m_sq_map, nullptr );
+		m_sq_map_size = rhs.m_sq_map_size;
+		m_cq_map = std::exchange( rhs.m_cq_map, nullptr );
+		m_cq_map_size = rhs.m_cq_map_size;
+		m_sqes = std::exchange( rhs.m_sqes, nullptr );
+		m_sqes_size = rhs.m_sqes_size;
+		m_sq_head = rhs.m_sq_head;
+		m_sq_tail = rhs.m_sq_tail;
+		m_sq_array = rhs.m_sq_array;
+		m_sq_mask = rhs.m_sq_mask;
+		m_sq_entries = rhs.m_sq_entries;
+		m_cq_head = rhs.m_cq_head;
+		m_cq_tail = rhs.m_cq_tail;
+		m_cq_mask = rhs.m_cq_mask;
+		m_cqes = rhs.m_cqes;
+		m_queued = std::exchange( rhs.m_queued, 0 );
+		m_in_flight = std::exchange( rhs.m_in_flight, 0 );
+	}
+	return *this;
+}
+
+void uring::release(){
+	if(m_sqes)
+		::munmap( m_sqes, m_sqes_size );
+	if(m_cq_map)
+		::munmap( m_cq_map, m_cq_map_size );
+	if(m_sq_map)
+		::munmap( m_sq_map, m_sq_map_size );
+	if(m_fd != -1)
+		::close(m_fd);
+	m_sqes = nullptr;
+	m_cq_map = m_sq_map = nullptr;
+	m_fd = -1;
+	m_queued = m_in_flight = 0;
+}
+
+//Linked operations came in 5.3, and the features field, nonzero ever since, in 5.4
+bool uring::supported(){
+	static const bool result = [](){
+		::io_uring_params params{};
+		int fd = io_uring_setup( 1, &params );
+		if(fd == -1)
+			return false;
+		::close(fd);
+		return params.features != 0;
+	}();
+	return result;
+}
+
+void uring::register_buffers( const ::iovec *iov, unsigned n ){
+	posix_exception::check( io_uring_register( m_fd, IORING_REGISTER_BUFFERS, iov, n ), "Failed registering io_uring buffers", meta::type<IOError>() );
+}
+
+void uring::queue( std::uint8_t opcode, int fd, const void *addr, unsigned len, std::uint64_t offset, std::uint64_t user_data,
+	std::uint8_t flags, std::uint16_t buffer, std::uint32_t op_flags ){
+
+	//Only this side moves the tail, so it needn't be loaded with acquire
+	auto tail = *m_sq_tail;
+	if(tail - load_acquire(m_sq_head) == m_sq_entries)
+		submit();
+
+	auto index = tail & m_sq_mask;
+	auto &sqe = m_sqes[index];
+	std::memset( &sqe, 0, sizeof(sqe) );
+	sqe.opcode = opcode;
+	sqe.flags = flags;
+	sqe.fd = fd;
+	sqe.off = offset;
+	sqe.addr = reinterpret_cast<std::uintptr_t>(addr);
+	sqe.len = len;
+	sqe.rw_flags = op_flags;
+	sqe.buf_index = buffer;
+	sqe.user_data = user_data;
+	m_sq_array[index] = index;
+
+	store_release( m_sq_tail, tail + 1 );
+	++m_queued;
+}
+
+void uring::readv( int fd, const ::iovec *iov, unsigned n, std::uint64_t offset, std::uint64_t user_data, std::uint8_t flags ){
+	queue( IORING_OP_READV, fd, iov, n, offset, user_data, flags );
+}
+
+void uring::writev( int fd, const ::iovec *iov, unsigned n, std::uint64_t offset, std::uint64_t user_data, std::uint8_t flags ){
+	queue( IORING_OP_WRITEV, fd, iov, n, offset, user_data, flags );
+}
+
+void uring::read_fixed( int fd, void *buf, unsigned len, std::uint64_t offset, unsigned buffer, std::uint64_t user_data, std::uint8_t flags ){
+	queue( IORING_OP_READ_FIXED, fd, buf, len, offset, user_data, flags, buffer );
+}
+
+void uring::write_fixed( int fd, const void *buf, unsigned len, std::uint64_t offset, unsigned buffer, std::uint64_t user_data, std::uint8_t flags ){
+	queue( IORING_OP_WRITE_FIXED, fd, buf, len, offset, user_data, flags, buffer );
+}
+
+void uring::fsync( int fd, bool datasync, std::uint64_t user_data, std::uint8_t flags ){
+	queue( IORING_OP_FSYNC, fd, nullptr, 0, 0, user_data, flags, 0, datasync ? IORING_FSYNC_DATASYNC : 0 );
+}
+
+void uring::submit( unsigned min_complete ){
+	auto flags = min_complete ? IORING_ENTER_GETEVENTS : 0u;
+	while(true){
+		int submitted = io_uring_enter( m_fd, m_queued, min_complete, flags );
+		if(submitted == -1 && errno == EINTR)
+			continue;
+		posix_exception::check( submitted, "Failed submitting to io_uring", meta::type<IOError>() );
+		m_queued -= submitted;
+		m_in_flight += submitted;
+		return;
+	}
+}
+
+bool uring::peek( completion &c ){
+	//Only this side moves the head
+	auto head = *m_cq_head;
+	if(head == load_acquire(m_cq_tail))
+		return false;
+
+	auto &cqe = m_cqes[head & m_cq_mask];
+	c = { cqe.user_data, cqe.res };
+	store_release( m_cq_head, head + 1 );
+	--m_in_flight;
+	return true;
+}
+
+uring::completion uring::wait(){
+	if(!m_queued && !m_in_flight)
+		throw std::logic_error("Waiting on an io_uring with nothing outstanding");
+
+	completion result;
+	while(!peek(result))
+		submit(1);
+	return result;
+}